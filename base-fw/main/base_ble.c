@@ -12,6 +12,9 @@
  *   - discover log service + CTRL/DATA characteristics
  *   - enable notifications
  *   - forward notifications to log_transfer_client
+ *
+ * The shears address is remembered in NVS so segments mirrored before a
+ * reboot are still tagged with the right device when forwarded to the Pi.
  */
 
 #include "base_ble.h"
@@ -21,6 +24,7 @@
 #include "esp_log.h"
 #include "esp_err.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 
 #include "nimble/nimble_port.h"
 #include "nimble/nimble_port_freertos.h"
@@ -51,10 +55,16 @@ static uint16_t s_logSvcStart       = 0;
 static uint16_t s_logSvcEnd         = 0;
 static uint16_t s_logCtrlChrHandle  = 0;
 static uint16_t s_logDataChrHandle  = 0;
+static uint16_t s_logDiagChrHandle  = 0;
+
+/* NVS location of the last connected shears address. */
+#define NVS_NAMESPACE       "base_ble"
+#define NVS_KEY_SHEARS_ADDR "shears_addr"
 
 /* Pending request storage if a log is requested before discovery finishes. */
 static bool  s_pendingRequest       = false;
 static char  s_pendingFilename[64]  = {0};
+static bool  s_pendingListRequest   = false;
 
 /* --- Forward declarations --- */
 static void startScan(void);
@@ -70,6 +80,50 @@ static int  gattDiscChrCb(uint16_t conn_handle,
                            const struct ble_gatt_chr *chr,
                            void *arg);
 
+/* --- Shears identity ----------------------------------------------------- */
+
+/* Hands the address saved by a previous boot to log_transfer_client. */
+static void loadShearsAddr(void)
+{
+	nvs_handle_t nvs;
+	if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+		return;
+	}
+
+	uint8_t addr[6];
+	size_t len = sizeof(addr);
+	if (nvs_get_blob(nvs, NVS_KEY_SHEARS_ADDR, addr, &len) == ESP_OK && len == sizeof(addr)) {
+		log_transfer_client_set_shears_addr(addr);
+	}
+	nvs_close(nvs);
+}
+
+/* Records the connected peer's identity address; NVS is only written on change. */
+static void storeShearsAddr(uint16_t connHandle)
+{
+	struct ble_gap_conn_desc desc;
+	if (ble_gap_conn_find(connHandle, &desc) != 0) {
+		return;
+	}
+
+	uint8_t prev[6];
+	if (log_transfer_client_get_shears_addr(prev) &&
+	    memcmp(prev, desc.peer_id_addr.val, sizeof(prev)) == 0) {
+		return;
+	}
+	log_transfer_client_set_shears_addr(desc.peer_id_addr.val);
+
+	nvs_handle_t nvs;
+	if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+		return;
+	}
+	if (nvs_set_blob(nvs, NVS_KEY_SHEARS_ADDR, desc.peer_id_addr.val, 6) != ESP_OK ||
+	    nvs_commit(nvs) != ESP_OK) {
+		ESP_LOGW(TAG, "Could not save shears address");
+	}
+	nvs_close(nvs);
+}
+
 /* --- Advertising helpers -------------------------------------------------- */
 
 /* Extract the advertised device name (if present). */
@@ -95,6 +149,7 @@ static void getAdvName(const struct ble_hs_adv_fields *fields,
 #define LOG_SVC_UUID       0xFFF0
 #define LOG_CTRL_CHR_UUID  0xFFF1
 #define LOG_DATA_CHR_UUID  0xFFF2
+#define LOG_DIAG_CHR_UUID  0xFFF3
 
 static int gattDiscSvcCb(uint16_t conn_handle,
                          const struct ble_gatt_error *error,
@@ -154,6 +209,10 @@ static int gattDiscChrCb(uint16_t conn_handle,
 			s_logDataChrHandle = chr->val_handle;
 			ESP_LOGI(TAG, "Found log DATA chr 0x%04x val_handle=0x%04x",
 			         uuid16, s_logDataChrHandle);
+		} else if (uuid16 == LOG_DIAG_CHR_UUID) {
+			s_logDiagChrHandle = chr->val_handle;
+			ESP_LOGI(TAG, "Found log DIAG chr 0x%04x val_handle=0x%04x",
+			         uuid16, s_logDiagChrHandle);
 		}
 		return 0;
 	}
@@ -191,6 +250,7 @@ static int gattDiscChrCb(uint16_t conn_handle,
 				.connHandle    = conn_handle,
 				.ctrlChrHandle = s_logCtrlChrHandle,
 				.dataChrHandle = s_logDataChrHandle,
+				.diagChrHandle = s_logDiagChrHandle,
 			};
 			log_transfer_client_init(&cfg);
 			ESP_LOGI(TAG, "Log transfer client initialized");
@@ -201,6 +261,12 @@ static int gattDiscChrCb(uint16_t conn_handle,
 				log_transfer_client_request_file(s_pendingFilename);
 				s_pendingRequest = false;
 			}
+
+			if (s_pendingListRequest) {
+				ESP_LOGI(TAG, "Issuing queued segment list request");
+				log_transfer_client_request_segment_list();
+				s_pendingListRequest = false;
+			}
 		} else {
 			ESP_LOGW(TAG, "Log transfer chars not fully discovered (ctrl=0x%04x data=0x%04x)",
 			         s_logCtrlChrHandle, s_logDataChrHandle);
@@ -274,6 +340,7 @@ static int gapEventHandler(struct ble_gap_event *event, void *arg)
 		if (event->connect.status == 0) {
 			ESP_LOGI(TAG, "Connected to WM-SHEARS");
 			s_connHandle = event->connect.conn_handle;
+			storeShearsAddr(s_connHandle);
 
 			if (connCallback) {
 				connCallback(true);
@@ -284,6 +351,7 @@ static int gapEventHandler(struct ble_gap_event *event, void *arg)
 			s_logSvcEnd        = 0;
 			s_logCtrlChrHandle = 0;
 			s_logDataChrHandle = 0;
+			s_logDiagChrHandle = 0;
 
 			ESP_LOGI(TAG, "Starting service discovery on shears");
 			ble_gattc_disc_all_svcs(s_connHandle, gattDiscSvcCb, NULL);
@@ -304,6 +372,7 @@ static int gapEventHandler(struct ble_gap_event *event, void *arg)
 		s_logSvcEnd         = 0;
 		s_logCtrlChrHandle  = 0;
 		s_logDataChrHandle  = 0;
+		s_logDiagChrHandle  = 0;
 		if (connCallback) {
 			connCallback(false);
 		}
@@ -405,6 +474,8 @@ void bleBaseInit(bleBaseConnCallback_t cb)
 	}
 	ESP_ERROR_CHECK(ret);
 
+	loadShearsAddr();
+
 	/* NimBLE host init + sync callback. */
 	nimble_port_init();
 	ble_hs_cfg.sync_cb = onSync;
@@ -445,3 +516,21 @@ esp_err_t bleBaseRequestLog(const char *filename)
 	ESP_LOGI(TAG, "GATT not ready yet, queued log request for '%s'", s_pendingFilename);
 	return ESP_OK;
 }
+
+/*
+ * Asks the shears for any sealed log segments not fetched yet.
+ *
+ * Queued the same way as bleBaseRequestLog() when discovery is still
+ * running.
+ */
+esp_err_t bleBaseRequestSegments(void)
+{
+	if (s_logCtrlChrHandle != 0 && s_logDataChrHandle != 0) {
+		return log_transfer_client_request_segment_list();
+	}
+
+	s_pendingListRequest = true;
+
+	ESP_LOGI(TAG, "GATT not ready yet, queued segment list request");
+	return ESP_OK;
+}
@@ -33,3 +33,11 @@ void bleBaseInit(bleBaseConnCallback_t cb);
  * once the service and characteristics are ready.
  */
 esp_err_t bleBaseRequestLog(const char *filename);
+
+/*
+ * Requests the list of sealed log segments from the shears and downloads
+ * each one not fetched yet on this connection.
+ *
+ * Queued until GATT discovery completes, like bleBaseRequestLog().
+ */
+esp_err_t bleBaseRequestSegments(void);
@@ -15,6 +15,12 @@
 
 #include "base_uartFileTransfer.h"
 #include "log_paths.h"
+#include "log_segments.h"
+#include "log_codec.h"
+#include "log_transfer_protocol.h"
+#include "log_transfer_client.h"
+#include "metrics.h"
+#include "trace.h"
 
 #define TAG "uartTx"
 
@@ -29,7 +35,12 @@
 #define BUTTON_GPIO			(GPIO_NUM_32)
 #define BUTTON_ACTIVE_LOW	1
 
-#define CSV_PATH			GPS_LOG_FILE_PATH
+/* Segments forwarded per directory scan; the task rescans until none are left. */
+#define SEGMENT_BATCH		8
+
+/* COMMIT failures of one segment before it is set aside under QUARANTINE_SUFFIX. */
+#define MAX_REJECTS			3
+#define QUARANTINE_SUFFIX	".bad"
 
 #define START_BYTE			0xAA
 
@@ -38,12 +49,16 @@
 #define TYPE_END			0x03
 #define TYPE_ACK			0x04
 #define TYPE_COMMIT			0x05
+#define TYPE_METRICS		0x06    // Fire-and-forget, never ACKed
 
 #define CHUNK_SIZE			255
 
 #define ACK_TIMEOUT_MS		500
 #define MAX_RETRIES			5
 
+/* Metrics go out after every forward and at least this often when idle. */
+#define METRICS_PERIOD_MS	60000
+
 /* ───────────────────────── Events ───────────────────────── */
 
 typedef struct {
@@ -55,6 +70,17 @@ static QueueHandle_t transferQueue;
 /* Busy lock: drop triggers while a transfer is in progress */
 static volatile bool transferBusy = false;
 
+/* Outcome of forwarding one segment. */
+typedef enum {
+	FORWARD_OK,			/* Committed (or empty) and deleted */
+	FORWARD_FAILED,		/* Local or link error; retried on the next run */
+	FORWARD_REJECTED	/* The Pi answered COMMIT with an error */
+} forwardResult_t;
+
+/* Segment at the head of the queue that the Pi has been rejecting. */
+static uint32_t rejectedSeq;
+static int rejectedCount;
+
 /* ───────────────────────── Packet helpers ───────────────────────── */
 
 static uint8_t checksumXor(const uint8_t* data, int len)
@@ -132,10 +158,8 @@ static bool uartTryReadPacket(uint8_t* type, uint8_t* payload, uint8_t* payloadL
 	uint8_t t = hdr[0];
 	uint8_t len = hdr[1];
 
-	if (len > CHUNK_SIZE) {
-		return false;
-	}
-
+	/* len is a byte, so any frame fits. */
+	_Static_assert(CHUNK_SIZE >= UINT8_MAX, "CHUNK_SIZE must hold a u8 length");
 	uint8_t tmp[CHUNK_SIZE + 1]; /* payload + checksum */
 	r = uart_read_bytes(UART_PORT, tmp, len + 1, pdMS_TO_TICKS(timeoutMs));
 	if (r != (len + 1)) {
@@ -207,6 +231,9 @@ static bool waitForCommit(uint32_t timeoutMs, uint8_t* outStatus)
 static bool sendWithAck(uint8_t type, const uint8_t* payload, uint8_t payloadLen)
 {
 	for (int attempt = 0; attempt < MAX_RETRIES; attempt++) {
+		if (attempt > 0) {
+			metrics_inc(METRIC_UART_RETRANSMITS);
+		}
 		if (uartSendPacket(type, payload, payloadLen) != ESP_OK) {
 			continue;
 		}
@@ -217,12 +244,12 @@ static bool sendWithAck(uint8_t type, const uint8_t* payload, uint8_t payloadLen
 	return false;
 }
 
-static bool transferCsvFile(void)
+static forwardResult_t transferCsvFile(const char* path, uint32_t seq)
 {
-	FILE* f = fopen(CSV_PATH, "rb");
+	FILE* f = fopen(path, "rb");
 	if (!f) {
-		ESP_LOGE(TAG, "Failed to open %s", CSV_PATH);
-		return false;
+		ESP_LOGE(TAG, "Failed to open %s", path);
+		return FORWARD_FAILED;
 	}
 
 	/* Determine file size */
@@ -230,32 +257,69 @@ static bool transferCsvFile(void)
 	long size = ftell(f);
 	fseek(f, 0, SEEK_SET);
 
-	if (size <= 0) {
-		ESP_LOGW(TAG, "File empty or invalid size (%ld), skipping", size);
+	if (size == 0) {
+		/* Nothing to forward; drop it so it does not block later segments. */
+		ESP_LOGW(TAG, "File empty, removing %s", path);
 		fclose(f);
-		return false;
+		remove(path);
+		return FORWARD_OK;
+	}
+
+	if (size < 0) {
+		ESP_LOGW(TAG, "Invalid size (%ld), skipping", size);
+		fclose(f);
+		return FORWARD_FAILED;
 	}
 
 	if (size > 0xFFFFFFFF) {
 		ESP_LOGE(TAG, "File too large");
 		fclose(f);
-		return false;
+		return FORWARD_FAILED;
 	}
 
 	uint32_t fileSize = (uint32_t)size;
 
-	/* START payload: [fileSize u32 little-endian] */
-	uint8_t startPayload[4];
+	/* Encoded files are forwarded as-is; the Pi decodes them. */
+	uint8_t magic[4] = {0};
+	size_t magicLen = fread(magic, 1, sizeof(magic), f);
+	fseek(f, 0, SEEK_SET);
+
+	uint8_t encoding = log_codec_is_encoded(magic, magicLen) ? LOG_XFER_ENC_DELTA_LZ
+	                                                         : LOG_XFER_ENC_RAW;
+
+	/*
+	 * START payload: [fileSize u32 LE][encoding u8][shears addr 6][seq u32 LE]
+	 *                [epoch u32 LE]
+	 * The Pi deduplicates on (addr, epoch, seq); an all-zero addr means
+	 * unknown. Segments mirrored before any epoch was known go out as 0.
+	 */
+	uint32_t epoch = 0;
+	log_epoch_load(&epoch);
+
+	uint8_t startPayload[19];
 	startPayload[0] = (uint8_t)(fileSize & 0xFF);
 	startPayload[1] = (uint8_t)((fileSize >> 8) & 0xFF);
 	startPayload[2] = (uint8_t)((fileSize >> 16) & 0xFF);
 	startPayload[3] = (uint8_t)((fileSize >> 24) & 0xFF);
-
-	ESP_LOGI(TAG, "START (size=%u)", fileSize);
-	if (!sendWithAck(TYPE_START, startPayload, 4)) {
+	startPayload[4] = encoding;
+	log_transfer_client_get_shears_addr(&startPayload[5]);
+	startPayload[11] = (uint8_t)(seq & 0xFF);
+	startPayload[12] = (uint8_t)((seq >> 8) & 0xFF);
+	startPayload[13] = (uint8_t)((seq >> 16) & 0xFF);
+	startPayload[14] = (uint8_t)((seq >> 24) & 0xFF);
+	startPayload[15] = (uint8_t)(epoch & 0xFF);
+	startPayload[16] = (uint8_t)((epoch >> 8) & 0xFF);
+	startPayload[17] = (uint8_t)((epoch >> 16) & 0xFF);
+	startPayload[18] = (uint8_t)((epoch >> 24) & 0xFF);
+
+	int64_t startUs = esp_timer_get_time();
+
+	ESP_LOGI(TAG, "START (size=%u, encoding=%u, seq=%u, epoch=%08x)",
+	         fileSize, encoding, seq, epoch);
+	if (!sendWithAck(TYPE_START, startPayload, sizeof(startPayload))) {
 		ESP_LOGE(TAG, "START not ACKed");
 		fclose(f);
-		return false;
+		return FORWARD_FAILED;
 	}
 
 	uint8_t chunk[CHUNK_SIZE];
@@ -271,13 +335,13 @@ static bool transferCsvFile(void)
 		if (got != toRead) {
 			ESP_LOGE(TAG, "Read error (%u/%u)", (unsigned)got, (unsigned)toRead);
 			fclose(f);
-			return false;
+			return FORWARD_FAILED;
 		}
 
 		if (!sendWithAck(TYPE_DATA, chunk, (uint8_t)got)) {
 			ESP_LOGE(TAG, "DATA not ACKed (sent=%u)", sent);
 			fclose(f);
-			return false;
+			return FORWARD_FAILED;
 		}
 
 		sent += (uint32_t)got;
@@ -288,31 +352,128 @@ static bool transferCsvFile(void)
 	ESP_LOGI(TAG, "END");
 	if (!sendWithAck(TYPE_END, NULL, 0)) {
 		ESP_LOGE(TAG, "END not ACKed");
-		return false;
+		return FORWARD_FAILED;
 	}
 
 	uint8_t commitStatus = 0xFF;
 	if (!waitForCommit(2000, &commitStatus)) {
 		ESP_LOGE(TAG, "No COMMIT received");
-		return false;
+		return FORWARD_FAILED;
 	}
 
 	if (commitStatus != 0x00) {
 		ESP_LOGE(TAG, "COMMIT error status=0x%02X", commitStatus);
+		return FORWARD_REJECTED;
+	}
+
+	metrics_inc(METRIC_UART_SEGMENTS_SENT);
+	metrics_observe_us(METRIC_HIST_UART_SEGMENT, esp_timer_get_time() - startUs);
+
+	ESP_LOGI(TAG, "COMMIT ok -> deleting %s", path);
+	if (remove(path) != 0) {
+		ESP_LOGE(TAG, "Failed to delete %s", path);
+		return FORWARD_FAILED;
+	}
+
+	return FORWARD_OK;
+}
+
+/*
+ * Counts a COMMIT failure of seq. Once the Pi has rejected the same segment
+ * MAX_REJECTS times in a row it is renamed out of the queue, so the
+ * segments behind it are not held up forever. Returns true if it was.
+ */
+static bool quarantineRejected(const char* path, uint32_t seq)
+{
+	if (seq != rejectedSeq) {
+		rejectedSeq = seq;
+		rejectedCount = 0;
+	}
+
+	if (++rejectedCount < MAX_REJECTS) {
 		return false;
 	}
 
-	ESP_LOGI(TAG, "COMMIT ok -> clearing file");
-	FILE* wf = fopen(CSV_PATH, "wb");
-	if (!wf) {
-		ESP_LOGE(TAG, "Failed to clear file");
+	char badPath[56];
+	snprintf(badPath, sizeof(badPath), "%s" QUARANTINE_SUFFIX, path);
+	remove(badPath);
+
+	if (rename(path, badPath) != 0) {
+		ESP_LOGE(TAG, "Could not set %s aside", path);
 		return false;
 	}
-	fclose(wf);
 
+	ESP_LOGE(TAG, "Pi rejected %s %d times; kept as %s", path, rejectedCount, badPath);
+	metrics_inc(METRIC_UART_QUARANTINED);
+	rejectedCount = 0;
 	return true;
 }
 
+/*
+ * Forwards every mirrored segment, oldest first. Stops at the first failure,
+ * except for a segment the Pi keeps rejecting, which is set aside.
+ */
+static bool transferSegments(void)
+{
+	uint32_t seqs[SEGMENT_BATCH];
+	int forwarded = 0;
+
+	while (1) {
+		int total = log_segment_list(0, seqs, SEGMENT_BATCH, NULL);
+		if (total < 0) {
+			ESP_LOGE(TAG, "Could not scan %s", GPS_LOG_DIR);
+			return false;
+		}
+		if (total == 0) {
+			break;
+		}
+
+		int batch = (total < SEGMENT_BATCH) ? total : SEGMENT_BATCH;
+		for (int i = 0; i < batch; i++) {
+			char path[48];
+			if (!log_segment_format_path(path, sizeof(path), seqs[i])) {
+				return false;
+			}
+
+			ESP_LOGI(TAG, "Segment %s (%d/%d pending)", path, i + 1, total);
+			TRACE_BEGIN(TRACE_ID_UART_SEGMENT, seqs[i]);
+			forwardResult_t res = transferCsvFile(path, seqs[i]);
+			TRACE_END(TRACE_ID_UART_SEGMENT, res == FORWARD_OK);
+
+			if (res == FORWARD_REJECTED && quarantineRejected(path, seqs[i])) {
+				continue;
+			}
+
+			if (res != FORWARD_OK) {
+				metrics_inc(METRIC_UART_RETRIES);
+				return false;
+			}
+			forwarded++;
+		}
+	}
+
+	if (forwarded == 0) {
+		ESP_LOGW(TAG, "No segments to forward");
+	}
+	return true;
+}
+
+/* Sends the base's own metrics and the last snapshot read from the shears. */
+static void sendMetrics(void)
+{
+	uint8_t snap[METRICS_SNAPSHOT_MAX];
+
+	size_t len = metrics_snapshot(METRICS_SOURCE_BASE, snap, sizeof(snap));
+	if (len > 0) {
+		uartSendPacket(TYPE_METRICS, snap, (uint8_t)len);
+	}
+
+	len = log_transfer_client_get_shears_metrics(snap, sizeof(snap));
+	if (len > 0) {
+		uartSendPacket(TYPE_METRICS, snap, (uint8_t)len);
+	}
+}
+
 /* ───────────────────────── Trigger plumbing ───────────────────────── */
 
 void transferStart(transferTrigger_t trigger)
@@ -354,7 +515,8 @@ static void transferTask(void* arg)
 
 	while (1) {
 		transferReq_t req;
-		if (xQueueReceive(transferQueue, &req, portMAX_DELAY) != pdTRUE) {
+		if (xQueueReceive(transferQueue, &req, pdMS_TO_TICKS(METRICS_PERIOD_MS)) != pdTRUE) {
+			sendMetrics();
 			continue;
 		}
 
@@ -369,9 +531,11 @@ static void transferTask(void* arg)
 
 		ESP_LOGI(TAG, "Transfer requested (trigger=%d)", (int)req.trigger);
 
-		bool ok = transferCsvFile();
+		bool ok = transferSegments();
 		ESP_LOGI(TAG, "Transfer %s", ok ? "OK" : "FAIL");
 
+		sendMetrics();
+
 		transferBusy = false;
 	}
 }
@@ -9,21 +9,31 @@
 #include <errno.h>
 #include <stdio.h>
 
-#ifndef GPS_LOG_FILE_PATH
-#define GPS_LOG_FILE_PATH	"/spiffs/gps_points.csv"
-#endif
+#include "log_segments.h"
+#include "log_transfer_client.h"
+#include "trace.h"
 
 #define csvDebugButtonGpio		GPIO_NUM_27
 #define debounceMs				200
+#define traceHoldMs				2000    // keep holding after the CSV print to dump traces
 
 static void formatUtcTime(const char *nmeaUtc, char *out, size_t outLen);
 static const char* TAG = "csvDbgBtn";
 static TaskHandle_t buttonTaskHandle = NULL;
 
 static void printCsvFile(void){
-  FILE *f = fopen(GPS_LOG_FILE_PATH, "r");
+  //newest segment still waiting to go to the Pi
+  uint32_t newestSeq = 0;
+  char path[48];
+  if (log_segment_list(0, NULL, 0, &newestSeq) <= 0 ||
+      !log_segment_format_path(path, sizeof(path), newestSeq)) {
+    ESP_LOGW(TAG, "No log segments pending on the base");
+    return;
+  }
+
+  FILE *f = fopen(path, "r");
   if (!f) {
-    ESP_LOGE(TAG, "Could not open CSV file for read");
+    ESP_LOGE(TAG, "Could not open %s for read", path);
     return;
   }
 
@@ -152,6 +162,14 @@ static void buttonTask(void* arg)
 		if (gpio_get_level(csvDebugButtonGpio) == 0) {
 			ESP_LOGI(TAG, "Button -> print CSV");
 			printCsvFile();
+
+			vTaskDelay(pdMS_TO_TICKS(traceHoldMs));
+			if (gpio_get_level(csvDebugButtonGpio) == 0) {
+				ESP_LOGI(TAG, "Button held -> dump base and shears traces");
+				trace_dump_console(TRACE_SOURCE_BASE);
+				log_transfer_client_request_trace();
+			}
+			ulTaskNotifyTake(pdTRUE, 0);    // drop edges seen while held
 		}
 	}
 }
@@ -4,61 +4,174 @@
  * Base-side client for the log transfer protocol.
  *
  * High-level behavior:
- *   - START_TRANSFER is written to the control characteristic with a filename
+ *   - LIST_SEGMENTS asks the shears which sealed log segments exist; the
+ *     shears also pushes that list on its own whenever it seals a segment
+ *   - segments newer than the last one fetched on this connection are
+ *     queued and requested one at a time with START_TRANSFER (basename plus
+ *     the preferred transfer encoding)
  *   - status updates arrive on the control characteristic
  *   - file chunks arrive on the data characteristic
- *   - payload is written to SPIFFS when available, otherwise stored in RAM
+ *   - payload is written to "<segment>.part" on SPIFFS and renamed to the
+ *     segment name once complete; a segment that cannot be written there is
+ *     fetched again like any other failed transfer
+ *   - a transfer that skips a chunk, comes up short of the size announced
+ *     in STATUS_OK or stalls is thrown away and the segment requested
+ *     again; one that keeps failing is skipped and retried once the rest
+ *     of the queue is done
+ *   - a stored segment is confirmed with ACK_SEGMENT, and only then does
+ *     the shears delete its copy
  *   - on completion, the first few lines are printed for a quick sanity check
+ *     and the UART task is kicked to forward the segment to the Pi
+ *   - after each segment the shears diagnostics characteristic is read and
+ *     the snapshot cached for the UART task to pass on
+ *   - a requested shears trace dump is echoed to the console (trace.h)
+ *   - the shears' BLE address is kept for the UART task, which tags every
+ *     forwarded segment with it; the storage epoch from SEGMENT_LIST is
+ *     kept in GPS_LOG_EPOCH_PATH next to the segments it numbers
+ *
+ * Encoded transfers are stored as received; the Pi decodes them.
  */
 
 #include <stdio.h>
 #include <string.h>
-#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
 #include "host/ble_hs.h"
 
 #include "log_transfer_client.h"
 #include "log_transfer_protocol.h"
 #include "log_paths.h"
+#include "log_segments.h"
 #include "base_uartFileTransfer.h"
+#include "metrics.h"
+#include "trace.h"
 
 static const char *TAG = "log_xfer_cli";
 
+/* Encoding requested from the shears; the shears may answer with RAW. */
+#define LOG_XFER_REQUEST_ENCODING  LOG_XFER_ENC_DELTA_LZ
+
+/* Suffix of a segment that is still being received. */
+#define PART_SUFFIX  ".part"
+
+/* Fetches of one segment in a row before it is skipped for now. */
+#define SEGMENT_FETCH_ATTEMPTS   3
+
+/* A fetch with no status or chunk for this long is given up. */
+#define XFER_STALL_US            (2 * 1000 * 1000)
+
+/* Idle time before skipped segments are listed and fetched again. */
+#define SKIPPED_RETRY_US         (5 * 1000 * 1000)
+
+#define XFER_WATCHDOG_PERIOD_US  (500 * 1000)
+
 /* --- Internal state ------------------------------------------------------- */
 
 typedef struct {
 	bool     active;
+	bool     awaitingStatus;
 	char     requestedName[64];
+	char     localPath[80];
+	char     partPath[88];
 	FILE    *fp;
 
-	uint8_t *buf;
-	uint32_t buf_size;
-
 	uint32_t expectedSize;
 	uint32_t bytesReceived;
 	uint16_t nextChunkIndex;
+	uint8_t  encoding;
+	bool     chunkGap;           /* A chunk was lost; the payload is unusable */
+	int64_t  acceptedUs;         /* STATUS_OK time, for the fetch histogram */
+	int64_t  lastEventUs;        /* Last request, status or chunk (watchdog) */
+
+	/* Segment bookkeeping; reset with the rest of the state per connection. */
+	uint32_t currentSeq;         /* Segment being fetched, 0 if not a segment */
+	uint32_t highWaterSeq;       /* Newest segment fetched on this connection */
+	uint32_t queuedSeq;          /* Newest segment fetched or queued */
+	uint32_t pendingSeqs[LOG_XFER_SEGMENT_LIST_MAX];
+	int      pendingCount;
+	bool     listMore;           /* Shears reported segments past the last list */
+	uint32_t retrySeq;           /* Segment whose fetch failed last */
+	int      retryCount;         /* Failed fetches of retrySeq */
+	bool     rescanSkipped;      /* A segment was skipped; list again when idle */
 } base_log_transfer_state_t;
 
+/* Latest shears metrics snapshot; read_long fragments land in rx first. */
+typedef struct {
+	SemaphoreHandle_t lock;
+	bool     reading;
+	uint16_t rxLen;
+	uint8_t  rx[METRICS_SNAPSHOT_MAX];
+	uint16_t len;
+	uint8_t  snapshot[METRICS_SNAPSHOT_MAX];
+} shears_metrics_cache_t;
+
+/* Identity of the shears on the other end; see set_shears_addr(). */
+static portMUX_TYPE g_shearsAddrMux = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t g_shearsAddr[6];
+static bool    g_shearsAddrKnown;
+
 static log_transfer_client_cfg_t g_cfg;
 static base_log_transfer_state_t g_state;
+static shears_metrics_cache_t g_shearsMetrics;
+
+/* Guards g_state: notifications arrive on the BLE host task, the watchdog on esp_timer. */
+static SemaphoreHandle_t g_stateLock;
+static esp_timer_handle_t g_watchdogTimer;
 
 static void dump_downloaded_file(void);
+static void read_shears_metrics(void);
+static void request_next_segment(void);
+static void drop_pending_segments(void);
+static void retry_segment(const char *reason);
+static void watchdog_timer_cb(void *arg);
 
 /* --- Public API ----------------------------------------------------------- */
 
 void log_transfer_client_init(const log_transfer_client_cfg_t *cfg)
 {
+	if (!g_stateLock) {
+		g_stateLock = xSemaphoreCreateMutex();
+	}
+
+	xSemaphoreTake(g_stateLock, portMAX_DELAY);
+
+	/* A transfer cut short by a disconnect leaves its partial file open. */
+	if (g_state.fp) {
+		fclose(g_state.fp);
+		remove(g_state.partPath);
+	}
+
 	memset(&g_state, 0, sizeof(g_state));
 
 	if (cfg) {
 		g_cfg = *cfg;
 	}
 
-	ESP_LOGI(TAG, "client_init: conn=%u ctrl=0x%04x data=0x%04x",
-	         g_cfg.connHandle, g_cfg.ctrlChrHandle, g_cfg.dataChrHandle);
+	xSemaphoreGive(g_stateLock);
+
+	if (!g_watchdogTimer) {
+		const esp_timer_create_args_t watchdogArgs = {
+			.callback = watchdog_timer_cb,
+			.name     = "xfer_watchdog"
+		};
+		esp_timer_create(&watchdogArgs, &g_watchdogTimer);
+		esp_timer_start_periodic(g_watchdogTimer, XFER_WATCHDOG_PERIOD_US);
+	}
+
+	if (!g_shearsMetrics.lock) {
+		g_shearsMetrics.lock = xSemaphoreCreateMutex();
+	}
+	g_shearsMetrics.reading = false;
+
+	ESP_LOGI(TAG, "client_init: conn=%u ctrl=0x%04x data=0x%04x diag=0x%04x",
+	         g_cfg.connHandle, g_cfg.ctrlChrHandle, g_cfg.dataChrHandle,
+	         g_cfg.diagChrHandle);
 }
 
 void log_transfer_client_set_conn_handle(uint16_t connHandle)
@@ -66,7 +179,7 @@ void log_transfer_client_set_conn_handle(uint16_t connHandle)
 	g_cfg.connHandle = connHandle;
 }
 
-esp_err_t log_transfer_client_request_file(const char *filename)
+static esp_err_t send_start_transfer(const char *filename)
 {
 	if (!filename || filename[0] == '\0') {
 		return ESP_ERR_INVALID_ARG;
@@ -77,19 +190,24 @@ esp_err_t log_transfer_client_request_file(const char *filename)
 		return ESP_FAIL;
 	}
 
-	uint8_t buf[1 + 64];
+	uint8_t buf[1 + 64 + 1];
 	uint16_t len = 0;
 
 	buf[len++] = CTRL_CMD_START_TRANSFER;
 
-	size_t nameLen = strnlen(filename, sizeof(buf) - 2);
+	size_t nameLen = strnlen(filename, sizeof(buf) - 3);
 	memcpy(&buf[len], filename, nameLen);
 	len += nameLen;
 	buf[len++] = '\0';
+	buf[len++] = LOG_XFER_REQUEST_ENCODING;
 
 	strncpy(g_state.requestedName, filename, sizeof(g_state.requestedName));
 	g_state.requestedName[sizeof(g_state.requestedName) - 1] = '\0';
 
+	if (!log_segment_parse_name(g_state.requestedName, &g_state.currentSeq)) {
+		g_state.currentSeq = 0;
+	}
+
 	int rc = ble_gattc_write_flat(g_cfg.connHandle,
 	                              g_cfg.ctrlChrHandle,
 	                              buf,
@@ -101,18 +219,421 @@ esp_err_t log_transfer_client_request_file(const char *filename)
 		return ESP_FAIL;
 	}
 
+	g_state.awaitingStatus = true;
+	g_state.lastEventUs = esp_timer_get_time();
+
 	ESP_LOGI(TAG, "Requested file '%s' from shears (conn=%u, ctrl=0x%04x)",
 	         g_state.requestedName, g_cfg.connHandle, g_cfg.ctrlChrHandle);
 
 	return ESP_OK;
 }
 
+static esp_err_t send_list_request(void)
+{
+	if (g_cfg.ctrlChrHandle == 0) {
+		ESP_LOGE(TAG, "Control characteristic handle is 0; client not initialized");
+		return ESP_FAIL;
+	}
+
+	uint8_t buf[1 + 4];
+	buf[0] = CTRL_CMD_LIST_SEGMENTS;
+	memcpy(&buf[1], &g_state.queuedSeq, sizeof(g_state.queuedSeq));
+
+	int rc = ble_gattc_write_flat(g_cfg.connHandle,
+	                              g_cfg.ctrlChrHandle,
+	                              buf,
+	                              sizeof(buf),
+	                              NULL,
+	                              NULL);
+	if (rc != 0) {
+		ESP_LOGE(TAG, "LIST_SEGMENTS write failed rc=%d", rc);
+		return ESP_FAIL;
+	}
+
+	ESP_LOGI(TAG, "Requested segment list (after=%u)", g_state.queuedSeq);
+	return ESP_OK;
+}
+
+static void send_segment_ack(uint32_t seq)
+{
+	uint8_t buf[1 + 4];
+	buf[0] = CTRL_CMD_ACK_SEGMENT;
+	memcpy(&buf[1], &seq, sizeof(seq));
+
+	int rc = ble_gattc_write_flat(g_cfg.connHandle,
+	                              g_cfg.ctrlChrHandle,
+	                              buf,
+	                              sizeof(buf),
+	                              NULL,
+	                              NULL);
+	if (rc != 0) {
+		/* The shears keeps the segment and lists it again; the Pi drops the duplicate. */
+		ESP_LOGW(TAG, "ACK_SEGMENT %u write failed rc=%d", seq, rc);
+	}
+}
+
+esp_err_t log_transfer_client_request_file(const char *filename)
+{
+	if (!g_stateLock) {
+		return ESP_FAIL;
+	}
+
+	xSemaphoreTake(g_stateLock, portMAX_DELAY);
+	esp_err_t err = send_start_transfer(filename);
+	xSemaphoreGive(g_stateLock);
+
+	return err;
+}
+
+esp_err_t log_transfer_client_request_segment_list(void)
+{
+	if (!g_stateLock) {
+		return ESP_FAIL;
+	}
+
+	xSemaphoreTake(g_stateLock, portMAX_DELAY);
+	esp_err_t err = send_list_request();
+	xSemaphoreGive(g_stateLock);
+
+	return err;
+}
+
+esp_err_t log_transfer_client_request_trace(void)
+{
+	if (g_cfg.ctrlChrHandle == 0) {
+		ESP_LOGE(TAG, "Control characteristic handle is 0; client not initialized");
+		return ESP_FAIL;
+	}
+
+	uint8_t op = CTRL_CMD_TRACE_DUMP;
+	int rc = ble_gattc_write_flat(g_cfg.connHandle,
+	                              g_cfg.ctrlChrHandle,
+	                              &op,
+	                              sizeof(op),
+	                              NULL,
+	                              NULL);
+	if (rc != 0) {
+		ESP_LOGE(TAG, "TRACE_DUMP write failed rc=%d", rc);
+		return ESP_FAIL;
+	}
+
+	ESP_LOGI(TAG, "Requested shears trace");
+	return ESP_OK;
+}
+
+void log_transfer_client_set_shears_addr(const uint8_t addr[6])
+{
+	portENTER_CRITICAL(&g_shearsAddrMux);
+	memcpy(g_shearsAddr, addr, sizeof(g_shearsAddr));
+	g_shearsAddrKnown = true;
+	portEXIT_CRITICAL(&g_shearsAddrMux);
+}
+
+bool log_transfer_client_get_shears_addr(uint8_t addr[6])
+{
+	portENTER_CRITICAL(&g_shearsAddrMux);
+	bool known = g_shearsAddrKnown;
+	if (known) {
+		memcpy(addr, g_shearsAddr, sizeof(g_shearsAddr));
+	} else {
+		memset(addr, 0, sizeof(g_shearsAddr));
+	}
+	portEXIT_CRITICAL(&g_shearsAddrMux);
+	return known;
+}
+
+size_t log_transfer_client_get_shears_metrics(uint8_t *out, size_t cap)
+{
+	if (!out || !g_shearsMetrics.lock) {
+		return 0;
+	}
+
+	size_t len = 0;
+	xSemaphoreTake(g_shearsMetrics.lock, portMAX_DELAY);
+	if (g_shearsMetrics.len > 0 && g_shearsMetrics.len <= cap) {
+		len = g_shearsMetrics.len;
+		memcpy(out, g_shearsMetrics.snapshot, len);
+	}
+	xSemaphoreGive(g_shearsMetrics.lock);
+
+	return len;
+}
+
+/* --- Shears diagnostics --------------------------------------------------- */
+
+static int on_diag_read(uint16_t conn_handle,
+                        const struct ble_gatt_error *error,
+                        struct ble_gatt_attr *attr,
+                        void *arg)
+{
+	(void)conn_handle;
+	(void)arg;
+
+	if (error->status == 0 && attr) {
+		uint16_t n = OS_MBUF_PKTLEN(attr->om);
+		if (g_shearsMetrics.rxLen + n > sizeof(g_shearsMetrics.rx)) {
+			ESP_LOGW(TAG, "Shears metrics larger than %u bytes; dropped",
+			         (unsigned)sizeof(g_shearsMetrics.rx));
+			g_shearsMetrics.reading = false;
+			return BLE_HS_EINVAL;    /* Stops the procedure */
+		}
+		os_mbuf_copydata(attr->om, 0, n, &g_shearsMetrics.rx[g_shearsMetrics.rxLen]);
+		g_shearsMetrics.rxLen += n;
+		return 0;
+	}
+
+	if (error->status == BLE_HS_EDONE && g_shearsMetrics.reading) {
+		xSemaphoreTake(g_shearsMetrics.lock, portMAX_DELAY);
+		memcpy(g_shearsMetrics.snapshot, g_shearsMetrics.rx, g_shearsMetrics.rxLen);
+		g_shearsMetrics.len = g_shearsMetrics.rxLen;
+		xSemaphoreGive(g_shearsMetrics.lock);
+
+		ESP_LOGI(TAG, "Shears metrics updated (%u bytes)", g_shearsMetrics.len);
+	} else if (error->status != BLE_HS_EDONE) {
+		ESP_LOGW(TAG, "Diagnostics read failed status=%u", error->status);
+	}
+
+	g_shearsMetrics.reading = false;
+	return 0;
+}
+
+static void read_shears_metrics(void)
+{
+	if (g_cfg.diagChrHandle == 0 || g_shearsMetrics.reading) {
+		return;
+	}
+
+	g_shearsMetrics.reading = true;
+	g_shearsMetrics.rxLen = 0;
+
+	int rc = ble_gattc_read_long(g_cfg.connHandle, g_cfg.diagChrHandle, 0,
+	                             on_diag_read, NULL);
+	if (rc != 0) {
+		ESP_LOGW(TAG, "Diagnostics read not started rc=%d", rc);
+		g_shearsMetrics.reading = false;
+	}
+}
+
+/* --- Segment queue -------------------------------------------------------- */
+
+static void drop_pending_segments(void)
+{
+	/* Anything not fetched yet is offered again by the next SEGMENT_LIST. */
+	g_state.pendingCount = 0;
+	g_state.listMore     = false;
+	g_state.queuedSeq    = g_state.highWaterSeq;
+}
+
+static void request_next_segment(void)
+{
+	if (g_state.active || g_state.awaitingStatus) {
+		return;
+	}
+
+	if (g_state.pendingCount == 0) {
+		if (g_state.listMore) {
+			g_state.listMore = false;
+			send_list_request();
+		}
+		return;
+	}
+
+	uint32_t seq = g_state.pendingSeqs[0];
+	g_state.pendingCount--;
+	memmove(&g_state.pendingSeqs[0], &g_state.pendingSeqs[1],
+	        (size_t)g_state.pendingCount * sizeof(g_state.pendingSeqs[0]));
+
+	char name[GPS_LOG_SEGMENT_NAME_MAX];
+	if (!log_segment_format_name(name, sizeof(name), seq) ||
+	    send_start_transfer(name) != ESP_OK) {
+		drop_pending_segments();
+	}
+}
+
+/* Closes and deletes whatever the current fetch has received so far. */
+static void discard_current_fetch(void)
+{
+	if (g_state.fp) {
+		fclose(g_state.fp);
+		g_state.fp = NULL;
+		remove(g_state.partPath);
+	}
+	g_state.active = false;
+	g_state.awaitingStatus = false;
+}
+
+/*
+ * Throws away the current fetch and puts its segment back at the head of
+ * the queue. After SEGMENT_FETCH_ATTEMPTS failures in a row the segment is
+ * skipped instead, so it cannot hold up the ones behind it; the shears
+ * still has it, and the watchdog lists it again once the queue is idle.
+ */
+static void retry_segment(const char *reason)
+{
+	uint32_t seq = g_state.currentSeq;
+
+	discard_current_fetch();
+	metrics_inc(METRIC_SEGMENTS_DISCARDED);
+
+	if (seq == 0) {
+		ESP_LOGW(TAG, "Fetch of '%s' failed (%s)", g_state.requestedName, reason);
+		return;
+	}
+
+	if (seq == g_state.retrySeq) {
+		g_state.retryCount++;
+	} else {
+		g_state.retrySeq = seq;
+		g_state.retryCount = 1;
+	}
+
+	if (g_state.retryCount >= SEGMENT_FETCH_ATTEMPTS) {
+		ESP_LOGE(TAG, "Segment %u failed %d times (%s); skipped for now",
+		         seq, g_state.retryCount, reason);
+		g_state.rescanSkipped = true;
+		return;
+	}
+
+	ESP_LOGW(TAG, "Segment %u fetch failed (%s); requesting it again", seq, reason);
+
+	if (g_state.pendingCount == LOG_XFER_SEGMENT_LIST_MAX) {
+		/* Make room; the newest one is listed again later. */
+		g_state.pendingCount--;
+		g_state.queuedSeq = g_state.pendingSeqs[g_state.pendingCount] - 1;
+		g_state.listMore  = true;
+	}
+
+	memmove(&g_state.pendingSeqs[1], &g_state.pendingSeqs[0],
+	        (size_t)g_state.pendingCount * sizeof(g_state.pendingSeqs[0]));
+	g_state.pendingSeqs[0] = seq;
+	g_state.pendingCount++;
+}
+
+static void watchdog_timer_cb(void *arg)
+{
+	(void)arg;
+
+	xSemaphoreTake(g_stateLock, portMAX_DELAY);
+
+	int64_t quietUs = esp_timer_get_time() - g_state.lastEventUs;
+	bool busy = g_state.active || g_state.awaitingStatus;
+
+	if (busy && quietUs > XFER_STALL_US) {
+		/* A lost START write, STATUS_OK or TRANSFER_DONE would otherwise wait forever. */
+		retry_segment("stalled");
+		request_next_segment();
+	} else if (!busy && g_state.pendingCount == 0 && g_state.rescanSkipped &&
+	           quietUs > SKIPPED_RETRY_US) {
+		/*
+		 * Acknowledged segments are gone, so a full list is exactly what is
+		 * missing. Repeated until handle_segment_list() sees the answer.
+		 */
+		g_state.retryCount    = 0;
+		g_state.queuedSeq     = 0;
+		g_state.lastEventUs   = esp_timer_get_time();
+		send_list_request();
+	}
+
+	xSemaphoreGive(g_stateLock);
+}
+
+/*
+ * Makes epoch the one mirrored segments are forwarded under. Segments of
+ * the previous epoch still on the base would be forwarded with the new one
+ * and could shadow the new segments with the same numbers on the Pi, so
+ * the switch waits until the UART task has forwarded all of them.
+ */
+static bool adopt_epoch(uint32_t epoch)
+{
+	uint32_t mirrored = 0;
+	log_epoch_load(&mirrored);
+	if (epoch == mirrored) {
+		return true;
+	}
+
+	int waiting = log_segment_list(0, NULL, 0, NULL);
+	if (waiting != 0) {
+		ESP_LOGW(TAG, "Shears epoch %08x; %d segment(s) of epoch %08x still to forward",
+		         epoch, waiting, mirrored);
+		return false;
+	}
+
+	if (!log_epoch_store(epoch)) {
+		ESP_LOGE(TAG, "Could not write %s", GPS_LOG_EPOCH_PATH);
+		return false;
+	}
+
+	ESP_LOGI(TAG, "Shears storage epoch %08x (was %08x)", epoch, mirrored);
+	return true;
+}
+
+static void handle_segment_list(const uint8_t *data, uint16_t len)
+{
+	if (len < LOG_XFER_SEGMENT_LIST_HDR) {
+		return;
+	}
+
+	uint8_t count = data[1];
+	bool more = data[2] != 0;
+
+	if (len < LOG_XFER_SEGMENT_LIST_HDR + (uint16_t)count * 4) {
+		ESP_LOGW(TAG, "SEGMENT_LIST truncated (count=%u len=%u)", count, len);
+		return;
+	}
+
+	uint32_t epoch;
+	memcpy(&epoch, &data[3], sizeof(epoch));
+	if (!adopt_epoch(epoch)) {
+		/* Not fetched yet; the watchdog lists again once the link is idle. */
+		g_state.rescanSkipped = true;
+		return;
+	}
+
+	/* Listed from the start: skipped segments are queued again below. */
+	if (g_state.queuedSeq == 0) {
+		g_state.rescanSkipped = false;
+	}
+
+	int added = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		uint32_t seq;
+		memcpy(&seq, &data[LOG_XFER_SEGMENT_LIST_HDR + i * 4], sizeof(seq));
+
+		if (seq <= g_state.queuedSeq) {
+			continue;   /* Already fetched or queued */
+		}
+
+		if (g_state.pendingCount >= LOG_XFER_SEGMENT_LIST_MAX) {
+			more = true;
+			break;
+		}
+
+		g_state.pendingSeqs[g_state.pendingCount++] = seq;
+		g_state.queuedSeq = seq;
+		added++;
+	}
+
+	if (more) {
+		g_state.listMore = true;
+	}
+
+	ESP_LOGI(TAG, "SEGMENT_LIST: count=%u new=%d pending=%d more=%d",
+	         count, added, g_state.pendingCount, more);
+
+	request_next_segment();
+}
+
 /* --- Notification handlers ------------------------------------------------ */
 
-void log_transfer_client_on_ctrl_notify(const uint8_t *data, uint16_t len)
+static void handle_ctrl_notify(const uint8_t *data, uint16_t len)
 {
 	ESP_LOGI(TAG, "CTRL notify: len=%u", len);
 
+	if (len >= 1 && data[0] == CTRL_EVT_TRACE) {
+		trace_print_hex(&data[1], len - 1);
+		return;
+	}
+
 	if (len < 2) {
 		return;
 	}
@@ -122,6 +643,11 @@ void log_transfer_client_on_ctrl_notify(const uint8_t *data, uint16_t len)
 
 	ESP_LOGI(TAG, "CTRL notify: opcode=0x%02X status=0x%02X", opcode, status);
 
+	if (opcode == CTRL_EVT_SEGMENT_LIST) {
+		handle_segment_list(data, len);
+		return;
+	}
+
 	if (opcode != CTRL_EVT_STATUS) {
 		ESP_LOGW(TAG, "Unknown CTRL EVT opcode 0x%02X", opcode);
 		return;
@@ -129,6 +655,10 @@ void log_transfer_client_on_ctrl_notify(const uint8_t *data, uint16_t len)
 
 	ctrl_status_code_t st = (ctrl_status_code_t)status;
 
+	if (st != STATUS_TRANSFER_DONE && st != STATUS_TRANSFER_ABORTED) {
+		g_state.awaitingStatus = false;
+	}
+
 	switch (st) {
 
 	case STATUS_OK: {
@@ -140,96 +670,122 @@ void log_transfer_client_on_ctrl_notify(const uint8_t *data, uint16_t len)
 		uint32_t fileSize = 0;
 		memcpy(&fileSize, &data[2], sizeof(fileSize));
 
-		if (g_state.active) {
-			if (g_state.fp) {
-				fclose(g_state.fp);
-				g_state.fp = NULL;
-			}
-			if (g_state.buf) {
-				free(g_state.buf);
-				g_state.buf = NULL;
-				g_state.buf_size = 0;
-			}
+		/* Older shears firmware omits the encoding byte. */
+		uint8_t encoding = (len >= 7) ? data[6] : LOG_XFER_ENC_RAW;
+
+		if (g_state.active && g_state.fp) {
+			fclose(g_state.fp);
+			g_state.fp = NULL;
 		}
 
-		g_state.fp = fopen(GPS_LOG_FILE_PATH, "wb");
+		snprintf(g_state.localPath, sizeof(g_state.localPath),
+		         GPS_LOG_DIR "/%s", g_state.requestedName);
+		snprintf(g_state.partPath, sizeof(g_state.partPath),
+		         "%s" PART_SUFFIX, g_state.localPath);
+
+		g_state.fp = fopen(g_state.partPath, "wb");
 		if (!g_state.fp) {
-			ESP_LOGE(TAG,
-			         "Failed to open local file '%s', using RAM buffer only",
-			         GPS_LOG_FILE_PATH);
-
-			g_state.buf = (uint8_t *)malloc(fileSize);
-			if (!g_state.buf) {
-				ESP_LOGE(TAG, "RAM allocation failed for %u bytes", fileSize);
-				g_state.active = false;
-				return;
-			}
-			g_state.buf_size = fileSize;
-		} else {
-			ESP_LOGI(TAG, "Opened local file '%s' for writing", GPS_LOG_FILE_PATH);
-			g_state.buf = NULL;
-			g_state.buf_size = 0;
+			/*
+			 * The chunks already on their way are ignored; the segment is
+			 * requested again once the shears reports TRANSFER_DONE.
+			 */
+			ESP_LOGE(TAG, "Failed to open local file '%s'", g_state.partPath);
+			retry_segment("cannot store");
+			return;
 		}
+		ESP_LOGI(TAG, "Opened local file '%s' for writing", g_state.partPath);
 
 		g_state.active         = true;
 		g_state.expectedSize   = fileSize;
 		g_state.bytesReceived  = 0;
 		g_state.nextChunkIndex = 0;
+		g_state.encoding       = encoding;
+		g_state.chunkGap       = false;
+		g_state.acceptedUs     = esp_timer_get_time();
+		g_state.lastEventUs    = g_state.acceptedUs;
 
-		ESP_LOGI(TAG, "Transfer accepted; size=%u bytes (dest='%s', RAM=%s)",
-		         fileSize,
-		         GPS_LOG_FILE_PATH,
-		         g_state.buf ? "yes" : "no");
+		ESP_LOGI(TAG, "Transfer accepted; size=%u bytes (dest='%s', encoding=%u)",
+		         fileSize, g_state.localPath, encoding);
 		break;
 	}
 
 	case STATUS_TRANSFER_DONE:
-		if (g_state.active) {
+		if (g_state.active &&
+		    (g_state.chunkGap || g_state.bytesReceived != g_state.expectedSize)) {
+			ESP_LOGW(TAG, "Transfer incomplete: received=%u bytes, expected=%u, gap=%d",
+			         g_state.bytesReceived, g_state.expectedSize, g_state.chunkGap);
+			retry_segment(g_state.chunkGap ? "chunk lost" : "short");
+		} else if (g_state.active) {
 			ESP_LOGI(TAG,
 			         "Transfer finished from shears: received=%u bytes, expected=%u",
 			         g_state.bytesReceived, g_state.expectedSize);
 
-			if (g_state.fp) {
-				fclose(g_state.fp);
-				g_state.fp = NULL;
+			fclose(g_state.fp);
+			g_state.fp = NULL;
+
+			/* Publish the segment to the UART task under its final name. */
+			remove(g_state.localPath);
+			if (rename(g_state.partPath, g_state.localPath) != 0) {
+				ESP_LOGE(TAG, "Could not rename '%s'", g_state.partPath);
+				remove(g_state.partPath);
+				retry_segment("cannot store");
+				request_next_segment();
+				break;
 			}
 
 			g_state.active = false;
+			g_state.awaitingStatus = false;
+
+			metrics_inc(METRIC_SEGMENTS_FETCHED);
+			metrics_observe_us(METRIC_HIST_SEGMENT_FETCH,
+			                   esp_timer_get_time() - g_state.acceptedUs);
+
+			if (g_state.currentSeq > g_state.highWaterSeq) {
+				g_state.highWaterSeq = g_state.currentSeq;
+			}
+
+			dump_downloaded_file();
+
+			/* Before the UART kick, so the forward carries fresh numbers. */
+			read_shears_metrics();
+
+			/* The base owns the segment now; let the shears drop its copy. */
+			if (g_state.currentSeq != 0) {
+				send_segment_ack(g_state.currentSeq);
+			}
 
 			ESP_LOGI(TAG, "Triggering UART transfer to Raspberry Pi");
 			transferStart(TRANSFER_TRIGGER_EVENT);
+		} else if (g_state.awaitingStatus) {
+			/* STATUS_OK was lost, so none of the chunks were kept. */
+			retry_segment("no STATUS_OK");
 		} else {
 			ESP_LOGW(TAG, "Transfer done but no active state");
-			g_state.active = false;
 		}
 
-		dump_downloaded_file();
+		request_next_segment();
 		break;
 
 	case STATUS_ERR_NO_FILE:
+		/* Already gone on the shears (e.g. cleared); move on to the next one. */
 		ESP_LOGW(TAG, "Shears: file not found");
+		request_next_segment();
 		break;
 
 	case STATUS_ERR_BUSY:
 		ESP_LOGW(TAG, "Shears: busy");
+		drop_pending_segments();
 		break;
 
 	case STATUS_ERR_FS:
 		ESP_LOGW(TAG, "Shears: filesystem error");
+		drop_pending_segments();
 		break;
 
 	case STATUS_TRANSFER_ABORTED:
 		ESP_LOGW(TAG, "Shears: transfer aborted");
-		if (g_state.active && g_state.fp) {
-			fclose(g_state.fp);
-			g_state.fp = NULL;
-		}
-		if (g_state.active && g_state.buf) {
-			free(g_state.buf);
-			g_state.buf = NULL;
-			g_state.buf_size = 0;
-		}
-		g_state.active = false;
+		discard_current_fetch();
+		drop_pending_segments();
 		break;
 
 	default:
@@ -238,16 +794,19 @@ void log_transfer_client_on_ctrl_notify(const uint8_t *data, uint16_t len)
 	}
 }
 
-void log_transfer_client_on_data_notify(const uint8_t *data, uint16_t len)
+void log_transfer_client_on_ctrl_notify(const uint8_t *data, uint16_t len)
 {
-	ESP_LOGI(TAG, "DATA notify: len=%u", len);
-
-	if (len < 2) {
+	if (!g_stateLock) {
 		return;
 	}
 
-	ESP_LOGI(TAG, "chunk bytes: %02X %02X", data[0], data[1]);
+	xSemaphoreTake(g_stateLock, portMAX_DELAY);
+	handle_ctrl_notify(data, len);
+	xSemaphoreGive(g_stateLock);
+}
 
+static void handle_data_notify(const uint8_t *data, uint16_t len)
+{
 	if (!g_state.active) {
 		return;
 	}
@@ -258,87 +817,74 @@ void log_transfer_client_on_data_notify(const uint8_t *data, uint16_t len)
 
 	uint16_t chunkIndex = 0;
 	memcpy(&chunkIndex, &data[0], sizeof(chunkIndex));
-	ESP_LOGI(TAG, "DATA notify: chunk=%u", chunkIndex);
+	ESP_LOGD(TAG, "DATA notify: chunk=%u len=%u", chunkIndex, len);
 
-	if (chunkIndex != g_state.nextChunkIndex) {
-		ESP_LOGW(TAG, "Chunk mismatch: got %u expected %u (resync for debug)",
+	TRACE_BEGIN(TRACE_ID_DATA_NOTIFY_RX, chunkIndex);
+
+	metrics_inc(METRIC_BLE_CHUNKS_RECEIVED);
+	g_state.lastEventUs = esp_timer_get_time();
+
+	if (chunkIndex != g_state.nextChunkIndex && !g_state.chunkGap) {
+		metrics_inc(METRIC_BLE_CHUNK_GAPS);
+		ESP_LOGW(TAG, "Chunk mismatch: got %u expected %u; segment will be fetched again",
 		         chunkIndex, g_state.nextChunkIndex);
-		g_state.nextChunkIndex = chunkIndex;
+		g_state.chunkGap = true;
+	}
+
+	if (g_state.chunkGap) {
+		/* Nothing after a gap can be used; wait for TRANSFER_DONE. */
+		TRACE_END(TRACE_ID_DATA_NOTIFY_RX, chunkIndex);
+		return;
 	}
 
 	size_t payloadLen = len - 2;
 	const uint8_t *payload = &data[2];
 
-	printf("---- CHUNK %u (%u bytes) ----\n", chunkIndex, (unsigned)payloadLen);
+	TRACE_BEGIN(TRACE_ID_CHUNK_FWRITE, 0);
+	size_t written = fwrite(payload, 1, payloadLen, g_state.fp);
+	TRACE_END(TRACE_ID_CHUNK_FWRITE, written);
 
-	for (size_t i = 0; i < payloadLen; i++) {
-		putchar(payload[i]);
+	if (written != payloadLen) {
+		/* Same as a lost chunk: the segment is fetched again after TRANSFER_DONE. */
+		ESP_LOGW(TAG, "Write to '%s' failed; segment will be fetched again",
+		         g_state.partPath);
+		g_state.chunkGap = true;
 	}
 
-	printf("\n---- END CHUNK ----\n");
+	g_state.bytesReceived += payloadLen;
+	g_state.nextChunkIndex++;
 
-	if (g_state.fp) {
-		size_t written = fwrite(payload, 1, payloadLen, g_state.fp);
-		(void)written;
-	}
+	TRACE_END(TRACE_ID_DATA_NOTIFY_RX, chunkIndex);
+}
 
-	if (g_state.buf && g_state.buf_size > 0) {
-		if (g_state.bytesReceived + payloadLen <= g_state.buf_size) {
-			memcpy(&g_state.buf[g_state.bytesReceived], payload, payloadLen);
-		} else {
-			ESP_LOGW(TAG, "RAM buffer overflow; dropping extra data");
-		}
+void log_transfer_client_on_data_notify(const uint8_t *data, uint16_t len)
+{
+	if (!g_stateLock) {
+		return;
 	}
 
-	g_state.bytesReceived += payloadLen;
-	g_state.nextChunkIndex++;
+	xSemaphoreTake(g_stateLock, portMAX_DELAY);
+	handle_data_notify(data, len);
+	xSemaphoreGive(g_stateLock);
 }
 
 /* --- Debug helpers -------------------------------------------------------- */
 
 static void dump_downloaded_file(void)
 {
-	if (g_state.buf && g_state.expectedSize > 0) {
-		ESP_LOGI(TAG, "Dumping first lines from RAM buffer (%u bytes):",
-		         g_state.expectedSize);
-
-		const char *ptr = (const char *)g_state.buf;
-		const char *end = ptr + g_state.expectedSize;
-		char line[128];
-		int lineCount = 0;
-
-		while (ptr < end && lineCount < 5) {
-			size_t i = 0;
-
-			while (ptr < end && *ptr != '\n' && i < sizeof(line) - 1) {
-				line[i++] = *ptr++;
-			}
-			line[i] = '\0';
-
-			if (i > 0) {
-				ESP_LOGI(TAG, "%s", line);
-				lineCount++;
-			}
-
-			if (ptr < end && *ptr == '\n') {
-				ptr++;
-			}
-		}
-
-		free(g_state.buf);
-		g_state.buf = NULL;
-		g_state.buf_size = 0;
-
+	if (g_state.encoding != LOG_XFER_ENC_RAW) {
+		ESP_LOGI(TAG, "Downloaded %u encoded bytes (encoding=%u); not dumping",
+		         g_state.bytesReceived, g_state.encoding);
 		return;
 	}
 
-	FILE *fp = fopen(GPS_LOG_FILE_PATH, "rb");
+	FILE *fp = fopen(g_state.localPath, "rb");
 	if (!fp) {
-		ESP_LOGE(TAG, "Could not open downloaded file '%s' for dump", GPS_LOG_FILE_PATH);
+		ESP_LOGE(TAG, "Could not open downloaded file '%s' for dump", g_state.localPath);
 		return;
 	}
 
-	ESP_LOGI(TAG, "Dumping first lines of '%s':", GPS_LOG_FILE_PATH);
+	ESP_LOGI(TAG, "Dumping first lines of '%s':", g_state.localPath);
 
 	char line[128];
 	int lineCount = 0;
@@ -13,6 +13,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 #include "log_transfer_protocol.h"
@@ -25,6 +26,7 @@ typedef struct {
 	uint16_t connHandle;
 	uint16_t ctrlChrHandle;
 	uint16_t dataChrHandle;
+	uint16_t diagChrHandle;      /* 0 if the shears has no diagnostics */
 } log_transfer_client_cfg_t;
 
 /*
@@ -49,6 +51,42 @@ void log_transfer_client_set_conn_handle(uint16_t connHandle);
  */
 esp_err_t log_transfer_client_request_file(const char *filename);
 
+/*
+ * Asks the shears for its sealed log segments (CTRL_CMD_LIST_SEGMENTS).
+ *
+ * Segments newer than the last one fetched on this connection are then
+ * downloaded one after another without further calls.
+ */
+esp_err_t log_transfer_client_request_segment_list(void);
+
+/*
+ * Asks the shears for its hot-path trace (CTRL_CMD_TRACE_DUMP). The dump
+ * is echoed on the base console as WMTRACE lines as it arrives.
+ */
+esp_err_t log_transfer_client_request_trace(void);
+
+/*
+ * Copies the shears metrics snapshot (metrics.h layout) last read from the
+ * diagnostics characteristic. The snapshot is refreshed after every fetched
+ * segment and kept across reconnects.
+ *
+ * Returns its length, or 0 if none has been read yet or cap is too small.
+ */
+size_t log_transfer_client_get_shears_metrics(uint8_t *out, size_t cap);
+
+/*
+ * Records the BLE identity address of the shears (ble_addr_t.val byte
+ * order). The base tags every segment it forwards to the Pi with it, so the
+ * Pi can deduplicate per device. Kept across reconnects.
+ */
+void log_transfer_client_set_shears_addr(const uint8_t addr[6]);
+
+/*
+ * Copies the shears address last set. Returns false (and zeroes addr) if
+ * none is known yet.
+ */
+bool log_transfer_client_get_shears_addr(uint8_t addr[6]);
+
 /*
  * Notification handlers used by the base BLE layer.
  *
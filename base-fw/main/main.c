@@ -7,7 +7,7 @@
  *   - mount SPIFFS for log storage
  *   - start the status LED
  *   - initialize BLE central and scan for WM-SHEARS
- *   - on connect, request the GPS log
+ *   - on connect, request the list of sealed GPS log segments
  */
 
 #include <stdbool.h>
@@ -23,12 +23,23 @@
 #include "base_ble.h"
 #include "csv_debug_button.h"
 #include "base_uartFileTransfer.h"
-#include "log_paths.h"   /* GPS_LOG_FILE_BASENAME, GPS_LOG_FILE_PATH */
+#include "metrics.h"
 
 static const char *TAG = "app_main";
 
 /* --- SPIFFS --------------------------------------------------------------- */
 
+/* Snapshot sampler: reports SPIFFS usage with every metrics snapshot. */
+static void sample_spiffs_usage(void)
+{
+	size_t total = 0;
+	size_t used  = 0;
+	if (esp_spiffs_info("storage", &total, &used) == ESP_OK) {
+		metrics_set(METRIC_SPIFFS_USED_BYTES, (uint32_t)used);
+		metrics_set(METRIC_SPIFFS_TOTAL_BYTES, (uint32_t)total);
+	}
+}
+
 /* Mounts the SPIFFS partition so /spiffs/... paths are available. */
 static void init_spiffs(void)
 {
@@ -60,6 +71,8 @@ static void init_spiffs(void)
 	} else {
 		ESP_LOGW(TAG, "SPIFFS info failed (%s)", esp_err_to_name(ret));
 	}
+
+	metrics_set_sampler(sample_spiffs_usage);
 }
 
 /* --- BLE connection state ------------------------------------------------- */
@@ -68,13 +81,12 @@ static void init_spiffs(void)
 static void bleConnChanged(bool connected)
 {
 	if (connected) {
-		/* Link up: solid LED and request the GPS log. */
+		/* Link up: solid LED and fetch any sealed segments we have not seen. */
 		baseLedSetSolidOn();
 
-		/* Shears side resolves basename to its filesystem path. */
-		esp_err_t err = bleBaseRequestLog(GPS_LOG_FILE_BASENAME);
+		esp_err_t err = bleBaseRequestSegments();
 		if (err != ESP_OK) {
-			ESP_LOGE(TAG, "Failed to request log (%s)", esp_err_to_name(err));
+			ESP_LOGE(TAG, "Failed to request log segments (%s)", esp_err_to_name(err));
 		}
 	} else {
 		/* Link down: blink while scanning / reconnecting. */
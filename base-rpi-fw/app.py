@@ -5,36 +5,53 @@ Watermelon Hub — Raspberry Pi web server.
 
 Endpoints:
     GET  /                      Serve Chris's frontend (static/index.html)
-    GET  /api/points            All GPS points as JSON
+    GET  /tiles/<z>/<x>/<y>.png Offline map tile (ETag / If-None-Match)
+    GET  /tiles/density/<z>/<x>/<y>.png?from=&to=
+                                Harvest density overlay tile (ETag / If-None-Match)
+    GET  /api/points            All GPS points as JSON (ETag / If-None-Match)
+    GET  /api/points?since=N    Rows added, deleted or restored after change seq N
+    GET  /api/points?offset=&limit=&sort=&from=&to=
+                                One page of points, sorted and date-filtered in SQL
+    GET  /api/points?bbox=&zoom=    Points in the map viewport, or grid counts at low zoom
     GET  /api/latest            Latest N points (default 50)
-    GET  /api/status            Transfer state + point count
-    GET  /api/export            Download all points as CSV
-    POST /api/points/delete     Soft-delete points by ID list
-    POST /api/points/restore    Restore soft-deleted points by ID list
+    GET  /api/status            Transfer state, point count, device metrics
+    GET  /api/events            Server-sent events: point deltas and status as they change
+    GET  /api/export?format=&from=&to=&bbox=
+                                Stream points as CSV, GeoJSON or compact binary
+    POST /api/export            Same, for a form with an ids list (selected cuts)
+    POST /api/points/delete     Soft-delete points by ids, id range, date range or bbox
+    POST /api/points/restore    Restore soft-deleted points, selected the same way
     GET  /api/points/deleted    List of soft-deleted points (trash)
     POST /api/clear             Delete all points (testing only)
     POST /api/cuts              Dev endpoint for inserting cuts
     
 Background tasks:
     - UART receiver thread: Listens for incoming CSV data from ESP32, parses it, and stores in SQLite.
-    - Purge thread: Periodically deletes points older than a certain age (48 hours) to prevent unbounded growth.
+    - Retention thread (retention.py): purges soft-deleted points 48 hours after deletion, in batches,
+      and shrinks the database file.
 
 The UART receiver runs in a background daemon thread, listening for
 file transfers from the ESP32. Received CSV data is parsed and stored
-in SQLite. Flask reads from the same database.
+in SQLite. Flask reads from the same database. Whatever changes the points
+or the transfer state calls events.publish(), which wakes the /api/events
+streams.
 """
 
 import argparse
-import io
-import csv
+import json
 import logging
-import threading
-import time
+import math
+import re
 
 from flask import Flask, jsonify, Response, request
 
 import config
 import database
+import density
+import events
+import export
+import retention
+import tiles
 import uart_receiver
 
 logging.basicConfig(
@@ -45,56 +62,56 @@ log = logging.getLogger("app")
 
 app = Flask(__name__, static_folder="static", static_url_path="")
 
-# ── Background purge thread ────────────────────────────────────────
+# ── Routes ─────────────────────────────────────────────────────────
 
-PURGE_INTERVAL_SECONDS = 3600   # Run purge every hour
-PURGE_AFTER_HOURS = 48          # Purge points older than this (48 hours)
+@app.route("/tiles/<int:z>/<int:x>/<int:y>.png")
+def serve_tile(z, x, y):
+    """
+    Serve offline map tiles from the MBTiles file (see tiles.py).
 
-def _purge_loop():
-    """Periodically purge expired soft-deleted points."""
-    while True:
-        time.sleep(PURGE_INTERVAL_SECONDS)
-        try:
-            purged = database.purge_expired_deleted(hours=PURGE_AFTER_HOURS)
-            if purged > 0:
-                log.info("Purge cycle: removed %d expired point(s)", purged)
-        except Exception as e:
-            log.error("Purge cycle error: %s", e)
+    Browsers keep a tile for config.TILE_MAX_AGE_S and then revalidate it
+    against its ETag.
+    """
+    # No map goes past z 22, and a huge z overflows the TMS row in the lookup
+    if not (0 <= z <= 22 and 0 <= x < (1 << z) and 0 <= y < (1 << z)):
+        return Response(status=404)
+    tile = tiles.get_tile(z, x, y)
+    if tile is None:
+        return Response(status=404)
 
+    if request.if_none_match.contains(tile.etag):
+        resp = Response(status=304)
+    else:
+        resp = Response(tile.data, mimetype=tile.mimetype)
+    resp.set_etag(tile.etag)
+    resp.headers["Cache-Control"] = "public, max-age=%d" % config.TILE_MAX_AGE_S
+    return resp
 
-def start_purge_thread():
-    """Launch the background purge thread as a daemon."""
-    thread = threading.Thread(
-        target=_purge_loop,
-        daemon=True,
-        name="purge-expired",
-    )
-    thread.start()
-    log.info("Purge thread started (every %ds, threshold %dh)",
-             PURGE_INTERVAL_SECONDS, PURGE_AFTER_HOURS)
-    
 
-# ── Routes ─────────────────────────────────────────────────────────
+@app.route("/tiles/density/<int:z>/<int:x>/<int:y>.png")
+def serve_density_tile(z, x, y):
+    """
+    Harvest density overlay tile (see density.py), optionally for the
+    cuts dated ?from= to ?to= (YYYY-MM-DD, inclusive).
 
-@app.route("/tiles/<int:z>/<int:x>/<int:y>.png")
-def serve_tile(z, x, y):
-    """Serve offline map tiles from the MBTiles file."""
-    import sqlite3 as _sqlite3
-    tms_y = (2 ** z) - 1 - y
-    try:
-        conn = _sqlite3.connect("uf_campus.mbtiles")
-        cursor = conn.cursor()
-        cursor.execute(
-            "SELECT tile_data FROM tiles WHERE zoom_level=? AND tile_column=? AND tile_row=?",
-            (z, x, tms_y),
-        )
-        row = cursor.fetchone()
-        conn.close()
-        if row:
-            return Response(row[0], mimetype="image/png")
-        return Response(status=404)
-    except Exception:
+    The tiles change as cuts arrive, so browsers revalidate them on every
+    use; an unchanged tile costs a 304.
+    """
+    date_from = request.args.get("from") or None
+    date_to = request.args.get("to") or None
+    if not (0 <= z <= 24 and 0 <= x < (1 << z) and 0 <= y < (1 << z)):
         return Response(status=404)
+    if not _valid_dates(date_from, date_to):
+        return Response(status=400)
+
+    tile = density.get_density_tile(z, x, y, date_from, date_to)
+    if request.if_none_match.contains(tile.etag):
+        resp = Response(status=304)
+    else:
+        resp = Response(tile.data, mimetype=tile.mimetype)
+    resp.set_etag(tile.etag)
+    resp.headers["Cache-Control"] = "no-cache"
+    return resp
 
 @app.route("/")
 def index():
@@ -103,9 +120,140 @@ def index():
 
 @app.route("/api/points", methods=["GET"])
 def api_points():
-    """All GPS points, oldest first."""
-    points = database.get_all_points()
-    return jsonify(points)
+    """
+    All GPS points, oldest first.
+
+    The ETag is the change sequence, so a client that already has the
+    current list gets a 304 without the list being read.
+
+    With ?since=N, only the rows inserted, soft-deleted or restored after
+    change sequence N (see database.get_changes_since); pass the returned
+    "seq" as the next N. since=0 returns everything.
+
+    With any of offset, limit, sort, from, to or fields, one page for the
+    cut log (see database.get_points_page):
+        offset, limit   rows to skip / return (limit ≤ config.POINTS_PAGE_MAX)
+        sort            time, -time (default), id or -id
+        from, to        inclusive YYYY-MM-DD range of the row's date
+        fields=id       ids only, for "select all"; no limit cap
+
+    With ?bbox=minLon,minLat,maxLon,maxLat&zoom=Z, what the map shows of
+    that box (from/to apply too). Below config.POINTS_GRID_MAX_ZOOM, or
+    when the box holds more than config.POINTS_BBOX_MAX points, "cells"
+    holds grid counts (see database.get_grid_in_bbox) instead of "points".
+    """
+    since = request.args.get("since", type=int)
+    if since is not None:
+        return jsonify(database.get_changes_since(since))
+
+    if "bbox" in request.args:
+        return _points_bbox()
+
+    if any(k in request.args for k in _PAGE_ARGS):
+        return _points_page()
+
+    etag = "points-%d" % database.get_point_seq()
+    if request.if_none_match.contains(etag):
+        resp = Response(status=304)
+    else:
+        resp = jsonify(database.get_all_points())
+    resp.set_etag(etag)
+    resp.headers["Cache-Control"] = "no-cache"
+    return resp
+
+
+_PAGE_ARGS = ("offset", "limit", "sort", "from", "to", "fields")
+_ISO_DATE = re.compile(r"^\d{4}-\d{2}-\d{2}$")
+
+
+def _valid_dates(*values):
+    """True if every value is None or a real YYYY-MM-DD date string."""
+    return all(v is None or (isinstance(v, str) and _ISO_DATE.match(v)
+                             and database.utc_epoch_ms(v, "0") is not None)
+               for v in values)
+
+
+def _points_page():
+    args = request.args
+    ids_only = args.get("fields") == "id"
+    offset = args.get("offset", 0, type=int)
+    limit = args.get("limit", config.POINTS_PAGE_DEFAULT, type=int)
+    sort = args.get("sort", "-time")
+    date_from = args.get("from") or None
+    date_to = args.get("to") or None
+
+    if offset < 0 or limit < 0 or (limit > config.POINTS_PAGE_MAX and not ids_only):
+        return jsonify({"status": "error",
+                        "message": "offset and limit must be 0..%d" % config.POINTS_PAGE_MAX}), 400
+    if sort not in database.POINT_SORTS:
+        return jsonify({"status": "error",
+                        "message": "sort must be one of %s" % ", ".join(database.POINT_SORTS)}), 400
+    if not _valid_dates(date_from, date_to):
+        return jsonify({"status": "error",
+                        "message": "from and to must be YYYY-MM-DD"}), 400
+
+    return jsonify(database.get_points_page(offset, limit, sort, date_from,
+                                            date_to, ids_only))
+
+
+def _is_int(v):
+    """JSON integer; bool is an int subclass but true/false are not ids."""
+    return isinstance(v, int) and not isinstance(v, bool)
+
+
+def _valid_bbox(bbox):
+    """Four finite numbers (no bools) with min <= max on both axes."""
+    if len(bbox) != 4 or not all(
+            isinstance(v, (int, float)) and not isinstance(v, bool) and math.isfinite(v)
+            for v in bbox):
+        return False
+    min_lon, min_lat, max_lon, max_lat = bbox
+    return min_lon <= max_lon and min_lat <= max_lat
+
+
+_BBOX_ERROR = "bbox must be minLon,minLat,maxLon,maxLat (finite, min <= max)"
+
+
+def _parse_bbox(text):
+    """(min_lon, min_lat, max_lon, max_lat) from "a,b,c,d", or None."""
+    try:
+        bbox = tuple(float(v) for v in text.split(","))
+    except ValueError:
+        return None
+    return bbox if _valid_bbox(bbox) else None
+
+
+def _points_bbox():
+    args = request.args
+    bbox = _parse_bbox(args["bbox"])
+    if bbox is None:
+        return jsonify({"status": "error",
+                        "message": _BBOX_ERROR}), 400
+    min_lon, min_lat, max_lon, max_lat = bbox
+    zoom = args.get("zoom", config.POINTS_GRID_MAX_ZOOM, type=int)
+    date_from = args.get("from") or None
+    date_to = args.get("to") or None
+
+    if not 0 <= zoom <= 30:
+        return jsonify({"status": "error", "message": "zoom must be 0..30"}), 400
+    if not _valid_dates(date_from, date_to):
+        return jsonify({"status": "error",
+                        "message": "from and to must be YYYY-MM-DD"}), 400
+
+    seq = database.get_point_seq()
+    bbox = (min_lon, min_lat, max_lon, max_lat)
+    if zoom >= config.POINTS_GRID_MAX_ZOOM:
+        points = database.get_points_in_bbox(*bbox, config.POINTS_BBOX_MAX + 1,
+                                             date_from, date_to)
+        if len(points) <= config.POINTS_BBOX_MAX:
+            return jsonify({"seq": seq, "zoom": zoom, "total": len(points),
+                            "points": points})
+
+    # A cell is POINTS_GRID_CELL_PX wide on screen at this zoom
+    level = zoom + (256 // config.POINTS_GRID_CELL_PX).bit_length() - 1
+    cells = database.get_grid_in_bbox(*bbox, level, date_from, date_to)
+    return jsonify({"seq": seq, "zoom": zoom,
+                    "total": sum(c["count"] for c in cells), "cells": cells})
 
 
 @app.route("/api/latest", methods=["GET"])
@@ -116,88 +264,193 @@ def api_latest():
     return jsonify(points)
 
 
-@app.route("/api/status", methods=["GET"])
-def api_status():
-    """Transfer state and total point count."""
+def _status():
     status = uart_receiver.get_status()
     status["total_points"] = database.get_point_count()
-    return jsonify(status)
+    status["retention"] = retention.get_stats()
+    return status
+
+
+@app.route("/api/status", methods=["GET"])
+def api_status():
+    """
+    Transfer state, total point count, the latest shears/base metrics
+    and the retention purge counters (retention.get_stats()).
+    """
+    return jsonify(_status())
+
+
+def _sse(event, data, event_id=None):
+    out = "event: %s\n" % event
+    if event_id is not None:
+        out += "id: %d\n" % event_id
+    return out + "data: %s\n\n" % json.dumps(data, separators=(",", ":"))
+
 
+@app.route("/api/events", methods=["GET"])
+def api_events():
+    """
+    Server-sent event stream replacing the dashboard's polling.
+
+    event: points   the /api/points?since=N delta past the client's cursor;
+                    the event id is the new seq
+    event: status   the /api/status body
 
-@app.route("/api/export", methods=["GET"])
+    The cursor is ?since=N or, on an automatic reconnect, the browser's
+    Last-Event-ID; without either the stream starts at the current seq.
+    Nothing is read or sent while nothing changes apart from a comment
+    every config.SSE_HEARTBEAT_S.
+    """
+    cursor = request.headers.get("Last-Event-ID", type=int)
+    if cursor is None:
+        cursor = request.args.get("since", type=int)
+    if cursor is None:
+        cursor = database.get_point_seq()
+
+    def stream(cursor):
+        seen = events.snapshot()
+        yield "retry: %d\n\n" % config.SSE_RETRY_MS
+        changed = ["points", "status"]      # catch up once on connect
+        while True:
+            if "points" in changed:
+                delta = database.get_changes_since(cursor)
+                if delta["reset"] or delta["points"] or delta["deleted"]:
+                    cursor = delta["seq"]
+                    yield _sse("points", delta, cursor)
+            if "status" in changed:
+                yield _sse("status", _status())
+            if not changed:
+                yield ": keepalive\n\n"
+            changed = events.wait(seen, config.SSE_HEARTBEAT_S)
+
+    resp = Response(stream(cursor), mimetype="text/event-stream")
+    resp.headers["Cache-Control"] = "no-cache"
+    resp.headers["X-Accel-Buffering"] = "no"
+    return resp
+
+
+@app.route("/api/export", methods=["GET", "POST"])
 def api_export():
-    """Download all active GPS points as a CSV file."""
-    points = database.get_all_points()
-
-    output = io.StringIO()
-    writer = csv.writer(output)
-    writer.writerow([
-        "id", "utc_date", "utc_time", "latitude", "longitude",
-        "fix_quality", "num_satellites", "hdop",
-        "altitude", "geoid_height",
-    ])
-    for p in points:
-        writer.writerow([
-            p["id"], p["utc_date"], p["utc_time"], p["latitude"], p["longitude"],
-            p["fix_quality"], p["num_satellites"], p["hdop"],
-            p["altitude"], p["geoid_height"],
-        ])
+    """
+    Download the active GPS points, streamed from one database snapshot
+    (see export.py), oldest first.
+
+        format      csv (default), geojson or bin (export.py's columnar
+                    binary)
+        from, to    inclusive YYYY-MM-DD range of the row's date
+        bbox        minLon,minLat,maxLon,maxLat
+        ids         comma-separated ids, only those rows. Sent as a POST
+                    form field, since a selection can be long
 
+    The arguments may come from the query string or a POST form.
+    """
+    args = request.values
+    fmt = args.get("format", "csv")
+    date_from = args.get("from") or None
+    date_to = args.get("to") or None
+    bbox = None
+    ids = None
+
+    if fmt not in export.FORMATS:
+        return jsonify({"status": "error",
+                        "message": "format must be one of %s" % ", ".join(export.FORMATS)}), 400
+    if not _valid_dates(date_from, date_to):
+        return jsonify({"status": "error",
+                        "message": "from and to must be YYYY-MM-DD"}), 400
+    if args.get("bbox"):
+        bbox = _parse_bbox(args["bbox"])
+        if bbox is None:
+            return jsonify({"status": "error",
+                            "message": _BBOX_ERROR}), 400
+    if "ids" in args:
+        try:
+            ids = [int(v) for v in args["ids"].split(",") if v.strip()]
+        except ValueError:
+            return jsonify({"status": "error",
+                            "message": "ids must be comma-separated integers"}), 400
+
+    mimetype, extension = export.FORMATS[fmt]
+    name = "gps_export_selected" if ids is not None else "gps_export"
+    batches = database.iter_points(date_from, date_to, bbox, ids)
     return Response(
-        output.getvalue(),
-        mimetype="text/csv",
-        headers={"Content-Disposition": "attachment; filename=gps_export.csv"},
+        export.encode(fmt, batches),
+        mimetype=mimetype,
+        headers={"Content-Disposition": "attachment; filename=%s.%s" % (name, extension)},
     )
 
+def _selection(data):
+    """
+    Batch selection keyword arguments from a delete/restore body, or an
+    error message. Any of:
+        ids         [1, 3, 5], any number
+        id_range    [first, last], inclusive
+        from, to    inclusive YYYY-MM-DD range of the row's date
+        bbox        [minLon, minLat, maxLon, maxLat]
+    Rows must match all that are given.
+    """
+    if not isinstance(data, dict):
+        return "Request body must be a JSON object"
+    sel = {}
+    if "ids" in data:
+        ids = data["ids"]
+        if not isinstance(ids, list) or not all(_is_int(i) for i in ids):
+            return "'ids' must be a list of integers"
+        sel["ids"] = ids
+    if "id_range" in data:
+        r = data["id_range"]
+        if not (isinstance(r, list) and len(r) == 2 and all(_is_int(i) for i in r)):
+            return "'id_range' must be [first, last]"
+        sel["id_range"] = tuple(r)
+    if "bbox" in data:
+        b = data["bbox"]
+        if not (isinstance(b, list) and _valid_bbox(b)):
+            return "'bbox' must be [minLon, minLat, maxLon, maxLat], finite, min <= max"
+        sel["bbox"] = tuple(b)
+    sel["date_from"] = data.get("from") or None
+    sel["date_to"] = data.get("to") or None
+    if not _valid_dates(sel["date_from"], sel["date_to"]):
+        return "'from' and 'to' must be YYYY-MM-DD"
+    if all(v is None for v in sel.values()):
+        return "Missing 'ids', 'id_range', 'from', 'to' or 'bbox' in request body"
+    return sel
+
+
+def _batch_change(change, counted):
+    sel = _selection(request.get_json(silent=True))
+    if isinstance(sel, str):
+        return jsonify({"status": "error", "message": sel}), 400
+    if sel.get("ids") == []:
+        return jsonify({"status": "ok", counted: 0})
+
+    delta = change(**sel)
+    if delta["changed"]:
+        events.publish("points")
+    return jsonify({"status": "ok", counted: delta.pop("changed"), "delta": delta})
+
+
 @app.route("/api/points/delete", methods=["POST"])
 def api_delete_points():
     """
-    Soft-delete one or more points.
-    
-    Request body (JSON):
-    { "ids": [1, 3, 5]  # List of point IDs to soft-delete}
-    
+    Soft-delete the active points matching a selection (see _selection).
+
+    Request body (JSON), e.g.:
+    { "ids": [1, 3, 5] }  or  { "from": "2026-06-01", "bbox": [...] }
+
     Response:
-    { "status": "ok", "deleted": "3" }
+    { "status": "ok", "deleted": 3, "delta": {...} }
+    delta is database.soft_delete_matching()'s: the changed rows, and the
+    change sequence before ("since") and after ("seq") them.
     """
-    data = request.get_json(silent=True)
-    if not data or "ids" not in data:
-        return jsonify({"status": "error", "message": "Missing 'ids' in request body"}), 400
-    
-    ids = data["ids"]
-    if not isinstance(ids, list) or not all(isinstance(i, int) for i in ids):
-        return jsonify({"status": "error", "message": "'ids' must be a list of integers"}), 400
-    
-    if len(ids) == 0:
-        return jsonify({"status": "ok", "deleted": "0"})
-    
-    affected = database.soft_delete_points(ids)
-    return jsonify({"status": "ok", "deleted": affected})
+    return _batch_change(database.soft_delete_matching, "deleted")
+
 
 @app.route("/api/points/restore", methods=["POST"])
 def api_restore_points():
     """
-    Restore one or more soft-deleted points.
-    
-    Request body (JSON):
-    { "ids": [1, 3, 5]  # List of point IDs to restore}
-    
-    Response:
-    { "status": "ok", "restored": "3" }
+    Restore the soft-deleted points matching a selection; body and
+    response as for /api/points/delete, with "restored" for "deleted".
     """
-    data = request.get_json(silent=True)
-    if not data or "ids" not in data:
-        return jsonify({"status": "error", "message": "Missing 'ids' in request body"}), 400
-    
-    ids = data["ids"]
-    if not isinstance(ids, list) or not all(isinstance(i, int) for i in ids):
-        return jsonify({"status": "error", "message": "'ids' must be a list of integers"}), 400
-    
-    if len(ids) == 0:
-        return jsonify({"status": "ok", "restored": "0"})
-    
-    affected = database.restore_points(ids)
-    return jsonify({"status": "ok", "restored": affected})
+    return _batch_change(database.restore_matching, "restored")
 
 @app.route("/api/points/deleted", methods=["GET"])
 def api_deleted_points():
@@ -214,6 +467,8 @@ def api_deleted_points():
 def api_clear():
     """Clear all GPS points. For testing only."""
     database.clear_all_points()
+    events.publish("points")
+    events.publish("status")
     return jsonify({"status": "ok", "message": "All points cleared"})
 
 
@@ -246,6 +501,7 @@ def api_cuts_compat():
                 utc_date,
                 int(fix_quality) if fix_quality is not None else None,
             )
+            events.publish("points")
             return jsonify({"success": True, "id": new_id}), 201
         except Exception as e:
             return jsonify({"error": str(e)}), 500
@@ -275,7 +531,7 @@ def main():
     else:
         log.info("UART receiver disabled (--no-serial mode)")
         
-    start_purge_thread()
+    retention.start()
 
     log.info("Starting web server on %s:%d", config.WEB_HOST, args.port)
     app.run(host=config.WEB_HOST, port=args.port, debug=False)
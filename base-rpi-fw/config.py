@@ -26,14 +26,19 @@ SERIAL_BAUD = 115200
 # ── UART packet types (must match uartFileTransfer.c) ──────────────
 START_BYTE  = 0xAA
 
-TYPE_START  = 0x01   # ESP32 → Pi : new file transfer, payload = fileSize (u32 LE)
+TYPE_START  = 0x01   # ESP32 → Pi : new file transfer, payload = fileSize (u32 LE) [+ encoding u8]
 TYPE_DATA   = 0x02   # ESP32 → Pi : file chunk, payload = raw bytes (1-255)
 TYPE_END    = 0x03   # ESP32 → Pi : all chunks sent, no payload
 TYPE_ACK    = 0x04   # Pi → ESP32 : acknowledgment, no payload
 TYPE_COMMIT = 0x05   # Pi → ESP32 : verification result, payload = 1 byte status
+TYPE_METRICS = 0x06  # ESP32 → Pi : metrics snapshot (see metrics.py), never ACKed
 
 MAX_PAYLOAD = 255    # CHUNK_SIZE in the C code
 
+# START payload encoding byte (log_xfer_encoding_t in log_transfer_protocol.h)
+ENC_RAW      = 0x00  # DATA carries the CSV bytes as stored on the shears
+ENC_DELTA_LZ = 0x01  # DATA carries a log_codec stream; decoded by log_codec.py
+
 # COMMIT status codes
 COMMIT_OK   = 0x00   # file received and verified
 COMMIT_FAIL = 0x01   # verification failed (size mismatch, parse error, etc.)
@@ -41,9 +46,61 @@ COMMIT_FAIL = 0x01   # verification failed (size mismatch, parse error, etc.)
 # ── Database ───────────────────────────────────────────────────────
 DB_PATH = os.environ.get("HUB_DB_PATH", "watermelon_hub.db")
 
+# WAL lets the dashboard read while the ingest thread writes; NORMAL only
+# syncs at checkpoints, which is safe against corruption in WAL mode.
+# HUB_DB_JOURNAL=DELETE restores the old rollback journal (for comparison).
+DB_JOURNAL_MODE = os.environ.get("HUB_DB_JOURNAL", "WAL")
+DB_SYNCHRONOUS = "NORMAL"
+DB_BUSY_TIMEOUT_S = 5.0
+DB_STATEMENT_CACHE = 64     # prepared statements kept per connection
+DB_READ_POOL = 4            # idle read connections kept open
+
+# Rows buffered per executemany() while a transfer is staged
+# (database.PointWriter)
+INGEST_BATCH_ROWS = 500
+
 # ── Web server ─────────────────────────────────────────────────────
 WEB_HOST = "0.0.0.0"
 WEB_PORT = int(os.environ.get("HUB_WEB_PORT", "80"))
+# /api/points?offset=&limit= page size: default and largest allowed
+POINTS_PAGE_DEFAULT = 200
+POINTS_PAGE_MAX = 1000
+# /api/points?bbox=: zooms below POINTS_GRID_MAX_ZOOM, or boxes holding
+# more than POINTS_BBOX_MAX points, get grid counts instead of points, one
+# cell per POINTS_GRID_CELL_PX (a power of two, at most 256) on screen
+POINTS_GRID_MAX_ZOOM = 17
+POINTS_BBOX_MAX = 5000
+POINTS_GRID_CELL_PX = 32
+# /api/events sends a comment line after this long without an event, so
+# proxies keep the stream open and a dead client is noticed on the write
+SSE_HEARTBEAT_S = 15.0
+# Browser reconnect delay after the stream drops (SSE "retry:")
+SSE_RETRY_MS = 3000
+# /api/export streams rows this many at a time (one batch in RAM), and
+# each compresses to one block of the binary format (export.py)
+EXPORT_BATCH_ROWS = 1000
+
+# ── Offline map tiles (tiles.py) ───────────────────────────────────
+MBTILES_PATH = os.environ.get("HUB_MBTILES", "uf_campus.mbtiles")
+TILE_POOL = 4                           # idle read connections kept open
+TILE_MMAP_BYTES = 256 * 1024 * 1024     # SQLite mmap window per connection
+TILE_CACHE_BYTES = 32 * 1024 * 1024     # LRU of served tiles, in RAM
+TILE_MAX_AGE_S = 86400                  # browser Cache-Control max-age
+TILE_RECHECK_S = 5.0                    # how often to stat the file for a swap
+
+# ── Harvest density tiles (density.py) ────────────────────────────
+DENSITY_CELL_PX = 8                     # grid cell width on screen (power of two)
+DENSITY_SHADES = 16                     # colour steps from sparse to dense
+DENSITY_FULL_SCALE = 20.0               # cuts per ~10 m cell drawn darkest
+DENSITY_CACHE_BYTES = 8 * 1024 * 1024   # LRU of rendered tiles, in RAM
+DENSITY_MAX_CHANGES = 5000              # more changed rows than this clear the cache
+
+# ── Retention of soft-deleted points (retention.py) ───────────────
+RETENTION_HOURS = 48                    # purged this long after deletion
+PURGE_BATCH_ROWS = 500                  # rows deleted per writer transaction
+PURGE_MIN_INTERVAL_S = 60               # runs are never closer than this
+PURGE_MAX_INTERVAL_S = 3600             # nor further apart than this
+VACUUM_BATCH_PAGES = 256                # free pages returned per writer job
 
 # ── File storage ───────────────────────────────────────────────────
 # Raw CSV backups saved here before parsing
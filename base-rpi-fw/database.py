@@ -6,36 +6,279 @@ SQLite wrapper for storing GPS cut/point records.
 Schema matches the actual CSV output from shears firmware:
     utc_time, latitude, longitude, fix_quality, num_satellites, hdop, altitude, geoid_height
 
+Deduplication:
+    - device_id column: the shears the row came from (its BLE address),
+      '' if the base did not know it, NULL for rows entered by hand
+    - (device_id, utc_date, utc_time, latitude, longitude) is unique; UART
+      ingest inserts with ON CONFLICT DO NOTHING, so a resent file adds
+      nothing. NULLs never conflict, so manual entries are not deduplicated.
+    - ingest_state keeps the newest segment committed per device below
+      which every segment is in (the high-water mark), and ingest_segments
+      the ones committed ahead of a gap, so a resent segment can be
+      skipped unread. Both are keyed per storage epoch as well: the
+      shears numbers segments from 1 again when its filesystem is
+      recreated, and picks a new random epoch when it does
+
+Connections:
+    - connections stay open: long-lived threads (the writer) keep one each
+      (get_connection()), and reads borrow one from a small pool, since
+      Flask serves every request on a fresh thread. sqlite3 caches the
+      prepared statements per connection, so each SQL string is compiled
+      once per connection rather than once per call
+    - the database runs in WAL mode with synchronous=NORMAL: readers never
+      block the writer or each other, and a commit does not fsync
+    - every write runs on one "db-writer" thread, in call order (@_serialized);
+      callers block until it is done and get its result or exception
+
 Soft-delete support:
-    - deleted_at column: NULL = active, timestamp = soft-deleted
+    - deleted_at column: NULL = active, else when the point was
+      soft-deleted, in ms since the epoch (UTC)
     - Points with deleted_at set are hidden from normal queries
-    - purge_expired_deleted() removes soft-deleted points older than 48 hours
+    - retention.py purges soft-deleted points config.RETENTION_HOURS after
+      deletion, in batches (purge_deleted_batch()), then returns the freed
+      pages to the file system (auto_vacuum = INCREMENTAL,
+      incremental_vacuum())
+
+Indexes (see host-fw/tools/pi_query_plans.py, which checks the plans):
+    - gps_points_active: partial index over active rows by id, used by the
+      point list and latest-points queries
+    - gps_points_deleted: partial index over deleted rows by deleted_at,
+      used by the trash list and the purge
+    - point_stats.active_count: active rows, kept by triggers, so the
+      dashboard's point count does not scan the table
+    - gps_points_change: rows by change_seq, for get_changes_since()
+    - gps_points_utc: active rows by (utc_ms, id), for the date-filtered,
+      time-sorted pages of get_points_page() and the exports of
+      iter_points()
+    - gps_points_rtree: R*Tree of active rows by longitude/latitude, kept
+      by triggers, for the map's get_points_in_bbox()
+    - point_grid: active row count and coordinate sums per GRID_LEVEL grid
+      cell, kept by triggers. get_grid_in_bbox() adds cells up into
+      coarser ones for low zooms without touching gps_points
+
+Timestamps:
+    - utc_date/utc_time are kept as received; utc_ms is the same instant
+      as milliseconds since the Unix epoch (UTC), computed once on insert
+      by utc_epoch_ms(). It is NULL when the date is unknown, so such rows
+      sort as oldest and fall outside every date range
+
+Change tracking:
+    - every insert, soft-delete and restore stamps the row with the next
+      point_stats.change_seq (triggers), so a client holding a sequence
+      can ask for just what changed after it
+    - hard deletes cannot be reported row by row; they raise
+      point_stats.reset_seq and clients behind it reload everything
     
 The Flask API reads from this database to serve /api/cuts for frontend.
 """
 
-import sqlite3
+import calendar
+import contextlib
+import functools
+import json
 import logging
+import queue
+import re
+import sqlite3
+import threading
+import time
+from concurrent.futures import Future
 
 import config
 
 log = logging.getLogger("database")
 
 
+_local = threading.local()
+_read_pool = queue.LifoQueue(maxsize=config.DB_READ_POOL)
+
+
+def _open_connection():
+    # check_same_thread=False: pooled connections move between request
+    # threads, but only one thread uses a connection at a time.
+    conn = sqlite3.connect(config.DB_PATH,
+                           timeout=config.DB_BUSY_TIMEOUT_S,
+                           cached_statements=config.DB_STATEMENT_CACHE,
+                           check_same_thread=False)
+    conn.row_factory = sqlite3.Row
+    conn.execute("PRAGMA journal_mode=%s" % config.DB_JOURNAL_MODE)
+    conn.execute("PRAGMA synchronous=%s" % config.DB_SYNCHRONOUS)
+    return conn
+
+
 def get_connection():
     """
-    Create a new SQLite connection for the current thread.
-    SQLite connections can't be shared across threads, so each caller
-    gets its own.
+    Return this thread's SQLite connection, opening it on first use.
+    It stays open for the life of the thread; callers must not close it.
     """
-    conn = sqlite3.connect(config.DB_PATH)
-    conn.row_factory = sqlite3.Row
+    conn = getattr(_local, "conn", None)
+    if conn is None:
+        conn = _local.conn = _open_connection()
     return conn
 
 
+@contextlib.contextmanager
+def _reading():
+    """Borrow a pooled connection for a read."""
+    try:
+        conn = _read_pool.get_nowait()
+    except queue.Empty:
+        conn = _open_connection()
+    try:
+        yield conn
+    finally:
+        if conn.in_transaction:
+            conn.rollback()
+        try:
+            _read_pool.put_nowait(conn)
+        except queue.Full:
+            conn.close()
+
+
+# ── Single writer ──────────────────────────────────────────────────
+
+class _WriteQueue:
+    """
+    Runs write jobs one at a time on a dedicated thread.
+
+    SQLite allows one writer at a time anyway; funnelling the ingest
+    thread, Flask handlers and the purge thread through one connection
+    means none of them ever waits on SQLITE_BUSY, and a job can never see
+    another job's half-finished transaction.
+    """
+
+    def __init__(self):
+        self._jobs = queue.Queue()
+        self._thread = None
+        self._start_lock = threading.Lock()
+
+    def call(self, fn, *args, **kwargs):
+        if self._thread is threading.current_thread():
+            return fn(*args, **kwargs)     # a job calling another write
+
+        with self._start_lock:
+            if self._thread is None:
+                self._thread = threading.Thread(
+                    target=self._run, daemon=True, name="db-writer")
+                self._thread.start()
+
+        fut = Future()
+        self._jobs.put((fut, fn, args, kwargs))
+        return fut.result()
+
+    def _run(self):
+        while True:
+            fut, fn, args, kwargs = self._jobs.get()
+            try:
+                fut.set_result(fn(*args, **kwargs))
+            except BaseException as e:
+                conn = get_connection()
+                if conn.in_transaction:
+                    conn.rollback()
+                fut.set_exception(e)
+
+
+_writer = _WriteQueue()
+
+
+def _serialized(fn):
+    """Run the decorated write function on the writer thread."""
+    @functools.wraps(fn)
+    def wrapper(*args, **kwargs):
+        return _writer.call(fn, *args, **kwargs)
+    return wrapper
+
+
+def utc_epoch_ms(utc_date, utc_time):
+    """
+    The UTC instant of utc_date/utc_time in ms since the epoch, or None.
+
+    utc_date arrives as YYYY-MM-DD (firmware), DDMMYY (GPS RMC, manual
+    entry) or '0000-00-00' (unknown); utc_time as HHMMSS[.ss], or "0"
+    from a manual entry without one (taken as midnight). Returns None
+    when the date is unknown or either field does not parse.
+    """
+    d = str(utc_date or "").strip()
+    try:
+        if len(d) == 10 and d[4] == "-" and d[7] == "-":
+            year, month, day = int(d[:4]), int(d[5:7]), int(d[8:])
+        elif len(d) >= 6 and d[:6].isdigit():
+            day, month, year = int(d[:2]), int(d[2:4]), 2000 + int(d[4:6])
+        else:
+            return None
+        if not (1 <= month <= 12 and 1 <= day <= calendar.monthrange(year, month)[1]):
+            return None
+
+        t = float(str(utc_time or "0").strip())
+    except ValueError:
+        return None
+    hms = int(t)
+    hh, mm, ss = hms // 10000, hms // 100 % 100, hms % 100
+    if t < 0 or hh > 23 or mm > 59 or ss > 60:
+        return None
+
+    seconds = calendar.timegm((year, month, day, hh, mm, ss))
+    return seconds * 1000 + int(round((t - hms) * 1000))
+
+
+def _backfill_utc_ms(conn):
+    """Fill utc_ms for rows stored before the column existed."""
+    cursor = conn.execute(
+        "SELECT id, utc_date, utc_time FROM gps_points WHERE utc_ms IS NULL")
+    while True:
+        rows = cursor.fetchmany(5000)
+        if not rows:
+            break
+        conn.executemany(
+            "UPDATE gps_points SET utc_ms = ? WHERE id = ?",
+            [(ms, r["id"]) for r in rows
+             for ms in (utc_epoch_ms(r["utc_date"], r["utc_time"]),)
+             if ms is not None])
+
+
+# point_grid cells are 360 / 2**GRID_LEVEL degrees on each side (about
+# 10 m of longitude); a coarser level's cell index is a right shift of
+# this one's. Changing it requires rebuilding point_grid.
+GRID_LEVEL = 22
+_GRID_CELL_SQL = "CAST((%%s + %s) * %r AS INTEGER)"
+_GRID_X_SQL = _GRID_CELL_SQL % (180.0, (1 << GRID_LEVEL) / 360.0)
+_GRID_Y_SQL = _GRID_CELL_SQL % (90.0, (1 << GRID_LEVEL) / 360.0)
+
+
+def _spatial_add_sql(row):
+    """Trigger body: add row (NEW/OLD) to the R*Tree and point_grid."""
+    gx, gy = _GRID_X_SQL % (row + ".longitude"), _GRID_Y_SQL % (row + ".latitude")
+    return """
+            INSERT OR REPLACE INTO gps_points_rtree
+            VALUES ({r}.id, {r}.longitude, {r}.longitude, {r}.latitude, {r}.latitude);
+            INSERT INTO point_grid (gx, gy, n, sum_lat, sum_lon)
+            VALUES ({gx}, {gy}, 1, {r}.latitude, {r}.longitude)
+            ON CONFLICT (gx, gy) DO UPDATE SET
+                n = n + 1,
+                sum_lat = sum_lat + excluded.sum_lat,
+                sum_lon = sum_lon + excluded.sum_lon;""".format(r=row, gx=gx, gy=gy)
+
+
+def _spatial_remove_sql(row):
+    """Trigger body: take row (NEW/OLD) out of the R*Tree and point_grid."""
+    gx, gy = _GRID_X_SQL % (row + ".longitude"), _GRID_Y_SQL % (row + ".latitude")
+    return """
+            DELETE FROM gps_points_rtree WHERE id = {r}.id;
+            UPDATE point_grid SET
+                n = n - 1,
+                sum_lat = sum_lat - {r}.latitude,
+                sum_lon = sum_lon - {r}.longitude
+            WHERE gx = {gx} AND gy = {gy};
+            DELETE FROM point_grid WHERE gx = {gx} AND gy = {gy} AND n <= 0;""".format(
+        r=row, gx=gx, gy=gy)
+
+
+@_serialized
 def init_db():
     """Create the gps_points table if it doesn't exist."""
     conn = get_connection()
+    # Only takes effect on a new file; an existing one is converted below
+    conn.execute("PRAGMA auto_vacuum = INCREMENTAL")
     conn.execute("""
         CREATE TABLE IF NOT EXISTS gps_points (
             id              INTEGER PRIMARY KEY AUTOINCREMENT,
@@ -49,7 +292,10 @@ def init_db():
             altitude        REAL    NOT NULL DEFAULT 0.0,
             geoid_height    REAL    NOT NULL DEFAULT 0.0,
             received_at     DATETIME DEFAULT CURRENT_TIMESTAMP,
-            deleted_at      TEXT    DEFAULT NULL
+            deleted_at      INTEGER DEFAULT NULL,
+            device_id       TEXT    DEFAULT NULL,
+            change_seq      INTEGER NOT NULL DEFAULT 0,
+            utc_ms          INTEGER DEFAULT NULL
         )
     """)
 
@@ -64,13 +310,312 @@ def init_db():
     cursor = conn.execute("PRAGMA table_info(gps_points)")
     columns = [row["name"] for row in cursor.fetchall()]
     if "deleted_at" not in columns:
-        conn.execute("ALTER TABLE gps_points ADD COLUMN deleted_at TEXT DEFAULT NULL")
+        conn.execute("ALTER TABLE gps_points ADD COLUMN deleted_at INTEGER DEFAULT NULL")
         log.info("Migrated gps_points table: added deleted_at column")
 
+    # ── Migration: deleted_at as epoch ms instead of text ─────────
+    cursor = conn.execute("PRAGMA table_info(gps_points)")
+    if any(row["name"] == "deleted_at" and row["type"].upper() == "TEXT"
+           for row in cursor.fetchall()):
+        _rebuild_deleted_at(conn)
+        log.info("Migrated gps_points table: deleted_at is now epoch ms")
+
+    # ── Migration: add device_id if upgrading from older schema ───
+    # Existing rows keep NULL: their source is unknown, so they are left
+    # out of deduplication rather than merged.
+    cursor = conn.execute("PRAGMA table_info(gps_points)")
+    columns = [row["name"] for row in cursor.fetchall()]
+    if "device_id" not in columns:
+        conn.execute("ALTER TABLE gps_points ADD COLUMN device_id TEXT DEFAULT NULL")
+        log.info("Migrated gps_points table: added device_id column")
+
+    conn.execute("""
+        CREATE UNIQUE INDEX IF NOT EXISTS gps_points_natural_key
+        ON gps_points (device_id, utc_date, utc_time, latitude, longitude)
+    """)
+
+    # ── Migration: segment bookkeeping keyed per storage epoch ────
+    # The old tables cannot tell a reformatted shears' segments from the
+    # ones it sent before. They only save re-parsing resent segments, so
+    # they are dropped rather than converted; rows are still deduplicated.
+    cursor = conn.execute("PRAGMA table_info(ingest_state)")
+    columns = [row["name"] for row in cursor.fetchall()]
+    if columns and "epoch" not in columns:
+        conn.execute("DROP TABLE ingest_state")
+        conn.execute("DROP TABLE IF EXISTS ingest_segments")
+        log.info("Migrated ingest_state: keyed by (device_id, epoch)")
+
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS ingest_state (
+            device_id   TEXT    NOT NULL,
+            epoch       INTEGER NOT NULL,
+            last_seq    INTEGER NOT NULL,
+            updated_at  DATETIME DEFAULT CURRENT_TIMESTAMP,
+            PRIMARY KEY (device_id, epoch)
+        )
+    """)
+
+    # Segments committed above a device's last_seq: the base fetches a
+    # segment again later when it fails, so they can arrive out of order.
+    conn.execute("""
+        CREATE TABLE IF NOT EXISTS ingest_segments (
+            device_id   TEXT    NOT NULL,
+            epoch       INTEGER NOT NULL,
+            seq         INTEGER NOT NULL,
+            PRIMARY KEY (device_id, epoch, seq)
+        ) WITHOUT ROWID
+    """)
+
+    # ── Migration: hot-path indexes and the maintained active count ──
+    conn.execute("""
+        CREATE INDEX IF NOT EXISTS gps_points_active
+        ON gps_points (id) WHERE deleted_at IS NULL
+    """)
+    conn.execute("""
+        CREATE INDEX IF NOT EXISTS gps_points_deleted
+        ON gps_points (deleted_at) WHERE deleted_at IS NOT NULL
+    """)
+
+    stats_exists = conn.execute(
+        "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'point_stats'"
+    ).fetchone()
+    if not stats_exists:
+        conn.execute("""
+            CREATE TABLE point_stats (
+                id            INTEGER PRIMARY KEY CHECK (id = 1),
+                active_count  INTEGER NOT NULL,
+                change_seq    INTEGER NOT NULL DEFAULT 0,
+                reset_seq     INTEGER NOT NULL DEFAULT 0
+            )
+        """)
+        conn.execute("""
+            INSERT INTO point_stats (id, active_count)
+            SELECT 1, COUNT(*) FROM gps_points WHERE deleted_at IS NULL
+        """)
+        log.info("Migrated: added point_stats")
+
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS point_stats_insert
+        AFTER INSERT ON gps_points WHEN NEW.deleted_at IS NULL
+        BEGIN
+            UPDATE point_stats SET active_count = active_count + 1 WHERE id = 1;
+        END
+    """)
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS point_stats_delete
+        AFTER DELETE ON gps_points WHEN OLD.deleted_at IS NULL
+        BEGIN
+            UPDATE point_stats SET active_count = active_count - 1 WHERE id = 1;
+        END
+    """)
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS point_stats_update
+        AFTER UPDATE OF deleted_at ON gps_points
+        WHEN (OLD.deleted_at IS NULL) != (NEW.deleted_at IS NULL)
+        BEGIN
+            UPDATE point_stats
+            SET active_count = active_count
+                + CASE WHEN NEW.deleted_at IS NULL THEN 1 ELSE -1 END
+            WHERE id = 1;
+        END
+    """)
+
+    # ── Migration: change sequence for /api/points?since= ─────────
+    # Rows that existed before get their id as sequence, in insert order.
+    cursor = conn.execute("PRAGMA table_info(gps_points)")
+    columns = [row["name"] for row in cursor.fetchall()]
+    if "change_seq" not in columns:
+        conn.execute("ALTER TABLE gps_points ADD COLUMN change_seq INTEGER NOT NULL DEFAULT 0")
+        conn.execute("UPDATE gps_points SET change_seq = id")
+        log.info("Migrated gps_points table: added change_seq column")
+
+    cursor = conn.execute("PRAGMA table_info(point_stats)")
+    columns = [row["name"] for row in cursor.fetchall()]
+    if "change_seq" not in columns:
+        conn.execute("ALTER TABLE point_stats ADD COLUMN change_seq INTEGER NOT NULL DEFAULT 0")
+        conn.execute("ALTER TABLE point_stats ADD COLUMN reset_seq INTEGER NOT NULL DEFAULT 0")
+        log.info("Migrated point_stats table: added change_seq, reset_seq")
+    conn.execute("""
+        UPDATE point_stats
+        SET change_seq = (SELECT COALESCE(MAX(change_seq), 0) FROM gps_points)
+        WHERE id = 1 AND change_seq = 0
+    """)
+
+    conn.execute("""
+        CREATE INDEX IF NOT EXISTS gps_points_change ON gps_points (change_seq)
+    """)
+
+    # ── Migration: utc_ms timestamp ───────────────────────────────
+    # Replaces the iso_date/time_key generated columns (computed from the
+    # text fields on every read); table_xinfo because table_info leaves
+    # generated columns out.
+    cursor = conn.execute("PRAGMA table_xinfo(gps_points)")
+    columns = [row["name"] for row in cursor.fetchall()]
+    if "iso_date" in columns:
+        conn.execute("DROP INDEX IF EXISTS gps_points_time")
+        conn.execute("ALTER TABLE gps_points DROP COLUMN iso_date")
+        conn.execute("ALTER TABLE gps_points DROP COLUMN time_key")
+        log.info("Migrated gps_points table: dropped iso_date, time_key")
+    if "utc_ms" not in columns:
+        conn.execute("ALTER TABLE gps_points ADD COLUMN utc_ms INTEGER DEFAULT NULL")
+        _backfill_utc_ms(conn)
+        log.info("Migrated gps_points table: added utc_ms column")
+    conn.execute("""
+        CREATE INDEX IF NOT EXISTS gps_points_utc
+        ON gps_points (utc_ms, id) WHERE deleted_at IS NULL
+    """)
+
+    # ── Migration: spatial index and grid for the map viewport ────
+    # Both hold active rows only. The R*Tree stores 32-bit floats rounded
+    # outward, so a bbox query can return points up to ~1 m outside it.
+    tables = {row["name"] for row in conn.execute(
+        "SELECT name FROM sqlite_master WHERE type = 'table'")}
+    if "point_grid" not in tables:
+        conn.execute("""
+            CREATE VIRTUAL TABLE IF NOT EXISTS gps_points_rtree USING rtree(
+                id, min_lon, max_lon, min_lat, max_lat
+            )
+        """)
+        conn.execute("""
+            CREATE TABLE point_grid (
+                gx       INTEGER NOT NULL,
+                gy       INTEGER NOT NULL,
+                n        INTEGER NOT NULL,
+                sum_lat  REAL    NOT NULL,
+                sum_lon  REAL    NOT NULL,
+                PRIMARY KEY (gx, gy)
+            ) WITHOUT ROWID
+        """)
+        conn.execute("""
+            INSERT INTO gps_points_rtree
+            SELECT id, longitude, longitude, latitude, latitude
+            FROM gps_points WHERE deleted_at IS NULL
+        """)
+        conn.execute("""
+            INSERT INTO point_grid
+            SELECT %s AS gx, %s AS gy, COUNT(*), SUM(latitude), SUM(longitude)
+            FROM gps_points WHERE deleted_at IS NULL
+            GROUP BY gx, gy
+        """ % (_GRID_X_SQL % "longitude", _GRID_Y_SQL % "latitude"))
+        log.info("Migrated: added gps_points_rtree, point_grid")
+
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS spatial_insert
+        AFTER INSERT ON gps_points WHEN NEW.deleted_at IS NULL
+        BEGIN%s
+        END
+    """ % _spatial_add_sql("NEW"))
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS spatial_delete
+        AFTER DELETE ON gps_points WHEN OLD.deleted_at IS NULL
+        BEGIN%s
+        END
+    """ % _spatial_remove_sql("OLD"))
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS spatial_soft_delete
+        AFTER UPDATE OF deleted_at ON gps_points
+        WHEN OLD.deleted_at IS NULL AND NEW.deleted_at IS NOT NULL
+        BEGIN%s
+        END
+    """ % _spatial_remove_sql("OLD"))
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS spatial_restore
+        AFTER UPDATE OF deleted_at ON gps_points
+        WHEN OLD.deleted_at IS NOT NULL AND NEW.deleted_at IS NULL
+        BEGIN%s
+        END
+    """ % _spatial_add_sql("NEW"))
+
+    # Inserts, soft-deletes and restores take the next sequence number.
+    # Bulk inserts that number their own rows (PointWriter) are left alone.
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS change_seq_insert
+        AFTER INSERT ON gps_points WHEN NEW.change_seq = 0
+        BEGIN
+            UPDATE point_stats SET change_seq = change_seq + 1 WHERE id = 1;
+            UPDATE gps_points
+            SET change_seq = (SELECT change_seq FROM point_stats WHERE id = 1)
+            WHERE id = NEW.id;
+        END
+    """)
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS change_seq_update
+        AFTER UPDATE OF deleted_at ON gps_points
+        WHEN (OLD.deleted_at IS NULL) != (NEW.deleted_at IS NULL)
+        BEGIN
+            UPDATE point_stats SET change_seq = change_seq + 1 WHERE id = 1;
+            UPDATE gps_points
+            SET change_seq = (SELECT change_seq FROM point_stats WHERE id = 1)
+            WHERE id = NEW.id;
+        END
+    """)
+    # A hard delete leaves nothing to report, so clients must reload:
+    # every client for an active row (clear), and those that have not
+    # seen the soft delete yet for a purged one.
+    conn.execute("""
+        CREATE TRIGGER IF NOT EXISTS change_seq_delete
+        AFTER DELETE ON gps_points
+        BEGIN
+            UPDATE point_stats SET
+                change_seq = change_seq + (OLD.deleted_at IS NULL),
+                reset_seq = CASE WHEN OLD.deleted_at IS NULL THEN change_seq + 1
+                                 ELSE MAX(reset_seq, OLD.change_seq) END
+            WHERE id = 1;
+        END
+    """)
+
     conn.commit()
-    conn.close()
+
+    # ── Migration: incremental vacuum, so purges shrink the file ──
+    # Switching an existing file over takes one full VACUUM.
+    if conn.execute("PRAGMA auto_vacuum").fetchone()[0] != 2:
+        conn.execute("PRAGMA auto_vacuum = INCREMENTAL")
+        conn.execute("VACUUM")
+        log.info("Migrated database file: auto_vacuum = INCREMENTAL")
+
     log.info("Database initialized: %s", config.DB_PATH)
 
+
+def _rebuild_deleted_at(conn):
+    """
+    Copy gps_points into a table declaring deleted_at INTEGER, holding
+    the deletion time in ms since the epoch (UTC).
+
+    A column's type cannot be changed in place, and TEXT affinity would
+    store the numbers as text. The new table is the old one's CREATE
+    statement with that one change, so the later migrations see the
+    columns they expect. The old table's indexes and triggers go with
+    it; init_db() creates them again after this. Ids and the
+    AUTOINCREMENT high mark are kept, so no id is ever reused. A text
+    timestamp that does not parse becomes 0 (long expired), never NULL,
+    which would restore the row.
+    """
+    sql = conn.execute(
+        "SELECT sql FROM sqlite_master WHERE type = 'table' AND name = 'gps_points'"
+    ).fetchone()[0]
+    sql = re.sub(r"^CREATE TABLE\s+(IF NOT EXISTS\s+)?\"?gps_points\"?",
+                 "CREATE TABLE gps_points_rebuild", sql)
+    sql = re.sub(r"\bdeleted_at\s+TEXT\b", "deleted_at INTEGER", sql, flags=re.I)
+    high = conn.execute(
+        "SELECT seq FROM sqlite_sequence WHERE name = 'gps_points'").fetchone()
+
+    conn.execute("DROP TABLE IF EXISTS gps_points_rebuild")
+    conn.execute(sql)
+    columns = [row["name"] for row in
+               conn.execute("PRAGMA table_info(gps_points)").fetchall()]
+    values = [c if c != "deleted_at" else
+              """CASE WHEN deleted_at IS NULL THEN NULL ELSE COALESCE(
+                     CAST(strftime('%s', deleted_at) AS INTEGER) * 1000, 0) END"""
+              for c in columns]
+    conn.execute("INSERT INTO gps_points_rebuild (%s) SELECT %s FROM gps_points"
+                 % (", ".join(columns), ", ".join(values)))
+    conn.execute("DROP TABLE gps_points")
+    conn.execute("ALTER TABLE gps_points_rebuild RENAME TO gps_points")
+    if high is not None:
+        conn.execute("UPDATE sqlite_sequence SET seq = MAX(seq, ?) WHERE name = 'gps_points'",
+                     (high[0],))
+
+@_serialized
 def insert_point(record):
     """
     Insert one GPS point record.
@@ -97,167 +642,726 @@ def insert_point(record):
         ),
     )
     conn.commit()
-    conn.close()
 
 
-def insert_points_batch(records):
+_INSERT_POINT_SQL = """INSERT INTO gps_points
+           (device_id, utc_date, utc_time, latitude, longitude, fix_quality,
+            num_satellites, hdop, altitude, geoid_height, utc_ms)
+           VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+           ON CONFLICT DO NOTHING"""
+
+
+def _point_row(device_id, r):
+    return (
+        device_id,
+        r["utc_date"],
+        r["utc_time"],
+        r["latitude"],
+        r["longitude"],
+        r["fix_quality"],
+        r["num_satellites"],
+        r["hdop"],
+        r["altitude"],
+        r["geoid_height"],
+        utc_epoch_ms(r["utc_date"], r["utc_time"]),
+    )
+
+
+@_serialized
+def insert_points_batch(records, device_id=""):
     """
     Insert multiple GPS points in a single transaction.
     Much faster than calling insert_point() in a loop.
+    Rows already stored for this device are skipped; returns the number
+    of new rows.
     """
     if not records:
         return 0
 
     conn = get_connection()
-    conn.executemany(
-        """INSERT INTO gps_points
-           (utc_date, utc_time, latitude, longitude, fix_quality,
-            num_satellites, hdop, altitude, geoid_height)
-           VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)""",
-        [
-            (
-                r["utc_date"],
-                r["utc_time"],
-                r["latitude"],
-                r["longitude"],
-                r["fix_quality"],
-                r["num_satellites"],
-                r["hdop"],
-                r["altitude"],
-                r["geoid_height"],
-            )
-            for r in records
-        ],
-    )
+    before = conn.total_changes
+    conn.executemany(_INSERT_POINT_SQL, [_point_row(device_id, r) for r in records])
     conn.commit()
-    count = len(records)
-    conn.close()
+    count = conn.total_changes - before
     return count
 
 
+def segment_stored(device_id, epoch, seq):
+    """
+    True if segment seq of the given storage epoch from device_id is
+    already committed: it is at or below the high-water mark (every
+    segment up to it is in) or was committed ahead of a gap.
+    """
+    with _reading() as conn:
+        row = conn.execute(
+            "SELECT last_seq FROM ingest_state WHERE device_id = ? AND epoch = ?",
+            (device_id, epoch)
+        ).fetchone()
+        if row and seq <= row["last_seq"]:
+            return True
+        return conn.execute(
+            "SELECT 1 FROM ingest_segments WHERE device_id = ? AND epoch = ? AND seq = ?",
+            (device_id, epoch, seq)
+        ).fetchone() is not None
+
+
+_STAGE_COLUMNS = """device_id, utc_date, utc_time, latitude, longitude,
+            fix_quality, num_satellites, hdop, altitude, geoid_height, utc_ms"""
+
+
+class PointWriter:
+    """
+    Stages GPS points as they arrive and stores them all at once.
+
+    Records are buffered and written with executemany() every batch_size
+    rows into a TEMP table on the writer connection, so memory stays
+    bounded however long the stream is and the main database is not
+    locked while a transfer trickles in. commit() moves the staged rows
+    into gps_points in one short transaction; rollback() drops them.
+    Nothing is visible to readers before commit().
+
+    count is the number of rows written, inserted the number that were new
+    (duplicates of stored rows are skipped). If seq is given, commit() also
+    records the segment of that storage epoch in the same transaction
+    (see _commit_segment()).
+    One PointWriter may be open at a time.
+    """
+
+    def __init__(self, device_id="", seq=None, epoch=0, batch_size=None):
+        self.device_id = device_id
+        self.seq = seq
+        self.epoch = epoch
+        self.batch_size = batch_size or config.INGEST_BATCH_ROWS
+        self.count = 0
+        self.inserted = 0
+        self._pending = []
+        _writer.call(self._stage_open)
+
+    def add(self, record):
+        self._pending.append(_point_row(self.device_id, record))
+        if len(self._pending) >= self.batch_size:
+            self.flush()
+
+    def flush(self):
+        """Stage the buffered records; they stay invisible until commit()."""
+        if self._pending:
+            rows, self._pending = self._pending, []
+            _writer.call(self._stage_rows, rows)
+            self.count += len(rows)
+
+    def commit(self):
+        """Store what is staged, commit, and return the number of rows."""
+        self.flush()
+        self.inserted = _writer.call(self._stage_commit)
+        return self.count
+
+    def rollback(self):
+        _writer.call(self._stage_drop)
+        self._pending = []
+        self.count = 0
+        self.inserted = 0
+
+    # The methods below run on the writer thread.
+
+    @staticmethod
+    def _stage_open():
+        conn = get_connection()
+        conn.execute("DROP TABLE IF EXISTS temp.ingest_stage")
+        conn.execute("CREATE TEMP TABLE ingest_stage AS "
+                     "SELECT %s FROM main.gps_points LIMIT 0" % _STAGE_COLUMNS)
+        conn.commit()
+
+    @staticmethod
+    def _stage_rows(rows):
+        conn = get_connection()
+        conn.executemany(_STAGE_ROW_SQL, rows)
+        conn.commit()
+
+    def _stage_commit(self):
+        conn = get_connection()
+        try:
+            conn.execute("BEGIN IMMEDIATE")
+            inserted = conn.execute(_STAGE_MOVE_SQL).rowcount
+            conn.execute(_STAGE_SEQ_SQL)
+            if self.seq is not None:
+                _commit_segment(conn, self.device_id, self.epoch, self.seq)
+            conn.commit()
+        except BaseException:
+            conn.rollback()
+            raise
+        finally:
+            PointWriter._stage_drop()
+        return inserted
+
+    @staticmethod
+    def _stage_drop():
+        conn = get_connection()
+        if conn.in_transaction:
+            conn.rollback()
+        conn.execute("DROP TABLE IF EXISTS temp.ingest_stage")
+        conn.commit()
+
+
+_STAGE_ROW_SQL = """INSERT INTO temp.ingest_stage
+           VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"""
+
+# WHERE true keeps ON CONFLICT from parsing as part of the SELECT.
+# Staged rows take their change_seq here, so change_seq_insert skips them;
+# rows lost to a conflict leave gaps in the sequence, which is harmless.
+_STAGE_MOVE_SQL = """INSERT INTO main.gps_points (%s, change_seq)
+           SELECT %s, (SELECT change_seq FROM point_stats WHERE id = 1) + rowid
+           FROM temp.ingest_stage WHERE true ORDER BY rowid
+           ON CONFLICT DO NOTHING""" % (_STAGE_COLUMNS, _STAGE_COLUMNS)
+
+_STAGE_SEQ_SQL = """UPDATE point_stats
+           SET change_seq = change_seq + (SELECT COALESCE(MAX(rowid), 0)
+                                          FROM temp.ingest_stage)
+           WHERE id = 1"""
+
+_HIGH_WATER_SQL = """INSERT INTO ingest_state (device_id, epoch, last_seq)
+           VALUES (?, ?, ?)
+           ON CONFLICT (device_id, epoch) DO UPDATE SET
+               last_seq = excluded.last_seq,
+               updated_at = CURRENT_TIMESTAMP"""
+
+
+def _commit_segment(conn, device_id, epoch, seq):
+    """
+    Record segment seq of a storage epoch as committed. The high-water
+    mark only moves over consecutive segments; one that arrives ahead of
+    a gap waits in ingest_segments until the gap is filled.
+    """
+    row = conn.execute(
+        "SELECT last_seq FROM ingest_state WHERE device_id = ? AND epoch = ?",
+        (device_id, epoch)
+    ).fetchone()
+    last = row[0] if row else 0
+    if seq <= last:
+        return
+    conn.execute("INSERT OR IGNORE INTO ingest_segments VALUES (?, ?, ?)",
+                 (device_id, epoch, seq))
+    start = last
+    while conn.execute(
+            "DELETE FROM ingest_segments WHERE device_id = ? AND epoch = ? AND seq = ?",
+            (device_id, epoch, last + 1)).rowcount:
+        last += 1
+    if last != start or row is None:
+        conn.execute(_HIGH_WATER_SQL, (device_id, epoch, last))
+
+
 def get_all_points():
     """Return all active GPS points as a list of dicts."""
-    conn = get_connection()
-    rows = conn.execute(
-        """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
-                  num_satellites, hdop, altitude, geoid_height
-           FROM gps_points
-           WHERE deleted_at IS NULL
-           ORDER BY id"""
-    ).fetchall()
-    conn.close()
+    with _reading() as conn:
+        rows = conn.execute(
+            """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
+                      num_satellites, hdop, altitude, geoid_height, utc_ms
+               FROM gps_points
+               WHERE deleted_at IS NULL
+               ORDER BY id"""
+        ).fetchall()
     return [dict(r) for r in rows]
 
 
+def get_point_seq():
+    """Current change sequence; it moves whenever the active list changes."""
+    with _reading() as conn:
+        seq = conn.execute(
+            "SELECT change_seq FROM point_stats WHERE id = 1"
+        ).fetchone()[0]
+    return seq
+
+
+def get_changes_since(since):
+    """
+    Rows inserted, soft-deleted or restored after change sequence since.
+
+    Returns {"seq", "reset", "points", "deleted"}: points are active rows,
+    deleted are soft-deleted rows with deleted_at, both oldest change
+    first. If reset is true the client's copy is stale (rows were removed
+    outright) and points/deleted hold everything instead. seq is the
+    cursor for the next call.
+    """
+    with _reading() as conn:
+        conn.execute("BEGIN")      # one snapshot for the sequence and rows
+        seq, reset_seq = conn.execute(
+            "SELECT change_seq, reset_seq FROM point_stats WHERE id = 1"
+        ).fetchone()
+        reset = since < reset_seq or since > seq
+        rows = conn.execute(
+            """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
+                      num_satellites, hdop, altitude, geoid_height, utc_ms,
+                      deleted_at
+               FROM gps_points
+               WHERE change_seq > ?
+               ORDER BY change_seq""",
+            (0 if reset else since,),
+        ).fetchall()
+        conn.rollback()
+
+    points, deleted = _split_changes(rows)
+    return {"seq": seq, "reset": reset, "points": points, "deleted": deleted}
+
+
+def _split_changes(rows):
+    """Changed rows as (active rows without deleted_at, soft-deleted rows)."""
+    points, deleted = [], []
+    for r in rows:
+        row = dict(r)
+        if row["deleted_at"] is None:
+            del row["deleted_at"]
+            points.append(row)
+        else:
+            deleted.append(row)
+    return points, deleted
+
+
+# get_points_page() sort orders; "-" = newest / highest first. Rows with
+# no date (utc_ms NULL) sort as oldest.
+POINT_SORTS = {
+    "time":  "utc_ms, id",
+    "-time": "utc_ms DESC, id DESC",
+    "id":    "id",
+    "-id":   "id DESC",
+}
+
+
+def get_points_page(offset=0, limit=200, sort="-time", date_from=None,
+                    date_to=None, ids_only=False):
+    """
+    One page of active points for the cut log.
+
+    sort is a POINT_SORTS key; date_from / date_to ("YYYY-MM-DD",
+    inclusive) keep only rows with a known date in that range. Returns
+    {"seq", "total", "offset", "points"}: total is the number of matching
+    rows, seq the change sequence the page was read at. With ids_only,
+    points is a list of ids instead of rows.
+    """
+    where, params = _date_range_sql(date_from, date_to)
+    where = " AND ".join(["deleted_at IS NULL"] + where)
+    columns = "id" if ids_only else """id, utc_date, utc_time, latitude,
+                      longitude, fix_quality, num_satellites, hdop, altitude,
+                      geoid_height, utc_ms"""
+
+    with _reading() as conn:
+        conn.execute("BEGIN")      # one snapshot for the count and the page
+        seq, total = conn.execute(
+            "SELECT change_seq, active_count FROM point_stats WHERE id = 1"
+        ).fetchone()
+        if date_from or date_to:
+            total = conn.execute(
+                "SELECT COUNT(*) FROM gps_points WHERE " + where, params
+            ).fetchone()[0]
+        rows = conn.execute(
+            "SELECT %s FROM gps_points WHERE %s ORDER BY %s LIMIT ? OFFSET ?"
+            % (columns, where, POINT_SORTS[sort]),
+            params + [limit, offset],
+        ).fetchall()
+        conn.rollback()
+
+    points = [r[0] for r in rows] if ids_only else [dict(r) for r in rows]
+    return {"seq": seq, "total": total, "offset": offset, "points": points}
+
+
+def get_changed_positions(since, limit):
+    """
+    Positions of the rows inserted, soft-deleted, restored or removed
+    after change sequence since, for invalidating map caches.
+
+    Returns {"seq", "positions"}: positions is a list of (lat, lon), or
+    None when it cannot be told (rows were removed outright, or more than
+    limit rows changed) and everything must be assumed changed.
+    """
+    with _reading() as conn:
+        conn.execute("BEGIN")
+        seq, reset_seq = conn.execute(
+            "SELECT change_seq, reset_seq FROM point_stats WHERE id = 1"
+        ).fetchone()
+        rows = None
+        if reset_seq <= since <= seq:
+            rows = conn.execute(
+                """SELECT latitude, longitude FROM gps_points
+                   WHERE change_seq > ? LIMIT ?""",
+                (since, limit + 1),
+            ).fetchall()
+        conn.rollback()
+
+    if rows is None or len(rows) > limit:
+        return {"seq": seq, "positions": None}
+    return {"seq": seq, "positions": [(r[0], r[1]) for r in rows]}
+
+
+def _date_range_sql(date_from, date_to, column="utc_ms"):
+    """WHERE terms and parameters for an inclusive YYYY-MM-DD day range."""
+    where, params = [], []
+    if date_from:
+        where.append("%s >= ?" % column)
+        params.append(utc_epoch_ms(date_from, "0"))
+    if date_to:
+        where.append("%s < ?" % column)
+        params.append(utc_epoch_ms(date_to, "0") + 86400000)
+    return where, params
+
+
+def get_points_in_bbox(min_lon, min_lat, max_lon, max_lat, limit=None,
+                       date_from=None, date_to=None):
+    """
+    Active points inside a longitude/latitude box, through the R*Tree.
+
+    date_from / date_to are as for get_points_page(). Returns at most
+    limit rows (all if None), in no particular order.
+    """
+    where, params = _date_range_sql(date_from, date_to, "gps_points.utc_ms")
+    sql = """SELECT gps_points.id, utc_date, utc_time, latitude, longitude,
+                      fix_quality, num_satellites, hdop, altitude,
+                      geoid_height, utc_ms
+               FROM gps_points_rtree
+               JOIN gps_points ON gps_points.id = gps_points_rtree.id
+               WHERE min_lon <= ? AND max_lon >= ?
+                 AND min_lat <= ? AND max_lat >= ?"""
+    sql += "".join(" AND " + w for w in where)
+    params = [max_lon, min_lon, max_lat, min_lat] + params
+    if limit is not None:
+        sql += " LIMIT ?"
+        params.append(limit)
+
+    with _reading() as conn:
+        rows = conn.execute(sql, params).fetchall()
+    return [dict(r) for r in rows]
+
+
+def get_grid_in_bbox(min_lon, min_lat, max_lon, max_lat, level,
+                     date_from=None, date_to=None):
+    """
+    Active point counts per grid cell of 360 / 2**level degrees, for the
+    cells overlapping a longitude/latitude box.
+
+    Without a date range the counts come from point_grid; with one they
+    are added up from the matching rows. Returns a list of
+    {"count", "lat", "lon", "bounds"}: lat/lon is the mean position of
+    the cell's points, bounds the cell as [min_lon, min_lat, max_lon,
+    max_lat].
+    """
+    level = max(0, min(GRID_LEVEL, level))
+    shift = GRID_LEVEL - level
+    scale = (1 << GRID_LEVEL) / 360.0
+    # Widen the box to whole cells so edge cells are counted in full
+    x0 = int((min_lon + 180.0) * scale) >> shift << shift
+    y0 = int((min_lat + 90.0) * scale) >> shift << shift
+    x1 = ((int((max_lon + 180.0) * scale) >> shift) + 1 << shift) - 1
+    y1 = ((int((max_lat + 90.0) * scale) >> shift) + 1 << shift) - 1
+
+    if date_from or date_to:
+        where, params = _date_range_sql(date_from, date_to, "gps_points.utc_ms")
+        sql = """SELECT %s >> ? AS cx, %s >> ? AS cy, COUNT(*) AS n,
+                        AVG(latitude) AS lat, AVG(longitude) AS lon
+                 FROM gps_points_rtree
+                 JOIN gps_points ON gps_points.id = gps_points_rtree.id
+                 WHERE min_lon <= ? AND max_lon >= ?
+                   AND min_lat <= ? AND max_lat >= ?
+                   AND %s BETWEEN ? AND ? AND %s BETWEEN ? AND ?%s
+                 GROUP BY cx, cy""" % (
+            _GRID_X_SQL % "longitude", _GRID_Y_SQL % "latitude",
+            _GRID_X_SQL % "longitude", _GRID_Y_SQL % "latitude",
+            "".join(" AND " + w for w in where))
+        params = [shift, shift, (x1 + 1) / scale - 180.0, x0 / scale - 180.0,
+                  (y1 + 1) / scale - 90.0, y0 / scale - 90.0,
+                  x0, x1, y0, y1] + params
+    else:
+        sql = """SELECT gx >> ? AS cx, gy >> ? AS cy, SUM(n) AS n,
+                        SUM(sum_lat) / SUM(n) AS lat, SUM(sum_lon) / SUM(n) AS lon
+                 FROM point_grid
+                 WHERE gx BETWEEN ? AND ? AND gy BETWEEN ? AND ?
+                 GROUP BY cx, cy"""
+        params = [shift, shift, x0, x1, y0, y1]
+
+    with _reading() as conn:
+        rows = conn.execute(sql, params).fetchall()
+
+    size = 360.0 / (1 << level)
+    return [{"count": r["n"], "lat": r["lat"], "lon": r["lon"],
+             "bounds": [r["cx"] * size - 180.0, r["cy"] * size - 90.0,
+                        (r["cx"] + 1) * size - 180.0, (r["cy"] + 1) * size - 90.0]}
+            for r in rows]
+
+
+EXPORT_COLUMNS = ("id", "utc_date", "utc_time", "latitude", "longitude",
+                  "fix_quality", "num_satellites", "hdop", "altitude",
+                  "geoid_height", "utc_ms")
+
+
+def iter_points(date_from=None, date_to=None, bbox=None, ids=None,
+                batch=None):
+    """
+    Stream active points for export, oldest first (utc_ms, id), as lists
+    of up to batch rows (tuples in EXPORT_COLUMNS order).
+
+    date_from / date_to are as for get_points_page(); bbox is
+    (min_lon, min_lat, max_lon, max_lat); ids limits the rows to those
+    ids. The bbox is checked on each row as gps_points_utc yields it,
+    not through the R*Tree, so SQLite never sorts the result (ids, being
+    a selection, are looked up and sorted). The rows come from one read
+    snapshot held for the whole stream, so memory stays at one batch
+    however many rows there are. Closing the generator early releases
+    the connection.
+    """
+    batch = batch or config.EXPORT_BATCH_ROWS
+    where, params = _date_range_sql(date_from, date_to)
+    where.insert(0, "deleted_at IS NULL")
+    if bbox is not None:
+        where.append("longitude BETWEEN ? AND ? AND latitude BETWEEN ? AND ?")
+        params += [bbox[0], bbox[2], bbox[1], bbox[3]]
+    if ids is not None:
+        where.append("id IN (SELECT value FROM json_each(?))")
+        params.append(json.dumps(list(ids)))
+
+    with _reading() as conn:
+        conn.execute("BEGIN")
+        cursor = conn.execute(
+            "SELECT %s FROM gps_points WHERE %s ORDER BY utc_ms, id"
+            % (", ".join(EXPORT_COLUMNS), " AND ".join(where)),
+            params,
+        )
+        while True:
+            rows = cursor.fetchmany(batch)
+            if not rows:
+                break
+            yield [tuple(r) for r in rows]
+        cursor.close()
+        conn.rollback()
+
+
 def get_point_count():
     """Return the total count of active GPS points."""
-    conn = get_connection()
-    count = conn.execute(
-        "SELECT COUNT(*) FROM gps_points WHERE deleted_at IS NULL"
-    ).fetchone()[0]
-    conn.close()
+    with _reading() as conn:
+        count = conn.execute(
+            "SELECT active_count FROM point_stats WHERE id = 1"
+        ).fetchone()[0]
     return count
 
 
 def get_latest_points(n=50):
     """Return the N most recent points (newest first)."""
-    conn = get_connection()
-    rows = conn.execute(
-        """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
-                  num_satellites, hdop, altitude, geoid_height
-           FROM gps_points
-           WHERE deleted_at IS NULL
-           ORDER BY id DESC LIMIT ?""",
-        (n,),
-    ).fetchall()
-    conn.close()
+    with _reading() as conn:
+        rows = conn.execute(
+            """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
+                      num_satellites, hdop, altitude, geoid_height, utc_ms
+               FROM gps_points
+               WHERE deleted_at IS NULL
+               ORDER BY id DESC LIMIT ?""",
+            (n,),
+        ).fetchall()
     return [dict(r) for r in rows]
 
 
+@_serialized
 def clear_all_points():
     """Delete all records. For testing/reset."""
     conn = get_connection()
-    conn.execute("DELETE FROM gps_points")
-    conn.commit()
-    conn.close()
+    try:
+        conn.execute("BEGIN IMMEDIATE")
+        conn.execute("DELETE FROM gps_points")
+        conn.execute("DELETE FROM ingest_state")
+        conn.execute("DELETE FROM ingest_segments")
+        conn.commit()
+    except BaseException:
+        conn.rollback()
+        raise
     log.info("All GPS points cleared from database")
     
-def soft_delete_points(ids):
-    """_summary_
+def _selection_sql(conn, deleted, ids=None, id_range=None, date_from=None,
+                   date_to=None, bbox=None):
+    """
+    WHERE terms and parameters picking the active (or, if deleted, the
+    soft-deleted) rows of a batch selection; all given criteria must hold.
 
-    Args:
-        ids (_type_): _description_
+    ids are loaded into temp.point_selection on conn and joined, so the
+    statement text is the same for any number of them. Raises ValueError
+    if no criterion is given, rather than select every row.
     """
-    if not ids:
-        return 0
+    if ids is None and id_range is None and bbox is None \
+            and not date_from and not date_to:
+        raise ValueError("empty selection")
+
+    where, params = _date_range_sql(date_from, date_to)
+    where.insert(0, "deleted_at IS NOT NULL" if deleted else "deleted_at IS NULL")
+    if ids is not None:
+        conn.execute("CREATE TEMP TABLE IF NOT EXISTS point_selection "
+                     "(id INTEGER PRIMARY KEY)")
+        conn.execute("DELETE FROM temp.point_selection")
+        conn.execute("INSERT OR IGNORE INTO temp.point_selection "
+                     "SELECT value FROM json_each(?)", (json.dumps(list(ids)),))
+        where.append("id IN temp.point_selection")
+    if id_range is not None:
+        where.append("id BETWEEN ? AND ?")
+        params += list(id_range)
+    if bbox is not None:
+        min_lon, min_lat, max_lon, max_lat = bbox
+        if not deleted:
+            # Active rows are in the R*Tree; its bounds are rounded
+            # outward, so the exact test below still applies
+            where.append("""id IN (SELECT id FROM gps_points_rtree
+                                   WHERE min_lon <= ? AND max_lon >= ?
+                                     AND min_lat <= ? AND max_lat >= ?)""")
+            params += [max_lon, min_lon, max_lat, min_lat]
+        where.append("longitude BETWEEN ? AND ? AND latitude BETWEEN ? AND ?")
+        params += [min_lon, max_lon, min_lat, max_lat]
+    return where, params
+
 
+def _set_deleted(delete, **selection):
+    """Soft-delete or restore a selection (writer thread); see soft_delete_matching()."""
     conn = get_connection()
-    placeholders = ",".join("?" for _ in ids)
+    since = conn.execute(
+        "SELECT change_seq FROM point_stats WHERE id = 1").fetchone()[0]
+    where, params = _selection_sql(conn, not delete, **selection)
     cursor = conn.execute(
-        f"UPDATE gps_points SET deleted_at = CURRENT_TIMESTAMP "
-        f"WHERE id IN ({placeholders}) AND deleted_at IS NULL",
-        ids,
+        "UPDATE gps_points SET deleted_at = ? WHERE " + " AND ".join(where),
+        [int(time.time() * 1000) if delete else None] + params,
     )
+    changed = cursor.rowcount
+    # Every row just changed took the next change_seq (change_seq_update),
+    # and nothing else writes meanwhile, so these are exactly those rows
+    rows = conn.execute(
+        """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
+                  num_satellites, hdop, altitude, geoid_height, utc_ms,
+                  deleted_at
+           FROM gps_points
+           WHERE change_seq > ?
+           ORDER BY change_seq""",
+        (since,),
+    ).fetchall()
+    seq = conn.execute(
+        "SELECT change_seq FROM point_stats WHERE id = 1").fetchone()[0]
+    if selection.get("ids") is not None:
+        conn.execute("DELETE FROM temp.point_selection")
     conn.commit()
-    affected = cursor.rowcount
-    conn.close()
-    log.info("Soft-deleted %d points with IDs: %s", affected, ids)
-    return affected
 
-def restore_points(ids):
+    points, deleted = _split_changes(rows)
+    return {"since": since, "seq": seq, "changed": changed,
+            "points": points, "deleted": deleted}
+
+
+@_serialized
+def soft_delete_matching(ids=None, id_range=None, date_from=None,
+                         date_to=None, bbox=None):
+    """
+    Soft-delete the active rows matching every given criterion:
+        ids         any number of ids
+        id_range    (first, last) ids, inclusive
+        date_from, date_to
+                    "YYYY-MM-DD", inclusive, as for get_points_page()
+        bbox        (min_lon, min_lat, max_lon, max_lat)
+
+    Returns the change as a delta, {"since", "seq", "changed", "points",
+    "deleted"}: points / deleted as in get_changes_since(), since the
+    change sequence before it and seq after. A client at since can apply
+    it in place of fetching ?since=. Raises ValueError for an empty
+    selection.
     """
-    Restore soft-deleted points by clearing deleted_at.
-    ids: list of point IDs to restore.
-    Returns the number of rows affected.
+    delta = _set_deleted(True, ids=ids, id_range=id_range,
+                         date_from=date_from, date_to=date_to, bbox=bbox)
+    log.info("Soft-deleted %d point(s)", delta["changed"])
+    return delta
+
+
+@_serialized
+def restore_matching(ids=None, id_range=None, date_from=None, date_to=None,
+                     bbox=None):
     """
+    Restore the soft-deleted rows matching every given criterion; the
+    criteria and result are as for soft_delete_matching().
+    """
+    delta = _set_deleted(False, ids=ids, id_range=id_range,
+                         date_from=date_from, date_to=date_to, bbox=bbox)
+    log.info("Restored %d point(s)", delta["changed"])
+    return delta
+
+
+def soft_delete_points(ids):
+    """Soft-delete points by id. Returns the number of rows affected."""
     if not ids:
         return 0
+    return soft_delete_matching(ids=ids)["changed"]
 
-    conn = get_connection()
-    placeholders = ",".join("?" for _ in ids)
-    cursor = conn.execute(
-        f"UPDATE gps_points SET deleted_at = NULL "
-        f"WHERE id IN ({placeholders}) AND deleted_at IS NOT NULL",
-        ids,
-    )
-    conn.commit()
-    affected = cursor.rowcount
-    conn.close()
-    log.info("Restored %d points with IDs: %s", affected, ids)
-    return affected
+
+def restore_points(ids):
+    """Restore soft-deleted points by id. Returns the number of rows affected."""
+    if not ids:
+        return 0
+    return restore_matching(ids=ids)["changed"]
 
 def get_deleted_points():
     """Return all soft-deleted points (the 'trash' list)."""
-    conn = get_connection()
-    rows = conn.execute(
-        """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
-                  num_satellites, hdop, altitude, geoid_height, deleted_at
-           FROM gps_points
-           WHERE deleted_at IS NOT NULL
-           ORDER BY deleted_at DESC"""
-    ).fetchall()
-    conn.close()
+    with _reading() as conn:
+        rows = conn.execute(
+            """SELECT id, utc_date, utc_time, latitude, longitude, fix_quality,
+                      num_satellites, hdop, altitude, geoid_height, utc_ms,
+                      deleted_at
+               FROM gps_points
+               WHERE deleted_at IS NOT NULL
+               ORDER BY deleted_at DESC"""
+        ).fetchall()
     return [dict(r) for r in rows]
 
-def purge_expired_deleted(hours=48):
+@_serialized
+def purge_deleted_batch(before_ms, limit):
+    """
+    Permanently delete up to limit soft-deleted points deleted before
+    before_ms (epoch ms), oldest deletion first, in one transaction.
+    Returns the number of rows deleted; fewer than limit means none are
+    left. Callers purge a backlog with repeated calls, so other writes
+    queue behind one batch at most, never the whole purge.
     """
-    Permanently delete soft-deleted points older than expire_hours.
-    Called periodically to clean up the database in app.py.
-    Returns the number of rows permanently deleted."""
     conn = get_connection()
     cursor = conn.execute(
         """DELETE FROM gps_points
-           WHERE deleted_at IS NOT NULL
-             AND deleted_at < datetime('now', ? || ' hours')""",
-        (f"{hours} hours"),
+           WHERE id IN (SELECT id FROM gps_points
+                        WHERE deleted_at IS NOT NULL AND deleted_at < ?
+                        ORDER BY deleted_at LIMIT ?)""",
+        (before_ms, limit),
     )
     conn.commit()
-    purged = cursor.rowcount
-    conn.close()
-    if purged > 0:
-        log.info("Purged %d expired soft-deleted point(s) (older than %d hours)", purged, hours)
-    return purged
+    return cursor.rowcount
+
+
+def get_oldest_deleted_ms():
+    """Deletion time (epoch ms) of the oldest soft-deleted point, or None."""
+    with _reading() as conn:
+        oldest = conn.execute(
+            "SELECT MIN(deleted_at) FROM gps_points WHERE deleted_at IS NOT NULL"
+        ).fetchone()[0]
+    return oldest
+
+
+@_serialized
+def incremental_vacuum(pages):
+    """
+    Return up to pages free pages to the file system. Returns how many
+    were freed; 0 means the free list is empty. The file shrinks once
+    the WAL is checkpointed, which is tried here without waiting.
+    """
+    conn = get_connection()
+    before = conn.execute("PRAGMA freelist_count").fetchone()[0]
+    if before == 0:
+        return 0
+    # The pragma frees one page per step and has no result rows, so
+    # execute() would step it once; executescript() runs it to the end
+    conn.executescript("PRAGMA incremental_vacuum(%d)" % int(pages))
+    after = conn.execute("PRAGMA freelist_count").fetchone()[0]
+    conn.execute("PRAGMA wal_checkpoint(PASSIVE)").fetchall()
+    return before - after
 
+
+def get_file_stats():
+    """Database file size and the part of it on the free list, in bytes."""
+    with _reading() as conn:
+        page_size = conn.execute("PRAGMA page_size").fetchone()[0]
+        pages = conn.execute("PRAGMA page_count").fetchone()[0]
+        free = conn.execute("PRAGMA freelist_count").fetchone()[0]
+    return {"db_bytes": pages * page_size, "free_bytes": free * page_size}
+
+
+@_serialized
 def insert_cut(lat, lng, timestamp=None, hdop=None, utc_date=None, fix_quality=None):
     """
     Insert a single cut record for dev/testing.
@@ -282,11 +1386,11 @@ def insert_cut(lat, lng, timestamp=None, hdop=None, utc_date=None, fix_quality=N
     cursor = conn.execute(
         """INSERT INTO gps_points
            (utc_date, utc_time, latitude, longitude, fix_quality,
-            num_satellites, hdop, altitude, geoid_height)
-           VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)""",
-        (utc_date, timestamp, lat, lng, fix_quality, 0, hdop, altitude, 0.0)
+            num_satellites, hdop, altitude, geoid_height, utc_ms)
+           VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)""",
+        (utc_date, timestamp, lat, lng, fix_quality, 0, hdop, altitude, 0.0,
+         utc_epoch_ms(utc_date, timestamp))
     )
     conn.commit()
     new_id = cursor.lastrowid
-    conn.close()
     return new_id
\ No newline at end of file
@@ -0,0 +1,247 @@
+"""
+density.py
+
+Harvest density tiles for the dashboard map, served by
+/tiles/density/<z>/<x>/<y>.png in app.py and drawn by Leaflet over the
+base map in place of individual cut markers.
+
+    - a tile is rendered from database.point_grid (see
+      database.get_grid_in_bbox): each grid cell, DENSITY_CELL_PX wide on
+      screen where the grid is fine enough, is filled with a colour for
+      its cuts per base cell (about 10 m x 10 m), so shades mean the same
+      at every zoom
+    - tiles are 8-bit palette PNGs written with zlib, so no imaging
+      library is needed; a tile with no cuts is one shared transparent PNG
+    - rendered tiles are kept in an LRU of config.DENSITY_CACHE_BYTES
+    - invalidation is incremental: before a tile is served, the rows
+      changed since the cache was last brought up to date are read from
+      the change sequence (database.get_changed_positions) and only the
+      cached tiles under their grid cells are dropped. Clears, or more
+      than config.DENSITY_MAX_CHANGES changes at once, drop everything
+    - each tile carries a strong ETag (a hash of its bytes), so a browser
+      revalidating an unchanged tile gets a 304
+
+Grid cells are squares in degrees, so in the Web Mercator tiles they can
+straddle a horizontal tile edge; they are drawn (and invalidated) on both
+tiles.
+"""
+
+import collections
+import hashlib
+import logging
+import math
+import struct
+import threading
+import zlib
+
+import config
+import database
+from tiles import Tile
+
+log = logging.getLogger("density")
+
+TILE_PX = 256
+
+# Cache accounting for a cached key and its Tile, beyond the PNG bytes
+_ENTRY_OVERHEAD = 200
+
+# Palette: index 0 transparent, then DENSITY_SHADES steps from pale
+# yellow through orange to dark red, increasingly opaque
+_RAMP = ((255, 237, 160, 110), (254, 178, 76, 160),
+         (240, 59, 32, 200), (128, 0, 38, 230))
+
+
+def _palette(shades):
+    rgb, alpha = bytearray(b"\0\0\0"), bytearray(b"\0")
+    for i in range(shades):
+        t = i / max(1, shades - 1) * (len(_RAMP) - 1)
+        lo = min(int(t), len(_RAMP) - 2)
+        f = t - lo
+        c = [round(a + (b - a) * f) for a, b in zip(_RAMP[lo], _RAMP[lo + 1])]
+        rgb += bytes(c[:3])
+        alpha.append(c[3])
+    return bytes(rgb), bytes(alpha)
+
+
+def _chunk(kind, data):
+    return (struct.pack(">I", len(data)) + kind + data
+            + struct.pack(">I", zlib.crc32(kind + data) & 0xFFFFFFFF))
+
+
+def _png(pixels):
+    """TILE_PX x TILE_PX palette PNG from one index byte per pixel."""
+    rgb, alpha = _palette(config.DENSITY_SHADES)
+    raw = bytearray()
+    for y in range(TILE_PX):
+        raw.append(0)                           # filter: none
+        raw += pixels[y * TILE_PX:(y + 1) * TILE_PX]
+    return (b"\x89PNG\r\n\x1a\n"
+            + _chunk(b"IHDR", struct.pack(">IIBBBBB", TILE_PX, TILE_PX, 8, 3, 0, 0, 0))
+            + _chunk(b"PLTE", rgb)
+            + _chunk(b"tRNS", alpha)
+            + _chunk(b"IDAT", zlib.compress(bytes(raw), 6))
+            + _chunk(b"IEND", b""))
+
+
+def _tile(data):
+    return Tile(data, hashlib.blake2b(data, digest_size=12).hexdigest(), "image/png")
+
+
+_EMPTY = None
+
+
+def _empty_tile():
+    global _EMPTY
+    if _EMPTY is None:
+        _EMPTY = _tile(_png(bytes(TILE_PX * TILE_PX)))
+    return _EMPTY
+
+
+# ── Tile geometry (Web Mercator, XYZ numbering) ───────────────────
+
+def _lon(x, z):
+    return x / (1 << z) * 360.0 - 180.0
+
+
+def _lat(y, z):
+    n = math.pi * (1 - 2 * y / (1 << z))
+    return math.degrees(math.atan(math.sinh(n)))
+
+
+def _y_px(lat, z):
+    """World pixel row of a latitude at zoom z."""
+    s = math.sin(math.radians(max(-85.05, min(85.05, lat))))
+    return (0.5 - math.log((1 + s) / (1 - s)) / (4 * math.pi)) * (TILE_PX << z)
+
+
+def _level(z):
+    """Grid level whose cells are DENSITY_CELL_PX wide at zoom z."""
+    shift = (TILE_PX // config.DENSITY_CELL_PX).bit_length() - 1
+    return min(database.GRID_LEVEL, z + shift)
+
+
+# ── Shared state (thread-safe via _lock) ───────────────────────────
+
+_lock = threading.Lock()
+_cache = collections.OrderedDict()     # (z, x, y, from, to) → Tile
+_cache_bytes = 0
+_seq = None                            # change sequence the cache is valid at
+
+
+def _drop(keys):
+    """Remove cache entries. Call with _lock held."""
+    global _cache_bytes
+    for key in keys:
+        tile = _cache.pop(key, None)
+        if tile is not None:
+            _cache_bytes -= _ENTRY_OVERHEAD + len(tile.data)
+
+
+def _sync():
+    """
+    Drop the cached tiles that changed rows fall on and return the change
+    sequence the cache is now valid at.
+    """
+    global _seq, _cache_bytes
+
+    with _lock:
+        since = _seq
+    if since is not None and database.get_point_seq() == since:
+        return since
+
+    changes = (database.get_changed_positions(since, config.DENSITY_MAX_CHANGES)
+               if since is not None else {"seq": database.get_point_seq(),
+                                          "positions": None})
+    with _lock:
+        if _seq != since:
+            return _seq                 # another request synced meanwhile
+        if changes["positions"] is None:
+            _cache.clear()
+            _cache_bytes = 0
+        else:
+            zooms = {key[0] for key in _cache}
+            stale = set()
+            for lat, lon in changes["positions"]:
+                for z in zooms:
+                    stale.update(_tiles_under_cell(lat, lon, z))
+            _drop([key for key in _cache if key[:3] in stale])
+        _seq = changes["seq"]
+        return _seq
+
+
+def _tiles_under_cell(lat, lon, z):
+    """(z, x, y) of the tiles the zoom-z grid cell holding lat/lon covers."""
+    size = 360.0 / (1 << _level(z))
+    lon0 = math.floor((lon + 180.0) / size) * size
+    lat0 = math.floor((lat + 90.0) / size) * size - 90.0
+    x_left = int(lon0 / 360.0 * (1 << z))
+    x_right = int(math.ceil((lon0 + size) / 360.0 * (1 << z))) - 1
+    y_top = int(_y_px(lat0 + size, z) // TILE_PX)
+    y_bottom = int(_y_px(lat0, z) // TILE_PX)
+    return [(z, x, y) for x in range(x_left, x_right + 1)
+            for y in range(y_top, y_bottom + 1)]
+
+
+def _render(z, x, y, date_from, date_to):
+    west, east = _lon(x, z), _lon(x + 1, z)
+    north, south = _lat(y, z), _lat(y + 1, z)
+    level = _level(z)
+    cells = database.get_grid_in_bbox(west, south, east, north, level,
+                                      date_from, date_to)
+    if not cells:
+        return _empty_tile()
+
+    # Counts are scaled to cuts per GRID_LEVEL cell, so a shade means the
+    # same density whatever the zoom
+    per_base = 4.0 ** (database.GRID_LEVEL - level)
+    shades = config.DENSITY_SHADES
+    top = math.log1p(config.DENSITY_FULL_SCALE)
+    x0, y0 = x * TILE_PX, y * TILE_PX
+    scale = TILE_PX << z
+    pixels = bytearray(TILE_PX * TILE_PX)
+
+    for cell in cells:
+        min_lon, min_lat, max_lon, max_lat = cell["bounds"]
+        px0 = max(0, round((min_lon + 180.0) / 360.0 * scale) - x0)
+        px1 = min(TILE_PX, round((max_lon + 180.0) / 360.0 * scale) - x0)
+        py0 = max(0, round(_y_px(max_lat, z)) - y0)
+        py1 = min(TILE_PX, round(_y_px(min_lat, z)) - y0)
+        if px0 >= px1 or py0 >= py1:
+            continue
+        t = math.log1p(cell["count"] / per_base) / top
+        shade = 1 + min(shades - 1, int(t * (shades - 1) + 0.5))
+        run = bytes([shade]) * (px1 - px0)
+        for py in range(py0, py1):
+            pixels[py * TILE_PX + px0:py * TILE_PX + px1] = run
+
+    return _tile(_png(pixels))
+
+
+def get_density_tile(z, x, y, date_from=None, date_to=None):
+    """
+    Density tile z/x/y (XYZ numbering) of the active cuts, optionally only
+    those dated date_from..date_to (YYYY-MM-DD, inclusive).
+    """
+    global _cache_bytes
+
+    key = (z, x, y, date_from, date_to)
+    seq = _sync()
+    with _lock:
+        if key in _cache:
+            _cache.move_to_end(key)
+            return _cache[key]
+
+    tile = _render(z, x, y, date_from, date_to)
+
+    with _lock:
+        # Only cache what was rendered after the last sync; rows changed
+        # since may not be reflected in it
+        size = _ENTRY_OVERHEAD + len(tile.data)
+        if _seq == seq and size <= config.DENSITY_CACHE_BYTES:
+            _drop([key])
+            _cache[key] = tile
+            _cache_bytes += size
+            while _cache_bytes > config.DENSITY_CACHE_BYTES:
+                _, old = _cache.popitem(last=False)
+                _cache_bytes -= _ENTRY_OVERHEAD + len(old.data)
+    return tile
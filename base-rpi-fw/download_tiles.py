@@ -3,24 +3,45 @@
 download_tiles.py — Download OSM tiles for offline use with Garden-E-Cutters.
 
 Downloads map tiles for a given bounding box and zoom range, then stores them
-in a single .mbtiles (SQLite) file that Flask can serve locally.
+in a single .mbtiles (SQLite) file that Flask can serve locally (tiles.py).
 
 Usage (on the Pi, connected to a hotspot with internet):
 
     python3 download_tiles.py
+    python3 download_tiles.py --bbox 29.60,-82.45,29.62,-82.42   # another field
+    python3 download_tiles.py --webp 80                          # smaller tiles
 
 The output file (uf_campus.mbtiles) will be created in the same directory.
 Point your Flask app at this file to serve tiles offline.
 
+Resuming and adding fields:
+    Tiles are written to <output>.part, committed every COMMIT_EVERY tiles,
+    and the .part file is renamed over the output when the run finishes.
+    A run that is interrupted resumes from the .part file; a run for a new
+    area starts from a copy of the existing output. Either way, tiles
+    already present are not downloaded again, and tiles that failed are
+    retried on the next run. The hub keeps serving the old file until the
+    rename.
+
 Tile source: OpenStreetMap (please respect their tile usage policy).
-This script throttles requests to ~1 per 100ms to be a good citizen.
+Requests go through WORKERS connections, spaced to at most REQUEST_RATE per
+second in total; 429 and 5xx answers are retried with backoff.
+
+With --webp, tiles are re-encoded to WebP (needs Pillow) before they are
+stored, which roughly halves the file and the bytes served per tile.
 """
 
+import argparse
+import concurrent.futures
+import io
 import math
 import os
+import shutil
 import sqlite3
 import sys
+import threading
 import time
+import urllib.error
 import urllib.request
 
 # ── Configuration ──────────────────────────────────────────────────
@@ -46,7 +67,10 @@ TILE_URL = "https://tile.openstreetmap.org/{z}/{x}/{y}.png"
 
 # Be a good citizen: identify ourselves and throttle requests
 USER_AGENT = "GardenECutters-TileDownloader/1.0 (UF Senior Design Project)"
-REQUEST_DELAY = 0.1  # seconds between requests
+WORKERS = 2          # concurrent connections to the tile server
+REQUEST_RATE = 10.0  # requests per second, across all workers
+RETRIES = 3          # extra attempts on 429 / 5xx / network errors
+COMMIT_EVERY = 200   # tiles per transaction
 
 # ── Tile math ──────────────────────────────────────────────────────
 
@@ -62,12 +86,18 @@ def lat_lon_to_tile(lat, lon, zoom):
     return x, y
 
 
+def tile_range(bbox, zoom):
+    """(x_min, x_max, y_min, y_max) covering the bounding box at a zoom level."""
+    x_min, y_min = lat_lon_to_tile(bbox["max_lat"], bbox["min_lon"], zoom)
+    x_max, y_max = lat_lon_to_tile(bbox["min_lat"], bbox["max_lon"], zoom)
+    return x_min, x_max, y_min, y_max
+
+
 def count_tiles(bbox, min_zoom, max_zoom):
     """Count total tiles in the bounding box across all zoom levels."""
     total = 0
     for z in range(min_zoom, max_zoom + 1):
-        x_min, y_min = lat_lon_to_tile(bbox["max_lat"], bbox["min_lon"], z)
-        x_max, y_max = lat_lon_to_tile(bbox["min_lat"], bbox["max_lon"], z)
+        x_min, x_max, y_min, y_max = tile_range(bbox, z)
         total += (x_max - x_min + 1) * (y_max - y_min + 1)
     return total
 
@@ -78,23 +108,24 @@ def flip_y(y, zoom):
 
 # ── MBTiles setup ─────────────────────────────────────────────────
 
-def create_mbtiles(filepath):
-    """Create a new MBTiles database with the required schema."""
-    if os.path.exists(filepath):
-        os.remove(filepath)
+def open_mbtiles(filepath, bbox, min_zoom, max_zoom, fmt):
+    """
+    Open (or create) an MBTiles database with the required schema.
 
+    The metadata bounds and zoom range are widened to include this run.
+    """
     conn = sqlite3.connect(filepath)
     c = conn.cursor()
 
     c.execute("""
-        CREATE TABLE metadata (
+        CREATE TABLE IF NOT EXISTS metadata (
             name  TEXT,
             value TEXT
         )
     """)
 
     c.execute("""
-        CREATE TABLE tiles (
+        CREATE TABLE IF NOT EXISTS tiles (
             zoom_level  INTEGER,
             tile_column INTEGER,
             tile_row    INTEGER,
@@ -103,21 +134,33 @@ def create_mbtiles(filepath):
     """)
 
     c.execute("""
-        CREATE UNIQUE INDEX idx_tiles
+        CREATE UNIQUE INDEX IF NOT EXISTS idx_tiles
         ON tiles (zoom_level, tile_column, tile_row)
     """)
 
+    old = dict(c.execute("SELECT name, value FROM metadata"))
+    bounds = [bbox["min_lon"], bbox["min_lat"], bbox["max_lon"], bbox["max_lat"]]
+    try:
+        ob = [float(v) for v in old["bounds"].split(",")]
+        bounds = [min(bounds[0], ob[0]), min(bounds[1], ob[1]),
+                  max(bounds[2], ob[2]), max(bounds[3], ob[3])]
+        min_zoom = min(min_zoom, int(old["minzoom"]))
+        max_zoom = max(max_zoom, int(old["maxzoom"]))
+    except (KeyError, ValueError, IndexError):
+        pass
+
     # MBTiles metadata
     metadata = [
         ("name",        "UF Campus - Garden-E-Cutters"),
         ("type",        "baselayer"),
         ("version",     "1"),
-        ("description", "OSM tiles for UF campus area, zoom 15-19"),
-        ("format",      "png"),
-        ("bounds",      f"{BBOX['min_lon']},{BBOX['min_lat']},{BBOX['max_lon']},{BBOX['max_lat']}"),
-        ("minzoom",     str(MIN_ZOOM)),
-        ("maxzoom",     str(MAX_ZOOM)),
+        ("description", f"OSM tiles for UF campus area, zoom {min_zoom}-{max_zoom}"),
+        ("format",      fmt),
+        ("bounds",      ",".join(f"{v:.4f}" for v in bounds)),
+        ("minzoom",     str(min_zoom)),
+        ("maxzoom",     str(max_zoom)),
     ]
+    c.execute("DELETE FROM metadata")
     c.executemany("INSERT INTO metadata (name, value) VALUES (?, ?)", metadata)
 
     conn.commit()
@@ -125,87 +168,209 @@ def create_mbtiles(filepath):
 
 # ── Download ──────────────────────────────────────────────────────
 
-def download_tile(z, x, y):
-    """Download a single tile from OSM. Returns PNG bytes or None on failure."""
-    url = TILE_URL.format(z=z, x=x, y=y)
+class RateLimiter:
+    """Spaces calls to wait() at least 1/rate seconds apart, across threads."""
+
+    def __init__(self, rate):
+        self.interval = 1.0 / rate if rate > 0 else 0.0
+        self.lock = threading.Lock()
+        self.next_time = time.monotonic()
+
+    def wait(self):
+        with self.lock:
+            now = time.monotonic()
+            slot = max(now, self.next_time)
+            self.next_time = slot + self.interval
+        if slot > now:
+            time.sleep(slot - now)
+
+
+def download_tile(url_template, z, x, y, limiter):
+    """Download a single tile. Returns the image bytes or None on failure."""
+    url = url_template.format(z=z, x=x, y=y)
     req = urllib.request.Request(url, headers={"User-Agent": USER_AGENT})
 
-    try:
-        with urllib.request.urlopen(req, timeout=15) as resp:
-            return resp.read()
-    except Exception as e:
-        print(f"  WARN: Failed to download z={z} x={x} y={y}: {e}")
-        return None
+    for attempt in range(RETRIES + 1):
+        limiter.wait()
+        try:
+            with urllib.request.urlopen(req, timeout=15) as resp:
+                return resp.read()
+        except urllib.error.HTTPError as e:
+            if e.code != 429 and e.code < 500:
+                err = e
+                break
+            err = e
+        except Exception as e:
+            err = e
+        if attempt < RETRIES:
+            time.sleep(min(8.0, 0.5 * 2 ** attempt))
+
+    print(f"\n  WARN: Failed to download z={z} x={x} y={y}: {err}")
+    return None
+
+
+def to_webp(data, quality):
+    """Re-encode a tile image as WebP."""
+    from PIL import Image
+
+    with Image.open(io.BytesIO(data)) as img:
+        out = io.BytesIO()
+        img.save(out, "WEBP", quality=quality, method=4)
+    return out.getvalue()
+
+
+def missing_tiles(conn, bbox, min_zoom, max_zoom):
+    """Yield (z, x, y) for every tile in the area not yet in the file."""
+    for z in range(min_zoom, max_zoom + 1):
+        x_min, x_max, y_min, y_max = tile_range(bbox, z)
+        have = set(conn.execute(
+            "SELECT tile_column, tile_row FROM tiles WHERE zoom_level=?", (z,)))
+        for x in range(x_min, x_max + 1):
+            for y in range(y_min, y_max + 1):
+                if (x, flip_y(y, z)) not in have:
+                    yield z, x, y
+
+
+def parse_args():
+    ap = argparse.ArgumentParser(description="Download map tiles into an MBTiles file")
+    ap.add_argument("--bbox", metavar="MIN_LAT,MIN_LON,MAX_LAT,MAX_LON",
+                    help="area to cover (default: UF campus)")
+    ap.add_argument("--min-zoom", type=int, default=MIN_ZOOM)
+    ap.add_argument("--max-zoom", type=int, default=MAX_ZOOM)
+    ap.add_argument("--output", default=OUTPUT_FILE)
+    ap.add_argument("--url", default=TILE_URL, help="tile URL template")
+    ap.add_argument("--workers", type=int, default=WORKERS)
+    ap.add_argument("--rate", type=float, default=REQUEST_RATE,
+                    help="max requests per second, 0 = unlimited")
+    ap.add_argument("--webp", type=int, nargs="?", const=80, metavar="QUALITY",
+                    help="re-encode tiles to WebP (needs Pillow)")
+    args = ap.parse_args()
+
+    bbox = dict(BBOX)
+    if args.bbox:
+        vals = [float(v) for v in args.bbox.split(",")]
+        if len(vals) != 4:
+            ap.error("--bbox needs four comma-separated numbers")
+        bbox = dict(zip(("min_lat", "min_lon", "max_lat", "max_lon"), vals))
+    if args.webp is not None:
+        try:
+            import PIL  # noqa: F401
+        except ImportError:
+            ap.error("--webp needs Pillow (pip install pillow)")
+    return args, bbox
 
 
 def main():
-    total = count_tiles(BBOX, MIN_ZOOM, MAX_ZOOM)
+    args, bbox = parse_args()
+    output = args.output
+    part = output + ".part"
+
+    total = count_tiles(bbox, args.min_zoom, args.max_zoom)
     print(f"Garden-E-Cutters Tile Downloader")
     print(f"================================")
-    print(f"Area:   UF Campus ({BBOX['min_lat']:.4f},{BBOX['min_lon']:.4f}) to ({BBOX['max_lat']:.4f},{BBOX['max_lon']:.4f})")
-    print(f"Zooms:  {MIN_ZOOM} – {MAX_ZOOM}")
+    print(f"Area:   ({bbox['min_lat']:.4f},{bbox['min_lon']:.4f}) to ({bbox['max_lat']:.4f},{bbox['max_lon']:.4f})")
+    print(f"Zooms:  {args.min_zoom} – {args.max_zoom}")
     print(f"Tiles:  {total}")
-    print(f"Output: {OUTPUT_FILE}")
-    print(f"Est. time: ~{int(total * REQUEST_DELAY / 60) + 1} minutes")
+    print(f"Output: {output}")
+
+    if os.path.exists(part):
+        print(f"Resuming from {part}")
+    elif os.path.exists(output):
+        print(f"Adding to {output}")
+        shutil.copyfile(output, part)
+
+    conn = open_mbtiles(part, bbox, args.min_zoom, args.max_zoom,
+                        "webp" if args.webp is not None else "png")
+    todo = list(missing_tiles(conn, bbox, args.min_zoom, args.max_zoom))
+    present = total - len(todo)
+    if args.rate > 0:
+        print(f"Est. time: ~{int(len(todo) / args.rate / 60) + 1} minutes "
+              f"({present} already present)")
     print()
 
-    conn = create_mbtiles(OUTPUT_FILE)
-    cursor = conn.cursor()
-
+    limiter = RateLimiter(args.rate)
     downloaded = 0
     failed = 0
+    uncommitted = 0
     start_time = time.time()
 
-    for z in range(MIN_ZOOM, MAX_ZOOM + 1):
-        x_min, y_min = lat_lon_to_tile(BBOX["max_lat"], BBOX["min_lon"], z)
-        x_max, y_max = lat_lon_to_tile(BBOX["min_lat"], BBOX["max_lon"], z)
-
-        zoom_tiles = (x_max - x_min + 1) * (y_max - y_min + 1)
-        print(f"Zoom {z}: {zoom_tiles} tiles (x: {x_min}-{x_max}, y: {y_min}-{y_max})")
-
-        for x in range(x_min, x_max + 1):
-            for y in range(y_min, y_max + 1):
-                tile_data = download_tile(z, x, y)
-
-                if tile_data:
-                    # MBTiles uses TMS y-axis (flipped from OSM)
-                    tms_y = flip_y(y, z)
-                    cursor.execute(
-                        "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)",
-                        (z, x, tms_y, tile_data)
-                    )
-                    downloaded += 1
-                else:
-                    failed += 1
+    def fetch(tile):
+        z, x, y = tile
+        data = download_tile(args.url, z, x, y, limiter)
+        if data and args.webp is not None:
+            try:
+                data = to_webp(data, args.webp)
+            except Exception as e:
+                print(f"\n  WARN: WebP encode failed z={z} x={x} y={y}: {e}")
+                data = None
+        return tile, data
+
+    # Keep a bounded number of tiles in flight; results are written here,
+    # on the main thread, so the database has a single writer.
+    try:
+        with concurrent.futures.ThreadPoolExecutor(max_workers=args.workers) as pool:
+            pending = set()
+            queue = iter(todo)
+            while True:
+                for tile in queue:
+                    pending.add(pool.submit(fetch, tile))
+                    if len(pending) >= args.workers * 4:
+                        break
+                if not pending:
+                    break
+
+                done, pending = concurrent.futures.wait(
+                    pending, return_when=concurrent.futures.FIRST_COMPLETED)
+                for fut in done:
+                    (z, x, y), tile_data = fut.result()
+                    if tile_data:
+                        # MBTiles uses TMS y-axis (flipped from OSM)
+                        conn.execute(
+                            "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data) VALUES (?, ?, ?, ?)",
+                            (z, x, flip_y(y, z), tile_data)
+                        )
+                        downloaded += 1
+                        uncommitted += 1
+                    else:
+                        failed += 1
+
+                if uncommitted >= COMMIT_EVERY:
+                    conn.commit()
+                    uncommitted = 0
 
                 # Progress
-                done = downloaded + failed
-                pct = (done / total) * 100 if total else 0
-                sys.stdout.write(f"\r  Progress: {done}/{total} ({pct:.1f}%) — {downloaded} ok, {failed} failed")
+                done_count = present + downloaded + failed
+                pct = (done_count / total) * 100 if total else 0
+                sys.stdout.write(f"\r  Progress: {done_count}/{total} ({pct:.1f}%) — {downloaded} ok, {failed} failed")
                 sys.stdout.flush()
-
-                time.sleep(REQUEST_DELAY)
-
-        # Commit after each zoom level
+    except KeyboardInterrupt:
         conn.commit()
-        print()  # newline after progress bar
+        conn.close()
+        print(f"\nInterrupted; run again to resume from {part}")
+        sys.exit(1)
 
+    conn.commit()
     conn.close()
+    print()  # newline after progress bar
+
+    # Swap the finished file in; the hub notices the new file by its stat.
+    os.replace(part, output)
 
     elapsed = time.time() - start_time
-    file_size_mb = os.path.getsize(OUTPUT_FILE) / (1024 * 1024)
+    file_size_mb = os.path.getsize(output) / (1024 * 1024)
 
     print()
     print(f"Done!")
     print(f"  Downloaded: {downloaded} tiles")
-    print(f"  Failed:     {failed} tiles")
+    print(f"  Present:    {present} tiles (skipped)")
+    print(f"  Failed:     {failed} tiles" + (" (run again to retry)" if failed else ""))
     print(f"  File size:  {file_size_mb:.1f} MB")
     print(f"  Time:       {elapsed:.0f} seconds")
     print()
     print(f"Next steps:")
-    print(f"  1. Move {OUTPUT_FILE} to your project directory (next to app.py)")
-    print(f"  2. Add the /tiles/ route to app.py")
-    print(f"  3. Set USE_ONLINE_TILES = false in app.js")
+    print(f"  1. Move {output} to your project directory (next to app.py)")
+    print(f"     or point HUB_MBTILES at it")
+    print(f"  2. Set USE_ONLINE_TILES = false in app.js")
 
 
 if __name__ == "__main__":
@@ -0,0 +1,48 @@
+"""
+events.py
+
+Change notifications for the dashboard push channel (/api/events in app.py).
+
+Producers call publish(topic) after something a browser shows has changed:
+
+    "points"   rows were committed, soft-deleted, restored or purged
+    "status"   transfer state or device metrics changed (/api/status)
+
+publish() only bumps a per-topic version and wakes the waiting streams; it
+never blocks the producer and carries no data. Each stream then reads what
+it needs itself (database.get_changes_since() from its own cursor), so a
+slow browser can never hold up the UART receiver and a burst of publishes
+collapses into one update.
+"""
+
+import threading
+
+_cond = threading.Condition()
+_versions = {}
+
+
+def publish(topic):
+    """Mark topic as changed and wake every waiting stream."""
+    with _cond:
+        _versions[topic] = _versions.get(topic, 0) + 1
+        _cond.notify_all()
+
+
+def snapshot():
+    """Current versions; pass to wait() to be woken by later publishes."""
+    with _cond:
+        return dict(_versions)
+
+
+def wait(seen, timeout):
+    """
+    Block until a topic moves past the versions in seen, or timeout.
+
+    seen is updated in place. Returns the topics that changed (empty on
+    timeout).
+    """
+    with _cond:
+        _cond.wait_for(lambda: _versions != seen, timeout)
+        changed = [t for t, v in _versions.items() if seen.get(t) != v]
+        seen.update(_versions)
+    return changed
@@ -0,0 +1,186 @@
+"""
+export.py
+
+Streaming encoders for /api/export. Each takes the row batches of
+database.iter_points() and yields the file a piece at a time, so an
+export of a whole season holds one batch in memory rather than the
+whole file:
+
+    csv      header line, then one line per point (EXPORT_COLUMNS)
+    geojson  a FeatureCollection of Point features; properties hold the
+             other columns
+    bin      the compact columnar format below, about a sixth the size
+             of the CSV
+
+Binary format (little-endian; read_binary() decodes it):
+
+    [0xA5 'W' 'P' ver]  then blocks  [rows u32][size u32][zlib data]
+    a block of rows = 0 (size 0) ends the stream; a file without it was
+    cut short
+
+    zlib data holds the block's columns one after another:
+        id              i64 × rows   difference from the previous row
+        utc_ms          i64 × rows   difference; 0 = date unknown
+        latitude        i64 × rows   difference, in 1e-9 degree
+        longitude       i64 × rows   difference, in 1e-9 degree
+        fix_quality     u8  × rows   (clamped to 0..255)
+        num_satellites  u8  × rows   (clamped to 0..255)
+        hdop            f32 × rows
+        altitude        f32 × rows
+        geoid_height    f32 × rows
+    Differences restart from 0 in every block. utc_date / utc_time are
+    not stored; they follow from utc_ms.
+"""
+
+import csv
+import io
+import json
+import struct
+import zlib
+
+import database
+
+MAGIC = b"\xA5WP"
+VERSION = 0x01
+
+FORMATS = {
+    # format → (mimetype, file extension)
+    "csv":     ("text/csv", "csv"),
+    "geojson": ("application/geo+json", "geojson"),
+    "bin":     ("application/octet-stream", "bin"),
+}
+
+_COORD_SCALE = 1e9
+_BLOCK_HEADER = struct.Struct("<II")
+
+
+def encode(fmt, batches):
+    """Yield the export file in format fmt (a FORMATS key) piece by piece."""
+    return {"csv": _csv, "geojson": _geojson, "bin": _binary}[fmt](batches)
+
+
+def _csv(batches):
+    out = io.StringIO()
+    writer = csv.writer(out)
+    writer.writerow(database.EXPORT_COLUMNS)
+    for rows in batches:
+        writer.writerows(rows)
+        yield out.getvalue()
+        out.seek(0)
+        out.truncate()
+    if out.tell():
+        yield out.getvalue()
+
+
+def _geojson(batches):
+    yield '{"type":"FeatureCollection","features":['
+    sep = ""
+    for rows in batches:
+        parts = []
+        for (pid, utc_date, utc_time, lat, lon, fix, sats, hdop, alt,
+             geoid, utc_ms) in rows:
+            parts.append(sep + json.dumps({
+                "type": "Feature",
+                "id": pid,
+                "geometry": {"type": "Point", "coordinates": [lon, lat]},
+                "properties": {
+                    "utc_date": utc_date, "utc_time": utc_time,
+                    "fix_quality": fix, "num_satellites": sats,
+                    "hdop": hdop, "altitude": alt,
+                    "geoid_height": geoid, "utc_ms": utc_ms,
+                },
+            }, separators=(",", ":")))
+            sep = ","
+        yield "".join(parts)
+    yield "]}\n"
+
+
+def _deltas(values):
+    prev, out = 0, []
+    for v in values:
+        out.append(v - prev)
+        prev = v
+    return out
+
+
+def _undeltas(diffs):
+    total, out = 0, []
+    for d in diffs:
+        total += d
+        out.append(total)
+    return out
+
+
+def _binary(batches):
+    yield MAGIC + bytes([VERSION])
+    for rows in batches:
+        n = len(rows)
+        cols = list(zip(*rows))
+        block = b"".join((
+            struct.pack("<%dq" % n, *_deltas(cols[0])),
+            struct.pack("<%dq" % n, *_deltas([ms or 0 for ms in cols[10]])),
+            struct.pack("<%dq" % n, *_deltas([round(v * _COORD_SCALE) for v in cols[3]])),
+            struct.pack("<%dq" % n, *_deltas([round(v * _COORD_SCALE) for v in cols[4]])),
+            bytes(min(255, max(0, v)) for v in cols[5]),
+            bytes(min(255, max(0, v)) for v in cols[6]),
+            struct.pack("<%df" % n, *cols[7]),
+            struct.pack("<%df" % n, *cols[8]),
+            struct.pack("<%df" % n, *cols[9]),
+        ))
+        data = zlib.compress(block, 6)
+        yield _BLOCK_HEADER.pack(n, len(data)) + data
+    yield _BLOCK_HEADER.pack(0, 0)
+
+
+class FormatError(Exception):
+    """Raised when a binary export is malformed or cut short."""
+
+
+def read_binary(f):
+    """
+    Decode a binary export from file object f, yielding one dict per
+    point (the stored columns; utc_ms None where the date is unknown).
+    """
+    head = f.read(4)
+    if head[:3] != MAGIC or len(head) < 4 or head[3] != VERSION:
+        raise FormatError("not a binary export")
+    while True:
+        header = f.read(_BLOCK_HEADER.size)
+        if len(header) < _BLOCK_HEADER.size:
+            raise FormatError("export cut short")
+        n, size = _BLOCK_HEADER.unpack(header)
+        if n == 0:
+            return
+        data = f.read(size)
+        if len(data) < size:
+            raise FormatError("export cut short")
+        block = zlib.decompress(data)
+        if len(block) != n * 46:
+            raise FormatError("bad block size")
+
+        pos = 0
+
+        def take(code, width):
+            nonlocal pos
+            values = struct.unpack_from("<%d%s" % (n, code), block, pos)
+            pos += n * width
+            return values
+
+        ids = _undeltas(take("q", 8))
+        utc_ms = _undeltas(take("q", 8))
+        lats = _undeltas(take("q", 8))
+        lons = _undeltas(take("q", 8))
+        fixes, sats = take("B", 1), take("B", 1)
+        hdops, alts, geoids = take("f", 4), take("f", 4), take("f", 4)
+        for i in range(n):
+            yield {
+                "id": ids[i],
+                "utc_ms": utc_ms[i] or None,
+                "latitude": lats[i] / _COORD_SCALE,
+                "longitude": lons[i] / _COORD_SCALE,
+                "fix_quality": fixes[i],
+                "num_satellites": sats[i],
+                "hdop": hdops[i],
+                "altitude": alts[i],
+                "geoid_height": geoids[i],
+            }
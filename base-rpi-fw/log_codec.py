@@ -0,0 +1,324 @@
+"""
+log_codec.py
+
+Decoder for the compressed log transfer encoding (ENC_DELTA_LZ).
+
+The shears encode each log file with log_codec.c before sending it over BLE;
+the base forwards the bytes untouched. Format details live in
+components/log_transfer/include/log_codec.h — this is the mirror image:
+
+    [0xA5 'W' 'Z' ver][rawSize u32 LE][deltaSize u32 LE][LZSS stream]
+
+    LZSS stream  → record stream (deltaSize bytes)
+    record stream → original CSV bytes (rawSize bytes)
+
+Decoder.feed() accepts the encoded bytes in arbitrary pieces and returns
+whatever decoded CSV bytes became available, so it can run while UART DATA
+frames are still arriving.
+"""
+
+import struct
+
+MAGIC = b"\xA5WZ"
+VERSION = 0x01
+HEADER_SIZE = 12
+
+MAX_FIELDS = 16
+MAX_FIELD_LEN = 31
+
+_REC_LITERAL = 0x00
+_REC_DELTA = 0x01
+
+_FIELD_SAME = 0
+_FIELD_NUMERIC = 1
+_FIELD_LITERAL = 2
+
+
+class CodecError(Exception):
+    """Raised when the encoded stream is malformed."""
+
+
+def is_encoded(head):
+    """True if the bytes start with the encoded-file magic."""
+    return len(head) >= 4 and head[:3] == MAGIC and head[3] == VERSION
+
+
+# ── Numeric field helpers (must match log_codec.c exactly) ─────────
+
+def _parse_numeric(text):
+    """Return (value, scale, width) or None — same rules as parse_numeric()."""
+    i = 0
+    n = len(text)
+    neg = False
+    if i < n and text[i] == "-":
+        neg = True
+        i += 1
+
+    start = i
+    while i < n and "0" <= text[i] <= "9":
+        i += 1
+    width = i - start
+    if width == 0:
+        return None
+    digits = text[start:i]
+
+    scale = 0
+    if i < n and text[i] == ".":
+        i += 1
+        fstart = i
+        while i < n and "0" <= text[i] <= "9":
+            i += 1
+        scale = i - fstart
+        if scale == 0:
+            return None
+        digits += text[fstart:i]
+
+    if i != n or len(digits) > 18:
+        return None
+
+    value = int(digits)
+    return (-value if neg else value), scale, width
+
+
+def _format_numeric(value, scale, width):
+    neg = value < 0
+    a = -value if neg else value
+    p = 10 ** scale
+    ip, fp = divmod(a, p)
+    s = ("-" if neg else "") + str(ip).zfill(width)
+    if scale > 0:
+        s += "." + str(fp).zfill(scale)
+    return s
+
+
+def _split_fields(line):
+    """Split a complete line (without '\\n'); None if it does not fit."""
+    fields = line.split(",")
+    if len(fields) > MAX_FIELDS:
+        return None
+    for f in fields:
+        if len(f) > MAX_FIELD_LEN:
+            return None
+    return fields
+
+
+# ── Streaming decoder ──────────────────────────────────────────────
+
+class Decoder:
+    """
+    Incremental decoder. Feed encoded bytes, collect decoded CSV bytes.
+
+    raw_size / delta_size are known once the 12-byte header has arrived.
+    """
+
+    def __init__(self):
+        self.raw_size = None
+        self.delta_size = None
+        self.encoded_bytes = 0
+        self.decoded_bytes = 0
+
+        self._header = bytearray()
+
+        # LZSS state
+        self._lz_in = bytearray()
+        self._history = bytearray()     # record-stage bytes produced so far
+        self._delta_out = 0
+
+        # Record state
+        self._rec = bytearray()         # record-stage bytes not yet consumed
+        self._prev_fields = None
+
+    # -- LZSS -------------------------------------------------------
+
+    def _run_lz(self):
+        """Expand as many complete flag groups as possible."""
+        buf = self._lz_in
+        pos = 0
+        produced = bytearray()
+
+        while self._delta_out < self.delta_size and pos < len(buf):
+            flags = buf[pos]
+            # Work out how many bytes this group needs before consuming it.
+            need = 1
+            items = 0
+            remaining = self.delta_size - self._delta_out
+            out_len = 0
+            while items < 8 and out_len < remaining:
+                if flags & (1 << items):
+                    if pos + need + 2 > len(buf):
+                        break
+                    b1 = buf[pos + need + 1]
+                    out_len += (b1 & 0x3F) + 3
+                    need += 2
+                else:
+                    if pos + need + 1 > len(buf):
+                        break
+                    out_len += 1
+                    need += 1
+                items += 1
+            else:
+                items = -1  # group complete
+
+            if items != -1:
+                break       # wait for more bytes
+
+            p = pos + 1
+            for i in range(8):
+                if self._delta_out >= self.delta_size:
+                    break
+                if flags & (1 << i):
+                    b0 = buf[p]
+                    b1 = buf[p + 1]
+                    p += 2
+                    offset = (((b1 >> 6) << 8) | b0) + 1
+                    length = (b1 & 0x3F) + 3
+                    hist = self._history
+                    if offset > len(hist):
+                        raise CodecError("LZ offset %d beyond history" % offset)
+                    start = len(hist) - offset
+                    for k in range(length):
+                        hist.append(hist[start + k])
+                    produced += hist[-length:]
+                    self._delta_out += length
+                else:
+                    self._history.append(buf[p])
+                    produced.append(buf[p])
+                    p += 1
+                    self._delta_out += 1
+            pos = p
+
+        del buf[:pos]
+        # Matches never reach back further than one LZ block (1 KiB).
+        if len(self._history) > 4096:
+            del self._history[:-1024]
+        return produced
+
+    # -- Records ----------------------------------------------------
+
+    @staticmethod
+    def _varint(buf, pos):
+        result = 0
+        shift = 0
+        while True:
+            b = buf[pos]        # IndexError → incomplete
+            pos += 1
+            result |= (b & 0x7F) << shift
+            if b < 0x80:
+                return result, pos
+            shift += 7
+
+    def _remember(self, line_bytes):
+        """Track the previous complete line, exactly as the encoder does."""
+        if not line_bytes.endswith(b"\n"):
+            return
+        text = line_bytes[:-1].decode("latin-1")
+        self._prev_fields = _split_fields(text)
+
+    def _decode_record(self, buf, pos):
+        """Decode one record at pos. Returns (line_bytes, new_pos)."""
+        tag = buf[pos]
+        pos += 1
+
+        if tag == _REC_LITERAL:
+            length, pos = self._varint(buf, pos)
+            if pos + length > len(buf):
+                raise IndexError
+            return bytes(buf[pos:pos + length]), pos + length
+
+        if tag != _REC_DELTA:
+            raise CodecError("Unknown record tag 0x%02X" % tag)
+
+        prev = self._prev_fields
+        if not prev:
+            raise CodecError("DELTA record without a previous line")
+
+        count = len(prev)
+        op_bytes = (count + 3) // 4
+        if pos + op_bytes > len(buf):
+            raise IndexError
+        ops = buf[pos:pos + op_bytes]
+        pos += op_bytes
+
+        fields = []
+        for i in range(count):
+            op = (ops[i // 4] >> ((i % 4) * 2)) & 0x03
+            if op == _FIELD_SAME:
+                fields.append(prev[i])
+            elif op == _FIELD_NUMERIC:
+                zz, pos = self._varint(buf, pos)
+                delta = (zz >> 1) ^ -(zz & 1)
+                parsed = _parse_numeric(prev[i])
+                if parsed is None:
+                    raise CodecError("Numeric delta against non-numeric field")
+                value, scale, width = parsed
+                fields.append(_format_numeric(value + delta, scale, width))
+            elif op == _FIELD_LITERAL:
+                length = buf[pos]
+                pos += 1
+                if pos + length > len(buf):
+                    raise IndexError
+                fields.append(buf[pos:pos + length].decode("latin-1"))
+                pos += length
+            else:
+                raise CodecError("Unknown field op %d" % op)
+
+        return (",".join(fields) + "\n").encode("latin-1"), pos
+
+    def _run_records(self):
+        buf = self._rec
+        pos = 0
+        out = bytearray()
+
+        while pos < len(buf):
+            try:
+                line, new_pos = self._decode_record(buf, pos)
+            except IndexError:
+                break           # record straddles a feed() boundary
+            self._remember(line)
+            out += line
+            pos = new_pos
+
+        del buf[:pos]
+        return out
+
+    # -- Public -----------------------------------------------------
+
+    def feed(self, data):
+        """Consume encoded bytes; return newly decoded CSV bytes."""
+        self.encoded_bytes += len(data)
+
+        if self.delta_size is None:
+            self._header += data
+            if len(self._header) < HEADER_SIZE:
+                return b""
+            if not is_encoded(self._header):
+                raise CodecError("Bad magic")
+            self.raw_size, self.delta_size = struct.unpack(
+                "<II", bytes(self._header[4:HEADER_SIZE]))
+            data = bytes(self._header[HEADER_SIZE:])
+            self._header = bytearray()
+
+        self._lz_in += data
+        self._rec += self._run_lz()
+        out = self._run_records()
+        self.decoded_bytes += len(out)
+        return bytes(out)
+
+    def finish(self):
+        """Validate that the whole stream was consumed."""
+        if self.delta_size is None:
+            raise CodecError("Truncated header")
+        if self._delta_out != self.delta_size or self._rec:
+            raise CodecError("Truncated stream (%d/%d record bytes)"
+                             % (self._delta_out, self.delta_size))
+        if self.decoded_bytes != self.raw_size:
+            raise CodecError("Decoded %d bytes, header says %d"
+                             % (self.decoded_bytes, self.raw_size))
+
+
+def decode(data):
+    """Decode a complete encoded file and return the original bytes."""
+    dec = Decoder()
+    out = dec.feed(bytes(data))
+    dec.finish()
+    return out
@@ -0,0 +1,100 @@
+"""
+metrics.py
+
+Decoder for the metrics snapshots the base forwards in METRICS frames.
+
+The layout is defined in components/metrics/include/metrics.h; this is the
+mirror image:
+
+    [ver u8][source u8][uptime_ms u32 LE]
+    [N u8]  N x { id u8, value u32 LE }
+    [M u8]  M x { id u8, count u32, sum_ms u32, max_ms u32, B u8, B x u16 }
+
+Ids the decoder does not know are kept under "id_<n>" so a newer firmware
+never breaks the Pi.
+"""
+
+import struct
+
+VERSION = 0x01
+
+SOURCES = {1: "shears", 2: "base"}
+
+# metric_id_t — append only, never renumber (must match metrics.h)
+COUNTERS = {
+    0: "cuts_saved",
+    1: "saves_failed",
+    2: "ble_chunks_sent",
+    3: "ble_chunks_failed",
+    4: "ble_notify_errors",
+    5: "ble_chunks_received",
+    6: "ble_chunk_gaps",
+    7: "segments_fetched",
+    8: "uart_segments_sent",
+    9: "uart_retransmits",
+    10: "uart_retries",
+    11: "spiffs_used_bytes",
+    12: "spiffs_total_bytes",
+    13: "segments_discarded",
+    14: "uart_quarantined",
+}
+
+# metric_hist_id_t (must match metrics.h)
+HISTOGRAMS = {
+    0: "cut_to_fix_ms",
+    1: "save_ms",
+    2: "segment_fetch_ms",
+    3: "uart_segment_ms",
+}
+
+# METRICS_HIST_BOUNDS_MS; the last bucket is everything above 5000 ms.
+BUCKET_BOUNDS_MS = [5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000]
+
+
+class MetricsError(Exception):
+    """Raised when a snapshot is malformed."""
+
+
+def _take(buf, pos, fmt):
+    size = struct.calcsize(fmt)
+    if pos + size > len(buf):
+        raise MetricsError("snapshot truncated at byte %d" % pos)
+    return struct.unpack_from(fmt, buf, pos), pos + size
+
+
+def decode(payload):
+    """
+    Decode one snapshot into
+        {"source", "uptime_ms", "counters": {...}, "histograms": {...}}.
+    Histogram buckets are listed as [upper_bound_ms or None, count].
+    """
+    buf = bytes(payload)
+    (ver, source, uptime), pos = _take(buf, 0, "<BBI")
+    if ver != VERSION:
+        raise MetricsError("unsupported snapshot version %d" % ver)
+
+    (n,), pos = _take(buf, pos, "<B")
+    counters = {}
+    for _ in range(n):
+        (mid, value), pos = _take(buf, pos, "<BI")
+        counters[COUNTERS.get(mid, "id_%d" % mid)] = value
+
+    (m,), pos = _take(buf, pos, "<B")
+    histograms = {}
+    for _ in range(m):
+        (hid, count, sum_ms, max_ms, nb), pos = _take(buf, pos, "<BIIIB")
+        (*buckets,), pos = _take(buf, pos, "<%dH" % nb)
+        bounds = BUCKET_BOUNDS_MS + [None] * max(0, nb - len(BUCKET_BOUNDS_MS))
+        histograms[HISTOGRAMS.get(hid, "id_%d" % hid)] = {
+            "count": count,
+            "mean_ms": round(sum_ms / count, 1) if count else None,
+            "max_ms": max_ms,
+            "buckets": [[bounds[i], c] for i, c in enumerate(buckets)],
+        }
+
+    return {
+        "source": SOURCES.get(source, "unknown"),
+        "uptime_ms": uptime,
+        "counters": counters,
+        "histograms": histograms,
+    }
@@ -0,0 +1,121 @@
+"""
+retention.py
+
+Purges soft-deleted points config.RETENTION_HOURS after their deletion,
+on a background thread.
+
+    - a run deletes the expired rows oldest first through the
+      gps_points_deleted index, config.PURGE_BATCH_ROWS per writer
+      transaction (database.purge_deleted_batch()), so ingest and the
+      dashboard's writes wait for one batch at most
+    - it then returns the freed pages to the file system in steps of
+      config.VACUUM_BATCH_PAGES (database.incremental_vacuum()), so the
+      database file shrinks rather than keeping its high-water size
+    - the next run is due when the oldest remaining soft-deleted point
+      expires, kept within config.PURGE_MIN_INTERVAL_S ..
+      PURGE_MAX_INTERVAL_S, so nothing is scanned while nothing expires
+    - get_stats() reports what the last run did, totals since start and
+      the file size, for /api/status
+"""
+
+import logging
+import threading
+import time
+
+import config
+import database
+import events
+
+log = logging.getLogger("retention")
+
+_lock = threading.Lock()
+_stats = {
+    "retention_hours": config.RETENTION_HOURS,
+    "runs": 0,
+    "last_run": None,               # epoch s
+    "last_purged": 0,
+    "last_batches": 0,
+    "last_vacuumed_pages": 0,
+    "last_duration_ms": 0.0,
+    "next_run": None,               # epoch s
+    "total_purged": 0,
+    "total_vacuumed_pages": 0,
+}
+
+
+def run_once():
+    """Purge what has expired, then vacuum. Returns the rows purged."""
+    t0 = time.monotonic()
+    before_ms = int(time.time() * 1000) - int(config.RETENTION_HOURS * 3600 * 1000)
+
+    purged = batches = 0
+    while True:
+        n = database.purge_deleted_batch(before_ms, config.PURGE_BATCH_ROWS)
+        purged += n
+        batches += 1
+        if n < config.PURGE_BATCH_ROWS:
+            break
+    if purged:
+        events.publish("points")
+
+    vacuumed = 0
+    while True:
+        n = database.incremental_vacuum(config.VACUUM_BATCH_PAGES)
+        vacuumed += n
+        if n < config.VACUUM_BATCH_PAGES:
+            break
+
+    elapsed_ms = (time.monotonic() - t0) * 1000.0
+    with _lock:
+        _stats["runs"] += 1
+        _stats["last_run"] = time.time()
+        _stats["last_purged"] = purged
+        _stats["last_batches"] = batches
+        _stats["last_vacuumed_pages"] = vacuumed
+        _stats["last_duration_ms"] = round(elapsed_ms, 1)
+        _stats["total_purged"] += purged
+        _stats["total_vacuumed_pages"] += vacuumed
+    if purged or vacuumed:
+        events.publish("status")
+        log.info("Purged %d point(s) in %d batch(es), vacuumed %d page(s) in %.0f ms",
+                 purged, batches, vacuumed, elapsed_ms)
+    return purged
+
+
+def _next_delay():
+    """Seconds until the oldest soft-deleted point expires, clamped."""
+    oldest = database.get_oldest_deleted_ms()
+    if oldest is None:
+        return config.PURGE_MAX_INTERVAL_S
+    due = oldest / 1000.0 + config.RETENTION_HOURS * 3600 - time.time()
+    return max(config.PURGE_MIN_INTERVAL_S, min(config.PURGE_MAX_INTERVAL_S, due))
+
+
+def _loop():
+    delay = config.PURGE_MIN_INTERVAL_S
+    while True:
+        with _lock:
+            _stats["next_run"] = time.time() + delay
+        time.sleep(delay)
+        try:
+            run_once()
+            delay = _next_delay()
+        except Exception as e:
+            log.error("Purge run failed: %s", e)
+            delay = config.PURGE_MAX_INTERVAL_S
+
+
+def start():
+    """Launch the purge thread as a daemon."""
+    thread = threading.Thread(target=_loop, daemon=True, name="retention")
+    thread.start()
+    log.info("Retention thread started (purge %gh after deletion)",
+             config.RETENTION_HOURS)
+
+
+def get_stats():
+    """Purge counters and the database file size, for /api/status."""
+    with _lock:
+        stats = dict(_stats)
+    stats.update(database.get_file_stats())
+    return stats
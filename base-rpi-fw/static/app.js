@@ -31,11 +31,28 @@ const FIX_QUALITY_RADIUS_METERS = {
   6: 0,      // Dead Reckoning (not attained)
 };
 
-// "normal" = default marker, "fix" = bubble size driven by fix quality
+// "normal" = default marker, "fix" = bubble size driven by fix quality,
+// "density" = the harvest density overlay only, at every zoom
 let mapMode = "normal";
 
+// The map fetches only its view (/api/points?bbox=&zoom=), widened by
+// MAP_VIEW_PAD of its size on each side so short pans need no new fetch
+const MAP_VIEW_PAD = 0.25;
+
+// Below this zoom the map shows server-rendered density tiles
+// (/tiles/density/..., see density.py) instead of cut markers; matches
+// POINTS_GRID_MAX_ZOOM in config.py
+const DENSITY_MAX_ZOOM = 17;
+const DENSITY_OPACITY = 0.75;
+
 let cutsData = [];
 let deletedCutsData = [];
+
+// In-memory model kept in step with /api/points?since= deltas.
+// cutsData / deletedCutsData are rebuilt from these when a delta changes them.
+const cutsById = new Map();
+const deletedCutsById = new Map();
+let pointsSeq = 0;
 const DELETED_RETENTION_HOURS = 48;
 const DELETED_RETENTION_MS = DELETED_RETENTION_HOURS * 60 * 60 * 1000;
 const API_PORT = "80";
@@ -48,8 +65,20 @@ async function apiFetch(path, options = {}) {
 // Leaflet state
 let map = null;
 let cutLayer = null;
+let clusterLayer = null;
+let cutRenderer = null;
+let densityLayer = null;
+let densityUrl = null;
+let densitySeq = null;       // pointsSeq the density tiles were loaded at
 let mapInitialized = false;
 
+// Markers drawn for each cut id: { cut, marker, fix }. updateMap()
+// diffs against this, so only cuts that changed touch Leaflet.
+const cutMarkers = new Map();
+let mapPoints = [];          // the cuts last fetched for the view
+let mapViewLoading = false;
+let mapViewDirty = false;
+
 async function canReachInternet() {
     try {
         const resp = await fetch("https://tile.openstreetmap.org/0/0/0.png", {
@@ -70,82 +99,41 @@ function normalizeLonForBounds(lon) {
   return lon;
 }
 
-// API only gives a UTC time-of-day (no date). We treat it as "today" and format in ET.
-// This will show EST/EDT correctly based on today.
-function utcTimeToET(utcTime) {
-  if (!utcTime) return "";
-
-  const raw = String(utcTime).trim();
-  // "0" is the default placeholder from manual cuts — not a real time
-  if (raw === "0" || raw === "") return "";
-
-  const main = raw.split(".")[0].padStart(6, "0"); // HHMMSS
-  const hh = Number(main.slice(0, 2));
-  const mm = Number(main.slice(2, 4));
-  const ss = Number(main.slice(4, 6));
-
-  if ([hh, mm, ss].some(n => Number.isNaN(n))) return "";
-  if (hh > 23 || mm > 59 || ss > 59) return "";
-
-  const now = new Date();
-  const y = now.getUTCFullYear();
-  const m = now.getUTCMonth();
-  const d = now.getUTCDate();
-  const dt = new Date(Date.UTC(y, m, d, hh, mm, ss));
-
-  return new Intl.DateTimeFormat("en-US", {
-    timeZone: "America/New_York",
-    hour: "numeric",
-    minute: "2-digit",
-    second: "2-digit",
-    hour12: true
-  }).format(dt);
+// utc_ms (from the server) is the cut's UTC instant in ms, or null when
+// its date is unknown. Times are shown in ET, dates as the UTC date.
+const ET_TIME_FORMAT = new Intl.DateTimeFormat("en-US", {
+  timeZone: "America/New_York",
+  hour: "numeric",
+  minute: "2-digit",
+  second: "2-digit",
+  hour12: true
+});
+
+const UTC_DATE_FORMAT = new Intl.DateTimeFormat("en-US", {
+  timeZone: "UTC",
+  year: "numeric",
+  month: "2-digit",
+  day: "2-digit"
+});
+
+/** "h:mm:ss AM" in ET, or the raw UTC HHMMSS when the date is unknown. */
+function cutTimeDisplay(cut) {
+  if (cut.utc_ms != null) return ET_TIME_FORMAT.format(cut.utc_ms);
+  const raw = String(cut.utc_time ?? "").split(".")[0];
+  return raw === "0" ? "" : raw;
 }
 
-/**
- * Convert utc_date from the API (DDMMYY string from $GNRMC) into "YYYY-MM-DD"
- * so it can be compared against the <input type="date"> filter values.
- *
- * Examples:
- *   "240326" → "2026-03-24"
- *   "010125" → "2025-01-01"
- *   ""       → ""
- */
-function utcDateToISO(utcDate) {
-  if (!utcDate) return "";
-  const raw = String(utcDate).trim();
-  if (raw === "0" || raw === "0000-00-00" || raw === "00-00-0000") return "";
-
-  // Already ISO format (YYYY-MM-DD) — return as-is
-  if (raw.length === 10 && raw[4] === "-") {
-    return raw;
-  }
-
-  // DDMMYY from GPS $GNRMC
-  if (raw.length >= 6) {
-    const dd = raw.slice(0, 2);
-    const mm = raw.slice(2, 4);
-    const yy = raw.slice(4, 6);
-    const day = Number(dd);
-    const month = Number(mm);
-    if (Number.isNaN(day) || Number.isNaN(month)) return "";
-    if (day < 1 || day > 31 || month < 1 || month > 12) return "";
-    return `20${yy}-${mm}-${dd}`;
-  }
-
-  return "";
+/** "MM/DD/YYYY", or "" when the date is unknown. */
+function cutDateDisplay(cut) {
+  return cut.utc_ms != null ? UTC_DATE_FORMAT.format(cut.utc_ms) : "";
 }
 
-async function fetchCuts() {
-  const res = await apiFetch("/api/cuts", { cache: "no-store" });
-  if (!res.ok) throw new Error(`GET /api/cuts failed: ${res.status}`);
-
-  const apiCuts = await res.json();
-
-  cutsData = (Array.isArray(apiCuts) ? apiCuts : []).map(row => ({
+function normalizeCutRow(row) {
+  return {
     id: row.id,
     utc_date: row.utc_date ?? "",
     utc_time: row.utc_time,
+    utc_ms: row.utc_ms != null ? Number(row.utc_ms) : null,
 
     latitude: Number(row.latitude),
     longitude: normalizeLonForBounds(Number(row.longitude)),
@@ -155,19 +143,62 @@ async function fetchCuts() {
     geoid_height: row.geoid_height != null ? Number(row.geoid_height) : null,
     hdop: row.hdop != null ? Number(row.hdop) : null,
     num_satellites: row.num_satellites != null ? Number(row.num_satellites) : null
-  }));
+  };
+}
+
+/**
+ * Fetch the rows added, deleted or restored since the last call and apply
+ * them to the model. The first call (or a server-side reset) loads everything.
+ *
+ * Returns true if cutsData / deletedCutsData changed.
+ */
+async function fetchCutChanges() {
+  const res = await apiFetch(`/api/points?since=${pointsSeq}`, { cache: "no-store" });
+  if (!res.ok) throw new Error(`GET /api/points failed: ${res.status}`);
+  return applyCutDelta(await res.json());
+}
+
+/**
+ * Apply a /api/points?since= delta (fetched, or pushed by /api/events).
+ * Rows are keyed by id, so a delta that overlaps one already applied is
+ * harmless.
+ *
+ * Returns true if cutsData / deletedCutsData changed.
+ */
+function applyCutDelta(delta) {
+  const points = Array.isArray(delta.points) ? delta.points : [];
+  const deleted = Array.isArray(delta.deleted) ? delta.deleted : [];
+
+  if (delta.reset) {
+    cutsById.clear();
+    deletedCutsById.clear();
+  }
+
+  for (const row of points) {
+    deletedCutsById.delete(row.id);
+    cutsById.set(row.id, normalizeCutRow(row));
+  }
+  for (const row of deleted) {
+    cutsById.delete(row.id);
+    selectedCutIds.delete(row.id);
+    deletedCutsById.set(row.id, { ...normalizeCutRow(row), deleted_at: row.deleted_at ?? "" });
+  }
+
+  pointsSeq = Number(delta.seq) || 0;
+
+  if (!delta.reset && !points.length && !deleted.length) return false;
+
+  cutsData = Array.from(cutsById.values());
+  deletedCutsData = Array.from(deletedCutsById.values())
+    .sort((a, b) => parseDeletedAtToMs(b.deleted_at) - parseDeletedAtToMs(a.deleted_at));
+  return true;
 }
 
+// deleted_at arrives as ms since the epoch (UTC).
 function parseDeletedAtToMs(deletedAt) {
-  if (!deletedAt) return Number.NaN;
-  const raw = String(deletedAt).trim();
-  if (!raw) return Number.NaN;
-
-  // SQLite CURRENT_TIMESTAMP is "YYYY-MM-DD HH:MM:SS" in UTC.
-  const isoLike = raw.includes("T") ? raw : raw.replace(" ", "T");
-  const utcValue = isoLike.endsWith("Z") ? isoLike : `${isoLike}Z`;
-  const parsed = Date.parse(utcValue);
-  return Number.isNaN(parsed) ? Number.NaN : parsed;
+  if (deletedAt == null || deletedAt === "") return Number.NaN;
+  const ms = Number(deletedAt);
+  return Number.isFinite(ms) ? ms : Number.NaN;
 }
 
 function getRetainedDeletedCuts() {
@@ -192,92 +223,77 @@ function formatTimeRemainingFromDeletedAt(deletedAt) {
   return `${hours}h ${String(minutes).padStart(2, "0")}m`;
 }
 
-async function fetchDeletedCuts() {
-  const res = await apiFetch("/api/points/deleted", { cache: "no-store" });
-  if (!res.ok) throw new Error(`GET /api/points/deleted failed: ${res.status}`);
-
-  const apiCuts = await res.json();
-  deletedCutsData = (Array.isArray(apiCuts) ? apiCuts : []).map(row => ({
-    id: row.id,
-    utc_date: row.utc_date ?? "",
-    utc_time: row.utc_time,
-    latitude: Number(row.latitude),
-    longitude: normalizeLonForBounds(Number(row.longitude)),
-    altitude: row.altitude != null ? Number(row.altitude) : null,
-    fix_quality: row.fix_quality != null ? Number(row.fix_quality) : null,
-    geoid_height: row.geoid_height != null ? Number(row.geoid_height) : null,
-    hdop: row.hdop != null ? Number(row.hdop) : null,
-    num_satellites: row.num_satellites != null ? Number(row.num_satellites) : null,
-    deleted_at: row.deleted_at ?? "",
-  }));
-}
-
 // ── Status polling ────────────────────────────────────────────────
 
+// Last /api/status body, kept so "Last sync: X min ago" can be refreshed
+// locally while the event stream has nothing new to say.
+let lastStatus = null;
+
 /**
  * Poll /api/status and update the header indicator.
- *
- * Shows one of:
- *   - "Transferring data..."   (green dot, transfer in progress)
- *   - "Last sync: X min ago"   (green dot, idle after a successful transfer)
- *   - "Last sync failed"       (red dot, last transfer had an error)
- *   - "No syncs yet"           (grey/red dot, server just started)
- *   - "Hub offline"            (red dot, can't reach the API at all)
  */
 async function fetchStatus() {
   try {
     const res = await apiFetch("/api/status", { cache: "no-store" });
     if (!res.ok) return;
-    const status = await res.json();
-
+    renderStatus(await res.json());
+  } catch (err) {
+    // Can't reach the server at all
+    lastStatus = null;
     const dot = document.getElementById("connection-status-dot");
     const text = document.getElementById("connection-status-text");
+    if (dot) dot.className = "disconnected";
+    if (text) text.textContent = "Hub offline";
+  }
+}
 
-    if (status.transfer_active) {
+/**
+ * Update the header indicator from a /api/status body.
+ *
+ * Shows one of:
+ *   - "Transferring data..."   (green dot, transfer in progress)
+ *   - "Last sync: X min ago"   (green dot, idle after a successful transfer)
+ *   - "Last sync failed"       (red dot, last transfer had an error)
+ *   - "No syncs yet"           (grey/red dot, server just started)
+ *   - "Hub offline"            (red dot, can't reach the API at all)
+ */
+function renderStatus(status) {
+  lastStatus = status;
+  const dot = document.getElementById("connection-status-dot");
+  const text = document.getElementById("connection-status-text");
+  if (!dot || !text) return;
+
+  if (status.transfer_active) {
+    dot.className = "connected";
+    text.textContent = "Transferring data...";
+  } else if (status.last_transfer_time) {
+    if (status.last_transfer_ok === false) {
+      dot.className = "disconnected";
+      text.textContent = "Last sync failed";
+    } else {
       dot.className = "connected";
-      text.textContent = "Transferring data...";
-    } else if (status.last_transfer_time) {
-      if (status.last_transfer_ok === false) {
-        dot.className = "disconnected";
-        text.textContent = "Last sync failed";
+      const ago = Math.floor(Date.now() / 1000 - status.last_transfer_time);
+      if (ago < 60) {
+        text.textContent = "Last sync: just now";
+      } else if (ago < 3600) {
+        const mins = Math.floor(ago / 60);
+        text.textContent = `Last sync: ${mins} min ago`;
+      } else if (ago < 86400) {
+        const hrs = Math.floor(ago / 3600);
+        text.textContent = `Last sync: ${hrs} hr ago`;
       } else {
-        dot.className = "connected";
-        const ago = Math.floor(Date.now() / 1000 - status.last_transfer_time);
-        if (ago < 60) {
-          text.textContent = "Last sync: just now";
-        } else if (ago < 3600) {
-          const mins = Math.floor(ago / 60);
-          text.textContent = `Last sync: ${mins} min ago`;
-        } else if (ago < 86400) {
-          const hrs = Math.floor(ago / 3600);
-          text.textContent = `Last sync: ${hrs} hr ago`;
-        } else {
-          const days = Math.floor(ago / 86400);
-          text.textContent = `Last sync: ${days}d ago`;
-        }
+        const days = Math.floor(ago / 86400);
+        text.textContent = `Last sync: ${days}d ago`;
       }
-    } else {
-      dot.className = "disconnected";
-      text.textContent = "No syncs yet";
     }
-  } catch (err) {
-    // Can't reach the server at all
-    const dot = document.getElementById("connection-status-dot");
-    const text = document.getElementById("connection-status-text");
-    if (dot) dot.className = "disconnected";
-    if (text) text.textContent = "Hub offline";
+  } else {
+    dot.className = "disconnected";
+    text.textContent = "No syncs yet";
   }
 }
 
 // ── Sorting & filtering ───────────────────────────────────────────
 
-function toSortKey(cut) {
-  const dateISO = utcDateToISO(cut.utc_date);   // "YYYY-MM-DD" or ""
-  const raw = (cut.utc_time == null) ? "" : String(cut.utc_time);
-  const timeKey = raw.split(".")[0].padStart(6, "0");
-  return `${dateISO} ${timeKey}`;
-}
-
 /** Display label for fix quality (NMEA-style codes). */
 function fixQualityToShortLabel(fix) {
   const map = {
@@ -303,13 +319,13 @@ function fixQualityPillClass(fix) {
   return "fix-pill fix-pill--neutral";
 }
 
-function updateLogsPaginationInfo(count) {
+function updateLogsPaginationInfo(first, last, total) {
   const el = document.getElementById("logs-pagination-info");
   if (!el) return;
-  if (count === 0) {
+  if (total === 0) {
     el.textContent = "Showing 0 of 0 entries";
   } else {
-    el.textContent = `Showing 1–${count} of ${count} entries`;
+    el.textContent = `Showing ${first + 1}–${last} of ${total} entries`;
   }
 }
 
@@ -323,36 +339,6 @@ function updateDeletedPaginationInfo(count) {
   }
 }
 
-/**
- * Return cuts filtered by the date range inputs and sorted newest-first.
- * If no date filters are set, returns all cuts sorted.
- */
-function getFilteredCuts() {
-  const startInput = document.getElementById("timestamp-start");
-  const endInput = document.getElementById("timestamp-end");
-
-  const startValue = startInput ? startInput.value : "";  // "YYYY-MM-DD" or ""
-  const endValue = endInput ? endInput.value : "";
-
-  let filtered = cutsData;
-
-  // Only filter if at least one date is set
-  if (startValue || endValue) {
-    filtered = cutsData.filter(cut => {
-      const isoDate = utcDateToISO(cut.utc_date);
-
-      // If the cut has no date, exclude it when filtering is active
-      if (!isoDate) return false;
-
-      if (startValue && isoDate < startValue) return false;
-      if (endValue && isoDate > endValue) return false;
-      return true;
-    });
-  }
-
-  return [...filtered].sort((a, b) => toSortKey(b).localeCompare(toSortKey(a)));
-}
-
 /**
  * Convert a user-entered date string into GPS DDMMYY format.
  * Accepts: "MM/DD/YYYY", "MM-DD-YYYY", "YYYY-MM-DD" (from <input type="date">)
@@ -483,17 +469,6 @@ async function addCutFromForm() {
       throw new Error(`POST /api/cuts failed: ${res.status}`);
     }
 
-    // Try to read the newly created ID so we can reflect the row immediately.
-    let newId = null;
-    try {
-      const json = await res.json();
-      if (json && typeof json.id === "number") {
-        newId = json.id;
-      }
-    } catch {
-      // If parsing fails, we'll still add a row without an ID.
-    }
-
     dateInput.value = "";
     latInput.value = "";
     lonInput.value = "";
@@ -501,25 +476,8 @@ async function addCutFromForm() {
     utcInput.value = "";
     hdopInput.value = "";
 
-    // Instead of re-fetching from the server (which doesn't yet persist the date),
-    // append a client-side cut so the date shows up immediately in the list.
-    const newCut = {
-      id: newId,
-      utc_date: dateConverted || "",
-      utc_time: utcRaw || "0",
-      latitude: lat,
-      longitude: normalizeLonForBounds(lon),
-      altitude: 73.0,
-      fix_quality: fixQualityVal,
-      geoid_height: 0.0,
-      hdop: Number.isNaN(hdopVal) ? 0.0 : hdopVal,
-      num_satellites: 0,
-    };
-
-    cutsData = [...cutsData, newCut];
-
-    renderTable();
-    updateMap(getFilteredCuts());
+    // The server stores the date and its utc_ms; pick the new row up from there
+    refreshCutViews(await fetchCutChanges());
 
     showAddCutMessage("success", "Cut added.");
   } catch (err) {
@@ -539,7 +497,9 @@ async function initLeafletMapIfNeeded() {
     [MAP_BOUNDS.maxLat, MAP_BOUNDS.maxLon]
   );
 
-  map = L.map("leaflet-map", { zoomControl: true });
+  // Canvas: one <canvas> for every cut marker rather than an SVG node each
+  map = L.map("leaflet-map", { zoomControl: true, preferCanvas: true });
+  cutRenderer = L.canvas({ padding: 0.5 });
 
   const online = await canReachInternet();
 
@@ -558,7 +518,19 @@ async function initLeafletMapIfNeeded() {
       }).addTo(map);
   }
 
-  cutLayer = L.layerGroup().addTo(map);
+  // cutLayer holds the cut markers when zoomed in, clusterLayer the grid
+  // counts when zoomed out (see loadMapView). Popups are built on click.
+  cutLayer = L.featureGroup().addTo(map);
+  clusterLayer = L.featureGroup().addTo(map);
+  cutLayer.on("click", openCutPopup);
+  clusterLayer.on("click", onClusterClick);
+  // Added to the map by showDensity() when it is wanted
+  densityLayer = L.tileLayer("", {
+    maxZoom: 22,
+    opacity: DENSITY_OPACITY,
+    attribution: "Harvest density"
+  });
+  map.on("moveend", loadMapView);
 
   if (online) {
     map.fitBounds(bounds);
@@ -585,104 +557,384 @@ function fixQualityToAccuracyRadiusMeters(fixQualityRaw) {
   return radius;
 }
 
-function updateMap(cuts) {
-  if (!map || !cutLayer) return;
+function cutPopupHtml(cut) {
+  const [lat, lon] = clampLatLon(cut.latitude, cut.longitude);
+  const etTime = cutTimeDisplay(cut);
+  const dateDisplay = cutDateDisplay(cut);
+  const accuracyRadiusMeters = fixQualityToAccuracyRadiusMeters(cut.fix_quality);
+
+  return `<b>Cut ID: ${cut.id ?? ""}</b><br>` +
+    (dateDisplay ? `Date: ${dateDisplay}<br>` : "") +
+    `${cut.utc_ms != null ? "ET" : "UTC"} Time: ${etTime || ""}<br>` +
+    `Lat: ${lat.toFixed(6)}<br>` +
+    `Lon: ${lon.toFixed(6)}<br>` +
+    `Alt: ${cut.altitude ?? ""}<br>` +
+    `Fix: ${cut.fix_quality ?? ""}<br>` +
+    (accuracyRadiusMeters != null ? `Fix Accuracy: ${accuracyRadiusMeters} m<br>` : "") +
+    `HDOP (Telemetry): ${cut.hdop ?? ""}<br>` +
+    `Sats: ${cut.num_satellites ?? ""}`;
+}
 
-  cutLayer.clearLayers();
+function openCutPopup(evt) {
+  const entry = cutMarkers.get(evt.layer.cutId);
+  if (!entry) return;
+  L.popup()
+    .setLatLng(evt.layer.getLatLng())
+    .setContent(cutPopupHtml(entry.cut))
+    .openOn(map);
+}
 
-  const totalCutsValue = document.getElementById("total-cuts-value");
-  if (totalCutsValue) totalCutsValue.textContent = cuts.length.toString();
-  updateLogsPaginationInfo(cuts.length);
+function makeCutMarker(cut, fix) {
+  const [lat, lon] = clampLatLon(cut.latitude, cut.longitude);
+  let marker;
+  if (fix != null) {
+    // In Fix Type mode, render fix-quality-derived accuracy in meters.
+    marker = L.circle([lat, lon], {
+      renderer: cutRenderer,
+      radius: fix,
+      weight: 1,
+      fillOpacity: 0.3
+    });
+  } else {
+    // Normal mode or unknown/invalid fix: fall back to pixel-based marker.
+    marker = L.circleMarker([lat, lon], {
+      renderer: cutRenderer,
+      radius: DEFAULT_MARKER_RADIUS,
+      weight: 2,
+      fillOpacity: DEFAULT_FILL_OPACITY
+    });
+  }
+  marker.cutId = cut.id;
+  cutLayer.addLayer(marker);
+  return { cut, marker, fix };
+}
+
+function sameCutOnMap(a, b) {
+  return a.latitude === b.latitude && a.longitude === b.longitude &&
+    a.fix_quality === b.fix_quality && a.utc_ms === b.utc_ms &&
+    a.hdop === b.hdop && a.num_satellites === b.num_satellites;
+}
 
-  if (!cuts.length) return;
+/** Density tile URL template for the current date filter. */
+function densityTileUrl() {
+  const params = new URLSearchParams();
+  const startInput = document.getElementById("timestamp-start");
+  const endInput = document.getElementById("timestamp-end");
+  if (startInput && startInput.value) params.set("from", startInput.value);
+  if (endInput && endInput.value) params.set("to", endInput.value);
+  const query = params.toString();
+  return `${apiOrigin}/tiles/density/{z}/{x}/{y}.png${query ? "?" + query : ""}`;
+}
 
+function densityShown() {
+  return mapMode === "density" || map.getZoom() < DENSITY_MAX_ZOOM;
+}
+
+/**
+ * Show or hide the density overlay. While shown it follows the date
+ * filter, and its tiles are reloaded when the cuts changed since they
+ * were loaded; the server answers unchanged tiles with a 304.
+ */
+function showDensity(on) {
+  if (!on) {
+    if (map.hasLayer(densityLayer)) map.removeLayer(densityLayer);
+    return;
+  }
+  const url = densityTileUrl();
+  if (!map.hasLayer(densityLayer)) {
+    densityLayer.setUrl(url, true);
+    densityLayer.addTo(map);
+  } else if (url !== densityUrl) {
+    densityLayer.setUrl(url);
+  } else if (densitySeq !== pointsSeq) {
+    densityLayer.redraw();
+  }
+  densityUrl = url;
+  densitySeq = pointsSeq;
+}
+
+/**
+ * Fetch what the map shows of its (padded) view and draw it: the cuts
+ * when the server sends points, count bubbles when it sends grid cells.
+ * Zoomed out (or in density mode) the density overlay is shown instead
+ * and nothing is fetched. Calls made while a fetch is out are folded
+ * into one more fetch; calls while the map tab is hidden do nothing
+ * (showing it fetches).
+ */
+async function loadMapView() {
+  if (!map || !cutLayer) return;
+  if (document.querySelector(".tab-content.active")?.id !== "map-tab") return;
+
+  showDensity(densityShown());
+  if (densityShown()) {
+    mapViewDirty = true;             // drop the answer of a fetch still out
+    mapPoints = [];
+    updateMap(mapPoints);
+    clusterLayer.clearLayers();
+    return;
+  }
+  if (mapViewLoading) {
+    mapViewDirty = true;
+    return;
+  }
+
+  mapViewLoading = true;
+  try {
+    do {
+      mapViewDirty = false;
+      if (densityShown()) break;     // zoomed out while a fetch was out
+      const b = map.getBounds().pad(MAP_VIEW_PAD);
+      const params = new URLSearchParams({
+        bbox: [b.getWest(), b.getSouth(), b.getEast(), b.getNorth()].map(v => v.toFixed(6)).join(","),
+        zoom: String(map.getZoom())
+      });
+      const startInput = document.getElementById("timestamp-start");
+      const endInput = document.getElementById("timestamp-end");
+      if (startInput && startInput.value) params.set("from", startInput.value);
+      if (endInput && endInput.value) params.set("to", endInput.value);
+
+      const res = await apiFetch(`/api/points?${params}`, { cache: "no-store" });
+      if (!res.ok) throw new Error(`GET /api/points bbox failed: ${res.status}`);
+      const data = await res.json();
+      if (mapViewDirty) continue;    // the view or the data changed meanwhile
+
+      if (Array.isArray(data.cells)) {
+        mapPoints = [];
+        updateMap(mapPoints);
+        showMapCells(data.cells);
+      } else {
+        mapPoints = (data.points || []).map(normalizeCutRow);
+        clusterLayer.clearLayers();
+        updateMap(mapPoints);
+      }
+    } while (mapViewDirty);
+  } catch (err) {
+    console.error(err);
+  } finally {
+    mapViewLoading = false;
+  }
+}
+
+/**
+ * Bring the map markers in line with cuts. Markers are only created for
+ * new or changed cuts (or a mode switch) and removed for cuts no longer
+ * listed, so a refetch of an unchanged view touches nothing.
+ */
+function updateMap(cuts) {
+  if (!map || !cutLayer) return;
+
+  const shown = new Set();
   for (const cut of cuts) {
-    const [lat, lon] = clampLatLon(cut.latitude, cut.longitude);
-    const etTime = utcTimeToET(cut.utc_time);
-    const isoDate = utcDateToISO(cut.utc_date);
-    const dateDisplay = isoDate ? isoDate.slice(5, 7) + "/" + isoDate.slice(8, 10) + "/" + isoDate.slice(0, 4) : "";
-
-    const accuracyRadiusMeters = fixQualityToAccuracyRadiusMeters(cut.fix_quality);
-    const popupHtml =
-      `<b>Cut ID: ${cut.id ?? ""}</b><br>` +
-      (dateDisplay ? `Date: ${dateDisplay}<br>` : "") +
-      `ET Time: ${etTime || ""}<br>` +
-      `Lat: ${lat.toFixed(6)}<br>` +
-      `Lon: ${lon.toFixed(6)}<br>` +
-      `Alt: ${cut.altitude ?? ""}<br>` +
-      `Fix: ${cut.fix_quality ?? ""}<br>` +
-      (accuracyRadiusMeters != null ? `Fix Accuracy: ${accuracyRadiusMeters} m<br>` : "") +
-      `HDOP (Telemetry): ${cut.hdop ?? ""}<br>` +
-      `Sats: ${cut.num_satellites ?? ""}`;
-
-    if (mapMode === "fix" && accuracyRadiusMeters != null) {
-      // In Fix Type mode, render fix-quality-derived accuracy in meters.
-      L.circle([lat, lon], {
-        radius: accuracyRadiusMeters,
-        weight: 1,
-        fillOpacity: 0.3
-      })
-        .bindPopup(popupHtml)
-        .addTo(cutLayer);
-    } else {
-      // Normal mode or unknown/invalid fix: fall back to pixel-based marker.
-      L.circleMarker([lat, lon], {
+    shown.add(cut.id);
+    const fix = mapMode === "fix" ? fixQualityToAccuracyRadiusMeters(cut.fix_quality) : null;
+    const entry = cutMarkers.get(cut.id);
+    if (entry && entry.fix === fix && sameCutOnMap(entry.cut, cut)) {
+      entry.cut = cut;
+      continue;
+    }
+    if (entry) cutLayer.removeLayer(entry.marker);
+    cutMarkers.set(cut.id, makeCutMarker(cut, fix));
+  }
+  for (const [id, entry] of cutMarkers) {
+    if (!shown.has(id)) {
+      cutLayer.removeLayer(entry.marker);
+      cutMarkers.delete(id);
+    }
+  }
+
+}
+
+/** Draw server grid cells (count, mean lat/lon, bounds) as bubbles. */
+function showMapCells(cells) {
+  clusterLayer.clearLayers();
+  for (const cell of cells) {
+    const [minLon, minLat, maxLon, maxLat] = cell.bounds;
+    const bounds = L.latLngBounds([minLat, minLon], [maxLat, maxLon]);
+    let marker;
+    if (cell.count === 1) {
+      marker = L.circleMarker([cell.lat, cell.lon], {
+        renderer: cutRenderer,
         radius: DEFAULT_MARKER_RADIUS,
         weight: 2,
         fillOpacity: DEFAULT_FILL_OPACITY
-      })
-        .bindPopup(popupHtml)
-        .addTo(cutLayer);
+      });
+    } else {
+      const size = Math.round(24 + 6 * Math.log10(cell.count));
+      marker = L.marker([cell.lat, cell.lon], {
+        icon: L.divIcon({
+          className: "cut-cluster",
+          html: `<span>${cell.count}</span>`,
+          iconSize: [size, size]
+        }),
+        keyboard: false
+      });
     }
+    marker.clusterBounds = bounds;
+    clusterLayer.addLayer(marker);
   }
 }
 
+function onClusterClick(evt) {
+  if (evt.layer.clusterBounds) {
+    map.fitBounds(evt.layer.clusterBounds, { padding: [40, 40], maxZoom: LOCAL_MAX_ZOOM });
+  }
+}
+
+// ── Cut log (virtualized) ─────────────────────────────────────────
+
+// The log table shows one page window of /api/points?offset=&limit=,
+// sorted and date-filtered by the server. Only the rows in view (plus
+// LOG_OVERSCAN either side) are in the DOM; spacer rows stand in for the
+// rest, so scrolling through 100k cuts costs the same as through 100.
+const LOG_PAGE_SIZE = 200;
+const LOG_OVERSCAN = 10;
+const LOG_SORT = "-time";
+
+const logView = {
+  total: 0,
+  pages: new Map(),      // page index → normalized rows
+  loading: new Set(),
+  generation: 0,         // bumped on every reload; stale responses are dropped
+  rowHeight: 64,         // measured from the first rendered row
+  from: "",
+  to: "",
+  first: 0,
+  last: 0
+};
+
+// Checked cut ids, kept across re-renders and pages
+const selectedCutIds = new Set();
+
+const LOG_PIN_SVG =
+  '<svg width="16" height="16" viewBox="0 0 24 24" fill="none" stroke="currentColor" stroke-width="2" aria-hidden="true">' +
+  '<path d="M12 21s-8-4.5-8-11a8 8 0 1 1 16 0c0 6.5-8 11-8 11z"/><circle cx="12" cy="10" r="3"/></svg>';
+
+const LOG_CHECK_SVG =
+  '<svg width="20" height="20" viewBox="0 0 24 24" fill="none" stroke="currentColor" stroke-width="2.5" aria-hidden="true">' +
+  '<path d="M20 6L9 17l-5-5"/></svg>';
+
+function logPageQuery() {
+  const params = new URLSearchParams({ sort: LOG_SORT });
+  if (logView.from) params.set("from", logView.from);
+  if (logView.to) params.set("to", logView.to);
+  return params;
+}
+
+/**
+ * Re-read the cut log from the server, keeping the scroll position.
+ * Called whenever the cuts or the date filter change.
+ */
 function renderTable() {
-  const tbody = document.getElementById("cut-log-body");
-  const totalCutsValue = document.getElementById("total-cuts-value");
+  const startInput = document.getElementById("timestamp-start");
+  const endInput = document.getElementById("timestamp-end");
+  logView.from = startInput ? startInput.value : "";
+  logView.to = endInput ? endInput.value : "";
+
+  logView.generation++;
+  logView.loading.clear();
+  // Keep the old rows on screen until their replacements arrive
+  const stale = logView.pages;
+  logView.pages = new Map();
+  renderLogWindow(stale);
+}
 
-  tbody.innerHTML = "";
+async function loadLogPage(page) {
+  if (logView.loading.has(page)) return;
+  logView.loading.add(page);
+  const generation = logView.generation;
 
-  const cuts = getFilteredCuts();
-  const n = cuts.length;
-  if (totalCutsValue) totalCutsValue.textContent = n.toString();
-  updateLogsPaginationInfo(n);
+  try {
+    const params = logPageQuery();
+    params.set("offset", String(page * LOG_PAGE_SIZE));
+    params.set("limit", String(LOG_PAGE_SIZE));
+    const res = await apiFetch(`/api/points?${params}`, { cache: "no-store" });
+    if (!res.ok) throw new Error(`GET /api/points page failed: ${res.status}`);
+    const data = await res.json();
+    if (generation !== logView.generation) return;
+
+    logView.pages.set(page, (data.points || []).map(normalizeCutRow));
+    logView.total = Number(data.total) || 0;
+    renderLogWindow();
+  } catch (err) {
+    console.error(err);
+  } finally {
+    if (generation === logView.generation) logView.loading.delete(page);
+  }
+}
 
-  const pinSvg =
-    '<svg width="16" height="16" viewBox="0 0 24 24" fill="none" stroke="currentColor" stroke-width="2" aria-hidden="true">' +
-    '<path d="M12 21s-8-4.5-8-11a8 8 0 1 1 16 0c0 6.5-8 11-8 11z"/><circle cx="12" cy="10" r="3"/></svg>';
+/**
+ * Draw the rows currently scrolled into view, fetching any page they
+ * need. stalePages (from before a reload) fill in while pages load.
+ */
+function renderLogWindow(stalePages = null) {
+  const tbody = document.getElementById("cut-log-body");
+  const scroller = document.getElementById("cut-log-scroll");
+  if (!tbody || !scroller) return;
+
+  const total = logView.total;
+  const rowHeight = logView.rowHeight;
+  const first = Math.max(0, Math.floor(scroller.scrollTop / rowHeight) - LOG_OVERSCAN);
+  const last = Math.min(total, Math.ceil((scroller.scrollTop + scroller.clientHeight) / rowHeight) + LOG_OVERSCAN);
+  logView.first = first;
+  logView.last = last;
+
+  const wanted = new Set([Math.floor(first / LOG_PAGE_SIZE)]);
+  if (last > 0) wanted.add(Math.floor((last - 1) / LOG_PAGE_SIZE));
+  for (const page of wanted) {
+    if (!logView.pages.has(page)) loadLogPage(page);
+  }
 
-  const checkSvg =
-    '<svg width="20" height="20" viewBox="0 0 24 24" fill="none" stroke="currentColor" stroke-width="2.5" aria-hidden="true">' +
-    '<path d="M20 6L9 17l-5-5"/></svg>';
+  const rowAt = (i) => {
+    const page = Math.floor(i / LOG_PAGE_SIZE);
+    const rows = logView.pages.get(page) || (stalePages && stalePages.get(page));
+    return rows ? rows[i % LOG_PAGE_SIZE] : undefined;
+  };
 
-  for (const cut of cuts) {
-    const tr = document.createElement("tr");
+  let html = `<tr class="log-spacer" style="height:${first * rowHeight}px"></tr>`;
+  for (let i = first; i < last; i++) {
+    const cut = rowAt(i);
+    html += cut ? cutRowHtml(cut) : '<tr class="log-row-loading"><td colspan="8">Loading…</td></tr>';
+  }
+  html += `<tr class="log-spacer" style="height:${(total - last) * rowHeight}px"></tr>`;
+  tbody.innerHTML = html;
 
-    const lat = (typeof cut.latitude === "number" && !Number.isNaN(cut.latitude))
-      ? cut.latitude.toFixed(6)
-      : "";
+  const sample = tbody.querySelector("tr.log-row");
+  if (sample && sample.offsetHeight > 0 && sample.offsetHeight !== rowHeight) {
+    logView.rowHeight = sample.offsetHeight;
+    renderLogWindow(stalePages);
+    return;
+  }
 
-    const lon = (typeof cut.longitude === "number" && !Number.isNaN(cut.longitude))
-      ? cut.longitude.toFixed(6)
-      : "";
+  const totalCutsValue = document.getElementById("total-cuts-value");
+  if (totalCutsValue) totalCutsValue.textContent = total.toString();
+  updateLogsPaginationInfo(first, last, total);
+  updateCutSelectAllState();
+}
 
-    const hdop = (typeof cut.hdop === "number" && !Number.isNaN(cut.hdop))
-      ? cut.hdop.toFixed(2)
-      : (cut.hdop ?? "");
+function cutRowHtml(cut) {
+  const lat = (typeof cut.latitude === "number" && !Number.isNaN(cut.latitude))
+    ? cut.latitude.toFixed(6)
+    : "";
 
-    const etTime = utcTimeToET(cut.utc_time);
-    const isoDate = utcDateToISO(cut.utc_date);
-    const dateDisplay = isoDate ? isoDate.slice(5, 7) + "/" + isoDate.slice(8, 10) + "/" + isoDate.slice(0, 4) : "";
-    const timeLine = etTime || String(cut.utc_time ?? "").split(".")[0] || "";
+  const lon = (typeof cut.longitude === "number" && !Number.isNaN(cut.longitude))
+    ? cut.longitude.toFixed(6)
+    : "";
 
-    const fixLabel = fixQualityToShortLabel(cut.fix_quality);
-    const fixClass = fixQualityPillClass(cut.fix_quality);
+  const hdop = (typeof cut.hdop === "number" && !Number.isNaN(cut.hdop))
+    ? cut.hdop.toFixed(2)
+    : (cut.hdop ?? "");
 
-    const idDisplay = cut.id != null ? `#${cut.id}` : "—";
+  const dateDisplay = cutDateDisplay(cut);
+  const timeLine = cutTimeDisplay(cut);
 
-    tr.innerHTML = `
-      <td><input type="checkbox" class="cut-select-checkbox" value="${cut.id ?? ""}"></td>
+  const fixLabel = fixQualityToShortLabel(cut.fix_quality);
+  const fixClass = fixQualityPillClass(cut.fix_quality);
+
+  const idDisplay = cut.id != null ? `#${cut.id}` : "—";
+  const checked = selectedCutIds.has(cut.id) ? " checked" : "";
+
+  return `<tr class="log-row">
+      <td><input type="checkbox" class="cut-select-checkbox" value="${cut.id ?? ""}"${checked}></td>
       <td class="cell-id">${idDisplay}</td>
       <td>
         <span class="cell-ts-date">${dateDisplay || "—"}</span>
@@ -690,7 +942,7 @@ function renderTable() {
       </td>
       <td>
         <div class="cell-coords">
-          ${pinSvg}
+          ${LOG_PIN_SVG}
           <div class="coord-lines">
             <span>${lat || "—"}</span>
             <span>${lon || "—"}</span>
@@ -700,12 +952,35 @@ function renderTable() {
       <td><span class="${fixClass}">${fixLabel}</span></td>
       <td class="cell-hdop">${hdop}</td>
       <td class="cell-sats">${cut.num_satellites ?? ""}</td>
-      <td class="status-check">${checkSvg}</td>
-    `;
-    tbody.appendChild(tr);
-  }
+      <td class="status-check">${LOG_CHECK_SVG}</td>
+    </tr>`;
+}
 
-  updateSelectAllCheckboxState("cut-select-all-checkbox", ".cut-select-checkbox");
+function updateCutSelectAllState() {
+  const selectAll = document.getElementById("cut-select-all-checkbox");
+  if (!selectAll) return;
+  const n = selectedCutIds.size;
+  selectAll.checked = n > 0 && n >= logView.total;
+  selectAll.indeterminate = n > 0 && n < logView.total;
+}
+
+/** Select (or clear) every cut matching the current date filter. */
+async function selectAllCuts(checked) {
+  selectedCutIds.clear();
+  if (checked && logView.total > 0) {
+    try {
+      const params = logPageQuery();
+      params.set("fields", "id");
+      params.set("limit", String(logView.total));
+      const res = await apiFetch(`/api/points?${params}`, { cache: "no-store" });
+      if (!res.ok) throw new Error(`GET /api/points ids failed: ${res.status}`);
+      const data = await res.json();
+      for (const id of data.points || []) selectedCutIds.add(id);
+    } catch (err) {
+      console.error(err);
+    }
+  }
+  renderLogWindow();
 }
 
 function renderDeletedTable() {
@@ -731,10 +1006,8 @@ function renderDeletedTable() {
       ? cut.longitude.toFixed(6)
       : "";
 
-    const etTime = utcTimeToET(cut.utc_time);
-    const isoDate = utcDateToISO(cut.utc_date);
-    const dateDisplay = isoDate ? isoDate.slice(5, 7) + "/" + isoDate.slice(8, 10) + "/" + isoDate.slice(0, 4) : "";
-    const timeLine = etTime || String(cut.utc_time ?? "").split(".")[0] || "";
+    const dateDisplay = cutDateDisplay(cut);
+    const timeLine = cutTimeDisplay(cut);
     const expiresIn = formatTimeRemainingFromDeletedAt(cut.deleted_at);
     const idDisplay = cut.id != null ? `#${cut.id}` : "—";
 
@@ -786,57 +1059,24 @@ function setAllCheckboxes(itemSelector, checked) {
   });
 }
 
-function escapeCsvValue(value) {
-  const str = value == null ? "" : String(value);
-  if (str.includes(",") || str.includes("\"") || str.includes("\n")) {
-    return `"${str.replace(/"/g, "\"\"")}"`;
-  }
-  return str;
-}
-
-function buildCutsCsv(cuts) {
-  const header = [
-    "id", "utc_date", "utc_time", "latitude", "longitude",
-    "fix_quality", "num_satellites", "hdop", "altitude", "geoid_height",
-  ];
-  const lines = [header.join(",")];
-
-  for (const cut of cuts) {
-    const row = [
-      cut.id ?? "",
-      cut.utc_date ?? "",
-      cut.utc_time ?? "",
-      cut.latitude ?? "",
-      cut.longitude ?? "",
-      cut.fix_quality ?? "",
-      cut.num_satellites ?? "",
-      cut.hdop ?? "",
-      cut.altitude ?? "",
-      cut.geoid_height ?? "",
-    ].map(escapeCsvValue);
-    lines.push(row.join(","));
+/**
+ * Apply a /api/points/delete or /restore response. Its delta holds the
+ * changed rows, so when the model is at the sequence the change started
+ * from it is applied as is; otherwise the model is behind and the
+ * missing changes are fetched with it.
+ */
+async function applyBatchChange(body) {
+  const delta = body.delta;
+  if (!delta) return;
+  if (Number(delta.since) === pointsSeq) {
+    refreshCutViews(applyCutDelta(delta));
+  } else {
+    refreshCutViews(await fetchCutChanges());
   }
-
-  return `${lines.join("\n")}\n`;
-}
-
-function downloadTextFile(filename, content, mimeType = "text/plain;charset=utf-8") {
-  const blob = new Blob([content], { type: mimeType });
-  const url = URL.createObjectURL(blob);
-  const link = document.createElement("a");
-  link.href = url;
-  link.download = filename;
-  document.body.appendChild(link);
-  link.click();
-  link.remove();
-  URL.revokeObjectURL(url);
 }
 
 async function deleteSelectedCuts() {
-  const checkboxes = document.querySelectorAll(".cut-select-checkbox:checked");
-  const ids = Array.from(checkboxes)
-    .map(cb => Number.parseInt(cb.value, 10))
-    .filter(id => !Number.isNaN(id));
+  const ids = Array.from(selectedCutIds);
 
   if (!ids.length) {
     return;
@@ -855,11 +1095,8 @@ async function deleteSelectedCuts() {
       throw new Error(`POST /api/points/delete failed: ${res.status}`);
     }
 
-    await fetchCuts();
-    await fetchDeletedCuts();
-    renderTable();
-    renderDeletedTable();
-    updateMap(getFilteredCuts());
+    for (const id of ids) selectedCutIds.delete(id);
+    await applyBatchChange(await res.json());
   } catch (err) {
     console.error(err);
   }
@@ -888,11 +1125,7 @@ async function recoverSelectedDeletedCuts() {
       throw new Error(`POST /api/points/restore failed: ${res.status}`);
     }
 
-    await fetchCuts();
-    await fetchDeletedCuts();
-    renderTable();
-    renderDeletedTable();
-    updateMap(getFilteredCuts());
+    await applyBatchChange(await res.json());
 
     // After a restore, return to active cuts view.
     setActiveTab("log-tab");
@@ -901,39 +1134,60 @@ async function recoverSelectedDeletedCuts() {
   }
 }
 
-async function downloadCsvExport() {
-  window.location.href = `${apiOrigin}/api/export`;
+function exportFormat() {
+  const select = document.getElementById("export-format");
+  return select && select.value ? select.value : "csv";
 }
 
-function exportSelectedCutsCsv() {
-  const selectedIds = new Set(
-    Array.from(document.querySelectorAll(".cut-select-checkbox:checked"))
-      .map(cb => Number.parseInt(cb.value, 10))
-      .filter(id => !Number.isNaN(id))
-  );
+/**
+ * Download the cuts the log lists (its applied date filter) in the
+ * chosen format. The server streams the file (/api/export), so nothing
+ * is built in the page.
+ */
+function downloadExport() {
+  const params = new URLSearchParams({ format: exportFormat() });
+  if (logView.from) params.set("from", logView.from);
+  if (logView.to) params.set("to", logView.to);
+  window.location.href = `${apiOrigin}/api/export?${params}`;
+}
 
-  if (!selectedIds.size) {
+/**
+ * Download the selected cuts. The ids go in a POST form, as a selection
+ * can be too long for a URL; the attachment response leaves the page
+ * where it is.
+ */
+function exportSelectedCuts() {
+  if (!selectedCutIds.size) {
     return;
   }
 
-  const selectedCuts = cutsData.filter(cut => selectedIds.has(cut.id));
-  if (!selectedCuts.length) {
-    return;
+  const form = document.createElement("form");
+  form.method = "POST";
+  form.action = `${apiOrigin}/api/export`;
+  for (const [name, value] of [["format", exportFormat()], ["ids", Array.from(selectedCutIds).join(",")]]) {
+    const input = document.createElement("input");
+    input.type = "hidden";
+    input.name = name;
+    input.value = value;
+    form.appendChild(input);
   }
-
-  const csv = buildCutsCsv(selectedCuts);
-  const now = new Date();
-  const timestamp = `${now.getFullYear()}${String(now.getMonth() + 1).padStart(2, "0")}${String(now.getDate()).padStart(2, "0")}_${String(now.getHours()).padStart(2, "0")}${String(now.getMinutes()).padStart(2, "0")}${String(now.getSeconds()).padStart(2, "0")}`;
-  downloadTextFile(`gps_export_selected_${timestamp}.csv`, csv, "text/csv;charset=utf-8");
+  document.body.appendChild(form);
+  form.submit();
+  form.remove();
 }
 
 // ── Polling loop ──────────────────────────────────────────────────
 
 let pollTimer = null;
 const POLL_INTERVAL = 5000;   // 5 seconds
-let _lastCutsJSON = "";       // track whether data actually changed
 let _lastDeletedCutsJSON = "";
 
+// /api/events pushes point deltas and status as they happen. While it is
+// open the poll loop makes no requests and only refreshes relative times;
+// if it drops, polling takes over until the browser reconnects it.
+let eventSource = null;
+let eventStreamOpen = false;
+
 function setActiveTab(targetId) {
   const tabButtons = document.querySelectorAll(".tab-button");
   const tabContents = document.querySelectorAll(".tab-content");
@@ -950,51 +1204,83 @@ function setActiveTab(targetId) {
   if (targetId === "log-tab") {
     renderTable();
   } else if (targetId === "map-tab") {
-    updateMap(getFilteredCuts());
     setTimeout(() => {
       if (map) map.invalidateSize();
+      loadMapView();
     }, 50);
   } else if (targetId === "deleted-tab") {
     renderDeletedTable();
   }
 }
 
-async function pollLoop() {
-  try {
-    await fetchCuts();
-    await fetchDeletedCuts();
-
-    // Only re-render if the data actually changed — avoids
-    // stomping on filter inputs mid-edit and applying filters
-    // before the user clicks the Filter button.
-    const newJSON = JSON.stringify(cutsData);
-    if (newJSON !== _lastCutsJSON) {
-      _lastCutsJSON = newJSON;
-      renderTable();
+function refreshCutViews(changed) {
+  // Only re-render if the data actually changed — avoids
+  // stomping on filter inputs mid-edit and applying filters
+  // before the user clicks the Filter button.
+  if (changed) {
+    renderTable();
+    loadMapView();
+  }
 
-      if (document.querySelector(".tab-content.active")?.id === "map-tab") {
-        updateMap(getFilteredCuts());
-      }
+  const deletedJSON = JSON.stringify(getRetainedDeletedCuts());
+  if (deletedJSON !== _lastDeletedCutsJSON) {
+    _lastDeletedCutsJSON = deletedJSON;
+    if (document.querySelector(".tab-content.active")?.id === "deleted-tab") {
+      renderDeletedTable();
     }
+  }
+}
 
-    const deletedJSON = JSON.stringify(getRetainedDeletedCuts());
-    if (deletedJSON !== _lastDeletedCutsJSON) {
-      _lastDeletedCutsJSON = deletedJSON;
-      if (document.querySelector(".tab-content.active")?.id === "deleted-tab") {
-        renderDeletedTable();
-      }
+async function pollLoop() {
+  if (eventStreamOpen) {
+    // Nothing to fetch; just age the trash list and "Last sync" text.
+    refreshCutViews(false);
+    if (lastStatus) renderStatus(lastStatus);
+  } else {
+    try {
+      refreshCutViews(await fetchCutChanges());
+    } catch (err) {
+      console.error("Polling failed:", err);
     }
-  } catch (err) {
-    console.error("Polling failed:", err);
-  }
 
-  // Also poll status
-  await fetchStatus();
+    // Also poll status
+    await fetchStatus();
+  }
 
   // Schedule next poll
   pollTimer = setTimeout(pollLoop, POLL_INTERVAL);
 }
 
+function openEventStream() {
+  if (typeof EventSource === "undefined") return;
+
+  // The browser resends the last event id on reconnect, so the server
+  // resumes the deltas from there.
+  eventSource = new EventSource(`${apiOrigin}/api/events?since=${pointsSeq}`);
+
+  eventSource.onopen = () => {
+    eventStreamOpen = true;
+  };
+  eventSource.onerror = () => {
+    eventStreamOpen = false;
+  };
+
+  eventSource.addEventListener("points", e => {
+    try {
+      refreshCutViews(applyCutDelta(JSON.parse(e.data)));
+    } catch (err) {
+      console.error("Bad points event:", err);
+    }
+  });
+  eventSource.addEventListener("status", e => {
+    try {
+      renderStatus(JSON.parse(e.data));
+    } catch (err) {
+      console.error("Bad status event:", err);
+    }
+  });
+}
+
 // ── Init ──────────────────────────────────────────────────────────
 
 async function initDashboard() {
@@ -1005,9 +1291,7 @@ async function initDashboard() {
   if (statusText) statusText.textContent = "Connecting...";
 
   try {
-    await fetchCuts();
-    await fetchDeletedCuts();
-    _lastCutsJSON = JSON.stringify(cutsData);
+    await fetchCutChanges();
     _lastDeletedCutsJSON = JSON.stringify(getRetainedDeletedCuts());
   } catch (err) {
     console.error(err);
@@ -1032,9 +1316,7 @@ async function initDashboard() {
   if (filterButton) {
     filterButton.addEventListener("click", () => {
       renderTable();
-      if (document.querySelector(".tab-content.active")?.id === "map-tab") {
-        updateMap(getFilteredCuts());
-      }
+      loadMapView();
     });
   }
 
@@ -1057,8 +1339,7 @@ async function initDashboard() {
   const cutSelectAll = document.getElementById("cut-select-all-checkbox");
   if (cutSelectAll) {
     cutSelectAll.addEventListener("change", () => {
-      setAllCheckboxes(".cut-select-checkbox", cutSelectAll.checked);
-      updateSelectAllCheckboxState("cut-select-all-checkbox", ".cut-select-checkbox");
+      selectAllCuts(cutSelectAll.checked);
     });
   }
 
@@ -1073,12 +1354,28 @@ async function initDashboard() {
   const cutLogBody = document.getElementById("cut-log-body");
   if (cutLogBody) {
     cutLogBody.addEventListener("change", (evt) => {
-      if (evt.target instanceof HTMLElement && evt.target.matches(".cut-select-checkbox")) {
-        updateSelectAllCheckboxState("cut-select-all-checkbox", ".cut-select-checkbox");
+      if (evt.target instanceof HTMLInputElement && evt.target.matches(".cut-select-checkbox")) {
+        const id = Number.parseInt(evt.target.value, 10);
+        if (Number.isNaN(id)) return;
+        if (evt.target.checked) selectedCutIds.add(id);
+        else selectedCutIds.delete(id);
+        updateCutSelectAllState();
       }
     });
   }
 
+  const cutLogScroll = document.getElementById("cut-log-scroll");
+  if (cutLogScroll) {
+    let scrollFrame = 0;
+    cutLogScroll.addEventListener("scroll", () => {
+      if (scrollFrame) return;
+      scrollFrame = requestAnimationFrame(() => {
+        scrollFrame = 0;
+        renderLogWindow();
+      });
+    }, { passive: true });
+  }
+
   const deletedLogBody = document.getElementById("deleted-cut-log-body");
   if (deletedLogBody) {
     deletedLogBody.addEventListener("change", (evt) => {
@@ -1100,7 +1397,7 @@ async function initDashboard() {
   if (exportCsvButton) {
     exportCsvButton.addEventListener("click", (evt) => {
       evt.preventDefault();
-      downloadCsvExport();
+      downloadExport();
     });
   }
 
@@ -1108,26 +1405,27 @@ async function initDashboard() {
   if (exportSelectedCsvButton) {
     exportSelectedCsvButton.addEventListener("click", (evt) => {
       evt.preventDefault();
-      exportSelectedCutsCsv();
+      exportSelectedCuts();
     });
   }
 
   const mapModeNormalBtn = document.getElementById("map-mode-normal");
   const mapModeFixBtn = document.getElementById("map-mode-fix");
-  const mapModeButtons = [mapModeNormalBtn, mapModeFixBtn].filter(Boolean);
+  const mapModeDensityBtn = document.getElementById("map-mode-density");
+  const mapModeButtons = [mapModeNormalBtn, mapModeFixBtn, mapModeDensityBtn].filter(Boolean);
 
   function setMapMode(newMode) {
+    const oldMode = mapMode;
     mapMode = newMode;
     mapModeButtons.forEach(btn => {
       if (!btn) return;
-      const isActive =
-        (newMode === "normal" && btn.id === "map-mode-normal") ||
-        (newMode === "fix" && btn.id === "map-mode-fix");
-      btn.classList.toggle("map-mode-active", isActive);
+      btn.classList.toggle("map-mode-active", btn.id === `map-mode-${newMode}`);
     });
 
-    if (document.querySelector(".tab-content.active")?.id === "map-tab") {
-      updateMap(getFilteredCuts());
+    if (newMode === "density" || oldMode === "density") {
+      loadMapView();
+    } else {
+      updateMap(mapPoints);
     }
   }
 
@@ -1145,6 +1443,13 @@ async function initDashboard() {
     });
   }
 
+  if (mapModeDensityBtn) {
+    mapModeDensityBtn.addEventListener("click", (evt) => {
+      evt.preventDefault();
+      setMapMode("density");
+    });
+  }
+
   try {
     await initLeafletMapIfNeeded();
   } catch (err) {
@@ -1153,7 +1458,8 @@ async function initDashboard() {
   renderTable();
   renderDeletedTable();
 
-  // Start the polling loop for live data + status updates
+  // Live updates over /api/events, with the polling loop as fallback
+  openEventStream();
   pollTimer = setTimeout(pollLoop, POLL_INTERVAL);
 }
 
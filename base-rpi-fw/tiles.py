@@ -0,0 +1,166 @@
+"""
+tiles.py
+
+Offline map tiles for the dashboard, read from the MBTiles file written by
+download_tiles.py and served by /tiles/<z>/<x>/<y>.png in app.py.
+
+    - the file is opened read-only and immutable (SQLite takes no locks and
+      never checks for changes) with mmap, so a tile read is one index
+      lookup and a copy out of the page cache
+    - connections stay open in a small pool, like database.py's readers,
+      since Flask serves every request on a fresh thread
+    - recently served tiles, and tiles the file does not have, are kept in
+      an LRU of config.TILE_CACHE_BYTES
+    - each tile carries a strong ETag (a hash of its bytes), so a browser
+      whose cached copy has expired revalidates with a 304
+
+The file's identity (inode, size, mtime) is checked at most every
+config.TILE_RECHECK_S; when it changes the pool and the cache are dropped
+and the new file is opened. SQLite is told the file is immutable, so it
+should be replaced (download to another name and rename it over) rather
+than written in place while the hub serves it.
+"""
+
+import collections
+import hashlib
+import logging
+import os
+import sqlite3
+import threading
+import time
+import urllib.parse
+
+import config
+
+log = logging.getLogger("tiles")
+
+Tile = collections.namedtuple("Tile", "data etag mimetype")
+
+_TILE_SQL = ("SELECT tile_data FROM tiles "
+             "WHERE zoom_level=? AND tile_column=? AND tile_row=?")
+
+# Cache accounting for a cached key and its Tile, beyond the tile bytes
+_ENTRY_OVERHEAD = 200
+
+# ── Shared state (thread-safe via _lock) ───────────────────────────
+
+_lock = threading.Lock()
+_cache = collections.OrderedDict()     # (z, x, y) → Tile, or None if absent
+_cache_bytes = 0
+_pool = []
+_file_id = None
+_checked_at = None
+
+
+def _stat_id(path):
+    try:
+        st = os.stat(path)
+    except OSError:
+        return None
+    return (st.st_ino, st.st_size, st.st_mtime_ns)
+
+
+def _check_file():
+    """Drop the pool and cache if the file changed. Call with _lock held."""
+    global _file_id, _checked_at, _cache_bytes
+
+    now = time.monotonic()
+    if _checked_at is not None and now - _checked_at < config.TILE_RECHECK_S:
+        return
+    _checked_at = now
+
+    file_id = _stat_id(config.MBTILES_PATH)
+    if file_id == _file_id:
+        return
+    if file_id is None:
+        log.warning("MBTiles file %s not found", config.MBTILES_PATH)
+    else:
+        log.info("Serving tiles from %s (%.1f MB)",
+                 config.MBTILES_PATH, file_id[1] / (1024 * 1024))
+
+    _file_id = file_id
+    for conn in _pool:
+        conn.close()
+    del _pool[:]
+    _cache.clear()
+    _cache_bytes = 0
+
+
+def _open_connection():
+    uri = "file:%s?mode=ro&immutable=1" % urllib.parse.quote(
+        os.path.abspath(config.MBTILES_PATH))
+    # check_same_thread=False: pooled connections move between request
+    # threads, but only one thread uses a connection at a time.
+    conn = sqlite3.connect(uri, uri=True, check_same_thread=False)
+    conn.execute("PRAGMA mmap_size=%d" % config.TILE_MMAP_BYTES)
+    return conn
+
+
+def _mimetype(data):
+    if data[:4] == b"\x89PNG":
+        return "image/png"
+    if data[:3] == b"\xff\xd8\xff":
+        return "image/jpeg"
+    if data[:4] == b"RIFF" and data[8:12] == b"WEBP":
+        return "image/webp"
+    return "application/octet-stream"
+
+
+def _remember(key, tile):
+    """Add a lookup result to the LRU. Call with _lock held."""
+    global _cache_bytes
+
+    size = _ENTRY_OVERHEAD + (len(tile.data) if tile else 0)
+    if size > config.TILE_CACHE_BYTES:
+        return
+    _cache[key] = tile
+    _cache_bytes += size
+    while _cache_bytes > config.TILE_CACHE_BYTES:
+        _, old = _cache.popitem(last=False)
+        _cache_bytes -= _ENTRY_OVERHEAD + (len(old.data) if old else 0)
+
+
+def get_tile(z, x, y):
+    """
+    Tile z/x/y (XYZ numbering, as Leaflet requests it) or None if the file
+    has no such tile or cannot be read.
+    """
+    key = (z, x, y)
+    with _lock:
+        _check_file()
+        if key in _cache:
+            _cache.move_to_end(key)
+            return _cache[key]
+        file_id = _file_id
+        conn = _pool.pop() if _pool else None
+
+    if file_id is None:
+        return None
+
+    try:
+        if conn is None:
+            conn = _open_connection()
+        # MBTiles rows use the TMS y axis (flipped from XYZ)
+        row = conn.execute(_TILE_SQL, (z, x, (1 << z) - 1 - y)).fetchone()
+    except sqlite3.Error as e:
+        log.warning("Tile %d/%d/%d: %s", z, x, y, e)
+        if conn is not None:
+            conn.close()
+        return None
+
+    tile = None
+    if row and row[0]:
+        data = bytes(row[0])
+        tile = Tile(data,
+                    hashlib.blake2b(data, digest_size=12).hexdigest(),
+                    _mimetype(data))
+
+    with _lock:
+        if file_id == _file_id:
+            _remember(key, tile)
+            if len(_pool) < config.TILE_POOL:
+                _pool.append(conn)
+                conn = None
+    if conn is not None:
+        conn.close()
+    return tile
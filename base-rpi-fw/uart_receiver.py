@@ -10,17 +10,41 @@ Protocol (matches uartFileTransfer.c exactly):
     START byte is NOT included in checksum.
 
     Transfer flow:
-        ESP32 → START (payload: fileSize as uint32 LE)
+        ESP32 → START (payload: fileSize as uint32 LE [+ encoding u8
+                       [+ shears address 6 bytes + segment seq u32 LE
+                       [+ storage epoch u32 LE]]])
         Pi    → ACK
         ESP32 → DATA  (payload: 1-255 bytes of file content)
         Pi    → ACK
         ... repeat DATA / ACK ...
         ESP32 → END   (no payload)
         Pi    → ACK
-        Pi verifies file, parses CSV, stores in DB
+        Pi verifies size and stream, commits the rows
         Pi    → COMMIT (payload: 0x00 = success, else failure)
         ESP32 clears its SPIFFS file on COMMIT(0x00)
 
+    Each DATA payload is decoded (if encoded), parsed line by line and
+    staged in the database as it arrives, in batches of
+    config.INGEST_BATCH_ROWS. END moves the staged rows into gps_points in
+    one transaction; any failure drops them, so a transfer is still stored
+    entirely or not at all.
+
+    Rows are tagged with the shears address and inserted with ON CONFLICT
+    DO NOTHING, so a file resent after a lost COMMIT adds nothing. When
+    START names a segment already committed for the device and storage
+    epoch (database.segment_stored) it is not parsed at all: its DATA is
+    ACKed and dropped and END gets COMMIT(0x00) straight away. Segments
+    may arrive out of order. The epoch changes when the shears' filesystem
+    is recreated, which restarts its sequence numbers; a base that does
+    not send one is treated as epoch 0.
+
+    Between transfers the ESP32 also sends METRICS frames (its own snapshot
+    and the shears' one). They are not ACKed; the latest per source is kept
+    for /api/status.
+
+    Committed rows and status changes are announced through events.publish()
+    so the dashboard's /api/events stream pushes them without polling.
+
     Timing:
         ESP32 waits 500ms for each ACK, retries up to 5 times.
         ESP32 waits 2000ms for COMMIT after END is ACKed.
@@ -40,6 +64,9 @@ import csv
 
 import config
 import database
+import events
+import log_codec
+import metrics
 
 log = logging.getLogger("uart_rx")
 
@@ -49,6 +76,8 @@ _transfer_active = False
 _last_transfer_ok = None
 _last_transfer_time = None
 _total_transfers = 0
+_last_compression = None
+_metrics = {}           # source name → decoded snapshot + "received_time"
 _lock = threading.Lock()
 
 
@@ -60,6 +89,8 @@ def get_status():
             "last_transfer_ok": _last_transfer_ok,
             "last_transfer_time": _last_transfer_time,
             "total_transfers": _total_transfers,
+            "last_compression": _last_compression,
+            "metrics": dict(_metrics),
         }
 
 
@@ -158,9 +189,9 @@ def _read_packet(ser):
 
 # ── CSV parsing ────────────────────────────────────────────────────
 
-def _parse_and_store_csv(raw_bytes):
+def _parse_row(row):
     """
-    Parse the received file as CSV and insert rows into the database.
+    Turn one CSV row into a record dict, or None if it is not a data row.
 
     CSV format from shears (gps_points.csv):
         utc_date,utc_time,latitude,longitude,fix_quality,num_satellites,hdop,altitude,geoid_height
@@ -168,67 +199,250 @@ def _parse_and_store_csv(raw_bytes):
         ...
 
     The first row may be a header — detected by checking if the first
-    field parses as a number. If not, it's a header and we skip it.
-
-    Returns the number of rows successfully inserted.
+    field starts with a letter. If so, it's a header and we skip it.
+    Rows with fewer than 9 columns get defaults for the missing fields.
     """
+    if len(row) < 3:
+        return None
+
+    # Header detection:
+    if row[0][:1].isalpha():
+        log.debug("Skipping header row: %s", row)
+        return None
+
     try:
-        text = raw_bytes.decode("utf-8", errors="replace")
-    except Exception as e:
-        log.error("Failed to decode CSV bytes: %s", e)
-        return 0
-
-    reader = csv.reader(io.StringIO(text))
-    records = []
-
-    for row in reader:
-        # Need at least 9 columns for the full GPS record
-        if len(row) < 9:
-            # Could be a partial/malformed line, try with fewer fields
-            if len(row) < 3:
-                continue
-
-        # Header detection: 
-        if row[0][0].isalpha():
-            log.debug("Skipping header row: %s", row)
-            continue
-        
+        return {
+            "utc_date":       row[0],
+            "utc_time":       row[1],
+            "latitude":       float(row[2]),
+            "longitude":      float(row[3]) if len(row) > 3 else 0.0,
+            "fix_quality":    int(row[4])   if len(row) > 4 else 0,
+            "num_satellites": int(row[5])   if len(row) > 5 else 0,
+            "hdop":           float(row[6]) if len(row) > 6 else 0.0,
+            "altitude":       float(row[7]) if len(row) > 7 else 0.0,
+            "geoid_height":   float(row[8]) if len(row) > 8 else 0.0,
+        }
+    except (ValueError, IndexError) as e:
+        log.warning("Skipping malformed row %s: %s", row, e)
+        return None
+
+
+# ── Streaming ingest ───────────────────────────────────────────────
+
+def _parse_start(payload):
+    """
+    Split a START payload into (file_size, encoding, device_id, epoch, seq).
+
+    device_id is the shears address as "AA:BB:CC:DD:EE:FF", or "" if the
+    base did not send one or does not know it. seq is None unless the
+    device is known; epoch is 0 if the base did not send one.
+    """
+    file_size = struct.unpack("<I", payload[:4])[0]
+    encoding = payload[4] if len(payload) >= 5 else config.ENC_RAW
+    device_id, epoch, seq = "", 0, None
+    if len(payload) >= 15:
+        addr = payload[5:11]
+        if any(addr):
+            device_id = ":".join("%02X" % b for b in reversed(addr))
+            seq = struct.unpack("<I", payload[11:15])[0]
+            if len(payload) >= 19:
+                epoch = struct.unpack("<I", payload[15:19])[0]
+    return file_size, encoding, device_id, epoch, seq
+
+
+class _Ingest:
+    """
+    One transfer, processed while its DATA frames arrive.
+
+    Each DATA payload is decoded (if the START said so), appended to the
+    raw backup file, split into complete lines and parsed; the rows are
+    staged by a database.PointWriter in bounded batches. Only the partial
+    last line and the decoder's window are held in memory.
+
+    finish() runs on END: it checks the size, commits the rows and keeps
+    the backup. abort() rolls everything back. A transfer that fails part
+    way (corrupt stream) keeps counting bytes so END can still be ACKed,
+    and fails at finish().
+
+    A segment already committed for this device is only counted, never
+    decoded or stored.
+    """
+
+    def __init__(self, expected_size, encoding, device_id="", epoch=0, seq=None):
+        self.expected_size = expected_size
+        self.encoding = encoding
+        self.device_id = device_id
+        self.epoch = epoch
+        self.seq = seq
+        self.received = 0
+        self.rows = 0
+        self.inserted = 0
+        self.error = None
+
+        self._decoder = None
+        self._decode_s = 0.0
+        self._writer = None
+        self._backup = None
+
+        self.duplicate = (seq is not None and
+                          database.segment_stored(device_id, epoch, seq))
+        if self.duplicate:
+            return
+
+        if encoding == config.ENC_DELTA_LZ:
+            self._decoder = log_codec.Decoder()
+        elif encoding != config.ENC_RAW:
+            self.error = "Unknown encoding 0x%02X" % encoding
+
+        self._line = bytearray()        # bytes after the last '\n'
+        self._writer = database.PointWriter(device_id, seq, epoch)
+        self._backup_path, self._backup = _open_raw_file()
+
+    def feed(self, data):
+        self.received += len(data)
+        if self.error is not None or self.duplicate:
+            return
+
+        if self._decoder is not None:
+            t0 = time.perf_counter()
+            try:
+                data = self._decoder.feed(data)
+            except log_codec.CodecError as e:
+                self.error = "Decode failed: %s" % e
+                return
+            finally:
+                self._decode_s += time.perf_counter() - t0
+
+        if self._backup is not None:
+            self._backup.write(data)
+
+        self._line += data
+        cut = self._line.rfind(b"\n")
+        if cut >= 0:
+            self._store_lines(self._line[:cut + 1])
+            del self._line[:cut + 1]
+
+    def _store_lines(self, raw):
+        text = bytes(raw).decode("utf-8", errors="replace")
+        for row in csv.reader(io.StringIO(text)):
+            record = _parse_row(row)
+            if record is not None:
+                self._writer.add(record)
+
+    def compression(self):
+        """Stats for /api/status, or None for a raw transfer."""
+        if self._decoder is None:
+            return None
+        dec = self._decoder
+        return {
+            "encoding": self.encoding,
+            "encoded_bytes": dec.encoded_bytes,
+            "decoded_bytes": dec.decoded_bytes,
+            "ratio": (round(dec.decoded_bytes / dec.encoded_bytes, 2)
+                      if dec.encoded_bytes else None),
+            "decode_ms": round(self._decode_s * 1000.0, 2),
+        }
+
+    def finish(self):
+        """
+        Commit the transfer. Returns True if it should be COMMIT(0x00)ed;
+        rows and inserted then hold the rows parsed and the new ones.
+        """
+        if self.error is None and self.received != self.expected_size:
+            self.error = "Size mismatch: got %d, expected %d" % (
+                self.received, self.expected_size)
+
+        if self.duplicate:
+            if self.error is not None:
+                log.error("  TRANSFER FAILED: %s", self.error)
+                return False
+            log.info("  Segment %d (epoch %08x) from %s already stored, skipped",
+                     self.seq, self.epoch, self.device_id)
+            return True
+
+        if self.error is None and self._decoder is not None:
+            try:
+                self._decoder.finish()
+            except log_codec.CodecError as e:
+                self.error = "Decode failed: %s" % e
+
+        # The backup is kept whenever the whole file arrived and decoded,
+        # even if none of it parses.
+        self._close_backup(keep=self.error is None)
+
+        if self.error is None and self._line:
+            # Last line without a trailing newline
+            self._store_lines(self._line)
+            self._line = bytearray()
+
+        if self.error is None:
+            self._writer.flush()
+            if self._writer.count == 0:
+                self.error = "0 valid CSV rows"
+
+        if self.error is not None:
+            log.error("  TRANSFER FAILED: %s", self.error)
+            self._writer.rollback()
+            return False
+
+        self.rows = self._writer.commit()
+        self.inserted = self._writer.inserted
+        log.info("CSV parsed: %d rows, %d new, inserted into database",
+                 self.rows, self.inserted)
+        return True
+
+    def abort(self):
+        """Roll back any rows written and drop the backup."""
+        if self._writer is not None:
+            self._writer.rollback()
+        self._close_backup(keep=False)
+
+    def _close_backup(self, keep):
+        if self._backup is None:
+            return
+        size = self._backup.tell()
+        self._backup.close()
+        self._backup = None
+        final = self._backup_path[:-len(".part")]
         try:
-            record = {
-                "utc_date":       row[0],
-                "utc_time":       row[1],
-                "latitude":       float(row[2]) if len(row) > 2 else 0.0,
-                "longitude":      float(row[3]) if len(row) > 3 else 0.0,
-                "fix_quality":    int(row[4])   if len(row) > 4 else 0,
-                "num_satellites": int(row[5])   if len(row) > 5 else 0,
-                "hdop":           float(row[6]) if len(row) > 6 else 0.0,
-                "altitude":       float(row[7]) if len(row) > 7 else 0.0,
-                "geoid_height":   float(row[8]) if len(row) > 8 else 0.0,
-            }
-            records.append(record)
-        except (ValueError, IndexError) as e:
-            log.warning("Skipping malformed row %s: %s", row, e)
-
-    if records:
-        inserted = database.insert_points_batch(records)
-        log.info("CSV parsed: %d rows inserted into database", inserted)
-        return inserted
-    else:
-        log.warning("No valid data rows found in CSV")
-        return 0
-
-
-def _save_raw_file(raw_bytes):
-    """Save a timestamped backup of the raw received file."""
+            if keep and size > 0:
+                os.replace(self._backup_path, final)
+                log.info("Raw backup saved: %s (%d bytes)", final, size)
+            else:
+                os.remove(self._backup_path)
+        except OSError as e:
+            log.error("Failed to finish raw backup: %s", e)
+
+
+def _open_raw_file():
+    """
+    Open a timestamped backup file for the decoded CSV. It is written as
+    <name>.part and renamed when the transfer commits.
+    Returns (path, file), or (path, None) if it could not be created.
+    """
     os.makedirs(config.RECEIVED_FILES_DIR, exist_ok=True)
     ts = time.strftime("%Y%m%d_%H%M%S")
-    filepath = os.path.join(config.RECEIVED_FILES_DIR, f"gps_points_{ts}.csv")
+    filepath = os.path.join(config.RECEIVED_FILES_DIR, f"gps_points_{ts}.csv.part")
     try:
-        with open(filepath, "wb") as f:
-            f.write(raw_bytes)
-        log.info("Raw backup saved: %s (%d bytes)", filepath, len(raw_bytes))
-    except Exception as e:
-        log.error("Failed to save raw file: %s", e)
+        return filepath, open(filepath, "wb")
+    except OSError as e:
+        log.error("Failed to open raw backup: %s", e)
+        return filepath, None
+
+
+def _store_metrics(payload):
+    """Decode a METRICS frame and keep it as the latest for its source."""
+    try:
+        snapshot = metrics.decode(payload)
+    except metrics.MetricsError as e:
+        log.warning("Bad METRICS frame: %s", e)
+        return
+
+    snapshot["received_time"] = time.time()
+    with _lock:
+        _metrics[snapshot["source"]] = snapshot
+    events.publish("status")
+    log.debug("Metrics from %s: %s", snapshot["source"], snapshot["counters"])
 
 
 # ── Main receiver loop (runs in daemon thread) ─────────────────────
@@ -243,8 +457,10 @@ def _receiver_loop(port, baud):
         RECEIVING → recv END → send ACK → verify → send COMMIT → IDLE
     """
     global _transfer_active, _last_transfer_ok, _last_transfer_time, _total_transfers
+    global _last_compression
 
     log.info("UART receiver starting on %s @ %d baud", port, baud)
+    ingest = None
 
     while True:
         try:
@@ -270,20 +486,23 @@ def _receiver_loop(port, baud):
                         log.warning("START missing fileSize payload, ignoring")
                         continue
 
-                    expected_size = struct.unpack("<I", payload[:4])[0]
+                    (expected_size, encoding,
+                     device_id, epoch, seq) = _parse_start(payload)
                     log.info("══════════════════════════════════════")
-                    log.info("  TRANSFER START  (expecting %d bytes)", expected_size)
+                    log.info("  TRANSFER START  (expecting %d bytes, encoding 0x%02X, "
+                             "device %s, epoch %08x, seq %s)",
+                             expected_size, encoding, device_id or "?", epoch, seq)
                     log.info("══════════════════════════════════════")
 
                     with _lock:
                         _transfer_active = True
+                    events.publish("status")
 
                     # ACK the START immediately
                     _send_ack(ser)
 
-                    # ── Inner loop: receive DATA until END ────────
-                    file_buffer = bytearray()
-                    transfer_ok = False
+                    # ── Inner loop: ingest DATA until END ─────────
+                    ingest = _Ingest(expected_size, encoding, device_id, epoch, seq)
 
                     while True:
                         pkt_type2, payload2 = _read_packet(ser)
@@ -293,44 +512,45 @@ def _receiver_loop(port, baud):
                             continue
 
                         if pkt_type2 == config.TYPE_DATA:
-                            file_buffer.extend(payload2)
-                            log.debug("  DATA +%d bytes  (%d / %d)",
-                                      len(payload2), len(file_buffer), expected_size)
-                            # ACK immediately — ESP32 blocks until it gets this
+                            # ACK first — ESP32 blocks until it gets this,
+                            # and the next frame queues in the UART while
+                            # this one is parsed.
                             _send_ack(ser)
+                            ingest.feed(payload2)
+                            log.debug("  DATA +%d bytes  (%d / %d)",
+                                      len(payload2), ingest.received, expected_size)
 
                         elif pkt_type2 == config.TYPE_END:
                             log.info("  END received  (%d / %d bytes)",
-                                     len(file_buffer), expected_size)
+                                     ingest.received, expected_size)
                             # ACK the END immediately
                             _send_ack(ser)
 
-                            # Now we have up to 2 seconds to verify and COMMIT.
-                            # Verify size
-                            if len(file_buffer) != expected_size:
-                                log.error("  SIZE MISMATCH: got %d, expected %d",
-                                          len(file_buffer), expected_size)
-                                _send_commit(ser, config.COMMIT_FAIL)
-                                transfer_ok = False
+                            # Now we have up to 2 seconds to COMMIT. The
+                            # rows are already staged, so
+                            # this is the tail of the file plus one commit.
+                            transfer_ok = ingest.finish()
+                            compression = ingest.compression()
+                            rows, new_rows = ingest.rows, ingest.inserted
+                            ingest = None
+
+                            if compression is not None:
+                                log.info("  Decoded %d → %d bytes (ratio %.2fx) in %.1f ms",
+                                         compression["encoded_bytes"],
+                                         compression["decoded_bytes"],
+                                         compression["ratio"] or 0.0,
+                                         compression["decode_ms"])
+                                with _lock:
+                                    _last_compression = compression
+
+                            if transfer_ok:
+                                _send_commit(ser, config.COMMIT_OK)
+                                log.info("══════════════════════════════════════")
+                                log.info("  TRANSFER COMPLETE  (%d GPS points, %d new)",
+                                         rows, new_rows)
+                                log.info("══════════════════════════════════════")
                             else:
-                                log.info("  Size verified OK (%d bytes)", expected_size)
-
-                                # Save raw backup
-                                _save_raw_file(file_buffer)
-
-                                # Parse CSV and store
-                                rows = _parse_and_store_csv(file_buffer)
-
-                                if rows > 0:
-                                    _send_commit(ser, config.COMMIT_OK)
-                                    transfer_ok = True
-                                    log.info("══════════════════════════════════════")
-                                    log.info("  TRANSFER COMPLETE  (%d GPS points)", rows)
-                                    log.info("══════════════════════════════════════")
-                                else:
-                                    _send_commit(ser, config.COMMIT_FAIL)
-                                    transfer_ok = False
-                                    log.warning("  TRANSFER FAILED (0 valid CSV rows)")
+                                _send_commit(ser, config.COMMIT_FAIL)
 
                             # Update shared state
                             with _lock:
@@ -338,36 +558,56 @@ def _receiver_loop(port, baud):
                                 _last_transfer_ok = transfer_ok
                                 _last_transfer_time = time.time()
                                 _total_transfers += 1
+                            if new_rows:
+                                events.publish("points")
+                            events.publish("status")
 
                             break   # back to outer loop, wait for next START
 
+                        elif pkt_type2 == config.TYPE_METRICS:
+                            _store_metrics(payload2)
+
                         elif pkt_type2 == config.TYPE_START:
                             # ESP32 restarted transfer mid-stream.
                             # Could happen if it timed out and retried from scratch.
                             log.warning("  Got new START during transfer — restarting")
                             if len(payload2) >= 4:
-                                expected_size = struct.unpack("<I", payload2[:4])[0]
-                            file_buffer = bytearray()
+                                (expected_size, encoding,
+                                 device_id, epoch, seq) = _parse_start(payload2)
+                            ingest.abort()
+                            ingest = _Ingest(expected_size, encoding, device_id, epoch, seq)
                             _send_ack(ser)
 
                         else:
                             log.warning("  Unexpected packet type 0x%02X during transfer",
                                         pkt_type2)
 
+                # ── METRICS: diagnostics snapshot, no ACK ─────────
+                elif pkt_type == config.TYPE_METRICS:
+                    _store_metrics(payload)
+
                 # ── Anything else while IDLE ──────────────────────
                 else:
                     log.debug("Ignoring packet type 0x%02X (idle)", pkt_type)
 
         except serial.SerialException as e:
             log.error("Serial error: %s — retrying in 3s", e)
+            if ingest is not None:
+                ingest.abort()
+                ingest = None
             with _lock:
                 _transfer_active = False
+            events.publish("status")
             time.sleep(3)
 
         except Exception as e:
             log.error("Unexpected error: %s — retrying in 3s", e)
+            if ingest is not None:
+                ingest.abort()
+                ingest = None
             with _lock:
                 _transfer_active = False
+            events.publish("status")
             time.sleep(3)
 
 
@@ -0,0 +1,75 @@
+/*
+ * log_codec.h
+ *
+ * Compressed transfer encoding for GPS log files (LOG_XFER_ENC_DELTA_LZ).
+ *
+ * The encoder runs on the shears before a file is streamed over BLE. The
+ * base forwards the encoded bytes untouched over UART, and the Pi decodes
+ * them in uart_receiver.py (see log_codec.py for the matching decoder).
+ *
+ * Encoded file layout:
+ *   [0..3]   magic: 0xA5 'W' 'Z' LOG_CODEC_VERSION
+ *   [4..7]   uint32_t rawSize   (original file bytes, little-endian)
+ *   [8..11]  uint32_t deltaSize (record-stage bytes, little-endian)
+ *   [12.. ]  LZSS stream that expands to deltaSize record-stage bytes
+ *
+ * Record stage (one record per input line):
+ *   0x00 LITERAL  varint len, then the exact line bytes (incl. '\n' if any)
+ *   0x01 DELTA    line has the same field count as the previous line;
+ *                 ceil(n/4) op bytes (2 bits per field, LSB first), then
+ *                 one payload per field:
+ *                   op 0  same text as the previous field
+ *                   op 1  zigzag varint delta against the previous numeric
+ *                         field, printed with the previous field's scale
+ *                         and integer width
+ *                   op 2  varint len, then the field bytes
+ *                 A DELTA record always ends with '\n'.
+ *
+ * Every complete line ('\n'-terminated, at most LOG_CODEC_MAX_FIELDS fields
+ * of at most LOG_CODEC_MAX_FIELD_LEN bytes) becomes the "previous line" for
+ * the next record, regardless of how it was encoded.
+ *
+ * LZSS stage: a flag byte precedes up to 8 items (bit i set = match).
+ * A literal is one byte; a match is two bytes holding a 10-bit offset
+ * (1..1024, stored minus one) and a 6-bit length (3..66, stored minus three):
+ *   b0 = (offset - 1) & 0xFF
+ *   b1 = (((offset - 1) >> 8) << 6) | (length - 3)
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_CODEC_VERSION        0x01
+#define LOG_CODEC_HEADER_SIZE    12
+
+#define LOG_CODEC_MAX_FIELDS     16
+#define LOG_CODEC_MAX_FIELD_LEN  31
+
+typedef struct {
+	uint32_t rawBytes;      /* Bytes read from the source file */
+	uint32_t deltaBytes;    /* Bytes after the record (delta) stage */
+	uint32_t encodedBytes;  /* Bytes written, including the header */
+} log_codec_stats_t;
+
+/*
+ * Encodes srcPath into dstPath (truncated first).
+ * Returns false on any filesystem or allocation error; dstPath may then be
+ * left partially written and should be removed by the caller.
+ */
+bool log_codec_compress_file(const char *srcPath,
+			     const char *dstPath,
+			     log_codec_stats_t *stats);
+
+/* Returns true when the buffer starts with the encoded-file magic. */
+bool log_codec_is_encoded(const uint8_t *head, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
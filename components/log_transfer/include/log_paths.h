@@ -3,8 +3,9 @@
  *
  * Shared log file naming conventions used by both the base and the shears.
  *
- * The shears writes CSV logs under /spiffs/, and the base mirrors that layout
- * so incoming data can be written directly to the same path.
+ * The shears writes CSV logs under /spiffs/ as numbered segments, and the
+ * base mirrors that layout so incoming data can be written directly to the
+ * same path. See log_segments.h for how segments are named and rotated.
  *
  * Only the basename is sent over BLE during a START_TRANSFER request.
  * It must remain short enough to fit within a single control write.
@@ -12,8 +13,38 @@
 
 #pragma once
 
-/* Full filesystem path used when opening the log file locally. */
-#define GPS_LOG_FILE_PATH      "/spiffs/gps_points.csv"
+/* Directory holding all log files on both devices. */
+#define GPS_LOG_DIR                "/spiffs"
+
+/* Segment basenames: GPS_LOG_SEGMENT_PREFIX + 6 digits + GPS_LOG_SEGMENT_EXT. */
+#define GPS_LOG_SEGMENT_PREFIX     "gps_"
+#define GPS_LOG_SEGMENT_EXT        ".csv"
+#define GPS_LOG_SEGMENT_DIGITS     6
+
+/* Longest segment basename plus NUL ("gps_000123.csv"). */
+#define GPS_LOG_SEGMENT_NAME_MAX   16
+
+/* The head segment is sealed once it grows past this many bytes. */
+#define GPS_LOG_SEGMENT_MAX_BYTES  8192
+
+/*
+ * While the base is connected the shears seals the head early, once it
+ * holds this many bytes (about 25 rows) or cuts pause. Smaller segments
+ * reach the Pi sooner but compress worse.
+ */
+#define GPS_LOG_SEGMENT_SEAL_BYTES 2048
 
-/* Basename sent over BLE during log transfer requests. */
+/*
+ * Storage epoch: a random non-zero number the shears picks when this file
+ * is missing, i.e. on a freshly created filesystem, where segment numbers
+ * start again at 1. The base keeps the epoch of the segments it mirrors
+ * in the same file on its own filesystem. See log_epoch_load().
+ */
+#define GPS_LOG_EPOCH_PATH     "/spiffs/log_epoch"
+
+/*
+ * Single-file log used before segmentation. The shears migrates any rows
+ * left in it into a sealed segment at boot.
+ */
+#define GPS_LOG_FILE_PATH      "/spiffs/gps_points.csv"
 #define GPS_LOG_FILE_BASENAME  "gps_points.csv"
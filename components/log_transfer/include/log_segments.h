@@ -0,0 +1,63 @@
+/*
+ * log_segments.h
+ *
+ * Naming and directory helpers for segmented GPS logs.
+ *
+ * The shears never append to a file that may be in flight. Cuts go to the
+ * head segment (the one with the highest sequence number); once a segment
+ * is sealed it is immutable and can be transferred and deleted on its own:
+ *
+ *   /spiffs/gps_000041.csv   sealed
+ *   /spiffs/gps_000042.csv   sealed
+ *   /spiffs/gps_000043.csv   head (still being appended)
+ *
+ * The base mirrors sealed segments under the same basename until they have
+ * been committed to the Pi. Sequence numbers start at 1 and only grow; 0 is
+ * used as "nothing seen yet" in list requests.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returns true and stores the sequence if name is exactly "gps_NNNNNN.csv". */
+bool log_segment_parse_name(const char *name, uint32_t *seq);
+
+/* Formats the segment basename / full path. Returns false if out is too small. */
+bool log_segment_format_name(char *out, size_t outLen, uint32_t seq);
+bool log_segment_format_path(char *out, size_t outLen, uint32_t seq);
+
+/*
+ * Scans GPS_LOG_DIR for segments with a sequence number greater than
+ * afterSeq.
+ *
+ * Up to maxSeqs of the oldest matches are written to seqs in ascending
+ * order. newestSeq (optional) receives the largest match, or 0 if none.
+ * Returns the total number of matches, which may exceed maxSeqs, or -1 if
+ * the directory could not be opened.
+ */
+int log_segment_list(uint32_t afterSeq,
+		     uint32_t *seqs,
+		     int maxSeqs,
+		     uint32_t *newestSeq);
+
+/*
+ * Reads / writes the storage epoch kept in GPS_LOG_EPOCH_PATH.
+ *
+ * Segment numbers only identify a segment within one epoch: the shears
+ * starts a new epoch (and numbers from 1 again) whenever its filesystem
+ * is created, so (shears, epoch, seq) is what the Pi deduplicates on.
+ * log_epoch_load() returns false if the file is missing or unreadable.
+ */
+bool log_epoch_load(uint32_t *epoch);
+bool log_epoch_store(uint32_t epoch);
+
+#ifdef __cplusplus
+}
+#endif
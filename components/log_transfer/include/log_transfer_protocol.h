@@ -24,9 +24,12 @@ typedef enum {
 	 * Control write payload:
 	 *   [0]     CTRL_CMD_START_TRANSFER
 	 *   [1..N]  Null-terminated ASCII filename (usually a basename)
+	 *   [N+1]   Optional requested encoding (log_xfer_encoding_t)
 	 *
 	 * The shears side resolves the provided name into a filesystem path
-	 * before opening the file.
+	 * before opening the file. Without the encoding byte the file is sent
+	 * as LOG_XFER_ENC_RAW. The encoding actually used is echoed back in
+	 * STATUS_OK and is remembered for transfers the shears start on its own.
 	 */
 	CTRL_CMD_START_TRANSFER = 0x01,
 
@@ -37,14 +40,96 @@ typedef enum {
 	 */
 	CTRL_CMD_ABORT          = 0x02,
 
+	/*
+	 * Asks for the sealed log segments the base has not fetched yet.
+	 *
+	 * Control write payload:
+	 *   [0]     CTRL_CMD_LIST_SEGMENTS
+	 *   [1..4]  uint32_t afterSeq (little-endian, optional, default 0)
+	 *
+	 * The shears seals its head segment first if it holds any rows, then
+	 * answers with CTRL_EVT_SEGMENT_LIST. Each listed segment is fetched with
+	 * START_TRANSFER using its basename and stays on the shears until the
+	 * base confirms it with ACK_SEGMENT.
+	 */
+	CTRL_CMD_LIST_SEGMENTS  = 0x03,
+
+	/*
+	 * Confirms that a segment arrived complete and is stored on the base.
+	 *
+	 * Control write payload:
+	 *   [0]     CTRL_CMD_ACK_SEGMENT
+	 *   [1..4]  uint32_t sequence number (little-endian)
+	 *
+	 * The shears deletes the segment. A segment that is never acknowledged
+	 * (short or gapped transfer, lost write) is listed again and may be
+	 * fetched twice; the Pi ignores the duplicate rows.
+	 */
+	CTRL_CMD_ACK_SEGMENT    = 0x04,
+
+	/*
+	 * Asks the shears for its hot-path trace (see trace.h).
+	 *
+	 * Answered with CTRL_EVT_TRACE notifications once no transfer is
+	 * running. A shears built without CONFIG_WM_TRACE sends only the end
+	 * marker.
+	 */
+	CTRL_CMD_TRACE_DUMP     = 0x05,
+
 	/* Control events sent back from the shears. */
-	CTRL_EVT_STATUS         = 0x80
+	CTRL_EVT_STATUS         = 0x80,
+
+	/*
+	 * Sealed segment listing, sent in reply to LIST_SEGMENTS and unsolicited
+	 * after a cut is saved while connected.
+	 *
+	 * Layout:
+	 *   [0]     CTRL_EVT_SEGMENT_LIST
+	 *   [1]     count of sequence numbers that follow
+	 *   [2]     1 if more sealed segments exist past the last one listed
+	 *   [3..6]  uint32_t storage epoch of the numbers (little-endian), see
+	 *           GPS_LOG_EPOCH_PATH
+	 *   [7.. ]  count x uint32_t sequence number (little-endian, ascending)
+	 */
+	CTRL_EVT_SEGMENT_LIST   = 0x81,
+
+	/*
+	 * One piece of a trace dump, in order.
+	 *
+	 * Layout:
+	 *   [0]     CTRL_EVT_TRACE
+	 *   [1.. ]  next bytes of the trace_serialize() stream
+	 *
+	 * An event with no bytes after the opcode ends the dump.
+	 */
+	CTRL_EVT_TRACE          = 0x82
 } ctrl_opcode_t;
 
+/* Most sequence numbers carried by one SEGMENT_LIST event. */
+#define LOG_XFER_SEGMENT_LIST_MAX  16
+
+/* SEGMENT_LIST bytes before the first sequence number. */
+#define LOG_XFER_SEGMENT_LIST_HDR  7
+
+/* --- Transfer encodings -------------------------------------------------- */
+
+typedef enum {
+	LOG_XFER_ENC_RAW        = 0x00,   /* File bytes as stored */
+	LOG_XFER_ENC_DELTA_LZ   = 0x01    /* Delta records + LZSS, see log_codec.h */
+} log_xfer_encoding_t;
+
 /* --- Status / event codes (shears → base) -------------------------------- */
 
+/*
+ * STATUS notification layout:
+ *   [0]     CTRL_EVT_STATUS
+ *   [1]     ctrl_status_code_t
+ *   [2..5]  uint32_t size of the bytes that follow on the data characteristic
+ *           (STATUS_OK only, little-endian)
+ *   [6]     log_xfer_encoding_t of those bytes (STATUS_OK only)
+ */
 typedef enum {
-	STATUS_OK               = 0x00,   /* Request accepted; size follows */
+	STATUS_OK               = 0x00,   /* Request accepted; size + encoding follow */
 	STATUS_ERR_NO_FILE      = 0x01,   /* Requested filename not found */
 	STATUS_ERR_FS           = 0x02,   /* Filesystem error */
 	STATUS_ERR_BUSY         = 0x03,   /* Transfer already in progress */
@@ -60,12 +145,23 @@ typedef enum {
  *
  * Layout:
  *   [0..1]  uint16_t chunkIndex (little-endian)
- *   [2.. ]  raw file bytes
+ *   [2.. ]  file bytes, in the encoding announced by STATUS_OK
  *
  * chunkIndex starts at 0 and increments by 1 per notification.
- * This is used to detect missing or out-of-order packets.
+ * This is used to detect missing or out-of-order packets; the base discards
+ * a transfer with a gap, or whose byte count differs from STATUS_OK, and
+ * requests the segment again.
  */
 typedef struct __attribute__((packed)) {
 	uint16_t chunkIndex;
 	uint8_t  data[];
 } log_xfer_chunk_t;
+
+/* --- Diagnostics characteristic (base reads from shears) ----------------- */
+
+/*
+ * The log service also exposes a read-only diagnostics characteristic
+ * (UUID 0xFFF3). Reading it returns the shears' current metrics snapshot
+ * in the layout documented in metrics.h. Snapshots can be longer than
+ * MTU - 1, so the base uses a long read.
+ */
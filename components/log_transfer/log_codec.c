@@ -0,0 +1,530 @@
+/*
+ * log_codec.c
+ *
+ * Encoder for the LOG_XFER_ENC_DELTA_LZ transfer encoding.
+ *
+ * The source file is read line by line. Each line is delta-encoded against
+ * the previous one (record stage) and the resulting bytes are squeezed by
+ * a small LZSS coder that works on independent 1 KiB blocks, so memory use
+ * stays fixed regardless of file size. See log_codec.h for the format.
+ */
+
+#include "log_codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LINE_BUF        256
+#define READ_BUF        256
+
+#define LZ_BLOCK_SIZE   1024
+#define LZ_MIN_MATCH    3
+#define LZ_MAX_MATCH    66
+#define LZ_MAX_OFFSET   1024
+#define LZ_HASH_SIZE    256
+#define LZ_MAX_CHAIN    32
+
+#define REC_BUF_SIZE    (1 + 4 + LOG_CODEC_MAX_FIELDS * (2 + LOG_CODEC_MAX_FIELD_LEN) + 8)
+
+enum {
+	REC_LITERAL = 0x00,
+	REC_DELTA   = 0x01
+};
+
+enum {
+	FIELD_SAME    = 0,
+	FIELD_NUMERIC = 1,
+	FIELD_LITERAL = 2
+};
+
+typedef struct {
+	char    text[LOG_CODEC_MAX_FIELD_LEN + 1];
+	uint8_t len;
+} codec_field_t;
+
+typedef struct {
+	FILE          *out;
+	bool           ioError;
+
+	/* LZSS block currently being filled. */
+	uint8_t        block[LZ_BLOCK_SIZE];
+	uint16_t       blockLen;
+	int16_t        head[LZ_HASH_SIZE];
+	int16_t        prev[LZ_BLOCK_SIZE];
+
+	/* Pending flag group: flag byte + up to 8 items of 2 bytes. */
+	uint8_t        group[1 + 16];
+	uint8_t        groupLen;
+	uint8_t        groupItems;
+
+	/* Record stage. */
+	codec_field_t  prevFields[LOG_CODEC_MAX_FIELDS];
+	int            prevCount;
+	codec_field_t  curFields[LOG_CODEC_MAX_FIELDS];
+	uint8_t        rec[REC_BUF_SIZE];
+
+	uint32_t       deltaBytes;
+	uint32_t       encodedBytes;
+} codec_state_t;
+
+/* --- Output helpers ------------------------------------------------------- */
+
+static void write_out(codec_state_t *st, const uint8_t *data, size_t len)
+{
+	if (st->ioError || len == 0) {
+		return;
+	}
+
+	if (fwrite(data, 1, len, st->out) != len) {
+		st->ioError = true;
+		return;
+	}
+
+	st->encodedBytes += (uint32_t)len;
+}
+
+static void put_le32(uint8_t *dst, uint32_t v)
+{
+	dst[0] = (uint8_t)(v & 0xFF);
+	dst[1] = (uint8_t)((v >> 8) & 0xFF);
+	dst[2] = (uint8_t)((v >> 16) & 0xFF);
+	dst[3] = (uint8_t)((v >> 24) & 0xFF);
+}
+
+static size_t put_varint(uint8_t *dst, uint64_t v)
+{
+	size_t n = 0;
+
+	while (v >= 0x80) {
+		dst[n++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	dst[n++] = (uint8_t)v;
+
+	return n;
+}
+
+/* --- LZSS stage ----------------------------------------------------------- */
+
+static void lz_flush_group(codec_state_t *st)
+{
+	if (st->groupItems == 0) {
+		return;
+	}
+
+	write_out(st, st->group, 1 + st->groupLen);
+
+	st->group[0]   = 0;
+	st->groupLen   = 0;
+	st->groupItems = 0;
+}
+
+static void lz_emit_literal(codec_state_t *st, uint8_t b)
+{
+	st->group[1 + st->groupLen++] = b;
+
+	if (++st->groupItems == 8) {
+		lz_flush_group(st);
+	}
+}
+
+static void lz_emit_match(codec_state_t *st, uint16_t offset, uint16_t length)
+{
+	uint16_t off = offset - 1;
+
+	st->group[0] |= (uint8_t)(1u << st->groupItems);
+	st->group[1 + st->groupLen++] = (uint8_t)(off & 0xFF);
+	st->group[1 + st->groupLen++] = (uint8_t)(((off >> 8) << 6) |
+						  (length - LZ_MIN_MATCH));
+
+	if (++st->groupItems == 8) {
+		lz_flush_group(st);
+	}
+}
+
+static inline uint8_t lz_hash(const uint8_t *p)
+{
+	return (uint8_t)((p[0] << 5) ^ (p[1] << 2) ^ p[2] ^ (p[0] >> 3));
+}
+
+static void lz_insert(codec_state_t *st, uint16_t pos)
+{
+	if (pos + LZ_MIN_MATCH > st->blockLen) {
+		return;
+	}
+
+	uint8_t h = lz_hash(&st->block[pos]);
+	st->prev[pos] = st->head[h];
+	st->head[h]   = (int16_t)pos;
+}
+
+/* Compresses the current block; matches never reach outside of it. */
+static void lz_flush_block(codec_state_t *st)
+{
+	uint16_t n = st->blockLen;
+	uint16_t pos = 0;
+
+	for (int i = 0; i < LZ_HASH_SIZE; i++) {
+		st->head[i] = -1;
+	}
+
+	while (pos < n) {
+		uint16_t bestLen = 0;
+		uint16_t bestOff = 0;
+
+		if (pos + LZ_MIN_MATCH <= n) {
+			uint16_t maxLen = n - pos;
+			if (maxLen > LZ_MAX_MATCH) {
+				maxLen = LZ_MAX_MATCH;
+			}
+
+			int16_t cand = st->head[lz_hash(&st->block[pos])];
+			int chain = 0;
+
+			while (cand >= 0 && chain < LZ_MAX_CHAIN) {
+				uint16_t off = pos - (uint16_t)cand;
+				if (off > LZ_MAX_OFFSET) {
+					break;
+				}
+
+				uint16_t l = 0;
+				while (l < maxLen && st->block[cand + l] == st->block[pos + l]) {
+					l++;
+				}
+
+				if (l > bestLen) {
+					bestLen = l;
+					bestOff = off;
+					if (l == maxLen) {
+						break;
+					}
+				}
+
+				cand = st->prev[cand];
+				chain++;
+			}
+		}
+
+		if (bestLen >= LZ_MIN_MATCH) {
+			lz_emit_match(st, bestOff, bestLen);
+			for (uint16_t i = 0; i < bestLen; i++) {
+				lz_insert(st, pos + i);
+			}
+			pos += bestLen;
+		} else {
+			lz_emit_literal(st, st->block[pos]);
+			lz_insert(st, pos);
+			pos++;
+		}
+	}
+
+	st->blockLen = 0;
+}
+
+static void lz_put(codec_state_t *st, const uint8_t *data, size_t len)
+{
+	st->deltaBytes += (uint32_t)len;
+
+	while (len > 0) {
+		size_t room = LZ_BLOCK_SIZE - st->blockLen;
+		size_t n = (len < room) ? len : room;
+
+		memcpy(&st->block[st->blockLen], data, n);
+		st->blockLen += (uint16_t)n;
+		data += n;
+		len -= n;
+
+		if (st->blockLen == LZ_BLOCK_SIZE) {
+			lz_flush_block(st);
+		}
+	}
+}
+
+/* --- Record stage --------------------------------------------------------- */
+
+/* Splits a line (without '\n') on commas. Returns -1 if it does not fit. */
+static int split_fields(const char *line, size_t len, codec_field_t *out)
+{
+	int count = 0;
+	size_t start = 0;
+
+	for (size_t i = 0; i <= len; i++) {
+		if (i < len && line[i] != ',') {
+			continue;
+		}
+
+		size_t flen = i - start;
+		if (count >= LOG_CODEC_MAX_FIELDS || flen > LOG_CODEC_MAX_FIELD_LEN) {
+			return -1;
+		}
+
+		memcpy(out[count].text, &line[start], flen);
+		out[count].text[flen] = '\0';
+		out[count].len = (uint8_t)flen;
+		count++;
+
+		start = i + 1;
+	}
+
+	return count;
+}
+
+static bool parse_numeric(const codec_field_t *f,
+			  int64_t *value,
+			  uint8_t *scale,
+			  uint8_t *width)
+{
+	const char *s = f->text;
+	size_t i = 0;
+	bool neg = false;
+	uint64_t v = 0;
+	int digits = 0;
+	uint8_t intDigits = 0;
+	uint8_t fracDigits = 0;
+
+	if (i < f->len && s[i] == '-') {
+		neg = true;
+		i++;
+	}
+
+	while (i < f->len && s[i] >= '0' && s[i] <= '9') {
+		v = v * 10 + (uint64_t)(s[i] - '0');
+		intDigits++;
+		digits++;
+		i++;
+	}
+
+	if (intDigits == 0) {
+		return false;
+	}
+
+	if (i < f->len && s[i] == '.') {
+		i++;
+		while (i < f->len && s[i] >= '0' && s[i] <= '9') {
+			v = v * 10 + (uint64_t)(s[i] - '0');
+			fracDigits++;
+			digits++;
+			i++;
+		}
+		if (fracDigits == 0) {
+			return false;
+		}
+	}
+
+	if (i != f->len || digits > 18) {
+		return false;
+	}
+
+	*value = neg ? -(int64_t)v : (int64_t)v;
+	*scale = fracDigits;
+	*width = intDigits;
+	return true;
+}
+
+static int format_numeric(int64_t value, uint8_t scale, uint8_t width,
+			  char *out, size_t outLen)
+{
+	bool neg = value < 0;
+	uint64_t a = neg ? (uint64_t)(-(value + 1)) + 1 : (uint64_t)value;
+	uint64_t p = 1;
+
+	for (uint8_t i = 0; i < scale; i++) {
+		p *= 10;
+	}
+
+	unsigned long long ip = (unsigned long long)(a / p);
+	unsigned long long fp = (unsigned long long)(a % p);
+
+	if (scale > 0) {
+		return snprintf(out, outLen, "%s%0*llu.%0*llu",
+				neg ? "-" : "", width, ip, scale, fp);
+	}
+
+	return snprintf(out, outLen, "%s%0*llu", neg ? "-" : "", width, ip);
+}
+
+static uint8_t choose_field_op(const codec_field_t *prev,
+			       const codec_field_t *cur,
+			       int64_t *delta)
+{
+	if (prev->len == cur->len && memcmp(prev->text, cur->text, cur->len) == 0) {
+		return FIELD_SAME;
+	}
+
+	int64_t pv, cv;
+	uint8_t ps, pw, cs, cw;
+
+	if (parse_numeric(prev, &pv, &ps, &pw) &&
+	    parse_numeric(cur, &cv, &cs, &cw) &&
+	    ps == cs) {
+		char check[LOG_CODEC_MAX_FIELD_LEN + 8];
+		int n = format_numeric(cv, ps, pw, check, sizeof(check));
+
+		if (n == cur->len && memcmp(check, cur->text, cur->len) == 0) {
+			*delta = cv - pv;
+			return FIELD_NUMERIC;
+		}
+	}
+
+	return FIELD_LITERAL;
+}
+
+static void encode_literal(codec_state_t *st, const char *line, size_t len)
+{
+	size_t n = 0;
+
+	st->rec[n++] = REC_LITERAL;
+	n += put_varint(&st->rec[n], len);
+
+	lz_put(st, st->rec, n);
+	lz_put(st, (const uint8_t *)line, len);
+}
+
+static void encode_delta(codec_state_t *st, int count)
+{
+	size_t opBytes = ((size_t)count + 3) / 4;
+	size_t n = 0;
+
+	st->rec[n++] = REC_DELTA;
+	memset(&st->rec[n], 0, opBytes);
+	size_t opsAt = n;
+	n += opBytes;
+
+	for (int i = 0; i < count; i++) {
+		const codec_field_t *cur = &st->curFields[i];
+		int64_t delta = 0;
+		uint8_t op = choose_field_op(&st->prevFields[i], cur, &delta);
+
+		st->rec[opsAt + (size_t)i / 4] |= (uint8_t)(op << ((i % 4) * 2));
+
+		if (op == FIELD_NUMERIC) {
+			uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+			n += put_varint(&st->rec[n], zz);
+		} else if (op == FIELD_LITERAL) {
+			st->rec[n++] = cur->len;
+			memcpy(&st->rec[n], cur->text, cur->len);
+			n += cur->len;
+		}
+	}
+
+	lz_put(st, st->rec, n);
+}
+
+static void encode_line(codec_state_t *st, const char *line, size_t len)
+{
+	bool complete = (len > 0 && line[len - 1] == '\n');
+	int count = complete ? split_fields(line, len - 1, st->curFields) : -1;
+
+	if (complete && count > 0 && count == st->prevCount) {
+		encode_delta(st, count);
+	} else {
+		encode_literal(st, line, len);
+	}
+
+	if (complete) {
+		if (count > 0) {
+			memcpy(st->prevFields, st->curFields,
+			       (size_t)count * sizeof(codec_field_t));
+			st->prevCount = count;
+		} else {
+			st->prevCount = 0;
+		}
+	}
+}
+
+/* --- Public API ----------------------------------------------------------- */
+
+bool log_codec_is_encoded(const uint8_t *head, size_t len)
+{
+	return len >= 4 &&
+	       head[0] == 0xA5 &&
+	       head[1] == 'W' &&
+	       head[2] == 'Z' &&
+	       head[3] == LOG_CODEC_VERSION;
+}
+
+bool log_codec_compress_file(const char *srcPath,
+			     const char *dstPath,
+			     log_codec_stats_t *stats)
+{
+	FILE *in = fopen(srcPath, "rb");
+	if (!in) {
+		return false;
+	}
+
+	FILE *out = fopen(dstPath, "wb");
+	if (!out) {
+		fclose(in);
+		return false;
+	}
+
+	codec_state_t *st = calloc(1, sizeof(*st));
+	if (!st) {
+		fclose(in);
+		fclose(out);
+		return false;
+	}
+
+	st->out = out;
+
+	/* Placeholder header; sizes are patched in once the stream is done. */
+	uint8_t header[LOG_CODEC_HEADER_SIZE] = { 0xA5, 'W', 'Z', LOG_CODEC_VERSION };
+	write_out(st, header, sizeof(header));
+
+	char line[LINE_BUF];
+	size_t lineLen = 0;
+	uint8_t rbuf[READ_BUF];
+	uint32_t rawBytes = 0;
+	size_t got;
+
+	while ((got = fread(rbuf, 1, sizeof(rbuf), in)) > 0) {
+		rawBytes += (uint32_t)got;
+
+		for (size_t i = 0; i < got; i++) {
+			line[lineLen++] = (char)rbuf[i];
+
+			if (rbuf[i] == '\n' || lineLen == sizeof(line)) {
+				encode_line(st, line, lineLen);
+				lineLen = 0;
+			}
+		}
+	}
+
+	bool ok = !ferror(in);
+	fclose(in);
+
+	if (lineLen > 0) {
+		encode_line(st, line, lineLen);
+	}
+
+	if (st->blockLen > 0) {
+		lz_flush_block(st);
+	}
+	lz_flush_group(st);
+
+	put_le32(&header[4], rawBytes);
+	put_le32(&header[8], st->deltaBytes);
+
+	if (!st->ioError) {
+		if (fseek(out, 0, SEEK_SET) != 0 ||
+		    fwrite(header, 1, sizeof(header), out) != sizeof(header)) {
+			st->ioError = true;
+		}
+	}
+
+	ok = ok && !st->ioError;
+
+	if (fclose(out) != 0) {
+		ok = false;
+	}
+
+	if (stats) {
+		stats->rawBytes     = rawBytes;
+		stats->deltaBytes   = st->deltaBytes;
+		stats->encodedBytes = st->encodedBytes;
+	}
+
+	free(st);
+	return ok;
+}
@@ -0,0 +1,135 @@
+/*
+ * log_segments.c
+ *
+ * Segment naming and directory scanning shared by the shears and the base.
+ * See log_segments.h for the layout.
+ */
+
+#include "log_segments.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "log_paths.h"
+
+bool log_segment_parse_name(const char *name, uint32_t *seq)
+{
+	const size_t prefixLen = sizeof(GPS_LOG_SEGMENT_PREFIX) - 1;
+	const size_t extLen    = sizeof(GPS_LOG_SEGMENT_EXT) - 1;
+
+	if (!name || strlen(name) != prefixLen + GPS_LOG_SEGMENT_DIGITS + extLen) {
+		return false;
+	}
+
+	if (strncmp(name, GPS_LOG_SEGMENT_PREFIX, prefixLen) != 0 ||
+	    strcmp(name + prefixLen + GPS_LOG_SEGMENT_DIGITS, GPS_LOG_SEGMENT_EXT) != 0) {
+		return false;
+	}
+
+	uint32_t value = 0;
+	for (size_t i = 0; i < GPS_LOG_SEGMENT_DIGITS; i++) {
+		char c = name[prefixLen + i];
+		if (c < '0' || c > '9') {
+			return false;
+		}
+		value = value * 10 + (uint32_t)(c - '0');
+	}
+
+	if (seq) {
+		*seq = value;
+	}
+	return true;
+}
+
+bool log_segment_format_name(char *out, size_t outLen, uint32_t seq)
+{
+	int n = snprintf(out, outLen, GPS_LOG_SEGMENT_PREFIX "%06lu" GPS_LOG_SEGMENT_EXT,
+			 (unsigned long)seq);
+	return n > 0 && (size_t)n < outLen;
+}
+
+bool log_segment_format_path(char *out, size_t outLen, uint32_t seq)
+{
+	int n = snprintf(out, outLen, GPS_LOG_DIR "/" GPS_LOG_SEGMENT_PREFIX "%06lu" GPS_LOG_SEGMENT_EXT,
+			 (unsigned long)seq);
+	return n > 0 && (size_t)n < outLen;
+}
+
+int log_segment_list(uint32_t afterSeq,
+		     uint32_t *seqs,
+		     int maxSeqs,
+		     uint32_t *newestSeq)
+{
+	if (newestSeq) {
+		*newestSeq = 0;
+	}
+
+	DIR *dir = opendir(GPS_LOG_DIR);
+	if (!dir) {
+		return -1;
+	}
+
+	int total = 0;
+	int stored = 0;
+	struct dirent *ent;
+
+	while ((ent = readdir(dir)) != NULL) {
+		uint32_t seq;
+		if (!log_segment_parse_name(ent->d_name, &seq) || seq <= afterSeq) {
+			continue;
+		}
+
+		total++;
+		if (newestSeq && seq > *newestSeq) {
+			*newestSeq = seq;
+		}
+
+		if (!seqs || maxSeqs <= 0) {
+			continue;
+		}
+
+		/* Keep the maxSeqs smallest, sorted ascending (directory order is arbitrary). */
+		if (stored == maxSeqs && seq >= seqs[stored - 1]) {
+			continue;
+		}
+
+		int i = (stored < maxSeqs) ? stored++ : stored - 1;
+		while (i > 0 && seqs[i - 1] > seq) {
+			seqs[i] = seqs[i - 1];
+			i--;
+		}
+		seqs[i] = seq;
+	}
+
+	closedir(dir);
+	return total;
+}
+
+bool log_epoch_load(uint32_t *epoch)
+{
+	FILE *f = fopen(GPS_LOG_EPOCH_PATH, "r");
+	if (!f) {
+		return false;
+	}
+
+	unsigned long value = 0;
+	bool ok = fscanf(f, "%lx", &value) == 1;
+	fclose(f);
+
+	if (ok && epoch) {
+		*epoch = (uint32_t)value;
+	}
+	return ok;
+}
+
+bool log_epoch_store(uint32_t epoch)
+{
+	FILE *f = fopen(GPS_LOG_EPOCH_PATH, "w");
+	if (!f) {
+		return false;
+	}
+
+	bool ok = fprintf(f, "%08lx\n", (unsigned long)epoch) > 0;
+	return (fclose(f) == 0) && ok;
+}
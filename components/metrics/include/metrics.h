@@ -0,0 +1,105 @@
+/*
+ * metrics.h
+ *
+ * Counters and latency histograms shared by the shears and the base.
+ *
+ * Every metric lives in a fixed slot of a static registry, so recording is
+ * a single atomic add (plus a compare-and-swap for a histogram's maximum)
+ * and is safe from any task. A device only ever touches its own metrics;
+ * the snapshot carries the ones that are non-zero.
+ *
+ * Snapshot layout (little-endian), at most METRICS_SNAPSHOT_MAX bytes:
+ *
+ *   [0]      METRICS_SNAPSHOT_VERSION
+ *   [1]      metrics_source_t
+ *   [2..5]   uint32_t uptime in ms
+ *   [6]      N, number of counters that follow
+ *            N x { uint8_t metric_id_t, uint32_t value }
+ *   [.]      M, number of histograms that follow
+ *            M x { uint8_t metric_hist_id_t, uint32_t count, uint32_t sum_ms,
+ *                  uint32_t max_ms, uint8_t B, B x uint16_t bucket count }
+ *
+ * Bucket i counts samples <= METRICS_HIST_BOUNDS_MS[i]; the last bucket is
+ * everything larger. Bucket counts saturate at 0xFFFF in the snapshot.
+ * Readers must skip ids they do not know.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define METRICS_SNAPSHOT_VERSION  1
+#define METRICS_SNAPSHOT_MAX      240     /* Fits one UART frame to the Pi */
+
+typedef enum {
+	METRICS_SOURCE_UNKNOWN = 0,
+	METRICS_SOURCE_SHEARS  = 1,
+	METRICS_SOURCE_BASE    = 2
+} metrics_source_t;
+
+/* Ids are part of the snapshot format: append only, never renumber. */
+typedef enum {
+	/* Shears */
+	METRIC_CUTS_SAVED          = 0,
+	METRIC_SAVES_FAILED        = 1,
+	METRIC_BLE_CHUNKS_SENT     = 2,
+	METRIC_BLE_CHUNKS_FAILED   = 3,   /* DATA notify rc != 0 or no mbuf */
+	METRIC_BLE_NOTIFY_ERRORS   = 4,   /* STATUS / SEGMENT_LIST notify rc != 0 */
+
+	/* Base */
+	METRIC_BLE_CHUNKS_RECEIVED = 5,
+	METRIC_BLE_CHUNK_GAPS      = 6,   /* Chunk index skipped: a chunk was lost */
+	METRIC_SEGMENTS_FETCHED    = 7,
+	METRIC_UART_SEGMENTS_SENT  = 8,   /* COMMIT(0) received */
+	METRIC_UART_RETRANSMITS    = 9,   /* Frame sent again after an ACK timeout */
+	METRIC_UART_RETRIES        = 10,  /* Segment left for the next run */
+
+	/* Both (gauges) */
+	METRIC_SPIFFS_USED_BYTES   = 11,
+	METRIC_SPIFFS_TOTAL_BYTES  = 12,
+
+	/* Base */
+	METRIC_SEGMENTS_DISCARDED  = 13,  /* Gapped, short or stalled fetch thrown away */
+	METRIC_UART_QUARANTINED    = 14,  /* Segment the Pi kept rejecting, set aside */
+
+	METRIC_COUNT
+} metric_id_t;
+
+typedef enum {
+	METRIC_HIST_CUT_TO_FIX     = 0,   /* Shears: cut press -> GGA captured */
+	METRIC_HIST_SAVE           = 1,   /* Shears: GGA captured -> row on flash */
+	METRIC_HIST_SEGMENT_FETCH  = 2,   /* Base: STATUS_OK -> TRANSFER_DONE */
+	METRIC_HIST_UART_SEGMENT   = 3,   /* Base: START -> COMMIT for one segment */
+
+	METRIC_HIST_COUNT
+} metric_hist_id_t;
+
+#define METRICS_HIST_BUCKETS  11
+
+extern const uint32_t METRICS_HIST_BOUNDS_MS[METRICS_HIST_BUCKETS - 1];
+
+void metrics_inc(metric_id_t id);
+void metrics_add(metric_id_t id, uint32_t n);
+void metrics_set(metric_id_t id, uint32_t value);
+uint32_t metrics_get(metric_id_t id);
+
+/* Records one latency sample. Negative durations are ignored. */
+void metrics_observe_us(metric_hist_id_t id, int64_t us);
+
+/*
+ * Optional hook run at the start of every snapshot, for gauges that are
+ * cheaper to sample on demand than to keep current (e.g. SPIFFS usage).
+ */
+void metrics_set_sampler(void (*sampler)(void));
+
+/* Writes a snapshot into out. Returns its length, or 0 if cap is too small. */
+size_t metrics_snapshot(metrics_source_t source, uint8_t *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,173 @@
+/*
+ * metrics.c
+ *
+ * Lock-free metrics registry shared by the shears and the base.
+ * See metrics.h for the snapshot layout.
+ */
+
+#include "metrics.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+typedef struct {
+	atomic_uint_least32_t count;
+	atomic_uint_least32_t sumMs;
+	atomic_uint_least32_t maxMs;
+	atomic_uint_least32_t buckets[METRICS_HIST_BUCKETS];
+} metricsHist_t;
+
+const uint32_t METRICS_HIST_BOUNDS_MS[METRICS_HIST_BUCKETS - 1] = {
+	5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+static atomic_uint_least32_t counters[METRIC_COUNT];
+static metricsHist_t hists[METRIC_HIST_COUNT];
+static void (*volatile snapshotSampler)(void) = NULL;
+
+/* --- Recording ------------------------------------------------------------ */
+
+void metrics_inc(metric_id_t id)
+{
+	metrics_add(id, 1);
+}
+
+void metrics_add(metric_id_t id, uint32_t n)
+{
+	if ((unsigned)id < METRIC_COUNT) {
+		atomic_fetch_add_explicit(&counters[id], n, memory_order_relaxed);
+	}
+}
+
+void metrics_set(metric_id_t id, uint32_t value)
+{
+	if ((unsigned)id < METRIC_COUNT) {
+		atomic_store_explicit(&counters[id], value, memory_order_relaxed);
+	}
+}
+
+uint32_t metrics_get(metric_id_t id)
+{
+	if ((unsigned)id >= METRIC_COUNT) {
+		return 0;
+	}
+	return atomic_load_explicit(&counters[id], memory_order_relaxed);
+}
+
+void metrics_observe_us(metric_hist_id_t id, int64_t us)
+{
+	if ((unsigned)id >= METRIC_HIST_COUNT || us < 0) {
+		return;
+	}
+
+	int64_t ms64 = us / 1000;
+	uint32_t ms = (ms64 > UINT32_MAX) ? UINT32_MAX : (uint32_t)ms64;
+
+	int bucket = 0;
+	while (bucket < METRICS_HIST_BUCKETS - 1 && ms > METRICS_HIST_BOUNDS_MS[bucket]) {
+		bucket++;
+	}
+
+	metricsHist_t *h = &hists[id];
+	atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->sumMs, ms, memory_order_relaxed);
+	atomic_fetch_add_explicit(&h->buckets[bucket], 1, memory_order_relaxed);
+
+	uint32_t prev = atomic_load_explicit(&h->maxMs, memory_order_relaxed);
+	while (ms > prev &&
+	       !atomic_compare_exchange_weak_explicit(&h->maxMs, &prev, ms,
+						      memory_order_relaxed,
+						      memory_order_relaxed)) {
+	}
+}
+
+void metrics_set_sampler(void (*sampler)(void))
+{
+	snapshotSampler = sampler;
+}
+
+/* --- Snapshot ------------------------------------------------------------- */
+
+static size_t put_u16(uint8_t *out, uint16_t v)
+{
+	out[0] = (uint8_t)(v & 0xFF);
+	out[1] = (uint8_t)(v >> 8);
+	return 2;
+}
+
+static size_t put_u32(uint8_t *out, uint32_t v)
+{
+	out[0] = (uint8_t)(v & 0xFF);
+	out[1] = (uint8_t)((v >> 8) & 0xFF);
+	out[2] = (uint8_t)((v >> 16) & 0xFF);
+	out[3] = (uint8_t)(v >> 24);
+	return 4;
+}
+
+size_t metrics_snapshot(metrics_source_t source, uint8_t *out, size_t cap)
+{
+	const size_t counterLen = 1 + 4;
+	const size_t histLen = 1 + 4 + 4 + 4 + 1 + 2 * METRICS_HIST_BUCKETS;
+
+	void (*sampler)(void) = snapshotSampler;
+	if (sampler) {
+		sampler();
+	}
+
+	if (cap < 8) {
+		return 0;
+	}
+
+	size_t len = 0;
+	out[len++] = METRICS_SNAPSHOT_VERSION;
+	out[len++] = (uint8_t)source;
+	len += put_u32(&out[len], (uint32_t)(esp_timer_get_time() / 1000));
+
+	size_t countAt = len++;
+	uint8_t n = 0;
+
+	for (int i = 0; i < METRIC_COUNT; i++) {
+		uint32_t v = atomic_load_explicit(&counters[i], memory_order_relaxed);
+		if (v == 0) {
+			continue;
+		}
+		if (len + counterLen + 1 > cap) {
+			return 0;
+		}
+		out[len++] = (uint8_t)i;
+		len += put_u32(&out[len], v);
+		n++;
+	}
+	out[countAt] = n;
+
+	countAt = len++;
+	n = 0;
+
+	for (int i = 0; i < METRIC_HIST_COUNT; i++) {
+		metricsHist_t *h = &hists[i];
+		uint32_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+		if (count == 0) {
+			continue;
+		}
+		if (len + histLen > cap) {
+			return 0;
+		}
+
+		out[len++] = (uint8_t)i;
+		len += put_u32(&out[len], count);
+		len += put_u32(&out[len], atomic_load_explicit(&h->sumMs, memory_order_relaxed));
+		len += put_u32(&out[len], atomic_load_explicit(&h->maxMs, memory_order_relaxed));
+		out[len++] = METRICS_HIST_BUCKETS;
+
+		for (int b = 0; b < METRICS_HIST_BUCKETS; b++) {
+			uint32_t c = atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+			len += put_u16(&out[len], c > 0xFFFF ? 0xFFFF : (uint16_t)c);
+		}
+		n++;
+	}
+	out[countAt] = n;
+
+	return len;
+}
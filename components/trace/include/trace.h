@@ -0,0 +1,120 @@
+/*
+ * trace.h
+ *
+ * Cycle-count trace of the cut -> flash -> BLE -> UART hot path.
+ *
+ * Each trace point writes one 8-byte event (CPU cycle count, id + phase,
+ * 16-bit argument) into a RAM ring owned by the core it runs on. Slots are
+ * claimed with one atomic add, so recording is lock-free and safe from
+ * tasks and ISRs alike. The oldest events are overwritten when a ring is
+ * full.
+ *
+ * The trace points compile to nothing unless CONFIG_WM_TRACE is set, which
+ * Kconfig only allows in debug-optimised builds.
+ *
+ * Dump layout (little-endian), produced by trace_serialize():
+ *
+ *   [0..3]   "WMTR"
+ *   [4]      TRACE_DUMP_VERSION
+ *   [5]      trace_source_t
+ *   [6]      C, number of per-core blocks that follow
+ *   [7]      reserved (0)
+ *   [8..11]  uint32_t cycles per microsecond used to convert timestamps
+ *            C x { uint8_t core, uint8_t reserved, uint16_t n,
+ *                  uint32_t overwritten, n x trace_event_t (oldest first) }
+ *
+ * Timestamps are the raw 32-bit cycle counter: it wraps every ~17 s at
+ * 240 MHz, stops in light sleep and slows down under dynamic frequency
+ * scaling, so only intervals inside one burst of activity are exact. The
+ * host decoder (host-fw/tools/wm_trace.py) unwraps them in ring order.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+#define TRACE_DUMP_VERSION  1
+
+typedef enum {
+	TRACE_SOURCE_UNKNOWN = 0,
+	TRACE_SOURCE_SHEARS  = 1,
+	TRACE_SOURCE_BASE    = 2
+} trace_source_t;
+
+typedef enum {
+	TRACE_PHASE_INSTANT = 0,
+	TRACE_PHASE_BEGIN   = 1,
+	TRACE_PHASE_END     = 2
+} trace_phase_t;
+
+/* Ids are part of the dump format: append only, never renumber. */
+typedef enum {
+	/* Shears */
+	TRACE_ID_CUT_PRESS        = 1,    /* ISR; arg = GPIO */
+	TRACE_ID_GGA_CAPTURED     = 2,
+	TRACE_ID_SAVE             = 3,    /* saveTask: append + announce; end arg = ok */
+	TRACE_ID_STORAGE_APPEND   = 4,    /* Mutex + fopen..fclose + seal */
+	TRACE_ID_STORAGE_FOPEN    = 5,
+	TRACE_ID_STORAGE_WRITE    = 6,    /* end arg = row length */
+	TRACE_ID_STORAGE_FCLOSE   = 7,
+	TRACE_ID_SEGMENT_ANNOUNCE = 8,
+	TRACE_ID_CHUNK_NOTIFY     = 9,    /* arg = chunk index */
+
+	/* Base */
+	TRACE_ID_DATA_NOTIFY_RX   = 32,   /* arg = chunk index */
+	TRACE_ID_CHUNK_FWRITE     = 33,   /* arg = bytes */
+	TRACE_ID_UART_SEGMENT     = 34,   /* One segment to the Pi; arg = seq, end arg = ok */
+} trace_id_t;
+
+typedef struct __attribute__((packed)) {
+	uint32_t cycles;
+	uint16_t id;          /* trace_id_t in bits 0..13, trace_phase_t in 14..15 */
+	uint16_t arg;
+} trace_event_t;
+
+#if CONFIG_WM_TRACE
+
+void trace_record(trace_id_t id, trace_phase_t phase, uint16_t arg);
+
+#define TRACE_INSTANT(id, arg)  trace_record((id), TRACE_PHASE_INSTANT, (uint16_t)(arg))
+#define TRACE_BEGIN(id, arg)    trace_record((id), TRACE_PHASE_BEGIN, (uint16_t)(arg))
+#define TRACE_END(id, arg)      trace_record((id), TRACE_PHASE_END, (uint16_t)(arg))
+
+#else
+
+/* sizeof keeps arg unevaluated but counts it as used, so no unused warnings. */
+#define TRACE_INSTANT(id, arg)  do { (void)sizeof(arg); } while (0)
+#define TRACE_BEGIN(id, arg)    do { (void)sizeof(arg); } while (0)
+#define TRACE_END(id, arg)      do { (void)sizeof(arg); } while (0)
+
+#endif
+
+/* Receives consecutive pieces of a dump. */
+typedef void (*trace_sink_fn)(const uint8_t *data, size_t len, void *ctx);
+
+/*
+ * Streams the current rings to sink. Recording is paused meanwhile, so the
+ * events are consistent; anything traced during the dump is lost.
+ * Returns the dump length, 0 when tracing is compiled out.
+ */
+size_t trace_serialize(trace_source_t source, trace_sink_fn sink, void *ctx);
+
+/*
+ * Prints a dump on the console as "WMTRACE <hex>" lines ending with
+ * "WMTRACE END", for wm_trace.py to pick out of a monitor log.
+ */
+void trace_dump_console(trace_source_t source);
+
+/* Console form of one piece of a dump; an empty piece prints the END line. */
+void trace_print_hex(const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
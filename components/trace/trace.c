@@ -0,0 +1,184 @@
+/*
+ * trace.c
+ *
+ * Per-core cycle-count trace rings. See trace.h for the dump layout.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_WM_TRACE
+
+#include <stdatomic.h>
+
+#include "esp_attr.h"
+#include "esp_cpu.h"
+
+#define TRACE_RING_EVENTS  CONFIG_WM_TRACE_EVENTS
+#define TRACE_CORES        portNUM_PROCESSORS
+
+_Static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0,
+               "CONFIG_WM_TRACE_EVENTS must be a power of two");
+
+typedef struct {
+	atomic_uint_least32_t head;     /* Events ever claimed on this core */
+	trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+static trace_ring_t rings[TRACE_CORES];
+static atomic_bool paused;
+
+void IRAM_ATTR trace_record(trace_id_t id, trace_phase_t phase, uint16_t arg)
+{
+	if (atomic_load_explicit(&paused, memory_order_relaxed)) {
+		return;
+	}
+
+	trace_ring_t *r = &rings[esp_cpu_get_core_id()];
+	uint32_t slot = atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+
+	trace_event_t *ev = &r->events[slot & (TRACE_RING_EVENTS - 1)];
+	ev->cycles = esp_cpu_get_cycle_count();
+	ev->id     = (uint16_t)(((unsigned)id & 0x3FFF) | ((unsigned)phase << 14));
+	ev->arg    = arg;
+}
+
+/* --- Dump ----------------------------------------------------------------- */
+
+static void put_u16(uint8_t *out, uint16_t v)
+{
+	out[0] = (uint8_t)(v & 0xFF);
+	out[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *out, uint32_t v)
+{
+	out[0] = (uint8_t)(v & 0xFF);
+	out[1] = (uint8_t)((v >> 8) & 0xFF);
+	out[2] = (uint8_t)((v >> 16) & 0xFF);
+	out[3] = (uint8_t)(v >> 24);
+}
+
+size_t trace_serialize(trace_source_t source, trace_sink_fn sink, void *ctx)
+{
+	if (!sink) {
+		return 0;
+	}
+
+	atomic_store(&paused, true);
+
+	uint8_t hdr[12] = { 'W', 'M', 'T', 'R', TRACE_DUMP_VERSION,
+	                    (uint8_t)source, TRACE_CORES, 0 };
+	put_u32(&hdr[8], CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+	sink(hdr, sizeof(hdr), ctx);
+	size_t total = sizeof(hdr);
+
+	for (int core = 0; core < TRACE_CORES; core++) {
+		trace_ring_t *r = &rings[core];
+		uint32_t head = atomic_load(&r->head);
+		uint32_t n = (head < TRACE_RING_EVENTS) ? head : TRACE_RING_EVENTS;
+
+		uint8_t blk[8] = { (uint8_t)core, 0 };
+		put_u16(&blk[2], (uint16_t)n);
+		put_u32(&blk[4], head - n);
+		sink(blk, sizeof(blk), ctx);
+		total += sizeof(blk);
+
+		for (uint32_t i = head - n; i != head; i++) {
+			const trace_event_t *ev = &r->events[i & (TRACE_RING_EVENTS - 1)];
+			uint8_t raw[sizeof(trace_event_t)];
+
+			put_u32(&raw[0], ev->cycles);
+			put_u16(&raw[4], ev->id);
+			put_u16(&raw[6], ev->arg);
+			sink(raw, sizeof(raw), ctx);
+			total += sizeof(raw);
+		}
+	}
+
+	atomic_store(&paused, false);
+	return total;
+}
+
+#else
+
+size_t trace_serialize(trace_source_t source, trace_sink_fn sink, void *ctx)
+{
+	(void)source;
+	(void)sink;
+	(void)ctx;
+	return 0;
+}
+
+#endif /* CONFIG_WM_TRACE */
+
+/* --- Console -------------------------------------------------------------- */
+
+#define TRACE_HEX_LINE  32
+
+typedef struct {
+	uint8_t buf[TRACE_HEX_LINE];
+	size_t fill;
+} hex_line_t;
+
+void trace_print_hex(const uint8_t *data, size_t len)
+{
+	if (len == 0) {
+		printf("WMTRACE END\n");
+		return;
+	}
+
+	while (len > 0) {
+		size_t n = (len < TRACE_HEX_LINE) ? len : TRACE_HEX_LINE;
+		char line[8 + 2 * TRACE_HEX_LINE + 1];
+		size_t pos = (size_t)snprintf(line, sizeof(line), "WMTRACE ");
+
+		for (size_t i = 0; i < n; i++) {
+			pos += (size_t)snprintf(&line[pos], sizeof(line) - pos, "%02x", data[i]);
+		}
+		printf("%s\n", line);
+
+		data += n;
+		len -= n;
+	}
+}
+
+static void hex_line_sink(const uint8_t *data, size_t len, void *ctx)
+{
+	hex_line_t *line = (hex_line_t *)ctx;
+
+	while (len > 0) {
+		size_t n = sizeof(line->buf) - line->fill;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(&line->buf[line->fill], data, n);
+		line->fill += n;
+		data += n;
+		len -= n;
+
+		if (line->fill == sizeof(line->buf)) {
+			trace_print_hex(line->buf, line->fill);
+			line->fill = 0;
+		}
+	}
+}
+
+void trace_dump_console(trace_source_t source)
+{
+	hex_line_t line = { .fill = 0 };
+
+	if (trace_serialize(source, hex_line_sink, &line) == 0) {
+		printf("WMTRACE disabled (CONFIG_WM_TRACE is off)\n");
+		return;
+	}
+
+	if (line.fill > 0) {
+		trace_print_hex(line.buf, line.fill);
+	}
+	trace_print_hex(NULL, 0);
+}
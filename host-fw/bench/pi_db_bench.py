@@ -0,0 +1,163 @@
+"""
+pi_db_bench.py
+
+Read/write concurrency of the Pi database layer: /api/points latency while
+the ingest thread stores a transfer.
+
+A throwaway database is preloaded with --preload rows. Then one thread
+streams --rows records through database.PointWriter at --rate rows/s (as
+uart_receiver does for a transfer), --readers threads fetch /api/points in a
+loop and --writers threads soft-delete and restore a row in a loop (the
+dashboard's trash buttons). Per client, latency percentiles are reported for
+the requests issued while the ingest ran.
+
+/api/points goes through Flask's test client when flask and pyserial are
+installed; otherwise the route's own work is timed (get_all_points() plus
+JSON encoding), which leaves out only Flask's constant overhead.
+
+Usage: pi_db_bench.py [--rpi-dir base-rpi-fw] [--rows 10000] [--rate 2000]
+                      [--preload 20000] [--readers 2] [--writers 1]
+
+Compare journal modes with HUB_DB_JOURNAL=DELETE python3 pi_db_bench.py.
+"""
+
+import argparse
+import json
+import os
+import random
+import shutil
+import sys
+import tempfile
+import threading
+import time
+
+
+def record(i):
+    return {
+        "utc_date": "010126",
+        "utc_time": "%06d.%02d" % (i // 100 % 240000, i % 100),
+        "latitude": 29.64 + i * 1e-6,
+        "longitude": -82.35 - i * 1e-6,
+        "fix_quality": 1,
+        "num_satellites": 9,
+        "hdop": 0.9,
+        "altitude": 30.0,
+        "geoid_height": -20.0,
+    }
+
+
+def percentile(sorted_ms, p):
+    if not sorted_ms:
+        return float("nan")
+    k = min(len(sorted_ms) - 1, int(round(p / 100.0 * (len(sorted_ms) - 1))))
+    return sorted_ms[k]
+
+
+def report(name, samples):
+    ms = sorted(samples)
+    print("%-14s %7d  %8.2f %8.2f %8.2f %8.2f" % (
+        name, len(ms), percentile(ms, 50), percentile(ms, 95),
+        percentile(ms, 99), ms[-1] if ms else float("nan")))
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--rpi-dir", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "..", "base-rpi-fw"))
+    ap.add_argument("--rows", type=int, default=10000)
+    ap.add_argument("--rate", type=float, default=2000.0,
+                    help="ingest rows/s, 0 = as fast as possible")
+    ap.add_argument("--preload", type=int, default=20000)
+    ap.add_argument("--readers", type=int, default=2)
+    ap.add_argument("--writers", type=int, default=1)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="pi_db_bench_")
+    os.environ["HUB_DB_PATH"] = os.path.join(work, "watermelon_hub.db")
+    sys.path.insert(0, os.path.abspath(args.rpi_dir))
+
+    import config
+    import database
+
+    try:
+        import app as hub_app
+        client = hub_app.app.test_client()
+
+        def get_points():
+            resp = client.get("/api/points")
+            resp.get_data()
+        target = "flask test client"
+    except ImportError:
+        def get_points():
+            json.dumps(database.get_all_points())
+        target = "get_all_points() + json (no flask/pyserial)"
+
+    database.init_db()
+    database.insert_points_batch(
+        [record(-1 - i) for i in range(args.preload)], device_id="preload")
+
+    done = threading.Event()
+    lat = {"points": [], "delete+restore": []}
+    ingest = {}
+
+    def ingest_thread():
+        t0 = time.perf_counter()
+        writer = database.PointWriter("bench", 1)
+        for i in range(args.rows):
+            writer.add(record(i))
+            if args.rate > 0:
+                ahead = t0 + (i + 1) / args.rate - time.perf_counter()
+                if ahead > 0:
+                    time.sleep(ahead)
+        t1 = time.perf_counter()
+        writer.commit()
+        ingest["total_s"] = time.perf_counter() - t0
+        ingest["commit_ms"] = (time.perf_counter() - t1) * 1000.0
+        done.set()
+
+    def reader():
+        out = []
+        while not done.is_set():
+            t = time.perf_counter()
+            get_points()
+            out.append((time.perf_counter() - t) * 1000.0)
+        lat["points"].extend(out)
+
+    def trash_writer(seed):
+        rng = random.Random(seed)
+        out = []
+        while not done.is_set():
+            pid = rng.randint(1, max(1, args.preload))
+            t = time.perf_counter()
+            database.soft_delete_points([pid])
+            database.restore_points([pid])
+            out.append((time.perf_counter() - t) * 1000.0)
+        lat["delete+restore"].extend(out)
+
+    threads = [threading.Thread(target=ingest_thread)]
+    threads += [threading.Thread(target=reader) for _ in range(args.readers)]
+    threads += [threading.Thread(target=trash_writer, args=(i,))
+                for i in range(args.writers)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    print("journal=%s synchronous=%s  preload=%d rows  ingest=%d rows @ %s rows/s"
+          % (config.DB_JOURNAL_MODE, config.DB_SYNCHRONOUS, args.preload,
+             args.rows, args.rate or "max"))
+    print("/api/points via %s" % target)
+    print("ingest: %.2f s total, final commit %.1f ms, %d rows stored"
+          % (ingest["total_s"], ingest["commit_ms"], database.get_point_count()))
+    print()
+    print("%-14s %7s  %8s %8s %8s %8s" % ("client", "calls", "p50 ms", "p95 ms",
+                                          "p99 ms", "max ms"))
+    report("/api/points", lat["points"])
+    if args.writers:
+        report("delete+restore", lat["delete+restore"])
+
+    shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
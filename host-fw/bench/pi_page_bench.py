@@ -0,0 +1,141 @@
+"""
+pi_page_bench.py
+
+Cut log load cost on the Pi hub: the whole list (/api/points) against one
+page of it (/api/points?offset=&limit=).
+
+A throwaway database is preloaded with --rows points spread over 30 days.
+Each case below is run --repeat times and its median latency and response
+size are reported:
+
+    full list          get_all_points() + JSON, what the log used to load
+    page @ offset      one --limit page, newest first, at the start, middle
+                       and end of the list (OFFSET cost grows with depth)
+    page, date filter  the first page of a 7-day range (COUNT + page)
+    ids, date filter   every id of that range, for "select all"
+    view z19 / z15     the map's viewport query (/api/points?bbox=&zoom=)
+                       at a close zoom (points) and a field-wide one (grid)
+
+Requests go through Flask's test client when flask and pyserial are
+installed; otherwise the database call behind each plus JSON encoding is
+timed, which leaves out only Flask's constant overhead.
+
+Usage: pi_page_bench.py [--rpi-dir base-rpi-fw] [--rows 100000]
+                        [--limit 200] [--repeat 20]
+"""
+
+import argparse
+import json
+import os
+import shutil
+import statistics
+import sys
+import tempfile
+import time
+
+DAYS = 30
+
+
+def record(i, rows):
+    day = 1 + i * DAYS // rows
+    return {
+        "utc_date": "%02d0626" % day,
+        "utc_time": "%06d.00" % (i % 86400 // 3600 * 10000
+                                 + i % 3600 // 60 * 100 + i % 60),
+        "latitude": 29.64 + (i % 1000) * 1e-5,
+        "longitude": -82.35 - (i // 1000) * 1e-5,
+        "fix_quality": 4,
+        "num_satellites": 12,
+        "hdop": 0.7,
+        "altitude": 30.0,
+        "geoid_height": -20.0,
+    }
+
+
+def timed(fn, repeat):
+    samples, size = [], 0
+    for _ in range(repeat):
+        t0 = time.perf_counter()
+        size = len(fn())
+        samples.append((time.perf_counter() - t0) * 1000.0)
+    return statistics.median(samples), size
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--rpi-dir", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "..", "base-rpi-fw"))
+    ap.add_argument("--rows", type=int, default=100000)
+    ap.add_argument("--limit", type=int, default=200)
+    ap.add_argument("--repeat", type=int, default=20)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="pi_page_bench_")
+    os.environ["HUB_DB_PATH"] = os.path.join(work, "watermelon_hub.db")
+    sys.path.insert(0, os.path.abspath(args.rpi_dir))
+
+    import config
+    import database
+
+    try:
+        import app as hub_app
+        client = hub_app.app.test_client()
+
+        def fetch(query):
+            return client.get("/api/points" + query).get_data()
+        target = "flask test client"
+    except ImportError:
+        from urllib.parse import parse_qs
+
+        def fetch(query):
+            if not query:
+                return json.dumps(database.get_all_points()).encode()
+            q = {k: v[0] for k, v in parse_qs(query[1:]).items()}
+            if "bbox" in q:
+                bbox = [float(v) for v in q["bbox"].split(",")]
+                zoom = int(q["zoom"])
+                if zoom >= config.POINTS_GRID_MAX_ZOOM:
+                    points = database.get_points_in_bbox(
+                        *bbox, config.POINTS_BBOX_MAX + 1)
+                    if len(points) <= config.POINTS_BBOX_MAX:
+                        return json.dumps({"points": points}).encode()
+                cell_shift = (256 // config.POINTS_GRID_CELL_PX).bit_length() - 1
+                return json.dumps({"cells": database.get_grid_in_bbox(
+                    *bbox, zoom + cell_shift)}).encode()
+            return json.dumps(database.get_points_page(
+                offset=int(q.get("offset", 0)), limit=int(q["limit"]),
+                date_from=q.get("from"), date_to=q.get("to"),
+                ids_only=q.get("fields") == "id")).encode()
+        target = "database + json (no flask/pyserial)"
+
+    database.init_db()
+    database.insert_points_batch(
+        [record(i, args.rows) for i in range(args.rows)], device_id="bench")
+
+    last = max(0, args.rows - args.limit)
+    week = "&from=2026-06-10&to=2026-06-16"
+    cases = [
+        ("full list", ""),
+        ("page @ 0", "?offset=0&limit=%d" % args.limit),
+        ("page @ middle", "?offset=%d&limit=%d" % (last // 2, args.limit)),
+        ("page @ end", "?offset=%d&limit=%d" % (last, args.limit)),
+        ("page, date filter", "?offset=0&limit=%d%s" % (args.limit, week)),
+        ("ids, date filter", "?fields=id&limit=%d%s" % (args.rows, week)),
+        # about 1.5x a 1280x900 window at each zoom, centred on the field
+        ("view z19", "?bbox=-82.3520,29.6440,-82.3490,29.6460&zoom=19"),
+        ("view z15", "?bbox=-82.3740,29.6320,-82.3260,29.6580&zoom=15"),
+    ]
+
+    print("%d rows over %d days, page size %d, median of %d; served via %s"
+          % (args.rows, DAYS, args.limit, args.repeat, target))
+    print()
+    print("%-18s %10s %10s" % ("request", "ms", "KB"))
+    for name, query in cases:
+        ms, size = timed(lambda: fetch(query), args.repeat)
+        print("%-18s %10.2f %10.1f" % (name, ms, size / 1024.0))
+
+    shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
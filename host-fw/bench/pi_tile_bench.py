@@ -0,0 +1,151 @@
+"""
+pi_tile_bench.py
+
+Offline tile serving throughput of the Pi hub, in tiles per second.
+
+A throwaway MBTiles file holds a --side x --side block of tiles at each of
+zooms 15-19 (--tile-kb bytes each, PNG signature). --threads clients then
+request tiles from it the way a map pan does: each picks a random viewport
+(4x3 tiles) at a random zoom and fetches all of it, for --seconds. Three
+servers are compared:
+
+    per-request   the old route: connect, SELECT, close for every tile
+    pooled        tiles.get_tile() with the RAM cache disabled
+    cached        tiles.get_tile() with the default cache, warmed
+
+Tiles go through Flask's test client when flask and pyserial are installed
+(so the 304/ETag handling is included); otherwise the tile lookup is timed
+directly, which leaves out only Flask's constant overhead.
+
+Usage: pi_tile_bench.py [--rpi-dir base-rpi-fw] [--side 16] [--tile-kb 16]
+                        [--threads 4] [--seconds 3]
+"""
+
+import argparse
+import os
+import random
+import shutil
+import sqlite3
+import sys
+import tempfile
+import threading
+import time
+
+ZOOMS = range(15, 20)
+
+
+def build_mbtiles(path, side, tile_bytes):
+    conn = sqlite3.connect(path)
+    conn.execute("CREATE TABLE metadata (name TEXT, value TEXT)")
+    conn.execute("CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, "
+                 "tile_row INTEGER, tile_data BLOB)")
+    conn.execute("CREATE UNIQUE INDEX idx_tiles ON tiles "
+                 "(zoom_level, tile_column, tile_row)")
+    rng = random.Random(1)
+    for z in ZOOMS:
+        conn.executemany(
+            "INSERT INTO tiles VALUES (?, ?, ?, ?)",
+            ((z, x, (1 << z) - 1 - y,
+              b"\x89PNG\r\n\x1a\n" + rng.randbytes(tile_bytes - 8))
+             for x in range(side) for y in range(side)))
+    conn.commit()
+    conn.close()
+
+
+def run(fetch, threads, seconds, side):
+    """Pan clients for the given time; returns tiles/s."""
+    stop = time.perf_counter() + seconds
+    counts = []
+
+    def client(seed):
+        rng = random.Random(seed)
+        n = 0
+        while time.perf_counter() < stop:
+            z = rng.choice(ZOOMS)
+            x0, y0 = rng.randrange(side - 3), rng.randrange(side - 2)
+            for x in range(x0, x0 + 4):
+                for y in range(y0, y0 + 3):
+                    fetch(z, x, y)
+                    n += 1
+        counts.append(n)
+
+    t0 = time.perf_counter()
+    ts = [threading.Thread(target=client, args=(i,)) for i in range(threads)]
+    for t in ts:
+        t.start()
+    for t in ts:
+        t.join()
+    return sum(counts) / (time.perf_counter() - t0)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--rpi-dir", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "..", "base-rpi-fw"))
+    ap.add_argument("--side", type=int, default=16,
+                    help="tiles per axis at each zoom")
+    ap.add_argument("--tile-kb", type=int, default=16)
+    ap.add_argument("--threads", type=int, default=4)
+    ap.add_argument("--seconds", type=float, default=3.0)
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="pi_tile_bench_")
+    path = os.path.join(work, "bench.mbtiles")
+    os.environ["HUB_MBTILES"] = path
+    os.environ["HUB_DB_PATH"] = os.path.join(work, "watermelon_hub.db")
+    sys.path.insert(0, os.path.abspath(args.rpi_dir))
+    build_mbtiles(path, args.side, args.tile_kb * 1024)
+
+    import config
+    import tiles
+
+    def per_request(z, x, y):
+        conn = sqlite3.connect(path)
+        row = conn.execute(
+            "SELECT tile_data FROM tiles "
+            "WHERE zoom_level=? AND tile_column=? AND tile_row=?",
+            (z, x, (1 << z) - 1 - y)).fetchone()
+        conn.close()
+        return row
+
+    try:
+        import app as hub_app
+        client = hub_app.app.test_client()
+
+        def pooled(z, x, y):
+            client.get("/tiles/%d/%d/%d.png" % (z, x, y)).get_data()
+        target = "flask test client"
+    except ImportError:
+        def pooled(z, x, y):
+            tiles.get_tile(z, x, y)
+        target = "tiles.get_tile() (no flask/pyserial)"
+
+    total = len(ZOOMS) * args.side * args.side
+    print("%d tiles x %d KB, %d threads, %.0f s per run; served via %s"
+          % (total, args.tile_kb, args.threads, args.seconds, target))
+    print()
+    print("%-12s %10s" % ("server", "tiles/s"))
+
+    print("%-12s %10.0f" % ("per-request", run(per_request, args.threads,
+                                               args.seconds, args.side)))
+
+    cache_bytes = config.TILE_CACHE_BYTES
+    config.TILE_CACHE_BYTES = 0
+    print("%-12s %10.0f" % ("pooled", run(pooled, args.threads,
+                                          args.seconds, args.side)))
+
+    config.TILE_CACHE_BYTES = cache_bytes
+    for z in ZOOMS:
+        for x in range(args.side):
+            for y in range(args.side):
+                tiles.get_tile(z, x, y)
+    print("%-12s %10.0f" % ("cached", run(pooled, args.threads,
+                                          args.seconds, args.side)))
+    print("(cache %d MB; working set %.1f MB)"
+          % (cache_bytes // (1024 * 1024), total * args.tile_kb / 1024.0))
+
+    shutil.rmtree(work, ignore_errors=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,722 @@
+/*
+ * wm_bench.c
+ *
+ * Per-record cost of the firmware hot paths, run on the host shims.
+ *
+ * Benchmarks follow the Google Benchmark model: each one is called with an
+ * iteration count, the runner grows that count until the timed region lasts
+ * at least --min-time, and results are reported per processed record:
+ *
+ *   parse/nmea_uart          RMC + GSA + GSV + GGA epoch through gps_logger's
+ *                            UART reader (one record = one epoch)
+ *   store/append_gngga       GGA tokenize + CSV append to a single file
+ *   store/append_cut         same through the segmented log (seal + rotate)
+ *   codec/compress/<rows>    log_codec_compress_file() on a <rows> segment
+ *   xfer/uart_forward/<rows> base -> Pi UART protocol for one encoded segment
+ *   xfer/ble_to_pi/<rows>    LIST_SEGMENTS -> BLE transfer -> base mirror ->
+ *                            UART forward -> Pi COMMIT for one segment
+ *
+ * "Time" is wall clock, "CPU" is process CPU time across all threads (the
+ * firmware tasks run on their own threads). The transfer benchmarks are
+ * dominated by the firmware's own vTaskDelay() pacing, which the shims run
+ * in real time; their CPU column is the number to compare between changes.
+ *
+ *   wm_bench [--filter=SUBSTR] [--min-time=SEC] [-v]
+ *
+ * Firmware stdout (ESP_LOGx, chunk dumps) is discarded unless -v is given.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "wm_host.h"
+#include "esp_log.h"
+#include "driver/uart.h"
+
+#include "shears_gpsStorage.h"
+#include "log_transfer_client.h"
+#include "base_uartFileTransfer.h"
+#include "log_codec.h"
+#include "log_segments.h"
+
+#include "wm_nmea.h"
+#include "wm_rig.h"
+
+#define GPS_UART             WM_RIG_GPS_UART
+#define BLE_MTU              185
+
+#define NMEA_POOL_EPOCHS     256
+#define PARSE_BLOCK_MAX      512     /* Half the GPS UART RX ring */
+
+#define XFER_TIMEOUT_MS      10000
+#define XFER_KICK_MS         50
+
+#define BENCH_PATH_MAX       512
+#define BENCH_MAX_ITERS      1000000000LL
+
+/* --- Runner --------------------------------------------------------------- */
+
+typedef struct {
+	int64_t iterations;
+	int64_t arg;
+
+	/* Set by the benchmark; reported per item. */
+	int64_t items;
+	int64_t bytes;
+
+	bool paused;
+	int64_t wallNs;
+	int64_t cpuNs;
+	struct timespec wallStart;
+	struct timespec cpuStart;
+
+	const char *error;
+} benchState_t;
+
+typedef void (*benchFn_t)(benchState_t *st);
+
+typedef struct {
+	const char *name;
+	benchFn_t fn;
+	int64_t arg;            /* -1: no argument */
+	const char *bytesLabel; /* Column name for bytes per item, NULL if unused */
+} benchDef_t;
+
+static FILE *report;
+static double minTimeSec = 0.5;
+
+static int64_t elapsedNs(const struct timespec *from, const struct timespec *to)
+{
+	return (int64_t)(to->tv_sec - from->tv_sec) * 1000000000LL + (to->tv_nsec - from->tv_nsec);
+}
+
+static void benchResume(benchState_t *st)
+{
+	if (!st->paused) {
+		return;
+	}
+	st->paused = false;
+	clock_gettime(CLOCK_MONOTONIC, &st->wallStart);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &st->cpuStart);
+}
+
+static void benchPause(benchState_t *st)
+{
+	if (st->paused) {
+		return;
+	}
+
+	struct timespec wall;
+	struct timespec cpu;
+	clock_gettime(CLOCK_MONOTONIC, &wall);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+
+	st->wallNs += elapsedNs(&st->wallStart, &wall);
+	st->cpuNs += elapsedNs(&st->cpuStart, &cpu);
+	st->paused = true;
+}
+
+static void benchError(benchState_t *st, const char *msg)
+{
+	if (!st->error) {
+		st->error = msg;
+	}
+}
+
+static void benchRunOnce(const benchDef_t *def, int64_t iterations, benchState_t *st)
+{
+	memset(st, 0, sizeof(*st));
+	st->iterations = iterations;
+	st->arg = def->arg;
+	st->paused = true;
+
+	benchResume(st);
+	def->fn(st);
+	benchPause(st);
+
+	if (st->items == 0) {
+		st->items = iterations;
+	}
+}
+
+static void benchRun(const benchDef_t *def)
+{
+	char name[64];
+	benchState_t st;
+	int64_t iterations = 1;
+
+	if (def->arg >= 0) {
+		snprintf(name, sizeof(name), "%s/%lld", def->name, (long long)def->arg);
+	} else {
+		snprintf(name, sizeof(name), "%s", def->name);
+	}
+
+	while (1) {
+		benchRunOnce(def, iterations, &st);
+
+		if (st.error) {
+			fprintf(report, "%-28s ERROR OCCURRED: '%s'\n", name, st.error);
+			fflush(report);
+			return;
+		}
+
+		double seconds = (double)st.wallNs / 1e9;
+		if (seconds >= minTimeSec || iterations >= BENCH_MAX_ITERS) {
+			break;
+		}
+
+		/* Same growth rule as Google Benchmark: aim 40% past min-time, at most 10x. */
+		double multiplier = (seconds > 0.0) ? (minTimeSec * 1.4 / seconds) : 10.0;
+		if (multiplier > 10.0 || seconds / minTimeSec < 0.1) {
+			multiplier = 10.0;
+		}
+
+		int64_t next = (int64_t)((double)iterations * multiplier + 0.5);
+		iterations = (next > iterations) ? next : iterations + 1;
+	}
+
+	double items = (double)st.items;
+	double perSec = items / ((double)st.wallNs / 1e9);
+
+	fprintf(report, "%-28s %12.0f ns %12.0f ns %10lld %10.3fk rec/s",
+	        name, (double)st.wallNs / items, (double)st.cpuNs / items,
+	        (long long)st.iterations, perSec / 1000.0);
+
+	if (def->bytesLabel) {
+		fprintf(report, "  %s=%.1f", def->bytesLabel, (double)st.bytes / items);
+	}
+
+	fputc('\n', report);
+	fflush(report);
+}
+
+/* --- Devices -------------------------------------------------------------- */
+
+static wmRig_t rig;
+
+/* --- Pi stub -------------------------------------------------------------- */
+
+/*
+ * Answers the base's UART protocol (see base-fw/main/UART_README.md) the way
+ * uart_receiver.py does, minus verification: ACK every START/DATA/END and
+ * COMMIT(0x00) after END. Replies are injected from the base's TX call, so
+ * they are already waiting when the base starts reading. METRICS frames are
+ * not part of a segment's cost and are left out of the byte count.
+ */
+
+#define PI_START_BYTE   0xAA
+#define PI_TYPE_START   0x01
+#define PI_TYPE_DATA    0x02
+#define PI_TYPE_END     0x03
+#define PI_TYPE_ACK     0x04
+#define PI_TYPE_COMMIT  0x05
+#define PI_TYPE_METRICS 0x06
+
+static struct {
+	uint8_t frame[3 + 255 + 1];
+	size_t fill;
+
+	int64_t txBytes;
+	int64_t commits;
+} pi;
+
+static pthread_mutex_t piMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t piCond = PTHREAD_COND_INITIALIZER;
+
+static void piReply(int dev, int port, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+	uint8_t buf[3 + 1 + 1];
+	uint8_t c = type ^ len;
+
+	buf[0] = PI_START_BYTE;
+	buf[1] = type;
+	buf[2] = len;
+	for (uint8_t i = 0; i < len; i++) {
+		buf[3 + i] = payload[i];
+		c ^= payload[i];
+	}
+	buf[3 + len] = c;
+
+	hostUartInject(dev, port, buf, 4 + len);
+}
+
+static void piOnFrame(int dev, int port, uint8_t type)
+{
+	static const uint8_t commitOk = 0x00;
+
+	switch (type) {
+	case PI_TYPE_START:
+	case PI_TYPE_DATA:
+		piReply(dev, port, PI_TYPE_ACK, NULL, 0);
+		break;
+
+	case PI_TYPE_END:
+		piReply(dev, port, PI_TYPE_ACK, NULL, 0);
+		piReply(dev, port, PI_TYPE_COMMIT, &commitOk, 1);
+
+		pthread_mutex_lock(&piMutex);
+		pi.commits++;
+		pthread_cond_broadcast(&piCond);
+		pthread_mutex_unlock(&piMutex);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void piUartTx(int dev, int port, const uint8_t *data, size_t len, void *ctx)
+{
+	(void)ctx;
+
+	for (size_t i = 0; i < len; i++) {
+		uint8_t b = data[i];
+
+		if (pi.fill == 0 && b != PI_START_BYTE) {
+			continue;
+		}
+
+		pi.frame[pi.fill++] = b;
+
+		if (pi.fill >= 3 && pi.fill == (size_t)pi.frame[2] + 4) {
+			if (pi.frame[1] != PI_TYPE_METRICS) {
+				pthread_mutex_lock(&piMutex);
+				pi.txBytes += (int64_t)pi.fill;
+				pthread_mutex_unlock(&piMutex);
+			}
+			piOnFrame(dev, port, pi.frame[1]);
+			pi.fill = 0;
+		}
+	}
+}
+
+static int64_t piCommits(void)
+{
+	pthread_mutex_lock(&piMutex);
+	int64_t n = pi.commits;
+	pthread_mutex_unlock(&piMutex);
+	return n;
+}
+
+static int64_t piTxBytes(void)
+{
+	pthread_mutex_lock(&piMutex);
+	int64_t n = pi.txBytes;
+	pthread_mutex_unlock(&piMutex);
+	return n;
+}
+
+/*
+ * Waits for the Pi to have committed target segments in total.
+ *
+ * transferStart() drops triggers while the base's transfer task is still
+ * finishing its previous directory scan, so a segment that lands in that
+ * window waits for the next trigger. Re-trigger periodically, as the base
+ * button would.
+ */
+static bool piWaitCommits(int64_t target)
+{
+	int64_t waitedMs = 0;
+
+	pthread_mutex_lock(&piMutex);
+
+	while (pi.commits < target && waitedMs < XFER_TIMEOUT_MS) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += XFER_KICK_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		if (pthread_cond_timedwait(&piCond, &piMutex, &deadline) != 0) {
+			waitedMs += XFER_KICK_MS;
+
+			pthread_mutex_unlock(&piMutex);
+			transferStart(TRANSFER_TRIGGER_EVENT);
+			pthread_mutex_lock(&piMutex);
+		}
+	}
+
+	bool ok = (pi.commits >= target);
+	pthread_mutex_unlock(&piMutex);
+	return ok;
+}
+
+/* --- Input data ----------------------------------------------------------- */
+
+/*
+ * A receiver walking a row of trees at ~1 m/s, 1 Hz epochs, RTK fixed
+ * (common/wm_nmea.c), with a fixed seed so runs are comparable.
+ */
+
+static wmNmeaLog_t nmeaLog;
+static const char *nmeaPool;
+static size_t epochOffsets[NMEA_POOL_EPOCHS + 1];
+static char ggaPool[NMEA_POOL_EPOCHS][128];
+
+static const char nmeaDate[] = WM_NMEA_SYNTH_DATE;
+
+static bool nmeaPoolInit(void)
+{
+	if (!wmNmeaSynth(NMEA_POOL_EPOCHS, 1, &nmeaLog)) {
+		return false;
+	}
+
+	nmeaPool = nmeaLog.text;
+	for (size_t i = 0; i < NMEA_POOL_EPOCHS; i++) {
+		const wmNmeaEpoch_t *e = &nmeaLog.epochs[i];
+		epochOffsets[i] = e->offset;
+
+		/* Storage expects the sentence as captured: CRLF included. */
+		snprintf(ggaPool[i], sizeof(ggaPool[i]), "%.*s",
+		         (int)e->ggaLen, nmeaLog.text + e->offset + e->ggaOffset);
+	}
+	epochOffsets[NMEA_POOL_EPOCHS] = nmeaLog.textLen;
+	return true;
+}
+
+/* Fills the shears' head segment with rows cuts and seals it. */
+static bool shearsMakeSegment(int64_t rows)
+{
+	hostDeviceEnter(rig.shearsDev);
+
+	for (int64_t i = 0; i < rows; i++) {
+		if (!shearsGpsStorageAppendCut(ggaPool[i % NMEA_POOL_EPOCHS], nmeaDate)) {
+			return false;
+		}
+	}
+	return shearsGpsStorageSealHead();
+}
+
+/* Reads a whole firmware file ("/spiffs/...") of dev into a malloc'd buffer. */
+static uint8_t *readDeviceFile(int dev, const char *path, size_t *len)
+{
+	char mapped[BENCH_PATH_MAX];
+
+	hostDeviceEnter(dev);
+	FILE *f = fopen(hostVfsMapPath(path, mapped, sizeof(mapped)), "rb");
+	if (!f) {
+		return NULL;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	uint8_t *buf = (size > 0) ? malloc((size_t)size) : NULL;
+	if (buf && fread(buf, 1, (size_t)size, f) != (size_t)size) {
+		free(buf);
+		buf = NULL;
+	}
+	fclose(f);
+
+	*len = buf ? (size_t)size : 0;
+	return buf;
+}
+
+/*
+ * Publishes a file on dev the way log_transfer_client.c does: written under
+ * "<path>.part" and renamed, so the UART task never sees it half written.
+ */
+static bool publishDeviceFile(int dev, const char *path, const uint8_t *data, size_t len)
+{
+	char part[BENCH_PATH_MAX];
+	char mapped[BENCH_PATH_MAX];
+	char mappedPart[BENCH_PATH_MAX];
+
+	snprintf(part, sizeof(part), "%s.part", path);
+
+	hostDeviceEnter(dev);
+	hostVfsMapPath(path, mapped, sizeof(mapped));
+	hostVfsMapPath(part, mappedPart, sizeof(mappedPart));
+
+	FILE *f = fopen(mappedPart, "wb");
+	if (!f) {
+		return false;
+	}
+
+	bool ok = (fwrite(data, 1, len, f) == len);
+	ok = (fclose(f) == 0) && ok;
+
+	return ok && rename(mappedPart, mapped) == 0;
+}
+
+/* --- Benchmarks: parse ---------------------------------------------------- */
+
+static void bmParseNmea(benchState_t *st)
+{
+	size_t epoch = 0;
+	int64_t remaining = st->iterations;
+
+	hostDeviceEnter(rig.shearsDev);
+
+	while (remaining > 0) {
+		/* Contiguous epochs from the pool, up to one block. */
+		size_t first = epoch;
+		while (remaining > 0 && epoch < NMEA_POOL_EPOCHS &&
+		       epochOffsets[epoch + 1] - epochOffsets[first] <= PARSE_BLOCK_MAX) {
+			epoch++;
+			remaining--;
+		}
+
+		size_t len = epochOffsets[epoch] - epochOffsets[first];
+		const uint8_t *data = (const uint8_t *)nmeaPool + epochOffsets[first];
+
+		if (hostUartInject(rig.shearsDev, GPS_UART, data, len) != len ||
+		    !hostUartWaitRxDrained(rig.shearsDev, GPS_UART, 1000)) {
+			benchError(st, "GPS UART did not drain");
+			return;
+		}
+
+		if (epoch == NMEA_POOL_EPOCHS) {
+			epoch = 0;
+		}
+	}
+
+	st->bytes = (int64_t)epochOffsets[NMEA_POOL_EPOCHS] * st->iterations / NMEA_POOL_EPOCHS;
+}
+
+/* --- Benchmarks: store ---------------------------------------------------- */
+
+static void bmStoreGngga(benchState_t *st)
+{
+	static const char path[] = "/spiffs/bench_gngga.csv";
+
+	benchPause(st);
+	hostDeviceEnter(rig.shearsDev);
+	shearsGpsStorageClearCsv(path);
+	benchResume(st);
+
+	for (int64_t i = 0; i < st->iterations; i++) {
+		if (!shearsGpsStorageAppendGngga(path, ggaPool[i % NMEA_POOL_EPOCHS], nmeaDate)) {
+			benchError(st, "append failed");
+			return;
+		}
+	}
+
+	benchPause(st);
+
+	char mapped[BENCH_PATH_MAX];
+	remove(hostVfsMapPath(path, mapped, sizeof(mapped)));
+}
+
+static void bmStoreCut(benchState_t *st)
+{
+	hostDeviceEnter(rig.shearsDev);
+
+	for (int64_t i = 0; i < st->iterations; i++) {
+		if (!shearsGpsStorageAppendCut(ggaPool[i % NMEA_POOL_EPOCHS], nmeaDate)) {
+			benchError(st, "append failed");
+			return;
+		}
+	}
+
+	benchPause(st);
+	shearsGpsStorageClearAll();
+}
+
+/* --- Benchmarks: codec ---------------------------------------------------- */
+
+static void bmCompress(benchState_t *st)
+{
+	static const char src[] = "/spiffs/bench_codec.csv";
+	static const char dst[] = "/spiffs/bench_codec.csv.wz";
+	log_codec_stats_t stats = { 0 };
+
+	benchPause(st);
+	hostDeviceEnter(rig.shearsDev);
+	shearsGpsStorageClearCsv(src);
+	for (int64_t i = 0; i < st->arg; i++) {
+		shearsGpsStorageAppendGngga(src, ggaPool[i % NMEA_POOL_EPOCHS], nmeaDate);
+	}
+	benchResume(st);
+
+	for (int64_t i = 0; i < st->iterations; i++) {
+		if (!log_codec_compress_file(src, dst, &stats)) {
+			benchError(st, "compress failed");
+			return;
+		}
+	}
+
+	benchPause(st);
+	st->items = st->iterations * st->arg;
+	st->bytes = (int64_t)stats.encodedBytes * st->iterations;
+
+	char mapped[BENCH_PATH_MAX];
+	remove(hostVfsMapPath(src, mapped, sizeof(mapped)));
+	remove(hostVfsMapPath(dst, mapped, sizeof(mapped)));
+}
+
+/* --- Benchmarks: transfer ------------------------------------------------- */
+
+static void bmUartForward(benchState_t *st)
+{
+	static const char src[] = "/spiffs/bench_fwd.csv";
+	static const char enc[] = "/spiffs/bench_fwd.csv.wz";
+	static uint32_t nextSeq = 1;
+
+	size_t len = 0;
+	uint8_t *segment = NULL;
+
+	/* The base holds segments as the shears encoded them. */
+	benchPause(st);
+	hostDeviceEnter(rig.shearsDev);
+	shearsGpsStorageClearCsv(src);
+	for (int64_t i = 0; i < st->arg; i++) {
+		shearsGpsStorageAppendGngga(src, ggaPool[i % NMEA_POOL_EPOCHS], nmeaDate);
+	}
+	if (log_codec_compress_file(src, enc, NULL)) {
+		segment = readDeviceFile(rig.shearsDev, enc, &len);
+	}
+
+	char mapped[BENCH_PATH_MAX];
+	remove(hostVfsMapPath(src, mapped, sizeof(mapped)));
+	remove(hostVfsMapPath(enc, mapped, sizeof(mapped)));
+
+	if (!segment) {
+		benchError(st, "could not build segment");
+		return;
+	}
+
+	int64_t txStart = piTxBytes();
+
+	for (int64_t i = 0; i < st->iterations; i++) {
+		char path[48];
+
+		benchPause(st);
+		int64_t target = piCommits() + 1;
+		log_segment_format_path(path, sizeof(path), nextSeq++);
+		bool written = publishDeviceFile(rig.baseDev, path, segment, len);
+		benchResume(st);
+
+		if (!written) {
+			benchError(st, "could not write base segment");
+			break;
+		}
+
+		transferStart(TRANSFER_TRIGGER_EVENT);
+		if (!piWaitCommits(target)) {
+			benchError(st, "Pi never committed the segment");
+			break;
+		}
+	}
+
+	benchPause(st);
+	st->items = st->iterations * st->arg;
+	st->bytes = piTxBytes() - txStart;
+	free(segment);
+}
+
+static void bmBleToPi(benchState_t *st)
+{
+	int64_t notifyStart = rig.notifyBytes;
+
+	for (int64_t i = 0; i < st->iterations; i++) {
+		benchPause(st);
+		int64_t target = piCommits() + 1;
+		bool made = shearsMakeSegment(st->arg);
+		benchResume(st);
+
+		if (!made) {
+			benchError(st, "could not build shears segment");
+			return;
+		}
+
+		hostDeviceEnter(rig.baseDev);
+		if (log_transfer_client_request_segment_list() != ESP_OK) {
+			benchError(st, "LIST_SEGMENTS write failed");
+			return;
+		}
+
+		if (!piWaitCommits(target)) {
+			benchError(st, "segment never reached the Pi");
+			return;
+		}
+	}
+
+	benchPause(st);
+	st->items = st->iterations * st->arg;
+	st->bytes = rig.notifyBytes - notifyStart;
+}
+
+static const benchDef_t benchmarks[] = {
+	{ "parse/nmea_uart",    bmParseNmea,    -1, "nmea_B/rec" },
+	{ "store/append_gngga", bmStoreGngga,   -1, NULL },
+	{ "store/append_cut",   bmStoreCut,     -1, NULL },
+	{ "codec/compress",     bmCompress,      1, "enc_B/rec" },
+	{ "codec/compress",     bmCompress,    100, "enc_B/rec" },
+	{ "xfer/uart_forward",  bmUartForward,   1, "uart_B/rec" },
+	{ "xfer/uart_forward",  bmUartForward, 100, "uart_B/rec" },
+	{ "xfer/ble_to_pi",     bmBleToPi,       1, "ble_B/rec" },
+	{ "xfer/ble_to_pi",     bmBleToPi,     100, "ble_B/rec" },
+};
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [--filter=SUBSTR] [--min-time=SEC] [-v]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+	const char *filter = NULL;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--filter=", 9) == 0) {
+			filter = argv[i] + 9;
+		} else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+			minTimeSec = atof(argv[i] + 11);
+		} else if (strcmp(argv[i], "-v") == 0) {
+			verbose = true;
+		} else {
+			usage(argv[0]);
+			return 2;
+		}
+	}
+
+	/* Results keep the real stdout; firmware output goes to /dev/null unless -v. */
+	report = fdopen(dup(STDOUT_FILENO), "w");
+	if (!report) {
+		perror("dup");
+		return 1;
+	}
+	if (!verbose) {
+		hostLogSetLevel(ESP_LOG_WARN);
+		if (!freopen("/dev/null", "w", stdout)) {
+			perror("freopen");
+			return 1;
+		}
+	}
+
+	if (!nmeaPoolInit() || !wmRigOpen(&rig, BLE_MTU, piUartTx, NULL)) {
+		fprintf(stderr, "host setup failed\n");
+		return 1;
+	}
+
+	fprintf(report, "wm_bench: shears fs %s, base fs %s, min-time %.2fs\n",
+	        rig.shearsRoot, rig.baseRoot, minTimeSec);
+	fprintf(report, "%-28s %15s %15s %10s %16s\n",
+	        "Benchmark", "Time/rec", "CPU/rec", "Iterations", "Throughput");
+	fprintf(report, "----------------------------------------------------------------"
+	                "--------------------------------\n");
+
+	for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		if (filter && !strstr(benchmarks[i].name, filter)) {
+			continue;
+		}
+		benchRun(&benchmarks[i]);
+	}
+
+	wmRigClose(&rig);
+	wmNmeaFree(&nmeaLog);
+
+	fclose(report);
+	return 0;
+}
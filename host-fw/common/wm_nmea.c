@@ -0,0 +1,284 @@
+/*
+ * wm_nmea.c
+ *
+ * Recorded and synthetic NMEA logs for the host harnesses.
+ */
+
+#include "wm_nmea.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SYNTH_EPOCH_MAX  512
+
+/* --- Epoch splitting ------------------------------------------------------ */
+
+/* Returns the time field of RMC/GGA/GLL/ZDA, or NULL for untimed sentences. */
+static const char *timeField(const char *line, size_t len, size_t *fieldLen)
+{
+	static const char *const timed[] = { "RMC,", "GGA,", "GLL,", "ZDA," };
+
+	if (len < 7 || line[0] != '$') {
+		return NULL;
+	}
+
+	const char *field = NULL;
+	for (size_t i = 0; i < sizeof(timed) / sizeof(timed[0]); i++) {
+		if (memcmp(line + 3, timed[i], 4) == 0) {
+			field = line + 7;
+			break;
+		}
+	}
+
+	/* GLL carries the time as field 5. */
+	if (field && memcmp(line + 3, "GLL,", 4) == 0) {
+		for (int commas = 0; commas < 4 && field < line + len; field++) {
+			if (*field == ',') {
+				commas++;
+			}
+		}
+	}
+
+	if (!field) {
+		return NULL;
+	}
+
+	size_t n = 0;
+	while (field + n < line + len && field[n] != ',' && field[n] != '*') {
+		n++;
+	}
+	if (n < 6) {
+		return NULL;
+	}
+
+	*fieldLen = n;
+	return field;
+}
+
+static double secondsOfDay(const char *utc)
+{
+	int hh = (utc[0] - '0') * 10 + (utc[1] - '0');
+	int mm = (utc[2] - '0') * 10 + (utc[3] - '0');
+	return hh * 3600.0 + mm * 60.0 + atof(utc + 4);
+}
+
+static bool pushEpoch(wmNmeaLog_t *log, size_t *cap, size_t offset, const char *utc, size_t utcLen)
+{
+	if (log->count == *cap) {
+		size_t newCap = *cap ? *cap * 2 : 256;
+		wmNmeaEpoch_t *grown = realloc(log->epochs, newCap * sizeof(*grown));
+		if (!grown) {
+			return false;
+		}
+		log->epochs = grown;
+		*cap = newCap;
+	}
+
+	wmNmeaEpoch_t *e = &log->epochs[log->count++];
+	memset(e, 0, sizeof(*e));
+	e->offset = offset;
+	e->ggaOffset = SIZE_MAX;
+
+	if (utcLen >= sizeof(e->utcTime)) {
+		utcLen = sizeof(e->utcTime) - 1;
+	}
+	memcpy(e->utcTime, utc, utcLen);
+	return true;
+}
+
+/* Splits log->text into epochs and fills in t, lengths and GGA positions. */
+static bool splitEpochs(wmNmeaLog_t *log)
+{
+	size_t cap = 0;
+	size_t pos = 0;
+
+	log->count = 0;
+
+	while (pos < log->textLen) {
+		const char *line = log->text + pos;
+		const char *nl = memchr(line, '\n', log->textLen - pos);
+		size_t lineLen = nl ? (size_t)(nl - line) + 1 : log->textLen - pos;
+
+		size_t utcLen = 0;
+		const char *utc = timeField(line, lineLen, &utcLen);
+
+		bool newEpoch = (log->count == 0);
+		if (utc && log->count > 0) {
+			const char *cur = log->epochs[log->count - 1].utcTime;
+			newEpoch = cur[0] != '\0' &&
+			           (strlen(cur) != utcLen || memcmp(cur, utc, utcLen) != 0);
+		}
+
+		if (newEpoch) {
+			if (!pushEpoch(log, &cap, pos, utc ? utc : "", utc ? utcLen : 0)) {
+				return false;
+			}
+		} else if (utc && log->epochs[log->count - 1].utcTime[0] == '\0') {
+			/* Leading untimed lines: the first timed sentence names the epoch. */
+			char *name = log->epochs[log->count - 1].utcTime;
+			size_t n = utcLen < sizeof(log->epochs[0].utcTime) ? utcLen : sizeof(log->epochs[0].utcTime) - 1;
+			memcpy(name, utc, n);
+			name[n] = '\0';
+		}
+
+		wmNmeaEpoch_t *e = &log->epochs[log->count - 1];
+		if (e->ggaOffset == SIZE_MAX && lineLen > 7 && line[0] == '$' &&
+		    memcmp(line + 3, "GGA,", 4) == 0) {
+			e->ggaOffset = pos - e->offset;
+			e->ggaLen = lineLen;
+		}
+
+		pos += lineLen;
+	}
+
+	double first = 0.0;
+	double dayOffset = 0.0;
+	double prev = 0.0;
+
+	for (size_t i = 0; i < log->count; i++) {
+		wmNmeaEpoch_t *e = &log->epochs[i];
+		size_t end = (i + 1 < log->count) ? log->epochs[i + 1].offset : log->textLen;
+		e->len = end - e->offset;
+
+		if (e->utcTime[0] == '\0') {
+			e->t = (i > 0) ? log->epochs[i - 1].t : 0.0;
+			continue;
+		}
+
+		double s = secondsOfDay(e->utcTime);
+		if (i == 0) {
+			first = s;
+		} else if (s + dayOffset < prev - 43200.0) {
+			dayOffset += 86400.0;   /* Crossed UTC midnight */
+		}
+
+		prev = s + dayOffset;
+		e->t = prev - first;
+	}
+
+	return true;
+}
+
+/* --- Loading -------------------------------------------------------------- */
+
+bool wmNmeaLoad(const char *path, wmNmeaLog_t *log)
+{
+	memset(log, 0, sizeof(*log));
+
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if (size <= 0) {
+		fclose(f);
+		return false;
+	}
+
+	log->text = malloc((size_t)size);
+	if (!log->text || fread(log->text, 1, (size_t)size, f) != (size_t)size) {
+		fclose(f);
+		wmNmeaFree(log);
+		return false;
+	}
+	fclose(f);
+
+	log->textLen = (size_t)size;
+
+	if (!splitEpochs(log) || log->count == 0) {
+		wmNmeaFree(log);
+		return false;
+	}
+	return true;
+}
+
+/* --- Synthetic receiver --------------------------------------------------- */
+
+/* Deterministic noise in [-1, 1]. */
+static double jitter(uint32_t *seed)
+{
+	*seed = *seed * 1664525u + 1013904223u;
+	return (double)(*seed >> 8) / (double)(1u << 23) - 1.0;
+}
+
+static size_t sentence(char *out, size_t outLen, const char *body)
+{
+	uint8_t cs = 0;
+	for (const char *p = body; *p; p++) {
+		cs ^= (uint8_t)*p;
+	}
+
+	int n = snprintf(out, outLen, "$%s*%02X\r\n", body, cs);
+	return (n > 0 && (size_t)n < outLen) ? (size_t)n : 0;
+}
+
+static void degMinutes(char *out, size_t outLen, double deg, int degDigits)
+{
+	int whole = (int)deg;
+	double minutes = (deg - whole) * 60.0;
+	snprintf(out, outLen, "%0*d%010.7f", degDigits, whole, minutes);
+}
+
+static size_t synthEpoch(char *out, size_t outLen, uint32_t epoch, uint32_t *seed)
+{
+	char body[160];
+	char lat[24];
+	char lon[24];
+	char utc[16];
+	size_t n = 0;
+
+	uint32_t secs = 12 * 3600 + epoch;
+	snprintf(utc, sizeof(utc), "%02u%02u%02u.00",
+	         (secs / 3600) % 24, (secs / 60) % 60, secs % 60);
+
+	degMinutes(lat, sizeof(lat), 29.6436 + epoch * 0.000009 + jitter(seed) * 0.0000004, 2);
+	degMinutes(lon, sizeof(lon), 82.3549 + jitter(seed) * 0.0000004, 3);
+
+	snprintf(body, sizeof(body), "GNRMC,%s,A,%s,N,%s,W,0.02,,%s,,,R,V",
+	         utc, lat, lon, WM_NMEA_SYNTH_DATE);
+	n += sentence(out + n, outLen - n, body);
+
+	n += sentence(out + n, outLen - n,
+	              "GNGSA,A,3,02,05,13,15,18,20,23,24,29,,,,1.10,0.62,0.91,1");
+	n += sentence(out + n, outLen - n,
+	              "GPGSV,3,1,11,02,47,312,44,05,22,058,39,13,63,103,47,15,35,231,42,1");
+
+	snprintf(body, sizeof(body), "GNGGA,%s,%s,N,%s,W,4,12,0.62,%.3f,M,-29.512,M,1.0,0000",
+	         utc, lat, lon, 31.25 + jitter(seed) * 0.03);
+	n += sentence(out + n, outLen - n, body);
+
+	return n;
+}
+
+bool wmNmeaSynth(size_t count, uint32_t seed, wmNmeaLog_t *log)
+{
+	memset(log, 0, sizeof(*log));
+
+	log->text = malloc(count * SYNTH_EPOCH_MAX);
+	if (!log->text) {
+		return false;
+	}
+
+	uint32_t state = seed ? seed : 1;
+	for (size_t i = 0; i < count; i++) {
+		log->textLen += synthEpoch(log->text + log->textLen, SYNTH_EPOCH_MAX, (uint32_t)i, &state);
+	}
+
+	if (!splitEpochs(log) || log->count != count) {
+		wmNmeaFree(log);
+		return false;
+	}
+	return true;
+}
+
+void wmNmeaFree(wmNmeaLog_t *log)
+{
+	free(log->text);
+	free(log->epochs);
+	memset(log, 0, sizeof(*log));
+}
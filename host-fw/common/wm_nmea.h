@@ -0,0 +1,45 @@
+/*
+ * wm_nmea.h
+ *
+ * NMEA input for the host harnesses: a recorded receiver log, or synthetic
+ * ZED-F9P output, split into epochs (all sentences of one fix time).
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	size_t offset;          /* Start of the epoch in wmNmeaLog_t.text */
+	size_t len;
+	size_t ggaOffset;       /* GGA sentence within the epoch, SIZE_MAX if none */
+	size_t ggaLen;          /* Including the line ending */
+	double t;               /* Seconds since the first epoch */
+	char utcTime[16];       /* Time field exactly as sent, e.g. "123519.00" */
+} wmNmeaEpoch_t;
+
+typedef struct {
+	char *text;
+	size_t textLen;
+	wmNmeaEpoch_t *epochs;
+	size_t count;
+} wmNmeaLog_t;
+
+/* The date field used by the synthetic log (RMC ddmmyy). */
+#define WM_NMEA_SYNTH_DATE  "161026"
+
+/*
+ * Loads a recorded log (one sentence per line, as the receiver sent it).
+ * Lines without a time field join the epoch of the last timed sentence.
+ */
+bool wmNmeaLoad(const char *path, wmNmeaLog_t *log);
+
+/*
+ * Generates count 1 Hz epochs (RMC, GSA, GSV, GGA) of a receiver walking a
+ * tree row at ~1 m/s with RTK fixed and a few cm of seeded noise.
+ */
+bool wmNmeaSynth(size_t count, uint32_t seed, wmNmeaLog_t *log);
+
+void wmNmeaFree(wmNmeaLog_t *log);
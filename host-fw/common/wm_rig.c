@@ -0,0 +1,113 @@
+/*
+ * wm_rig.c
+ *
+ * Shears + base wiring shared by wm_bench and wm_sim.
+ */
+
+#include "wm_rig.h"
+
+#include <string.h>
+
+#include "gps_logger.h"
+#include "shears_gpsButtons.h"
+#include "log_transfer_server.h"
+#include "log_transfer_client.h"
+#include "base_uartFileTransfer.h"
+
+#define LOG_CTRL_CHR_UUID  0xFFF1
+#define LOG_DATA_CHR_UUID  0xFFF2
+#define LOG_DIAG_CHR_UUID  0xFFF3
+
+static void onLinkNotify(uint16_t attrHandle, const uint8_t *data, uint16_t len, void *ctx)
+{
+	wmRig_t *rig = ctx;
+
+	rig->notifyBytes += len;
+
+	if (attrHandle == rig->ctrlHandle) {
+		log_transfer_client_on_ctrl_notify(data, len);
+	} else if (attrHandle == rig->dataHandle) {
+		log_transfer_client_on_data_notify(data, len);
+	}
+}
+
+static bool openShears(wmRig_t *rig)
+{
+	if (!hostMakeTempDir("wm-shears", rig->shearsRoot, sizeof(rig->shearsRoot))) {
+		return false;
+	}
+
+	rig->shearsDev = hostDeviceCreate("shears", rig->shearsRoot);
+	if (rig->shearsDev < 0) {
+		return false;
+	}
+	hostDeviceEnter(rig->shearsDev);
+
+	/* Primed, so the receiver is awake and NMEA is parsed. */
+	hostGpioSetLevel(rig->shearsDev, SHEARS_PRIME_BUTTON_PIN, 0);
+	hostGpioSetLevel(rig->shearsDev, SHEARS_CUT2_BUTTON_PIN, 1);
+	hostGpioSetLevel(rig->shearsDev, SHEARS_CUT3_BUTTON_PIN, 1);
+
+	gpsLoggerInit();
+	log_transfer_server_init();
+	log_transfer_server_setConnection(WM_RIG_CONN_HANDLE);
+	return true;
+}
+
+static bool openBase(wmRig_t *rig, uint16_t mtu, hostUartTxHook_t piTx, void *piCtx)
+{
+	if (!hostMakeTempDir("wm-base", rig->baseRoot, sizeof(rig->baseRoot))) {
+		return false;
+	}
+
+	rig->baseDev = hostDeviceCreate("base", rig->baseRoot);
+	if (rig->baseDev < 0) {
+		return false;
+	}
+	hostDeviceEnter(rig->baseDev);
+
+	uartFileTransferInit();
+	hostUartSetTxHook(rig->baseDev, WM_RIG_PI_UART, piTx, piCtx);
+
+	rig->ctrlHandle = hostBleFindChr(rig->shearsDev, LOG_CTRL_CHR_UUID);
+	rig->dataHandle = hostBleFindChr(rig->shearsDev, LOG_DATA_CHR_UUID);
+	if (rig->ctrlHandle == 0 || rig->dataHandle == 0) {
+		return false;
+	}
+
+	log_transfer_client_cfg_t cfg = {
+		.connHandle = WM_RIG_CONN_HANDLE,
+		.ctrlChrHandle = rig->ctrlHandle,
+		.dataChrHandle = rig->dataHandle,
+		.diagChrHandle = hostBleFindChr(rig->shearsDev, LOG_DIAG_CHR_UUID)
+	};
+	log_transfer_client_init(&cfg);
+
+	/* What base_ble would read from the connection descriptor. */
+	static const uint8_t shearsAddr[6] = WM_RIG_SHEARS_ADDR;
+	log_transfer_client_set_shears_addr(shearsAddr);
+
+	return hostBleLinkOpen(rig->shearsDev, rig->baseDev, WM_RIG_CONN_HANDLE, mtu,
+	                       onLinkNotify, rig);
+}
+
+bool wmRigOpen(wmRig_t *rig, uint16_t mtu, hostUartTxHook_t piTx, void *piCtx)
+{
+	memset(rig, 0, sizeof(*rig));
+	rig->shearsDev = -1;
+	rig->baseDev = -1;
+
+	return openShears(rig) && openBase(rig, mtu, piTx, piCtx);
+}
+
+void wmRigClose(wmRig_t *rig)
+{
+	hostBleLinkClose();
+
+	if (rig->shearsRoot[0]) {
+		hostRemoveTempDir(rig->shearsRoot);
+	}
+	if (rig->baseRoot[0]) {
+		hostRemoveTempDir(rig->baseRoot);
+	}
+}
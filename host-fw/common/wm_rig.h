@@ -0,0 +1,45 @@
+/*
+ * wm_rig.h
+ *
+ * A shears and a base in one process, connected the way they are in the
+ * field: the shears' log-transfer GATT server and the base's client over an
+ * in-process BLE link, and the base's Pi UART TX on a caller-supplied hook.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "wm_host.h"
+#include "driver/uart.h"
+
+#define WM_RIG_CONN_HANDLE   1
+#define WM_RIG_GPS_UART      UART_NUM_2
+#define WM_RIG_PI_UART       UART_NUM_2
+#define WM_RIG_PATH_MAX      512
+#define WM_RIG_SHEARS_ADDR   { 0x01, 0x00, 0x00, 0x5E, 0x1E, 0xC0 }
+
+typedef struct {
+	int shearsDev;
+	int baseDev;
+	char shearsRoot[WM_RIG_PATH_MAX];
+	char baseRoot[WM_RIG_PATH_MAX];
+
+	uint16_t ctrlHandle;
+	uint16_t dataHandle;
+
+	/* Bytes the shears notified over the link (ctrl + data, ATT payload only). */
+	volatile int64_t notifyBytes;
+} wmRig_t;
+
+/*
+ * Creates both devices with fresh temp filesystems, primes the shears (the
+ * cut buttons idle high), starts the transfer server and client and opens
+ * the link with the given ATT MTU. piTx receives everything the base sends
+ * to the Pi.
+ */
+bool wmRigOpen(wmRig_t *rig, uint16_t mtu, hostUartTxHook_t piTx, void *piCtx);
+
+/* Closes the link and removes both temp filesystems. */
+void wmRigClose(wmRig_t *rig);
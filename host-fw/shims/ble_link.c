@@ -0,0 +1,380 @@
+/*
+ * ble_link.c
+ *
+ * In-process BLE connection between two devices. The server's notify hook
+ * and the client's write hook enqueue PDUs; one link thread delivers them
+ * in order, so firmware callbacks never re-enter each other on the same
+ * stack and the client sees every notification on a single thread.
+ *
+ * An optional link model (hostBleLinkSetModel) drops PDUs and delays
+ * delivery. Delays never reorder PDUs: each one is delivered no earlier
+ * than the one queued before it, as on a real connection.
+ *
+ * Client reads are the exception: they are answered straight away on the
+ * calling thread and bypass the queue and the link model.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "host/ble_hs.h"
+#include "wm_host.h"
+#include "wm_host_internal.h"
+
+#define LINK_QUEUE_MAX  64     /* PDUs in flight before notify reports ENOMEM */
+
+typedef enum {
+	PDU_NOTIFY,
+	PDU_WRITE
+} pduKind_t;
+
+typedef struct linkPdu {
+	pduKind_t kind;
+	uint16_t attrHandle;
+	uint16_t len;
+	int64_t deliverAtUs;
+	struct linkPdu *next;
+	uint8_t data[];
+} linkPdu_t;
+
+static struct {
+	bool open;
+	int serverDev;
+	int clientDev;
+	uint16_t connHandle;
+	hostBleLinkRx_t onNotify;
+	void *ctx;
+
+	linkPdu_t *head;
+	linkPdu_t *tail;
+	int queued;
+	bool delivering;
+
+	hostBleLinkModel_t model;
+	uint32_t rng;
+	hostBleLinkStats_t stats;
+} link;
+
+static pthread_mutex_t linkMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t linkCond;
+static pthread_once_t linkOnce = PTHREAD_ONCE_INIT;
+
+/* --- Link model ----------------------------------------------------------- */
+
+/* xorshift32; state is never 0. */
+static uint32_t nextRandom(void)
+{
+	uint32_t x = link.rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	link.rng = x;
+	return x;
+}
+
+/* Uniform in [0, 1). */
+static double nextUnit(void)
+{
+	return (double)(nextRandom() >> 8) / (double)(1u << 24);
+}
+
+static bool modelDrops(void)
+{
+	return link.model.lossRate > 0.0 && nextUnit() < link.model.lossRate;
+}
+
+static int64_t modelDeliverAt(void)
+{
+	int64_t delayUs = link.model.latencyUs;
+
+	if (link.model.jitterUs > 0) {
+		delayUs += (int64_t)(nextRandom() % (link.model.jitterUs + 1));
+	}
+
+	int64_t at = esp_timer_get_time() + delayUs;
+
+	/* Keep connection order: never overtake the PDU queued before. */
+	if (link.tail && link.tail->deliverAtUs > at) {
+		at = link.tail->deliverAtUs;
+	}
+	return at;
+}
+
+static void deadlineFromUs(int64_t atUs, struct timespec *deadline)
+{
+	int64_t waitUs = atUs - esp_timer_get_time();
+
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	if (waitUs <= 0) {
+		return;
+	}
+
+	deadline->tv_sec += (time_t)(waitUs / 1000000);
+	deadline->tv_nsec += (long)(waitUs % 1000000) * 1000;
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+}
+
+/* --- Queue ---------------------------------------------------------------- */
+
+static int enqueue(pduKind_t kind, uint16_t attrHandle, const uint8_t *data, uint16_t len)
+{
+	pthread_mutex_lock(&linkMutex);
+
+	if (!link.open) {
+		pthread_mutex_unlock(&linkMutex);
+		return BLE_HS_ENOTCONN;
+	}
+
+	if (link.queued >= LINK_QUEUE_MAX) {
+		link.stats.rejected++;
+		pthread_mutex_unlock(&linkMutex);
+		return BLE_HS_ENOMEM;
+	}
+
+	/* Lost on air: the sender cannot tell, just like a missed notification. */
+	if (modelDrops()) {
+		link.stats.dropped++;
+		pthread_mutex_unlock(&linkMutex);
+		return 0;
+	}
+
+	linkPdu_t *pdu = malloc(sizeof(*pdu) + len);
+	if (!pdu) {
+		pthread_mutex_unlock(&linkMutex);
+		return BLE_HS_ENOMEM;
+	}
+
+	pdu->kind = kind;
+	pdu->attrHandle = attrHandle;
+	pdu->len = len;
+	pdu->deliverAtUs = modelDeliverAt();
+	pdu->next = NULL;
+	memcpy(pdu->data, data, len);
+
+	if (link.tail) {
+		link.tail->next = pdu;
+	} else {
+		link.head = pdu;
+	}
+	link.tail = pdu;
+	link.queued++;
+
+	pthread_cond_broadcast(&linkCond);
+	pthread_mutex_unlock(&linkMutex);
+	return 0;
+}
+
+static void flushLocked(void)
+{
+	while (link.head) {
+		linkPdu_t *pdu = link.head;
+		link.head = pdu->next;
+		free(pdu);
+	}
+	link.tail = NULL;
+	link.queued = 0;
+}
+
+static void *linkThread(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&linkMutex);
+
+	while (1) {
+		if (!link.head) {
+			pthread_cond_wait(&linkCond, &linkMutex);
+			continue;
+		}
+
+		if (link.head->deliverAtUs > esp_timer_get_time()) {
+			struct timespec deadline;
+			deadlineFromUs(link.head->deliverAtUs, &deadline);
+			hostCondWaitTicks(&linkCond, &linkMutex, &deadline);
+			continue;
+		}
+
+		linkPdu_t *pdu = link.head;
+		link.head = pdu->next;
+		if (!link.head) {
+			link.tail = NULL;
+		}
+		link.queued--;
+		link.delivering = true;
+
+		if (pdu->kind == PDU_NOTIFY) {
+			link.stats.notifies++;
+			link.stats.notifyBytes += pdu->len;
+		} else {
+			link.stats.writes++;
+			link.stats.writeBytes += pdu->len;
+		}
+
+		int serverDev = link.serverDev;
+		int clientDev = link.clientDev;
+		uint16_t connHandle = link.connHandle;
+		hostBleLinkRx_t onNotify = link.onNotify;
+		void *ctx = link.ctx;
+
+		pthread_mutex_unlock(&linkMutex);
+
+		if (pdu->kind == PDU_NOTIFY) {
+			if (onNotify) {
+				hostDeviceEnter(clientDev);
+				onNotify(pdu->attrHandle, pdu->data, pdu->len, ctx);
+			}
+		} else {
+			hostBleDeliverWrite(serverDev, connHandle, pdu->attrHandle, pdu->data, pdu->len);
+		}
+		free(pdu);
+
+		pthread_mutex_lock(&linkMutex);
+		link.delivering = false;
+		pthread_cond_broadcast(&linkCond);
+	}
+
+	return NULL;
+}
+
+static void linkStart(void)
+{
+	pthread_t thread;
+
+	hostCondInit(&linkCond);
+	pthread_create(&thread, NULL, linkThread, NULL);
+	pthread_setname_np(thread, "ble_link");
+	pthread_detach(thread);
+}
+
+/* --- Hooks ---------------------------------------------------------------- */
+
+static int serverNotifyHook(int dev, uint16_t connHandle, uint16_t attrHandle,
+                            const uint8_t *data, uint16_t len, void *ctx)
+{
+	(void)dev;
+	(void)connHandle;
+	(void)ctx;
+
+	return enqueue(PDU_NOTIFY, attrHandle, data, len);
+}
+
+static int clientWriteHook(int dev, uint16_t connHandle, uint16_t attrHandle,
+                           const uint8_t *data, uint16_t len, void *ctx)
+{
+	(void)dev;
+	(void)connHandle;
+	(void)ctx;
+
+	return enqueue(PDU_WRITE, attrHandle, data, len);
+}
+
+static int clientReadHook(int dev, uint16_t connHandle, uint16_t attrHandle,
+                          uint8_t *out, uint16_t outCap, void *ctx)
+{
+	(void)dev;
+	(void)ctx;
+
+	pthread_mutex_lock(&linkMutex);
+	bool open = link.open;
+	int serverDev = link.serverDev;
+	pthread_mutex_unlock(&linkMutex);
+
+	if (!open) {
+		return -1;
+	}
+	return hostBleDeliverRead(serverDev, connHandle, attrHandle, out, outCap);
+}
+
+/* --- Harness API ---------------------------------------------------------- */
+
+void hostBleLinkSetModel(const hostBleLinkModel_t *model)
+{
+	pthread_mutex_lock(&linkMutex);
+
+	memset(&link.model, 0, sizeof(link.model));
+	if (model) {
+		link.model = *model;
+	}
+	link.rng = (link.model.seed != 0) ? link.model.seed : 1;
+
+	pthread_mutex_unlock(&linkMutex);
+}
+
+void hostBleLinkGetStats(hostBleLinkStats_t *out)
+{
+	pthread_mutex_lock(&linkMutex);
+	*out = link.stats;
+	pthread_mutex_unlock(&linkMutex);
+}
+
+bool hostBleLinkOpen(int serverDev, int clientDev, uint16_t connHandle, uint16_t mtu,
+                     hostBleLinkRx_t onNotify, void *ctx)
+{
+	pthread_once(&linkOnce, linkStart);
+
+	pthread_mutex_lock(&linkMutex);
+
+	if (link.open) {
+		pthread_mutex_unlock(&linkMutex);
+		return false;
+	}
+
+	link.open = true;
+	link.serverDev = serverDev;
+	link.clientDev = clientDev;
+	link.connHandle = connHandle;
+	link.onNotify = onNotify;
+	link.ctx = ctx;
+
+	pthread_mutex_unlock(&linkMutex);
+
+	hostBleSetMtu(serverDev, mtu);
+	hostBleSetMtu(clientDev, mtu);
+	hostBleSetNotifyHook(serverDev, serverNotifyHook, NULL);
+	hostBleSetWriteHook(clientDev, clientWriteHook, NULL);
+	hostBleSetReadHook(clientDev, clientReadHook, NULL);
+	return true;
+}
+
+void hostBleLinkClose(void)
+{
+	pthread_mutex_lock(&linkMutex);
+	int serverDev = link.serverDev;
+	int clientDev = link.clientDev;
+	bool wasOpen = link.open;
+
+	link.open = false;
+	flushLocked();
+	pthread_mutex_unlock(&linkMutex);
+
+	if (wasOpen) {
+		hostBleSetNotifyHook(serverDev, NULL, NULL);
+		hostBleSetWriteHook(clientDev, NULL, NULL);
+		hostBleSetReadHook(clientDev, NULL, NULL);
+	}
+}
+
+bool hostBleLinkWaitIdle(uint32_t timeoutMs)
+{
+	pthread_once(&linkOnce, linkStart);
+
+	struct timespec deadline;
+	hostDeadlineFromTicks(pdMS_TO_TICKS(timeoutMs), &deadline);
+
+	pthread_mutex_lock(&linkMutex);
+
+	bool idle = true;
+	while (link.head || link.delivering) {
+		if (!hostCondWaitTicks(&linkCond, &linkMutex, &deadline)) {
+			idle = !link.head && !link.delivering;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&linkMutex);
+	return idle;
+}
@@ -0,0 +1,426 @@
+/*
+ * ble_shim.c
+ *
+ * NimBLE GATT surface without a controller. Services registered with
+ * ble_gatts_add_svcs() get sequential attribute handles per device;
+ * notifications, client writes and client reads are handed to the harness
+ * hooks, which decide how (and whether) they reach the peer.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host/ble_hs.h"
+#include "host/ble_att.h"
+#include "wm_host.h"
+
+#define BLE_MAX_CHRS       16
+#define BLE_DEFAULT_MTU    23
+#define BLE_READ_CAP       512
+
+typedef struct {
+	uint16_t uuid16;
+	uint16_t valHandle;
+	ble_gatt_access_fn *accessCb;
+	void *arg;
+} bleChr_t;
+
+typedef struct {
+	bleChr_t chrs[BLE_MAX_CHRS];
+	int chrCount;
+	uint16_t nextHandle;
+	uint16_t mtu;
+
+	hostBleNotifyHook_t notifyHook;
+	void *notifyCtx;
+	hostBleWriteHook_t writeHook;
+	void *writeCtx;
+	hostBleReadHook_t readHook;
+	void *readCtx;
+} bleDevice_t;
+
+static bleDevice_t bleDevices[HOST_MAX_DEVICES];
+static pthread_mutex_t bleMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bleDevice_t *bleFor(int dev)
+{
+	if (dev < 0 || dev >= HOST_MAX_DEVICES) {
+		return NULL;
+	}
+	return &bleDevices[dev];
+}
+
+static const bleChr_t *findByHandle(const bleDevice_t *d, uint16_t handle)
+{
+	for (int i = 0; i < d->chrCount; i++) {
+		if (d->chrs[i].valHandle == handle) {
+			return &d->chrs[i];
+		}
+	}
+	return NULL;
+}
+
+static uint16_t uuid16Of(const ble_uuid_t *uuid)
+{
+	if (!uuid || uuid->type != BLE_UUID_TYPE_16) {
+		return 0;
+	}
+	return ((const ble_uuid16_t *)uuid)->value;
+}
+
+/* --- mbufs ---------------------------------------------------------------- */
+
+static struct os_mbuf *mbufAlloc(uint16_t cap)
+{
+	struct os_mbuf *om = malloc(sizeof(*om) + cap);
+	if (om) {
+		om->om_len = 0;
+		om->om_cap = cap;
+	}
+	return om;
+}
+
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len)
+{
+	struct os_mbuf *om = mbufAlloc(len);
+	if (om && len > 0) {
+		memcpy(om->om_data, buf, len);
+		om->om_len = len;
+	}
+	return om;
+}
+
+int os_mbuf_copydata(const struct os_mbuf *om, int off, int len, void *dst)
+{
+	if (!om || off < 0 || len < 0 || off + len > om->om_len) {
+		return -1;
+	}
+	memcpy(dst, om->om_data + off, (size_t)len);
+	return 0;
+}
+
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len)
+{
+	if (!om || om->om_len + len > om->om_cap) {
+		return BLE_HS_ENOMEM;
+	}
+	memcpy(om->om_data + om->om_len, data, len);
+	om->om_len += len;
+	return 0;
+}
+
+void os_mbuf_free_chain(struct os_mbuf *om)
+{
+	free(om);
+}
+
+/* --- GATT server ---------------------------------------------------------- */
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs)
+{
+	return defs ? 0 : BLE_HS_EINVAL;
+}
+
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *defs)
+{
+	bleDevice_t *d = bleFor(hostDeviceCurrent());
+	if (!d || !defs) {
+		return BLE_HS_EINVAL;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+
+	if (d->nextHandle == 0) {
+		d->nextHandle = 1;
+	}
+
+	for (const struct ble_gatt_svc_def *svc = defs; svc->type != BLE_GATT_SVC_TYPE_END; svc++) {
+		d->nextHandle++;    /* service declaration */
+
+		for (const struct ble_gatt_chr_def *chr = svc->characteristics;
+		     chr && chr->uuid; chr++) {
+			if (d->chrCount >= BLE_MAX_CHRS) {
+				pthread_mutex_unlock(&bleMutex);
+				return BLE_HS_ENOMEM;
+			}
+
+			d->nextHandle++;    /* characteristic declaration */
+
+			bleChr_t *c = &d->chrs[d->chrCount++];
+			c->uuid16 = uuid16Of(chr->uuid);
+			c->valHandle = d->nextHandle++;
+			c->accessCb = chr->access_cb;
+			c->arg = chr->arg;
+
+			if (chr->val_handle) {
+				*chr->val_handle = c->valHandle;
+			}
+
+			if (chr->flags & (BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE)) {
+				d->nextHandle++;    /* CCCD */
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&bleMutex);
+	return 0;
+}
+
+int ble_gatts_notify_custom(uint16_t conn_handle, uint16_t attr_handle, struct os_mbuf *om)
+{
+	int dev = hostDeviceCurrent();
+	bleDevice_t *d = bleFor(dev);
+	if (!d || !om) {
+		os_mbuf_free_chain(om);
+		return BLE_HS_EINVAL;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	hostBleNotifyHook_t hook = d->notifyHook;
+	void *ctx = d->notifyCtx;
+	pthread_mutex_unlock(&bleMutex);
+
+	int rc = hook ? hook(dev, conn_handle, attr_handle, om->om_data, om->om_len, ctx)
+	              : BLE_HS_ENOTCONN;
+
+	/* NimBLE consumes the mbuf whether or not the notify succeeded. */
+	os_mbuf_free_chain(om);
+	return rc;
+}
+
+uint16_t ble_att_mtu(uint16_t conn_handle)
+{
+	(void)conn_handle;
+
+	bleDevice_t *d = bleFor(hostDeviceCurrent());
+	if (!d) {
+		return BLE_DEFAULT_MTU;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	uint16_t mtu = d->mtu ? d->mtu : BLE_DEFAULT_MTU;
+	pthread_mutex_unlock(&bleMutex);
+	return mtu;
+}
+
+/* --- GATT client ---------------------------------------------------------- */
+
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle,
+                         const void *data, uint16_t data_len,
+                         ble_gatt_attr_fn *cb, void *cb_arg)
+{
+	int dev = hostDeviceCurrent();
+	bleDevice_t *d = bleFor(dev);
+	if (!d) {
+		return BLE_HS_EINVAL;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	hostBleWriteHook_t hook = d->writeHook;
+	void *ctx = d->writeCtx;
+	pthread_mutex_unlock(&bleMutex);
+
+	int rc = hook ? hook(dev, conn_handle, attr_handle, (const uint8_t *)data, data_len, ctx)
+	              : BLE_HS_ENOTCONN;
+
+	if (cb) {
+		struct ble_gatt_error err = {
+			.status = (uint16_t)rc,
+			.att_handle = attr_handle
+		};
+		cb(conn_handle, &err, NULL, cb_arg);
+	}
+	return rc;
+}
+
+int ble_gattc_read_long(uint16_t conn_handle, uint16_t handle, uint16_t offset,
+                        ble_gatt_attr_fn *cb, void *cb_arg)
+{
+	int dev = hostDeviceCurrent();
+	bleDevice_t *d = bleFor(dev);
+	if (!d || !cb) {
+		return BLE_HS_EINVAL;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	hostBleReadHook_t hook = d->readHook;
+	void *ctx = d->readCtx;
+	pthread_mutex_unlock(&bleMutex);
+
+	if (!hook) {
+		return BLE_HS_ENOTCONN;
+	}
+
+	struct os_mbuf *om = mbufAlloc(BLE_READ_CAP);
+	if (!om) {
+		return BLE_HS_ENOMEM;
+	}
+
+	int len = hook(dev, conn_handle, handle, om->om_data, om->om_cap, ctx);
+	struct ble_gatt_error err = {
+		.status = 0,
+		.att_handle = handle
+	};
+
+	if (len < 0) {
+		err.status = BLE_ATT_ERR_UNLIKELY;
+		cb(conn_handle, &err, NULL, cb_arg);
+	} else {
+		/* Hand over everything past offset as a single fragment. */
+		if (offset < len) {
+			om->om_len = (uint16_t)(len - offset);
+			memmove(om->om_data, om->om_data + offset, om->om_len);
+
+			struct ble_gatt_attr attr = {
+				.handle = handle,
+				.offset = offset,
+				.om = om
+			};
+			cb(conn_handle, &err, &attr, cb_arg);
+		}
+
+		err.status = BLE_HS_EDONE;
+		cb(conn_handle, &err, NULL, cb_arg);
+	}
+
+	os_mbuf_free_chain(om);
+	return 0;
+}
+
+/* --- Harness API ---------------------------------------------------------- */
+
+void hostBleSetNotifyHook(int dev, hostBleNotifyHook_t hook, void *ctx)
+{
+	bleDevice_t *d = bleFor(dev);
+	if (!d) {
+		return;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	d->notifyHook = hook;
+	d->notifyCtx = ctx;
+	pthread_mutex_unlock(&bleMutex);
+}
+
+void hostBleSetWriteHook(int dev, hostBleWriteHook_t hook, void *ctx)
+{
+	bleDevice_t *d = bleFor(dev);
+	if (!d) {
+		return;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	d->writeHook = hook;
+	d->writeCtx = ctx;
+	pthread_mutex_unlock(&bleMutex);
+}
+
+void hostBleSetReadHook(int dev, hostBleReadHook_t hook, void *ctx)
+{
+	bleDevice_t *d = bleFor(dev);
+	if (!d) {
+		return;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	d->readHook = hook;
+	d->readCtx = ctx;
+	pthread_mutex_unlock(&bleMutex);
+}
+
+void hostBleSetMtu(int dev, uint16_t mtu)
+{
+	bleDevice_t *d = bleFor(dev);
+	if (!d) {
+		return;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	d->mtu = mtu;
+	pthread_mutex_unlock(&bleMutex);
+}
+
+uint16_t hostBleFindChr(int dev, uint16_t uuid16)
+{
+	bleDevice_t *d = bleFor(dev);
+	uint16_t handle = 0;
+
+	if (!d) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	for (int i = 0; i < d->chrCount; i++) {
+		if (d->chrs[i].uuid16 == uuid16) {
+			handle = d->chrs[i].valHandle;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&bleMutex);
+	return handle;
+}
+
+static int deliverAccess(int dev, uint16_t connHandle, uint16_t attrHandle,
+                         uint8_t op, struct os_mbuf *om)
+{
+	bleDevice_t *d = bleFor(dev);
+	if (!d) {
+		return BLE_HS_EINVAL;
+	}
+
+	pthread_mutex_lock(&bleMutex);
+	const bleChr_t *c = findByHandle(d, attrHandle);
+	ble_gatt_access_fn *accessCb = c ? c->accessCb : NULL;
+	void *arg = c ? c->arg : NULL;
+	pthread_mutex_unlock(&bleMutex);
+
+	if (!accessCb) {
+		return BLE_HS_EINVAL;
+	}
+
+	struct ble_gatt_access_ctxt ctxt = {
+		.op = op,
+		.om = om
+	};
+
+	int saved = hostDeviceCurrent();
+	hostDeviceEnter(dev);
+	int rc = accessCb(connHandle, attrHandle, &ctxt, arg);
+	hostDeviceEnter(saved);
+
+	return rc;
+}
+
+int hostBleDeliverWrite(int dev, uint16_t connHandle, uint16_t attrHandle,
+                        const uint8_t *data, uint16_t len)
+{
+	struct os_mbuf *om = ble_hs_mbuf_from_flat(data, len);
+	if (!om) {
+		return BLE_HS_ENOMEM;
+	}
+
+	int rc = deliverAccess(dev, connHandle, attrHandle, BLE_GATT_ACCESS_OP_WRITE_CHR, om);
+	os_mbuf_free_chain(om);
+	return rc;
+}
+
+int hostBleDeliverRead(int dev, uint16_t connHandle, uint16_t attrHandle,
+                       uint8_t *out, uint16_t outCap)
+{
+	struct os_mbuf *om = mbufAlloc(BLE_READ_CAP);
+	if (!om) {
+		return -1;
+	}
+
+	int rc = deliverAccess(dev, connHandle, attrHandle, BLE_GATT_ACCESS_OP_READ_CHR, om);
+	int len = -1;
+
+	if (rc == 0) {
+		len = (om->om_len < outCap) ? om->om_len : outCap;
+		memcpy(out, om->om_data, (size_t)len);
+	}
+
+	os_mbuf_free_chain(om);
+	return len;
+}
@@ -0,0 +1,253 @@
+/*
+ * esp_timer_shim.c
+ *
+ * esp_timer on one dispatcher thread. Armed timers sit in a list sorted by
+ * deadline; callbacks run without the lock held, in the context of the
+ * device that created the timer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "wm_host.h"
+#include "wm_host_internal.h"
+
+struct hostTimer {
+	esp_timer_cb_t callback;
+	void *arg;
+	const char *name;
+	int device;
+
+	bool armed;
+	int64_t deadlineUs;
+	uint64_t periodUs;
+	struct hostTimer *next;
+};
+
+static pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timerCond;
+static pthread_once_t timerOnce = PTHREAD_ONCE_INIT;
+static struct hostTimer *armedList = NULL;
+
+static struct timespec startTime;
+static pthread_once_t clockOnce = PTHREAD_ONCE_INIT;
+
+/* --- Clock ---------------------------------------------------------------- */
+
+static void clockInit(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+}
+
+int64_t esp_timer_get_time(void)
+{
+	struct timespec now;
+
+	pthread_once(&clockOnce, clockInit);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (int64_t)(now.tv_sec - startTime.tv_sec) * 1000000 +
+	       (now.tv_nsec - startTime.tv_nsec) / 1000;
+}
+
+static void usToTimespec(int64_t us, struct timespec *ts)
+{
+	pthread_once(&clockOnce, clockInit);
+
+	int64_t ns = (int64_t)startTime.tv_nsec + (us % 1000000) * 1000;
+	ts->tv_sec = startTime.tv_sec + (time_t)(us / 1000000) + (time_t)(ns / 1000000000);
+	ts->tv_nsec = (long)(ns % 1000000000);
+}
+
+/* --- Armed list (timerMutex held) ----------------------------------------- */
+
+static void unlinkLocked(struct hostTimer *t)
+{
+	struct hostTimer **pp = &armedList;
+
+	while (*pp) {
+		if (*pp == t) {
+			*pp = t->next;
+			break;
+		}
+		pp = &(*pp)->next;
+	}
+	t->next = NULL;
+	t->armed = false;
+}
+
+static void insertLocked(struct hostTimer *t)
+{
+	struct hostTimer **pp = &armedList;
+
+	while (*pp && (*pp)->deadlineUs <= t->deadlineUs) {
+		pp = &(*pp)->next;
+	}
+	t->next = *pp;
+	*pp = t;
+	t->armed = true;
+
+	pthread_cond_signal(&timerCond);
+}
+
+/* --- Dispatcher ----------------------------------------------------------- */
+
+static void *dispatcherThread(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&timerMutex);
+
+	while (1) {
+		if (!armedList) {
+			pthread_cond_wait(&timerCond, &timerMutex);
+			continue;
+		}
+
+		struct hostTimer *t = armedList;
+		int64_t nowUs = esp_timer_get_time();
+
+		if (t->deadlineUs > nowUs) {
+			struct timespec deadline;
+			usToTimespec(t->deadlineUs, &deadline);
+			pthread_cond_timedwait(&timerCond, &timerMutex, &deadline);
+			continue;
+		}
+
+		unlinkLocked(t);
+		if (t->periodUs > 0) {
+			t->deadlineUs += (int64_t)t->periodUs;
+			if (t->deadlineUs < nowUs) {
+				t->deadlineUs = nowUs + (int64_t)t->periodUs;
+			}
+			insertLocked(t);
+		}
+
+		esp_timer_cb_t cb = t->callback;
+		void *cbArg = t->arg;
+		int device = t->device;
+
+		pthread_mutex_unlock(&timerMutex);
+
+		hostDeviceEnter(device);
+		cb(cbArg);
+
+		pthread_mutex_lock(&timerMutex);
+	}
+
+	return NULL;
+}
+
+static void dispatcherStart(void)
+{
+	pthread_t thread;
+
+	hostCondInit(&timerCond);
+	pthread_create(&thread, NULL, dispatcherThread, NULL);
+	pthread_setname_np(thread, "esp_timer");
+	pthread_detach(thread);
+}
+
+/* --- Public API ----------------------------------------------------------- */
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+	if (!args || !args->callback || !out) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_once(&timerOnce, dispatcherStart);
+
+	struct hostTimer *t = calloc(1, sizeof(*t));
+	if (!t) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	t->callback = args->callback;
+	t->arg = args->arg;
+	t->name = args->name;
+	t->device = hostDeviceCurrent();
+
+	*out = t;
+	return ESP_OK;
+}
+
+static esp_err_t timerStart(esp_timer_handle_t t, uint64_t timeoutUs, uint64_t periodUs)
+{
+	if (!t) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&timerMutex);
+
+	if (t->armed) {
+		pthread_mutex_unlock(&timerMutex);
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	t->deadlineUs = esp_timer_get_time() + (int64_t)timeoutUs;
+	t->periodUs = periodUs;
+	insertLocked(t);
+
+	pthread_mutex_unlock(&timerMutex);
+	return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeoutUs)
+{
+	return timerStart(t, timeoutUs, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t periodUs)
+{
+	return timerStart(t, periodUs, periodUs);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+	if (!t) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&timerMutex);
+
+	esp_err_t rc = t->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+	if (t->armed) {
+		unlinkLocked(t);
+	}
+
+	pthread_mutex_unlock(&timerMutex);
+	return rc;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t)
+{
+	if (!t) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&timerMutex);
+	bool armed = t->armed;
+	pthread_mutex_unlock(&timerMutex);
+
+	if (armed) {
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	free(t);
+	return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t t)
+{
+	if (!t) {
+		return false;
+	}
+
+	pthread_mutex_lock(&timerMutex);
+	bool armed = t->armed;
+	pthread_mutex_unlock(&timerMutex);
+
+	return armed;
+}
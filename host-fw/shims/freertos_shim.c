@@ -0,0 +1,544 @@
+/*
+ * freertos_shim.c
+ *
+ * FreeRTOS tasks, notifications, queues and semaphores on POSIX threads.
+ *
+ * Priorities and stack sizes are accepted and ignored: the host scheduler
+ * decides. Code that only works because of strict priority preemption will
+ * show it here, which is part of the point.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_timer.h"
+#include "wm_host.h"
+#include "wm_host_internal.h"
+
+struct hostTask {
+	pthread_t thread;
+	TaskFunction_t fn;
+	void *arg;
+	int device;
+	char name[16];
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint32_t notifyValue;
+	bool notifyPending;
+};
+
+struct hostQueue {
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty;
+	pthread_cond_t notFull;
+	uint8_t *storage;
+	UBaseType_t length;
+	UBaseType_t itemSize;
+	UBaseType_t head;
+	UBaseType_t count;
+};
+
+static __thread struct hostTask *currentTask = NULL;
+
+/* --- Time helpers --------------------------------------------------------- */
+
+void hostCondInit(pthread_cond_t *cond)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+bool hostDeadlineFromTicks(TickType_t ticks, struct timespec *deadline)
+{
+	if (ticks == portMAX_DELAY) {
+		return false;
+	}
+
+	uint64_t ns = (uint64_t)ticks * (1000000000ull / configTICK_RATE_HZ);
+
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += (time_t)(ns / 1000000000ull);
+	deadline->tv_nsec += (long)(ns % 1000000000ull);
+	if (deadline->tv_nsec >= 1000000000L) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000L;
+	}
+	return true;
+}
+
+bool hostCondWaitTicks(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                       const struct timespec *deadline)
+{
+	if (!deadline) {
+		pthread_cond_wait(cond, mutex);
+		return true;
+	}
+	return pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
+
+void hostSleepUs(int64_t us)
+{
+	if (us <= 0) {
+		return;
+	}
+
+	struct timespec ts = {
+		.tv_sec  = (time_t)(us / 1000000),
+		.tv_nsec = (long)((us % 1000000) * 1000)
+	};
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+	}
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+/* --- Tasks ---------------------------------------------------------------- */
+
+static void *taskTrampoline(void *param)
+{
+	struct hostTask *task = (struct hostTask *)param;
+
+	currentTask = task;
+	hostDeviceEnter(task->device);
+
+	task->fn(task->arg);
+
+	/* A FreeRTOS task must never return; treat it like vTaskDelete(NULL). */
+	return NULL;
+}
+
+static struct hostTask *taskAlloc(const char *name)
+{
+	struct hostTask *task = calloc(1, sizeof(*task));
+	if (!task) {
+		return NULL;
+	}
+
+	snprintf(task->name, sizeof(task->name), "%s", name ? name : "task");
+	task->device = hostDeviceCurrent();
+	pthread_mutex_init(&task->mutex, NULL);
+	hostCondInit(&task->cond);
+	return task;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+	(void)stackDepth;
+	(void)priority;
+
+	struct hostTask *task = taskAlloc(name);
+	if (!task) {
+		return pdFAIL;
+	}
+
+	task->fn = fn;
+	task->arg = arg;
+
+	/* Publish the handle before the task runs, as FreeRTOS does. */
+	if (handle) {
+		*handle = task;
+	}
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	int rc = pthread_create(&task->thread, &attr, taskTrampoline, task);
+	pthread_attr_destroy(&attr);
+
+	if (rc != 0) {
+		if (handle) {
+			*handle = NULL;
+		}
+		free(task);
+		return pdFAIL;
+	}
+
+	pthread_setname_np(task->thread, task->name);
+	return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core)
+{
+	(void)core;
+	return xTaskCreate(fn, name, stackDepth, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+	if (task == NULL || task == currentTask) {
+		pthread_exit(NULL);
+	}
+
+	/* Deleting another task is not used by the firmware; cancel it. */
+	pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+	hostSleepUs((int64_t)ticks * (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	if (!currentTask) {
+		/* Harness threads get a handle lazily so they can be notified too. */
+		currentTask = taskAlloc("host");
+		if (currentTask) {
+			currentTask->thread = pthread_self();
+		}
+	}
+	return currentTask;
+}
+
+void hostTaskYield(void)
+{
+	sched_yield();
+}
+
+/* --- Notifications -------------------------------------------------------- */
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              uint32_t *previous)
+{
+	if (!task) {
+		return pdFAIL;
+	}
+
+	BaseType_t rc = pdPASS;
+
+	pthread_mutex_lock(&task->mutex);
+
+	if (previous) {
+		*previous = task->notifyValue;
+	}
+
+	switch (action) {
+	case eSetBits:
+		task->notifyValue |= value;
+		break;
+	case eIncrement:
+		task->notifyValue++;
+		break;
+	case eSetValueWithOverwrite:
+		task->notifyValue = value;
+		break;
+	case eSetValueWithoutOverwrite:
+		if (task->notifyPending) {
+			rc = pdFAIL;
+		} else {
+			task->notifyValue = value;
+		}
+		break;
+	case eNoAction:
+	default:
+		break;
+	}
+
+	task->notifyPending = true;
+	pthread_cond_signal(&task->cond);
+	pthread_mutex_unlock(&task->mutex);
+
+	return rc;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken) {
+		*higherPriorityTaskWoken = pdFALSE;
+	}
+	return xTaskGenericNotify(task, value, action, NULL);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken) {
+		*higherPriorityTaskWoken = pdFALSE;
+	}
+	xTaskGenericNotify(task, 0, eIncrement, NULL);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit,
+                           uint32_t *value, TickType_t ticks)
+{
+	struct hostTask *task = xTaskGetCurrentTaskHandle();
+	struct timespec deadline;
+	bool timed = hostDeadlineFromTicks(ticks, &deadline);
+	BaseType_t rc = pdTRUE;
+
+	pthread_mutex_lock(&task->mutex);
+
+	if (!task->notifyPending) {
+		task->notifyValue &= ~clearOnEntry;
+	}
+
+	while (!task->notifyPending) {
+		if (ticks == 0 ||
+		    !hostCondWaitTicks(&task->cond, &task->mutex, timed ? &deadline : NULL)) {
+			if (!task->notifyPending) {
+				rc = pdFALSE;
+				break;
+			}
+		}
+	}
+
+	if (value) {
+		*value = task->notifyValue;
+	}
+	if (rc == pdTRUE) {
+		task->notifyValue &= ~clearOnExit;
+		task->notifyPending = false;
+	}
+
+	pthread_mutex_unlock(&task->mutex);
+	return rc;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+	struct hostTask *task = xTaskGetCurrentTaskHandle();
+	struct timespec deadline;
+	bool timed = hostDeadlineFromTicks(ticks, &deadline);
+
+	pthread_mutex_lock(&task->mutex);
+
+	while (task->notifyValue == 0) {
+		if (ticks == 0 ||
+		    !hostCondWaitTicks(&task->cond, &task->mutex, timed ? &deadline : NULL)) {
+			if (task->notifyValue == 0) {
+				break;
+			}
+		}
+	}
+
+	uint32_t value = task->notifyValue;
+	if (value != 0) {
+		task->notifyValue = clearOnExit ? 0 : value - 1;
+	}
+	task->notifyPending = false;
+
+	pthread_mutex_unlock(&task->mutex);
+	return value;
+}
+
+/* --- Queues --------------------------------------------------------------- */
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+	if (length == 0) {
+		return NULL;
+	}
+
+	struct hostQueue *q = calloc(1, sizeof(*q));
+	if (!q) {
+		return NULL;
+	}
+
+	if (itemSize > 0) {
+		q->storage = calloc(length, itemSize);
+		if (!q->storage) {
+			free(q);
+			return NULL;
+		}
+	}
+
+	q->length = length;
+	q->itemSize = itemSize;
+	pthread_mutex_init(&q->mutex, NULL);
+	hostCondInit(&q->notEmpty);
+	hostCondInit(&q->notFull);
+	return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+	if (!q) {
+		return;
+	}
+	pthread_mutex_destroy(&q->mutex);
+	pthread_cond_destroy(&q->notEmpty);
+	pthread_cond_destroy(&q->notFull);
+	free(q->storage);
+	free(q);
+}
+
+static BaseType_t queuePut(QueueHandle_t q, const void *item, TickType_t ticks, bool front)
+{
+	if (!q) {
+		return errQUEUE_FULL;
+	}
+
+	struct timespec deadline;
+	bool timed = hostDeadlineFromTicks(ticks, &deadline);
+
+	pthread_mutex_lock(&q->mutex);
+
+	while (q->count == q->length) {
+		if (ticks == 0 ||
+		    !hostCondWaitTicks(&q->notFull, &q->mutex, timed ? &deadline : NULL)) {
+			if (q->count == q->length) {
+				pthread_mutex_unlock(&q->mutex);
+				return errQUEUE_FULL;
+			}
+		}
+	}
+
+	UBaseType_t slot;
+	if (front) {
+		q->head = (q->head + q->length - 1) % q->length;
+		slot = q->head;
+	} else {
+		slot = (q->head + q->count) % q->length;
+	}
+
+	if (q->itemSize > 0 && item) {
+		memcpy(q->storage + (size_t)slot * q->itemSize, item, q->itemSize);
+	}
+	q->count++;
+
+	pthread_cond_signal(&q->notEmpty);
+	pthread_mutex_unlock(&q->mutex);
+	return pdPASS;
+}
+
+static BaseType_t queueGet(QueueHandle_t q, void *item, TickType_t ticks, bool remove)
+{
+	if (!q) {
+		return pdFALSE;
+	}
+
+	struct timespec deadline;
+	bool timed = hostDeadlineFromTicks(ticks, &deadline);
+
+	pthread_mutex_lock(&q->mutex);
+
+	while (q->count == 0) {
+		if (ticks == 0 ||
+		    !hostCondWaitTicks(&q->notEmpty, &q->mutex, timed ? &deadline : NULL)) {
+			if (q->count == 0) {
+				pthread_mutex_unlock(&q->mutex);
+				return pdFALSE;
+			}
+		}
+	}
+
+	if (q->itemSize > 0 && item) {
+		memcpy(item, q->storage + (size_t)q->head * q->itemSize, q->itemSize);
+	}
+
+	if (remove) {
+		q->head = (q->head + 1) % q->length;
+		q->count--;
+		pthread_cond_signal(&q->notFull);
+	}
+
+	pthread_mutex_unlock(&q->mutex);
+	return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+	return queuePut(q, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+	return queuePut(q, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+	return queueGet(q, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks)
+{
+	return queueGet(q, item, ticks, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t q)
+{
+	if (!q) {
+		return pdFAIL;
+	}
+
+	pthread_mutex_lock(&q->mutex);
+	q->head = 0;
+	q->count = 0;
+	pthread_cond_broadcast(&q->notFull);
+	pthread_mutex_unlock(&q->mutex);
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+	if (!q) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&q->mutex);
+	UBaseType_t n = q->count;
+	pthread_mutex_unlock(&q->mutex);
+	return n;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void *item,
+                             BaseType_t *higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken) {
+		*higherPriorityTaskWoken = pdFALSE;
+	}
+	return queuePut(q, item, 0, false);
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t q, void *item,
+                                BaseType_t *higherPriorityTaskWoken)
+{
+	if (higherPriorityTaskWoken) {
+		*higherPriorityTaskWoken = pdFALSE;
+	}
+	return queueGet(q, item, 0, true);
+}
+
+/* --- Semaphores ----------------------------------------------------------- */
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	QueueHandle_t q = xQueueCreate(1, 0);
+	if (q) {
+		xQueueSend(q, NULL, 0);
+	}
+	return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+	QueueHandle_t q = xQueueCreate(maxCount, 0);
+	for (UBaseType_t i = 0; q && i < initialCount; i++) {
+		xQueueSend(q, NULL, 0);
+	}
+	return q;
+}
@@ -0,0 +1,240 @@
+/*
+ * gpio_shim.c
+ *
+ * driver/gpio on per-device level tables. hostGpioSetLevel() plays the
+ * role of the pin interrupt: it updates the level and runs the handler on
+ * the calling thread, under the device it belongs to.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "wm_host.h"
+
+typedef struct {
+	int level;
+	bool driven;            /* set by hostGpioSetLevel() or gpio_set_level() */
+	gpio_mode_t mode;
+	gpio_int_type_t intrType;
+	gpio_isr_t handler;
+	void *handlerArg;
+} gpioPin_t;
+
+static gpioPin_t pins[HOST_MAX_DEVICES][HOST_MAX_GPIOS];
+static pthread_mutex_t gpioMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static gpioPin_t *pinFor(int dev, int pin)
+{
+	if (dev < 0 || dev >= HOST_MAX_DEVICES || pin < 0 || pin >= HOST_MAX_GPIOS) {
+		return NULL;
+	}
+	return &pins[dev][pin];
+}
+
+/* --- Driver API ----------------------------------------------------------- */
+
+esp_err_t gpio_config(const gpio_config_t *cfg)
+{
+	if (!cfg) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	int dev = hostDeviceCurrent();
+
+	pthread_mutex_lock(&gpioMutex);
+	for (int pin = 0; pin < HOST_MAX_GPIOS; pin++) {
+		if (!(cfg->pin_bit_mask & (1ULL << pin))) {
+			continue;
+		}
+
+		gpioPin_t *p = pinFor(dev, pin);
+		p->mode = cfg->mode;
+		p->intrType = cfg->intr_type;
+
+		/* An undriven input idles at its pull level. */
+		if (!p->driven) {
+			p->level = cfg->pull_up_en ? 1 : 0;
+		}
+	}
+	pthread_mutex_unlock(&gpioMutex);
+
+	return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t pin)
+{
+	gpioPin_t *p = pinFor(hostDeviceCurrent(), pin);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&gpioMutex);
+	memset(p, 0, sizeof(*p));
+	pthread_mutex_unlock(&gpioMutex);
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t pin, gpio_mode_t mode)
+{
+	gpioPin_t *p = pinFor(hostDeviceCurrent(), pin);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&gpioMutex);
+	p->mode = mode;
+	pthread_mutex_unlock(&gpioMutex);
+	return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level)
+{
+	gpioPin_t *p = pinFor(hostDeviceCurrent(), pin);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&gpioMutex);
+	p->level = level ? 1 : 0;
+	p->driven = true;
+	pthread_mutex_unlock(&gpioMutex);
+	return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin)
+{
+	return hostGpioGetLevel(hostDeviceCurrent(), pin);
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+	(void)flags;
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg)
+{
+	gpioPin_t *p = pinFor(hostDeviceCurrent(), pin);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&gpioMutex);
+	p->handler = handler;
+	p->handlerArg = arg;
+	pthread_mutex_unlock(&gpioMutex);
+	return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin)
+{
+	return gpio_isr_handler_add(pin, NULL, NULL);
+}
+
+/* There is no sleep on the host; like the driver, this sets the interrupt type. */
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t intr_type)
+{
+	gpioPin_t *p = pinFor(hostDeviceCurrent(), pin);
+	if (!p || (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&gpioMutex);
+	p->intrType = intr_type;
+	pthread_mutex_unlock(&gpioMutex);
+	return ESP_OK;
+}
+
+/* --- Harness API ---------------------------------------------------------- */
+
+void hostGpioSetLevel(int dev, int pin, int level)
+{
+	gpioPin_t *p = pinFor(dev, pin);
+	if (!p) {
+		return;
+	}
+
+	level = level ? 1 : 0;
+
+	pthread_mutex_lock(&gpioMutex);
+
+	int old = p->level;
+	p->level = level;
+	p->driven = true;
+
+	bool fire = false;
+	if (p->handler && old != level) {
+		switch (p->intrType) {
+		case GPIO_INTR_ANYEDGE:    fire = true;        break;
+		case GPIO_INTR_POSEDGE:    fire = (level == 1); break;
+		case GPIO_INTR_NEGEDGE:    fire = (level == 0); break;
+		case GPIO_INTR_LOW_LEVEL:  fire = (level == 0); break;
+		case GPIO_INTR_HIGH_LEVEL: fire = (level == 1); break;
+		default:                   break;
+		}
+	}
+
+	gpio_isr_t handler = p->handler;
+	void *arg = p->handlerArg;
+
+	pthread_mutex_unlock(&gpioMutex);
+
+	if (fire) {
+		int saved = hostDeviceCurrent();
+		hostDeviceEnter(dev);
+		handler(arg);
+		hostDeviceEnter(saved);
+	}
+}
+
+int hostGpioGetLevel(int dev, int pin)
+{
+	gpioPin_t *p = pinFor(dev, pin);
+	if (!p) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&gpioMutex);
+	int level = p->level;
+	pthread_mutex_unlock(&gpioMutex);
+	return level;
+}
+
+/* --- LEDC (accepted, no output) ------------------------------------------- */
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *cfg)
+{
+	(void)cfg;
+	return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *cfg)
+{
+	(void)cfg;
+	return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+	(void)mode;
+	(void)channel;
+	(void)duty;
+	return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+	(void)mode;
+	(void)channel;
+	return ESP_OK;
+}
+
+esp_err_t ledc_stop(ledc_mode_t mode, ledc_channel_t channel, uint32_t idleLevel)
+{
+	(void)mode;
+	(void)channel;
+	(void)idleLevel;
+	return ESP_OK;
+}
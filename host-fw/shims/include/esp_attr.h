@@ -0,0 +1,9 @@
+/* esp_attr.h (host shim): placement attributes have no meaning on the host. */
+
+#pragma once
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_ATTR
@@ -0,0 +1,30 @@
+/*
+ * esp_cpu.h (host shim)
+ *
+ * A 32-bit "cycle counter" derived from CLOCK_MONOTONIC at the target's
+ * default CPU frequency, so trace timestamps convert back to real time the
+ * same way as on the ESP32. Every thread reports core 0.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include "sdkconfig.h"
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+static inline esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+	return (esp_cpu_cycle_count_t)(ns * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / 1000);
+}
+
+static inline int esp_cpu_get_core_id(void)
+{
+	return 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * esp_log.h (host shim)
+ *
+ * Same macros as ESP-IDF; output goes to stdout prefixed with the device
+ * name. Anything above hostLogSetLevel() is dropped before formatting.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+typedef enum {
+	ESP_LOG_NONE = 0,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern int hostLogLevel;
+
+void hostLogWrite(esp_log_level_t level, const char *tag, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ...) do {                \
+		if ((int)(level) <= hostLogLevel) {                    \
+			hostLogWrite((level), (tag), fmt, ##__VA_ARGS__); \
+		}                                                      \
+	} while (0)
+
+#define ESP_LOGE(tag, fmt, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR,   tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN,    tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO,    tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG,   tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...)  ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+void esp_log_level_set(const char *tag, esp_log_level_t level);
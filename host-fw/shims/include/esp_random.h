@@ -0,0 +1,7 @@
+/* esp_random.h (host shim): draws from /dev/urandom instead of the RF noise source. */
+
+#pragma once
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
@@ -0,0 +1,51 @@
+/*
+ * FreeRTOS.h (host shim)
+ *
+ * The subset of the FreeRTOS/ESP-IDF port API the firmware uses, backed by
+ * POSIX threads. One tick is one millisecond. "ISR" variants are plain
+ * calls from whatever thread simulates the interrupt.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+#include "sdkconfig.h"
+
+typedef int32_t  BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE          ((BaseType_t)1)
+#define pdFALSE         ((BaseType_t)0)
+#define pdPASS          pdTRUE
+#define pdFAIL          pdFALSE
+#define errQUEUE_FULL   ((BaseType_t)0)
+
+#define portMAX_DELAY   ((TickType_t)0xFFFFFFFFu)
+#define portNUM_PROCESSORS  1
+#define configTICK_RATE_HZ  CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS  ((TickType_t)(1000 / configTICK_RATE_HZ))
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+/* Critical sections: a recursive mutex per portMUX (same core may nest). */
+typedef struct {
+	pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED  { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+#define portENTER_CRITICAL(mux)       pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)        pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux)   portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)    portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux)  portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)   portEXIT_CRITICAL(mux)
+
+#define portYIELD_FROM_ISR(...)       do { } while (0)
+
+TickType_t xTaskGetTickCount(void);
@@ -0,0 +1,31 @@
+/*
+ * queue.h (host shim)
+ *
+ * Fixed-size item ring guarded by a mutex and two condition variables.
+ * Semaphores are queues with zero-sized items, as in FreeRTOS.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct hostQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+                             BaseType_t *higherPriorityTaskWoken);
+BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void *item,
+                                BaseType_t *higherPriorityTaskWoken);
+
+#define xQueueSendToBack(queue, item, ticks)  xQueueSend((queue), (item), (ticks))
+#define xQueueOverwrite(queue, item) \
+	(xQueueReset(queue), xQueueSend((queue), (item), 0))
@@ -0,0 +1,22 @@
+/*
+ * semphr.h (host shim)
+ *
+ * Semaphores built on the queue shim: a "give" posts an empty item, a
+ * "take" removes one. A mutex starts with its single token available.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+
+#define xSemaphoreTake(sem, ticks)  xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem)         xQueueSend((sem), NULL, 0)
+#define xSemaphoreGiveFromISR(sem, woken)  xQueueSendFromISR((sem), NULL, (woken))
+#define vSemaphoreDelete(sem)       vQueueDelete(sem)
@@ -0,0 +1,51 @@
+/*
+ * task.h (host shim)
+ *
+ * Tasks are detached pthreads; notifications are a 32-bit value plus a
+ * pending flag guarded by a per-task condition variable.
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct hostTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+	eNoAction = 0,
+	eSetBits,
+	eIncrement,
+	eSetValueWithOverwrite,
+	eSetValueWithoutOverwrite
+} eNotifyAction;
+
+#define tskIDLE_PRIORITY  0
+#define tskNO_AFFINITY    0x7FFFFFFF
+
+#define taskYIELD()       hostTaskYield()
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void hostTaskYield(void);
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              uint32_t *previous);
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit,
+                           uint32_t *value, TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+#define xTaskNotify(task, value, action) \
+	xTaskGenericNotify((task), (value), (action), NULL)
+#define xTaskNotifyGive(task) \
+	xTaskGenericNotify((task), 0, eIncrement, NULL)
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higherPriorityTaskWoken);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
@@ -0,0 +1,7 @@
+/* ble_att.h (host shim): the MTU comes from hostBleSetMtu(). */
+
+#pragma once
+
+#include <stdint.h>
+
+uint16_t ble_att_mtu(uint16_t conn_handle);
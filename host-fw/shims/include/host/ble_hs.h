@@ -0,0 +1,141 @@
+/*
+ * ble_hs.h (host shim)
+ *
+ * The slice of the NimBLE host API used by the log transfer server and
+ * client: GATT service registration, notify, flat writes, long reads and
+ * mbufs. There is no controller: notifications, writes and reads are
+ * handed to the hooks set with hostBleSetNotifyHook() /
+ * hostBleSetWriteHook() / hostBleSetReadHook().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "wm_host.h"
+
+#define BLE_HS_CONN_HANDLE_NONE   0xFFFF
+#define BLE_HS_FOREVER            INT32_MAX
+
+#define BLE_HS_EAGAIN             1
+#define BLE_HS_ENOMEM             6
+#define BLE_HS_ENOTCONN           7
+#define BLE_HS_EDONE              14
+#define BLE_HS_EINVAL             3
+
+/* --- mbufs (flat, single-chunk) ------------------------------------------- */
+
+struct os_mbuf {
+	uint16_t om_len;
+	uint16_t om_cap;
+	uint8_t  om_data[];
+};
+
+#define OS_MBUF_PKTLEN(om)  ((om)->om_len)
+
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len);
+int os_mbuf_copydata(const struct os_mbuf *om, int off, int len, void *dst);
+void os_mbuf_free_chain(struct os_mbuf *om);
+
+/* --- UUIDs ---------------------------------------------------------------- */
+
+enum {
+	BLE_UUID_TYPE_16 = 16,
+	BLE_UUID_TYPE_32 = 32,
+	BLE_UUID_TYPE_128 = 128
+};
+
+typedef struct {
+	uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+	ble_uuid_t u;
+	uint16_t value;
+} ble_uuid16_t;
+
+#define BLE_UUID16_INIT(uuid16)  { .u = { .type = BLE_UUID_TYPE_16 }, .value = (uuid16) }
+#define BLE_UUID16_DECLARE(uuid16) \
+	((ble_uuid_t *)(&(ble_uuid16_t)BLE_UUID16_INIT(uuid16)))
+
+/* --- GATT server ---------------------------------------------------------- */
+
+#define BLE_GATT_SVC_TYPE_END        0
+#define BLE_GATT_SVC_TYPE_PRIMARY    1
+#define BLE_GATT_SVC_TYPE_SECONDARY  2
+
+#define BLE_GATT_CHR_F_READ          0x0002
+#define BLE_GATT_CHR_F_WRITE_NO_RSP  0x0004
+#define BLE_GATT_CHR_F_WRITE         0x0008
+#define BLE_GATT_CHR_F_NOTIFY        0x0010
+#define BLE_GATT_CHR_F_INDICATE      0x0020
+
+#define BLE_GATT_ACCESS_OP_READ_CHR   0
+#define BLE_GATT_ACCESS_OP_WRITE_CHR  1
+#define BLE_GATT_ACCESS_OP_READ_DSC   2
+#define BLE_GATT_ACCESS_OP_WRITE_DSC  3
+
+#define BLE_ATT_ERR_INSUFFICIENT_RES  0x11
+#define BLE_ATT_ERR_UNLIKELY          0x0E
+
+struct ble_gatt_access_ctxt {
+	uint8_t op;
+	struct os_mbuf *om;
+};
+
+typedef int ble_gatt_access_fn(uint16_t conn_handle, uint16_t attr_handle,
+                               struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+struct ble_gatt_chr_def {
+	const ble_uuid_t *uuid;
+	ble_gatt_access_fn *access_cb;
+	void *arg;
+	void *descriptors;
+	uint16_t flags;
+	uint8_t min_key_size;
+	uint16_t *val_handle;
+};
+
+struct ble_gatt_svc_def {
+	uint8_t type;
+	const ble_uuid_t *uuid;
+	const struct ble_gatt_svc_def **includes;
+	const struct ble_gatt_chr_def *characteristics;
+};
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs);
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *defs);
+int ble_gatts_notify_custom(uint16_t conn_handle, uint16_t attr_handle, struct os_mbuf *om);
+
+/* For reads: append the value to the response mbuf. */
+int os_mbuf_append(struct os_mbuf *om, const void *data, uint16_t len);
+
+/* --- GATT client ---------------------------------------------------------- */
+
+struct ble_gatt_error {
+	uint16_t status;
+	uint16_t att_handle;
+};
+
+struct ble_gatt_attr {
+	uint16_t handle;
+	uint16_t offset;
+	struct os_mbuf *om;
+};
+
+typedef int ble_gatt_attr_fn(uint16_t conn_handle, const struct ble_gatt_error *error,
+                             struct ble_gatt_attr *attr, void *arg);
+
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle,
+                         const void *data, uint16_t data_len,
+                         ble_gatt_attr_fn *cb, void *cb_arg);
+
+/*
+ * The callback gets the whole value in one fragment (status 0), then a
+ * final call with status BLE_HS_EDONE, or a single call with the error.
+ */
+int ble_gattc_read_long(uint16_t conn_handle, uint16_t handle, uint16_t offset,
+                        ble_gatt_attr_fn *cb, void *cb_arg);
+
+#include "host/ble_att.h"
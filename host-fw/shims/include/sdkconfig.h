@@ -0,0 +1,18 @@
+/*
+ * sdkconfig.h (host shim)
+ *
+ * Host build configuration. Power management is off: there is nothing to
+ * put to sleep, and shears_power.c then only keeps its wakeup counters.
+ * The hot-path trace follows the WM_TRACE CMake option.
+ */
+
+#pragma once
+
+#define CONFIG_FREERTOS_HZ                1000
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ   240
+#define CONFIG_LOG_DEFAULT_LEVEL          3
+
+#ifndef CONFIG_WM_TRACE
+#define CONFIG_WM_TRACE                   1
+#endif
+#define CONFIG_WM_TRACE_EVENTS            4096
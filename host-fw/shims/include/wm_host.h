@@ -0,0 +1,167 @@
+/*
+ * wm_host.h
+ *
+ * Control surface of the host shims (FreeRTOS, esp_timer, UART, GPIO,
+ * SPIFFS, NimBLE GATT) used to run the firmware logic on a workstation.
+ *
+ * Several firmware images can live in one process: each is a "device" with
+ * its own filesystem root, UART ports, GPIO levels and GATT table. Every
+ * thread runs on behalf of one device; tasks and timers inherit the device
+ * of the thread that created them. Harness code selects a device with
+ * hostDeviceEnter() before calling into that device's firmware.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOST_MAX_DEVICES   4
+#define HOST_MAX_UARTS     3
+#define HOST_MAX_GPIOS     40
+
+/* --- Devices -------------------------------------------------------------- */
+
+/*
+ * Creates a device whose "/spiffs" paths map to fsRoot (created if needed).
+ * Returns the device id, or -1 when HOST_MAX_DEVICES are in use.
+ */
+int hostDeviceCreate(const char *name, const char *fsRoot);
+
+/* Runs the calling thread on behalf of dev. */
+void hostDeviceEnter(int dev);
+
+/* Device of the calling thread (0 if never set). */
+int hostDeviceCurrent(void);
+
+const char *hostDeviceName(int dev);
+const char *hostDeviceFsRoot(int dev);
+
+/* Creates a fresh directory under $TMPDIR (or /tmp). Returns false on error. */
+bool hostMakeTempDir(const char *prefix, char *out, size_t outLen);
+
+/* Removes every regular file in dir and the directory itself. */
+void hostRemoveTempDir(const char *dir);
+
+/* Maps a firmware path ("/spiffs/...") onto the current device's root. */
+const char *hostVfsMapPath(const char *path, char *out, size_t outLen);
+
+/* --- Logging -------------------------------------------------------------- */
+
+/* Maximum ESP_LOGx level printed (ESP_LOG_NONE..ESP_LOG_VERBOSE). */
+void hostLogSetLevel(int level);
+
+/* --- UART ----------------------------------------------------------------- */
+
+/* Called with every byte block the firmware writes to a port. */
+typedef void (*hostUartTxHook_t)(int dev, int port, const uint8_t *data, size_t len, void *ctx);
+
+void hostUartSetTxHook(int dev, int port, hostUartTxHook_t hook, void *ctx);
+
+/*
+ * Delivers bytes to a port's RX side as if they arrived on the wire.
+ * Dropped while the RX interrupt is disabled. Returns bytes accepted.
+ */
+size_t hostUartInject(int dev, int port, const uint8_t *data, size_t len);
+
+/* Waits until the firmware has read everything injected so far. */
+bool hostUartWaitRxDrained(int dev, int port, uint32_t timeoutMs);
+
+/* --- GPIO ----------------------------------------------------------------- */
+
+/* Drives an input pin; runs the pin's ISR handler if the edge matches. */
+void hostGpioSetLevel(int dev, int pin, int level);
+
+int hostGpioGetLevel(int dev, int pin);
+
+/* --- BLE GATT ------------------------------------------------------------- */
+
+/* Server side: every ble_gatts_notify_custom() on dev ends up here. */
+typedef int (*hostBleNotifyHook_t)(int dev, uint16_t connHandle, uint16_t attrHandle,
+                                   const uint8_t *data, uint16_t len, void *ctx);
+
+/* Client side: every ble_gattc_write_flat() on dev ends up here. */
+typedef int (*hostBleWriteHook_t)(int dev, uint16_t connHandle, uint16_t attrHandle,
+                                  const uint8_t *data, uint16_t len, void *ctx);
+
+/*
+ * Client side: every ble_gattc_read_long() on dev ends up here. Returns the
+ * value length copied into out, or -1 on error.
+ */
+typedef int (*hostBleReadHook_t)(int dev, uint16_t connHandle, uint16_t attrHandle,
+                                 uint8_t *out, uint16_t outCap, void *ctx);
+
+void hostBleSetNotifyHook(int dev, hostBleNotifyHook_t hook, void *ctx);
+void hostBleSetWriteHook(int dev, hostBleWriteHook_t hook, void *ctx);
+void hostBleSetReadHook(int dev, hostBleReadHook_t hook, void *ctx);
+
+/* ATT MTU reported by ble_att_mtu() on dev (default 23). */
+void hostBleSetMtu(int dev, uint16_t mtu);
+
+/* Value handle of a registered characteristic on dev, 0 if unknown. */
+uint16_t hostBleFindChr(int dev, uint16_t uuid16);
+
+/* Delivers a GATT write to dev's characteristic access callback. */
+int hostBleDeliverWrite(int dev, uint16_t connHandle, uint16_t attrHandle,
+                        const uint8_t *data, uint16_t len);
+
+/* Performs a GATT read on dev. Returns the value length, or -1 on error. */
+int hostBleDeliverRead(int dev, uint16_t connHandle, uint16_t attrHandle,
+                       uint8_t *out, uint16_t outCap);
+
+/* --- BLE link ------------------------------------------------------------- */
+
+/*
+ * A connection between a GATT server device and a client device. Server
+ * notifications and client writes are queued and delivered in order from
+ * one link thread, the way the NimBLE host task serialises them on target.
+ */
+
+/* Client-side sink for notifications arriving over the link. */
+typedef void (*hostBleLinkRx_t)(uint16_t attrHandle, const uint8_t *data, uint16_t len, void *ctx);
+
+/* Connects serverDev and clientDev as connHandle with the given ATT MTU. */
+bool hostBleLinkOpen(int serverDev, int clientDev, uint16_t connHandle, uint16_t mtu,
+                     hostBleLinkRx_t onNotify, void *ctx);
+
+/* Drops the hooks; queued traffic is discarded. */
+void hostBleLinkClose(void);
+
+/* Waits until nothing is queued or being delivered. */
+bool hostBleLinkWaitIdle(uint32_t timeoutMs);
+
+/*
+ * Imperfect radio. Each PDU (either direction) is lost with probability
+ * lossRate without the sender noticing, otherwise delivered latencyUs plus
+ * a uniform 0..jitterUs later. The same seed gives the same losses for the
+ * same traffic. All zero (the default) is a perfect, immediate link.
+ */
+typedef struct {
+	double lossRate;
+	uint32_t latencyUs;
+	uint32_t jitterUs;
+	uint32_t seed;
+} hostBleLinkModel_t;
+
+typedef struct {
+	uint64_t notifies;      /* Delivered server -> client */
+	uint64_t notifyBytes;
+	uint64_t writes;        /* Delivered client -> server */
+	uint64_t writeBytes;
+	uint64_t dropped;       /* Lost by the model */
+	uint64_t rejected;      /* Refused with BLE_HS_ENOMEM (queue full) */
+} hostBleLinkStats_t;
+
+/* Applies to PDUs queued from now on; NULL restores the perfect link. */
+void hostBleLinkSetModel(const hostBleLinkModel_t *model);
+
+void hostBleLinkGetStats(hostBleLinkStats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,30 @@
+/*
+ * wm_host_vfs.h
+ *
+ * Force-included into every firmware source of the host build. Redirects
+ * the libc file calls the firmware makes on "/spiffs/..." paths to the
+ * current device's temp directory (see hostVfsMapPath()).
+ *
+ * The system headers are pulled in first so the function-like macros
+ * below only affect firmware code, never the libc prototypes.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "wm_host.h"
+
+FILE *hostVfsFopen(const char *path, const char *mode);
+int   hostVfsRemove(const char *path);
+int   hostVfsRename(const char *from, const char *to);
+int   hostVfsStat(const char *path, struct stat *st);
+DIR  *hostVfsOpendir(const char *path);
+
+#define fopen(p, m)    hostVfsFopen((p), (m))
+#define remove(p)      hostVfsRemove((p))
+#define rename(a, b)   hostVfsRename((a), (b))
+#define stat(p, s)     hostVfsStat((p), (s))
+#define opendir(p)     hostVfsOpendir((p))
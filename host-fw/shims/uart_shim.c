@@ -0,0 +1,334 @@
+/*
+ * uart_shim.c
+ *
+ * driver/uart on in-memory rings. RX bytes come from hostUartInject(); a
+ * full ring drops the overflow and posts UART_BUFFER_FULL, as the real
+ * driver does. TX goes straight to the port's hook.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/uart.h"
+#include "wm_host.h"
+#include "wm_host_internal.h"
+
+#define UART_MIN_RX_BUFFER  256
+
+typedef struct {
+	bool installed;
+	bool rxEnabled;
+
+	uint8_t *rx;
+	size_t rxCap;
+	size_t rxHead;
+	size_t rxCount;
+
+	QueueHandle_t events;
+
+	hostUartTxHook_t txHook;
+	void *txCtx;
+} uartPort_t;
+
+static uartPort_t ports[HOST_MAX_DEVICES][HOST_MAX_UARTS];
+
+/* One lock for all ports keeps TX hooks and RX waits simple; traffic is low. */
+static pthread_mutex_t uartMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t uartCond;
+static pthread_once_t uartOnce = PTHREAD_ONCE_INIT;
+
+static void uartInitOnce(void)
+{
+	hostCondInit(&uartCond);
+}
+
+static uartPort_t *portFor(int dev, uart_port_t port)
+{
+	pthread_once(&uartOnce, uartInitOnce);
+
+	if (dev < 0 || dev >= HOST_MAX_DEVICES || port < 0 || port >= HOST_MAX_UARTS) {
+		return NULL;
+	}
+	return &ports[dev][port];
+}
+
+static void postEvent(uartPort_t *p, uart_event_type_t type, size_t size)
+{
+	if (!p->events) {
+		return;
+	}
+
+	uart_event_t ev = {
+		.type = type,
+		.size = size,
+		.timeout_flag = false
+	};
+	xQueueSend(p->events, &ev, 0);
+}
+
+/* --- Driver API ----------------------------------------------------------- */
+
+esp_err_t uart_driver_install(uart_port_t port, int rxBufferSize, int txBufferSize,
+                              int queueSize, QueueHandle_t *queue, int intrFlags)
+{
+	(void)txBufferSize;
+	(void)intrFlags;
+
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+
+	if (p->installed) {
+		pthread_mutex_unlock(&uartMutex);
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	p->rxCap = (rxBufferSize > UART_MIN_RX_BUFFER) ? (size_t)rxBufferSize : UART_MIN_RX_BUFFER;
+	p->rx = malloc(p->rxCap);
+	p->rxHead = 0;
+	p->rxCount = 0;
+	p->rxEnabled = true;
+	p->events = NULL;
+
+	if (queueSize > 0 && queue) {
+		p->events = xQueueCreate((UBaseType_t)queueSize, sizeof(uart_event_t));
+		*queue = p->events;
+	}
+
+	p->installed = (p->rx != NULL);
+
+	pthread_mutex_unlock(&uartMutex);
+	return p->installed ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t uart_driver_delete(uart_port_t port)
+{
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	free(p->rx);
+	p->rx = NULL;
+	p->installed = false;
+	pthread_mutex_unlock(&uartMutex);
+	return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *cfg)
+{
+	(void)port;
+	(void)cfg;
+	return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+	(void)port;
+	(void)tx;
+	(void)rx;
+	(void)rts;
+	(void)cts;
+	return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t port, const void *src, size_t size)
+{
+	int dev = hostDeviceCurrent();
+	uartPort_t *p = portFor(dev, port);
+	if (!p || !src) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	hostUartTxHook_t hook = p->txHook;
+	void *ctx = p->txCtx;
+	pthread_mutex_unlock(&uartMutex);
+
+	if (hook) {
+		hook(dev, port, (const uint8_t *)src, size, ctx);
+	}
+	return (int)size;
+}
+
+int uart_read_bytes(uart_port_t port, void *buf, uint32_t length, TickType_t ticks)
+{
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p || !buf) {
+		return -1;
+	}
+
+	struct timespec deadline;
+	bool timed = hostDeadlineFromTicks(ticks, &deadline);
+	uint8_t *out = (uint8_t *)buf;
+	uint32_t got = 0;
+
+	pthread_mutex_lock(&uartMutex);
+
+	while (got < length) {
+		while (p->rxCount > 0 && got < length) {
+			out[got++] = p->rx[p->rxHead];
+			p->rxHead = (p->rxHead + 1) % p->rxCap;
+			p->rxCount--;
+		}
+
+		if (got == length) {
+			break;
+		}
+
+		pthread_cond_broadcast(&uartCond);
+
+		if (ticks == 0 ||
+		    !hostCondWaitTicks(&uartCond, &uartMutex, timed ? &deadline : NULL)) {
+			if (p->rxCount == 0) {
+				break;
+			}
+		}
+	}
+
+	/* Wake anyone in hostUartWaitRxDrained(). */
+	pthread_cond_broadcast(&uartCond);
+	pthread_mutex_unlock(&uartMutex);
+
+	return (int)got;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks)
+{
+	(void)port;
+	(void)ticks;
+	return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t port)
+{
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	p->rxHead = 0;
+	p->rxCount = 0;
+	pthread_cond_broadcast(&uartCond);
+	pthread_mutex_unlock(&uartMutex);
+	return ESP_OK;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t port, size_t *size)
+{
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p || !size) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	*size = p->rxCount;
+	pthread_mutex_unlock(&uartMutex);
+	return ESP_OK;
+}
+
+esp_err_t uart_enable_rx_intr(uart_port_t port)
+{
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	p->rxEnabled = true;
+	pthread_mutex_unlock(&uartMutex);
+	return ESP_OK;
+}
+
+esp_err_t uart_disable_rx_intr(uart_port_t port)
+{
+	uartPort_t *p = portFor(hostDeviceCurrent(), port);
+	if (!p) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	p->rxEnabled = false;
+	pthread_mutex_unlock(&uartMutex);
+	return ESP_OK;
+}
+
+/* --- Harness API ---------------------------------------------------------- */
+
+void hostUartSetTxHook(int dev, int port, hostUartTxHook_t hook, void *ctx)
+{
+	uartPort_t *p = portFor(dev, port);
+	if (!p) {
+		return;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+	p->txHook = hook;
+	p->txCtx = ctx;
+	pthread_mutex_unlock(&uartMutex);
+}
+
+size_t hostUartInject(int dev, int port, const uint8_t *data, size_t len)
+{
+	uartPort_t *p = portFor(dev, port);
+	if (!p || !data) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&uartMutex);
+
+	if (!p->installed || !p->rxEnabled) {
+		pthread_mutex_unlock(&uartMutex);
+		return 0;
+	}
+
+	size_t space = p->rxCap - p->rxCount;
+	size_t accepted = (len < space) ? len : space;
+
+	for (size_t i = 0; i < accepted; i++) {
+		p->rx[(p->rxHead + p->rxCount) % p->rxCap] = data[i];
+		p->rxCount++;
+	}
+
+	for (size_t off = 0; off < accepted; off += UART_HOST_RX_EVENT_MAX) {
+		size_t n = accepted - off;
+		postEvent(p, UART_DATA, n < UART_HOST_RX_EVENT_MAX ? n : UART_HOST_RX_EVENT_MAX);
+	}
+	if (accepted < len) {
+		postEvent(p, UART_BUFFER_FULL, 0);
+	}
+
+	pthread_cond_broadcast(&uartCond);
+	pthread_mutex_unlock(&uartMutex);
+
+	return accepted;
+}
+
+bool hostUartWaitRxDrained(int dev, int port, uint32_t timeoutMs)
+{
+	uartPort_t *p = portFor(dev, port);
+	if (!p) {
+		return false;
+	}
+
+	struct timespec deadline;
+	hostDeadlineFromTicks(pdMS_TO_TICKS(timeoutMs), &deadline);
+
+	pthread_mutex_lock(&uartMutex);
+
+	bool ok = true;
+	while (p->rxCount > 0 || (p->events && uxQueueMessagesWaiting(p->events) > 0)) {
+		if (!hostCondWaitTicks(&uartCond, &uartMutex, &deadline)) {
+			ok = (p->rxCount == 0);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&uartMutex);
+	return ok;
+}
@@ -0,0 +1,242 @@
+/*
+ * wm_host.c
+ *
+ * Device registry, "/spiffs" path mapping, logging, error names and
+ * esp_random() for the host shims.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wm_host.h"
+#include "wm_host_internal.h"
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#define SPIFFS_PREFIX      "/spiffs"
+#define HOST_PATH_MAX      512
+
+typedef struct {
+	bool used;
+	char name[16];
+	char fsRoot[HOST_PATH_MAX];
+} hostDevice_t;
+
+static hostDevice_t devices[HOST_MAX_DEVICES];
+static int deviceCount = 0;
+static pthread_mutex_t deviceMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread int currentDevice = 0;
+
+int hostLogLevel = CONFIG_LOG_DEFAULT_LEVEL;
+
+/* --- Devices -------------------------------------------------------------- */
+
+int hostDeviceCreate(const char *name, const char *fsRoot)
+{
+	pthread_mutex_lock(&deviceMutex);
+
+	if (deviceCount >= HOST_MAX_DEVICES) {
+		pthread_mutex_unlock(&deviceMutex);
+		return -1;
+	}
+
+	int dev = deviceCount++;
+	hostDevice_t *d = &devices[dev];
+
+	d->used = true;
+	snprintf(d->name, sizeof(d->name), "%s", name ? name : "dev");
+	snprintf(d->fsRoot, sizeof(d->fsRoot), "%s", fsRoot ? fsRoot : ".");
+
+	pthread_mutex_unlock(&deviceMutex);
+
+	mkdir(d->fsRoot, 0755);
+	return dev;
+}
+
+void hostDeviceEnter(int dev)
+{
+	if (dev >= 0 && dev < HOST_MAX_DEVICES) {
+		currentDevice = dev;
+	}
+}
+
+int hostDeviceCurrent(void)
+{
+	return currentDevice;
+}
+
+const char *hostDeviceName(int dev)
+{
+	if (dev < 0 || dev >= HOST_MAX_DEVICES || !devices[dev].used) {
+		return "host";
+	}
+	return devices[dev].name;
+}
+
+const char *hostDeviceFsRoot(int dev)
+{
+	if (dev < 0 || dev >= HOST_MAX_DEVICES || !devices[dev].used) {
+		return ".";
+	}
+	return devices[dev].fsRoot;
+}
+
+bool hostMakeTempDir(const char *prefix, char *out, size_t outLen)
+{
+	const char *tmp = getenv("TMPDIR");
+	if (!tmp || tmp[0] == '\0') {
+		tmp = "/tmp";
+	}
+
+	int n = snprintf(out, outLen, "%s/%s-XXXXXX", tmp, prefix ? prefix : "wm");
+	if (n <= 0 || (size_t)n >= outLen) {
+		return false;
+	}
+	return mkdtemp(out) != NULL;
+}
+
+void hostRemoveTempDir(const char *dir)
+{
+	DIR *d = opendir(dir);
+	if (!d) {
+		return;
+	}
+
+	struct dirent *ent;
+	char path[HOST_PATH_MAX];
+
+	while ((ent = readdir(d)) != NULL) {
+		if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+		unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+/* --- Path mapping --------------------------------------------------------- */
+
+const char *hostVfsMapPath(const char *path, char *out, size_t outLen)
+{
+	size_t prefixLen = strlen(SPIFFS_PREFIX);
+
+	if (!path || strncmp(path, SPIFFS_PREFIX, prefixLen) != 0 ||
+	    (path[prefixLen] != '\0' && path[prefixLen] != '/')) {
+		return path;
+	}
+
+	snprintf(out, outLen, "%s%s", hostDeviceFsRoot(currentDevice), path + prefixLen);
+	return out;
+}
+
+FILE *hostVfsFopen(const char *path, const char *mode)
+{
+	char buf[HOST_PATH_MAX];
+	return fopen(hostVfsMapPath(path, buf, sizeof(buf)), mode);
+}
+
+int hostVfsRemove(const char *path)
+{
+	char buf[HOST_PATH_MAX];
+	return remove(hostVfsMapPath(path, buf, sizeof(buf)));
+}
+
+int hostVfsRename(const char *from, const char *to)
+{
+	char a[HOST_PATH_MAX];
+	char b[HOST_PATH_MAX];
+	return rename(hostVfsMapPath(from, a, sizeof(a)), hostVfsMapPath(to, b, sizeof(b)));
+}
+
+int hostVfsStat(const char *path, struct stat *st)
+{
+	char buf[HOST_PATH_MAX];
+	return stat(hostVfsMapPath(path, buf, sizeof(buf)), st);
+}
+
+DIR *hostVfsOpendir(const char *path)
+{
+	char buf[HOST_PATH_MAX];
+	return opendir(hostVfsMapPath(path, buf, sizeof(buf)));
+}
+
+/* --- Logging -------------------------------------------------------------- */
+
+void hostLogSetLevel(int level)
+{
+	hostLogLevel = level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+	(void)tag;
+	hostLogLevel = (int)level;
+}
+
+void hostLogWrite(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+	static const char letters[] = "NEWIDV";
+	va_list ap;
+
+	pthread_mutex_lock(&logMutex);
+
+	printf("[%s] %c (%lld) %s: ", hostDeviceName(currentDevice),
+	       letters[level <= ESP_LOG_VERBOSE ? level : 0],
+	       (long long)(esp_timer_get_time() / 1000), tag);
+
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+
+	putchar('\n');
+	pthread_mutex_unlock(&logMutex);
+}
+
+/* --- Errors --------------------------------------------------------------- */
+
+const char *esp_err_to_name(esp_err_t code)
+{
+	switch (code) {
+	case ESP_OK:                return "ESP_OK";
+	case ESP_FAIL:              return "ESP_FAIL";
+	case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+	case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+	case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+	case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+	case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+	case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+	case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+	default:                    return "ESP_ERR_UNKNOWN";
+	}
+}
+
+/* --- Random --------------------------------------------------------------- */
+
+uint32_t esp_random(void)
+{
+	uint32_t value = 0;
+	FILE *f = fopen("/dev/urandom", "rb");
+	if (f) {
+		if (fread(&value, sizeof(value), 1, f) != 1) {
+			value = 0;
+		}
+		fclose(f);
+	}
+	if (value == 0) {
+		value = (uint32_t)esp_timer_get_time() ^ ((uint32_t)getpid() << 16);
+	}
+	return value;
+}
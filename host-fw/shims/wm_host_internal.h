@@ -0,0 +1,29 @@
+/*
+ * wm_host_internal.h
+ *
+ * Helpers shared by the shim implementations (not part of the harness API).
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+/* Initializes a condition variable that waits on CLOCK_MONOTONIC. */
+void hostCondInit(pthread_cond_t *cond);
+
+/*
+ * Waits on cond for up to ticks (portMAX_DELAY = forever).
+ * Returns false on timeout. The caller re-checks its predicate either way.
+ */
+bool hostCondWaitTicks(pthread_cond_t *cond, pthread_mutex_t *mutex,
+                       const struct timespec *deadline);
+
+/* Absolute CLOCK_MONOTONIC deadline ticks from now; NULL-equivalent for forever. */
+bool hostDeadlineFromTicks(TickType_t ticks, struct timespec *deadline);
+
+void hostSleepUs(int64_t us);
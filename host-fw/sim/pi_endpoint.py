@@ -0,0 +1,84 @@
+"""
+pi_endpoint.py
+
+The Pi side of wm_sim: runs the real uart_receiver.py receive loop on the
+simulator's pty, against a throwaway SQLite database.
+
+Every row that reaches the database and every COMMIT sent back is reported
+on stdout, one line each, so the simulator can time cuts end to end:
+
+    READY
+    DB <monotonic_ns> <utc_date> <utc_time>
+    COMMIT <status>
+
+monotonic_ns is CLOCK_MONOTONIC, the same clock wm_sim stamps cuts with.
+
+Usage: pi_endpoint.py --port /dev/pts/N --rpi-dir base-rpi-fw --work DIR [-v]
+"""
+
+import argparse
+import logging
+import os
+import sys
+import time
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--port", required=True)
+    ap.add_argument("--rpi-dir", required=True)
+    ap.add_argument("--work", required=True)
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+
+    # config.py reads these at import time.
+    os.environ["HUB_DB_PATH"] = os.path.join(args.work, "watermelon_hub.db")
+    os.environ["HUB_FILES_DIR"] = os.path.join(args.work, "received_files")
+    os.environ["HUB_SERIAL_PORT"] = args.port
+    sys.path.insert(0, os.path.abspath(args.rpi_dir))
+
+    logging.basicConfig(
+        level=logging.INFO if args.verbose else logging.WARNING,
+        format="pi %(name)s: %(message)s",
+        stream=sys.stderr,
+    )
+
+    import config
+    import database
+    import uart_receiver
+
+    database.init_db()
+
+    send_commit = uart_receiver._send_commit
+
+    class TimedWriter(database.PointWriter):
+        # Rows become visible at commit(), so that is when they are stamped.
+        def __init__(self, *a, **kw):
+            super().__init__(*a, **kw)
+            self._keys = []
+
+        def add(self, record):
+            self._keys.append((record["utc_date"], record["utc_time"]))
+            super().add(record)
+
+        def commit(self):
+            count = super().commit()
+            now = time.monotonic_ns()
+            for utc_date, utc_time in self._keys:
+                print("DB %d %s %s" % (now, utc_date, utc_time))
+            sys.stdout.flush()
+            return count
+
+    def timed_commit(ser, status):
+        send_commit(ser, status)
+        print("COMMIT %d" % status, flush=True)
+
+    database.PointWriter = TimedWriter
+    uart_receiver._send_commit = timed_commit
+
+    print("READY", flush=True)
+    uart_receiver._receiver_loop(config.SERIAL_PORT, config.SERIAL_BAUD)
+
+
+if __name__ == "__main__":
+    main()
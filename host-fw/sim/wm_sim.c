@@ -0,0 +1,913 @@
+/*
+ * wm_sim.c
+ *
+ * End-to-end pipeline simulator: NMEA replay -> shears -> BLE -> base ->
+ * UART -> Pi, with nothing but the radio and the serial cable simulated.
+ *
+ *   shears   gps_logger, storage and log_transfer_server, fed NMEA epochs on
+ *            the GPS UART at the log's own pace (scaled by --speed) and cut
+ *            presses on CUT2
+ *   BLE      ble_link.c with the loss/latency model and the given ATT MTU
+ *   base     log_transfer_client and base_uartFileTransfer; the Pi UART is a
+ *            pty pair
+ *   Pi       the real base-rpi-fw/uart_receiver.py on the pty's slave side
+ *            (sim/pi_endpoint.py), writing a throwaway SQLite database
+ *
+ * Each cut is stamped when the button is pressed and matched to the row
+ * that reaches gps_points by the UTC time field of the GGA it should
+ * capture: the first one after the press. Cuts the firmware cannot record on their own
+ * (a second press before the GGA arrives, or inside the 400 ms debounce)
+ * are counted as coalesced, not lost.
+ *
+ * Cut rates are given per phase (--cut-rate=0.2,1,2 runs three phases back
+ * to back, a Poisson process each) or as recorded timestamps (--cuts=FILE).
+ * The report has, per phase, cut-to-DB latency percentiles and the rate
+ * rows actually landed in the database, so a rising rate shows where the
+ * chain saturates. --trace=FILE saves the hot-path trace ring (trace.h) at
+ * the end for tools/wm_trace.py.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "wm_host.h"
+#include "esp_log.h"
+
+#include "shears_gpsButtons.h"
+#include "base_uartFileTransfer.h"
+#include "trace.h"
+
+#include "wm_nmea.h"
+#include "wm_rig.h"
+
+#ifndef WM_SIM_ENDPOINT
+#define WM_SIM_ENDPOINT      "host-fw/sim/pi_endpoint.py"
+#endif
+#ifndef WM_SIM_RPI_DIR
+#define WM_SIM_RPI_DIR       "base-rpi-fw"
+#endif
+
+#define SIM_MAX_PHASES       16
+#define SIM_INJECT_MAX       512     /* Half the GPS UART RX ring */
+#define SIM_DEBOUNCE_NS      400000000LL
+#define SIM_READY_TIMEOUT_S  15
+#define SIM_KICK_MS          500
+
+#define NS_PER_S             1000000000LL
+
+/* --- Options -------------------------------------------------------------- */
+
+static struct {
+	const char *nmeaPath;
+	const char *cutsPath;
+	const char *tracePath;
+	size_t epochs;
+	double rates[SIM_MAX_PHASES];
+	int phaseCount;
+	double phaseSec;
+	double speed;
+	uint32_t seed;
+	double lossRate;
+	double latencyMs;
+	double jitterMs;
+	int mtu;
+	const char *python;
+	double drainSec;
+	bool verbose;
+} opt = {
+	.phaseSec = 60.0,
+	.speed = 1.0,
+	.seed = 1,
+	.mtu = 185,
+	.python = "python3",
+	.drainSec = 30.0,
+};
+
+/* --- State ---------------------------------------------------------------- */
+
+typedef enum {
+	CUT_PENDING = 0,
+	CUT_CAPTURED,       /* The firmware should store a row for it */
+	CUT_COALESCED,      /* Folded into an earlier press or debounced */
+} cutState_t;
+
+typedef struct {
+	double t;           /* Seconds since the first epoch */
+	int phase;
+	cutState_t state;
+	size_t epoch;       /* Epoch whose GGA it captures */
+	int64_t pressNs;
+	int64_t dbNs;
+	int dbRows;
+} simCut_t;
+
+typedef struct {
+	double rate;
+	double start;       /* Log seconds */
+	double end;
+	int64_t wallStartNs;
+	int64_t wallEndNs;
+} simPhase_t;
+
+static FILE *report;
+static wmRig_t rig;
+static wmNmeaLog_t nmea;
+
+static simPhase_t phases[SIM_MAX_PHASES];
+static int phaseCount;
+
+static simCut_t *cuts;
+static size_t cutCount;
+
+/* Updated from the Pi reader thread. */
+static pthread_mutex_t simMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t simCond = PTHREAD_COND_INITIALIZER;
+static struct {
+	bool ready;
+	bool exited;
+	size_t stored;
+	size_t duplicates;
+	size_t unexpected;
+	size_t commitsOk;
+	size_t commitsFail;
+	int64_t *rowNs;
+	size_t rowCount;
+	size_t rowCap;
+} pi;
+
+static int ptyMaster = -1;
+static int ptySlave = -1;
+static pid_t piPid = -1;
+
+static int64_t nowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static void sleepUntilNs(int64_t deadline)
+{
+	struct timespec ts = {
+		.tv_sec = deadline / NS_PER_S,
+		.tv_nsec = deadline % NS_PER_S
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+	}
+}
+
+/* --- Cut schedule --------------------------------------------------------- */
+
+static uint64_t rngState;
+
+static double nextUnit(void)
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 7;
+	rngState ^= rngState << 17;
+	return (double)(rngState >> 11) / (double)(1ULL << 53);
+}
+
+static bool addCut(double t, int phase)
+{
+	static size_t cap = 0;
+
+	if (cutCount == cap) {
+		size_t newCap = cap ? cap * 2 : 256;
+		simCut_t *grown = realloc(cuts, newCap * sizeof(*grown));
+		if (!grown) {
+			return false;
+		}
+		cuts = grown;
+		cap = newCap;
+	}
+
+	simCut_t *c = &cuts[cutCount++];
+	memset(c, 0, sizeof(*c));
+	c->t = t;
+	c->phase = phase;
+	return true;
+}
+
+/* Poisson arrivals at each phase's rate, phases back to back. */
+static bool scheduleRates(void)
+{
+	rngState = 0x9E3779B97F4A7C15ULL ^ opt.seed;
+
+	for (int p = 0; p < opt.phaseCount; p++) {
+		simPhase_t *ph = &phases[phaseCount++];
+		ph->rate = opt.rates[p];
+		ph->start = p * opt.phaseSec;
+		ph->end = ph->start + opt.phaseSec;
+
+		if (ph->rate <= 0.0) {
+			continue;
+		}
+
+		double t = ph->start;
+		for (;;) {
+			t += -log(1.0 - nextUnit()) / ph->rate;
+			if (t >= ph->end) {
+				break;
+			}
+			if (!addCut(t, p)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/* One timestamp per line, seconds since the first epoch; '#' starts a comment. */
+static bool scheduleFile(const char *path, double logEnd)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return false;
+	}
+
+	char line[128];
+	double prev = -1.0;
+	bool ok = true;
+
+	while (ok && fgets(line, sizeof(line), f)) {
+		char *p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0') {
+			continue;
+		}
+
+		char *end = NULL;
+		double t = strtod(p, &end);
+		if (end == p || t < prev) {
+			fprintf(stderr, "%s: bad or unsorted timestamp: %s", path, line);
+			ok = false;
+		} else {
+			ok = addCut(t, 0);
+			prev = t;
+		}
+	}
+	fclose(f);
+
+	phases[0].rate = (logEnd > 0.0) ? cutCount / logEnd : 0.0;
+	phases[0].start = 0.0;
+	phases[0].end = logEnd;
+	phaseCount = 1;
+	return ok;
+}
+
+/* Only $GNGGA is captured by gps_logger. */
+static bool epochHasGngga(size_t i)
+{
+	const wmNmeaEpoch_t *e = &nmea.epochs[i];
+	return e->ggaOffset != SIZE_MAX &&
+	       strncmp(nmea.text + e->offset + e->ggaOffset, "$GNGGA,", 7) == 0;
+}
+
+/* --- Pi side -------------------------------------------------------------- */
+
+static void piTx(int dev, int port, const uint8_t *data, size_t len, void *ctx)
+{
+	(void)dev;
+	(void)port;
+	(void)ctx;
+
+	while (len > 0) {
+		ssize_t n = write(ptyMaster, data, len);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		data += n;
+		len -= (size_t)n;
+	}
+}
+
+/* Pi -> base bytes: pty master into the base's UART RX ring. */
+static void *ptyReader(void *arg)
+{
+	(void)arg;
+	uint8_t buf[256];
+
+	for (;;) {
+		ssize_t n = read(ptyMaster, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return NULL;
+		}
+
+		size_t done = 0;
+		while (done < (size_t)n) {
+			done += hostUartInject(rig.baseDev, WM_RIG_PI_UART, buf + done, (size_t)n - done);
+			if (done < (size_t)n) {
+				usleep(1000);
+			}
+		}
+	}
+}
+
+static void onDbRow(int64_t ns, const char *rowTime)
+{
+	if (pi.rowCount == pi.rowCap) {
+		size_t newCap = pi.rowCap ? pi.rowCap * 2 : 256;
+		int64_t *grown = realloc(pi.rowNs, newCap * sizeof(*grown));
+		if (!grown) {
+			return;
+		}
+		pi.rowNs = grown;
+		pi.rowCap = newCap;
+	}
+	pi.rowNs[pi.rowCount++] = ns;
+
+	for (size_t i = 0; i < cutCount; i++) {
+		simCut_t *c = &cuts[i];
+		if (c->state != CUT_CAPTURED || strcmp(nmea.epochs[c->epoch].utcTime, rowTime) != 0) {
+			continue;
+		}
+
+		if (c->dbRows++ == 0) {
+			c->dbNs = ns;
+			pi.stored++;
+		} else {
+			pi.duplicates++;
+		}
+		return;
+	}
+
+	pi.unexpected++;
+}
+
+static void *piReader(void *arg)
+{
+	FILE *in = arg;
+	char line[256];
+
+	while (fgets(line, sizeof(line), in)) {
+		long long ns = 0;
+		char date[32];
+		char rowTime[32];
+		int status = 0;
+
+		pthread_mutex_lock(&simMutex);
+
+		if (strncmp(line, "READY", 5) == 0) {
+			pi.ready = true;
+		} else if (sscanf(line, "DB %lld %31s %31s", &ns, date, rowTime) == 3) {
+			onDbRow(ns, rowTime);
+		} else if (sscanf(line, "COMMIT %d", &status) == 1) {
+			if (status == 0) {
+				pi.commitsOk++;
+			} else {
+				pi.commitsFail++;
+			}
+		}
+
+		pthread_cond_broadcast(&simCond);
+		pthread_mutex_unlock(&simMutex);
+	}
+
+	pthread_mutex_lock(&simMutex);
+	pi.exited = true;
+	pthread_cond_broadcast(&simCond);
+	pthread_mutex_unlock(&simMutex);
+
+	fclose(in);
+	return NULL;
+}
+
+static bool openPty(char *slaveName, size_t slaveNameLen)
+{
+	ptyMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if (ptyMaster < 0 || grantpt(ptyMaster) != 0 || unlockpt(ptyMaster) != 0 ||
+	    ptsname_r(ptyMaster, slaveName, slaveNameLen) != 0) {
+		perror("pty");
+		return false;
+	}
+
+	/* Held open so the master never sees EIO while the receiver reopens the port. */
+	ptySlave = open(slaveName, O_RDWR | O_NOCTTY);
+	if (ptySlave < 0) {
+		perror(slaveName);
+		return false;
+	}
+
+	struct termios tio;
+	tcgetattr(ptySlave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(ptySlave, TCSANOW, &tio);
+	return true;
+}
+
+static bool startPi(const char *slaveName, const char *workDir)
+{
+	int out[2];
+	if (pipe(out) != 0) {
+		perror("pipe");
+		return false;
+	}
+
+	fflush(NULL);
+	piPid = fork();
+	if (piPid < 0) {
+		perror("fork");
+		return false;
+	}
+
+	if (piPid == 0) {
+		dup2(out[1], STDOUT_FILENO);
+		close(out[0]);
+		close(out[1]);
+		close(ptyMaster);
+
+		execlp(opt.python, opt.python, WM_SIM_ENDPOINT,
+		       "--port", slaveName, "--rpi-dir", WM_SIM_RPI_DIR, "--work", workDir,
+		       opt.verbose ? "-v" : NULL, (char *)NULL);
+		perror(opt.python);
+		_exit(127);
+	}
+
+	close(out[1]);
+
+	FILE *in = fdopen(out[0], "r");
+	pthread_t reader;
+	if (!in || pthread_create(&reader, NULL, piReader, in) != 0) {
+		return false;
+	}
+	pthread_detach(reader);
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += SIM_READY_TIMEOUT_S;
+
+	pthread_mutex_lock(&simMutex);
+	while (!pi.ready && !pi.exited) {
+		if (pthread_cond_timedwait(&simCond, &simMutex, &deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	bool ready = pi.ready;
+	pthread_mutex_unlock(&simMutex);
+
+	if (!ready) {
+		fprintf(stderr, "pi endpoint did not start (is pyserial installed?)\n");
+	}
+	return ready;
+}
+
+static void stopPi(void)
+{
+	if (piPid > 0) {
+		kill(piPid, SIGTERM);
+		waitpid(piPid, NULL, 0);
+		piPid = -1;
+	}
+}
+
+/* --- Replay --------------------------------------------------------------- */
+
+static bool injectEpoch(size_t i)
+{
+	const wmNmeaEpoch_t *e = &nmea.epochs[i];
+	const uint8_t *data = (const uint8_t *)nmea.text + e->offset;
+	size_t left = e->len;
+
+	while (left > 0) {
+		size_t n = left < SIM_INJECT_MAX ? left : SIM_INJECT_MAX;
+		if (hostUartInject(rig.shearsDev, WM_RIG_GPS_UART, data, n) != n ||
+		    !hostUartWaitRxDrained(rig.shearsDev, WM_RIG_GPS_UART, 1000)) {
+			return false;
+		}
+		data += n;
+		left -= n;
+	}
+	return true;
+}
+
+/*
+ * Presses CUT2 and predicts what gps_logger does with it: the first GNGGA
+ * after the press is captured unless a capture is already pending or the
+ * last accepted press is inside the debounce window.
+ */
+static size_t lastCapturedEpoch = SIZE_MAX;
+
+static void pressCut(size_t idx, size_t nextEpoch)
+{
+	static int64_t lastAcceptedNs = INT64_MIN / 2;
+
+	simCut_t *c = &cuts[idx];
+
+	while (nextEpoch < nmea.count && !epochHasGngga(nextEpoch)) {
+		nextEpoch++;
+	}
+
+	c->pressNs = nowNs();
+	hostGpioSetLevel(rig.shearsDev, SHEARS_CUT2_BUTTON_PIN, 0);
+	hostGpioSetLevel(rig.shearsDev, SHEARS_CUT2_BUTTON_PIN, 1);
+
+	pthread_mutex_lock(&simMutex);
+	if (nextEpoch >= nmea.count || nextEpoch == lastCapturedEpoch ||
+	    c->pressNs - lastAcceptedNs < SIM_DEBOUNCE_NS) {
+		c->state = CUT_COALESCED;
+	} else {
+		c->state = CUT_CAPTURED;
+		c->epoch = nextEpoch;
+		lastCapturedEpoch = nextEpoch;
+		lastAcceptedNs = c->pressNs;
+	}
+	pthread_mutex_unlock(&simMutex);
+}
+
+static bool replay(void)
+{
+	size_t epoch = 0;
+	size_t cut = 0;
+
+	for (int p = 0; p < phaseCount; p++) {
+		simPhase_t *ph = &phases[p];
+		int64_t wallStart = nowNs();
+		ph->wallStartNs = wallStart;
+
+		for (;;) {
+			double te = (epoch < nmea.count) ? nmea.epochs[epoch].t : INFINITY;
+			double tc = (cut < cutCount) ? cuts[cut].t : INFINITY;
+
+			/* An epoch and a cut at the same instant: the epoch was already sent. */
+			bool isCut = tc < te;
+			double t = isCut ? tc : te;
+
+			if (t >= ph->end || t == INFINITY) {
+				break;
+			}
+
+			sleepUntilNs(wallStart + (int64_t)((t - ph->start) / opt.speed * NS_PER_S));
+
+			if (isCut) {
+				pressCut(cut++, epoch);
+			} else if (!injectEpoch(epoch++)) {
+				fprintf(stderr, "GPS UART did not drain\n");
+				return false;
+			}
+		}
+
+		ph->wallEndNs = wallStart + (int64_t)((ph->end - ph->start) / opt.speed * NS_PER_S);
+		sleepUntilNs(ph->wallEndNs);
+	}
+
+	/* The GGA the last cuts are waiting for. */
+	while (lastCapturedEpoch != SIZE_MAX && epoch <= lastCapturedEpoch) {
+		if (!injectEpoch(epoch++)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Waits for the captured cuts still in flight. A segment that reaches the
+ * base while it is forwarding waits there for the next trigger; on the bench
+ * that is the operator's dump button, so it is pressed every SIM_KICK_MS.
+ */
+static size_t drain(void)
+{
+	int64_t deadline = nowNs() + (int64_t)(opt.drainSec * NS_PER_S);
+	size_t captured = 0;
+
+	for (size_t i = 0; i < cutCount; i++) {
+		captured += (cuts[i].state == CUT_CAPTURED);
+	}
+
+	for (;;) {
+		pthread_mutex_lock(&simMutex);
+		bool done = (pi.stored >= captured) || pi.exited;
+		pthread_mutex_unlock(&simMutex);
+
+		if (done || nowNs() >= deadline) {
+			break;
+		}
+
+		hostDeviceEnter(rig.baseDev);
+		transferStart(TRANSFER_TRIGGER_BUTTON);
+		usleep(SIM_KICK_MS * 1000);
+	}
+
+	return captured;
+}
+
+/* --- Report --------------------------------------------------------------- */
+
+static int compareDouble(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, size_t n, double q)
+{
+	if (n == 0) {
+		return NAN;
+	}
+	size_t rank = (size_t)ceil(q * n);
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static size_t printReport(void)
+{
+	double *lat = malloc((cutCount ? cutCount : 1) * sizeof(*lat));
+	size_t lostTotal = 0;
+
+	fprintf(report, "%-6s %9s %6s %9s %10s %7s %5s %9s %9s %9s %9s %9s\n",
+	        "phase", "cuts/s", "cuts", "captured", "coalesced", "stored", "lost",
+	        "p50 ms", "p90 ms", "p99 ms", "max ms", "rows/s");
+
+	for (int p = 0; p < phaseCount; p++) {
+		const simPhase_t *ph = &phases[p];
+		size_t total = 0, captured = 0, coalesced = 0, stored = 0, n = 0;
+
+		for (size_t i = 0; i < cutCount; i++) {
+			const simCut_t *c = &cuts[i];
+			if (c->phase != p) {
+				continue;
+			}
+			total++;
+			if (c->state == CUT_COALESCED) {
+				coalesced++;
+			} else if (c->state == CUT_CAPTURED) {
+				captured++;
+				if (c->dbRows > 0) {
+					stored++;
+					lat[n++] = (double)(c->dbNs - c->pressNs) / 1e6;
+				}
+			}
+		}
+
+		/* Rows landing in the database while the phase was running. */
+		size_t rows = 0;
+		for (size_t i = 0; i < pi.rowCount; i++) {
+			rows += (pi.rowNs[i] >= ph->wallStartNs && pi.rowNs[i] < ph->wallEndNs);
+		}
+		double wallSec = (double)(ph->wallEndNs - ph->wallStartNs) / NS_PER_S;
+
+		qsort(lat, n, sizeof(*lat), compareDouble);
+		lostTotal += captured - stored;
+
+		fprintf(report, "%-6d %9.2f %6zu %9zu %10zu %7zu %5zu %9.1f %9.1f %9.1f %9.1f %9.2f\n",
+		        p + 1, ph->rate, total, captured, coalesced, stored, captured - stored,
+		        percentile(lat, n, 0.50), percentile(lat, n, 0.90), percentile(lat, n, 0.99),
+		        n ? lat[n - 1] : NAN, wallSec > 0.0 ? rows / wallSec : 0.0);
+	}
+	free(lat);
+
+	hostBleLinkStats_t ble;
+	hostBleLinkGetStats(&ble);
+
+	fprintf(report, "\nble: %llu notifies (%llu B), %llu writes (%llu B), %llu dropped, %llu rejected\n",
+	        (unsigned long long)ble.notifies, (unsigned long long)ble.notifyBytes,
+	        (unsigned long long)ble.writes, (unsigned long long)ble.writeBytes,
+	        (unsigned long long)ble.dropped, (unsigned long long)ble.rejected);
+	fprintf(report, "pi:  %zu COMMIT ok, %zu COMMIT fail, %zu duplicate rows, %zu unmatched rows\n",
+	        pi.commitsOk, pi.commitsFail, pi.duplicates, pi.unexpected);
+
+	return lostTotal;
+}
+
+/* --- Main ----------------------------------------------------------------- */
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+	        "usage: %s [--nmea=FILE | --epochs=N] [--cuts=FILE | --cut-rate=R[,R...]]\n"
+	        "          [--phase-s=SEC] [--speed=X] [--seed=N] [--loss=P] [--latency-ms=MS]\n"
+	        "          [--jitter-ms=MS] [--mtu=N] [--python=EXE] [--drain-s=SEC]\n"
+	        "          [--trace=FILE] [-v]\n",
+	        argv0);
+}
+
+static bool parseRates(const char *list)
+{
+	opt.phaseCount = 0;
+
+	for (;;) {
+		char *end = NULL;
+		double r = strtod(list, &end);
+		if (end == list || r < 0.0 || opt.phaseCount == SIM_MAX_PHASES) {
+			return false;
+		}
+		opt.rates[opt.phaseCount++] = r;
+
+		if (*end == '\0') {
+			return true;
+		}
+		if (*end != ',') {
+			return false;
+		}
+		list = end + 1;
+	}
+}
+
+static bool parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *a = argv[i];
+
+		if (strncmp(a, "--nmea=", 7) == 0) {
+			opt.nmeaPath = a + 7;
+		} else if (strncmp(a, "--epochs=", 9) == 0) {
+			opt.epochs = strtoul(a + 9, NULL, 10);
+		} else if (strncmp(a, "--cuts=", 7) == 0) {
+			opt.cutsPath = a + 7;
+		} else if (strncmp(a, "--cut-rate=", 11) == 0) {
+			if (!parseRates(a + 11)) {
+				return false;
+			}
+		} else if (strncmp(a, "--phase-s=", 10) == 0) {
+			opt.phaseSec = atof(a + 10);
+		} else if (strncmp(a, "--speed=", 8) == 0) {
+			opt.speed = atof(a + 8);
+		} else if (strncmp(a, "--seed=", 7) == 0) {
+			opt.seed = (uint32_t)strtoul(a + 7, NULL, 0);
+		} else if (strncmp(a, "--loss=", 7) == 0) {
+			opt.lossRate = atof(a + 7);
+		} else if (strncmp(a, "--latency-ms=", 13) == 0) {
+			opt.latencyMs = atof(a + 13);
+		} else if (strncmp(a, "--jitter-ms=", 12) == 0) {
+			opt.jitterMs = atof(a + 12);
+		} else if (strncmp(a, "--mtu=", 6) == 0) {
+			opt.mtu = atoi(a + 6);
+		} else if (strncmp(a, "--python=", 9) == 0) {
+			opt.python = a + 9;
+		} else if (strncmp(a, "--drain-s=", 10) == 0) {
+			opt.drainSec = atof(a + 10);
+		} else if (strncmp(a, "--trace=", 8) == 0) {
+			opt.tracePath = a + 8;
+		} else if (strcmp(a, "-v") == 0) {
+			opt.verbose = true;
+		} else {
+			return false;
+		}
+	}
+
+	if (opt.cutsPath && opt.phaseCount > 0) {
+		return false;
+	}
+	if (!opt.cutsPath && opt.phaseCount == 0) {
+		opt.rates[0] = 0.5;
+		opt.phaseCount = 1;
+	}
+
+	return opt.speed > 0.0 && opt.phaseSec > 0.0 && opt.mtu >= 23 && opt.mtu <= 512 &&
+	       opt.lossRate >= 0.0 && opt.lossRate < 1.0;
+}
+
+static bool loadInput(void)
+{
+	if (opt.nmeaPath) {
+		if (!wmNmeaLoad(opt.nmeaPath, &nmea)) {
+			fprintf(stderr, "%s: no NMEA epochs\n", opt.nmeaPath);
+			return false;
+		}
+	} else {
+		/* One epoch past the end so the last cut has a GGA to capture. */
+		size_t epochs = opt.epochs;
+		if (epochs == 0) {
+			epochs = (size_t)ceil(opt.cutsPath ? 600.0 : opt.phaseCount * opt.phaseSec) + 1;
+		}
+		if (!wmNmeaSynth(epochs, opt.seed, &nmea)) {
+			return false;
+		}
+	}
+
+	double logEnd = nmea.epochs[nmea.count - 1].t;
+
+	if (opt.cutsPath) {
+		return scheduleFile(opt.cutsPath, logEnd);
+	}
+
+	if (opt.phaseCount * opt.phaseSec > logEnd + 1.0) {
+		fprintf(stderr, "NMEA covers %.0f s, phases need %.0f s\n",
+		        logEnd, opt.phaseCount * opt.phaseSec);
+		return false;
+	}
+	return scheduleRates();
+}
+
+static void traceFileSink(const uint8_t *data, size_t len, void *ctx)
+{
+	fwrite(data, 1, len, (FILE *)ctx);
+}
+
+/* Both devices share one process here, so there is a single "host" ring. */
+static void saveTrace(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return;
+	}
+
+	size_t len = trace_serialize(TRACE_SOURCE_UNKNOWN, traceFileSink, f);
+	fclose(f);
+
+	if (len == 0) {
+		fprintf(report, "trace: compiled out (configure with -DWM_TRACE=ON)\n");
+	} else {
+		fprintf(report, "trace: %zu bytes -> %s\n", len, path);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if (!parseArgs(argc, argv)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	/* Results keep the real stdout; firmware output goes to /dev/null unless -v. */
+	report = fdopen(dup(STDOUT_FILENO), "w");
+	if (!report) {
+		perror("dup");
+		return 1;
+	}
+	if (!opt.verbose) {
+		hostLogSetLevel(ESP_LOG_WARN);
+		if (!freopen("/dev/null", "w", stdout)) {
+			perror("freopen");
+			return 1;
+		}
+	}
+
+	if (!loadInput()) {
+		return 1;
+	}
+
+	char slaveName[64];
+	char piRoot[WM_RIG_PATH_MAX];
+	pthread_t ptyThread;
+
+	if (!hostMakeTempDir("wm-pi", piRoot, sizeof(piRoot)) ||
+	    !openPty(slaveName, sizeof(slaveName)) ||
+	    !wmRigOpen(&rig, (uint16_t)opt.mtu, piTx, NULL) ||
+	    pthread_create(&ptyThread, NULL, ptyReader, NULL) != 0) {
+		fprintf(stderr, "host setup failed\n");
+		return 1;
+	}
+	pthread_detach(ptyThread);
+
+	hostBleLinkModel_t model = {
+		.lossRate = opt.lossRate,
+		.latencyUs = (uint32_t)(opt.latencyMs * 1000.0),
+		.jitterUs = (uint32_t)(opt.jitterMs * 1000.0),
+		.seed = opt.seed
+	};
+	hostBleLinkSetModel(&model);
+
+	if (!startPi(slaveName, piRoot)) {
+		stopPi();
+		return 1;
+	}
+
+	fprintf(report, "wm_sim: %zu epochs, %zu cuts in %d phase(s), speed %.2fx, "
+	                "ble loss %.3f latency %.1f+%.1f ms mtu %d, pi on %s\n",
+	        nmea.count, cutCount, phaseCount, opt.speed,
+	        opt.lossRate, opt.latencyMs, opt.jitterMs, opt.mtu, slaveName);
+	fflush(report);
+
+	bool ok = replay();
+	drain();
+
+	pthread_mutex_lock(&simMutex);
+	size_t lost = printReport();
+	pthread_mutex_unlock(&simMutex);
+
+	if (opt.tracePath) {
+		saveTrace(opt.tracePath);
+	}
+
+	stopPi();
+	wmRigClose(&rig);
+	hostRemoveTempDir(piRoot);
+	wmNmeaFree(&nmea);
+
+	fclose(report);
+
+	if (!ok) {
+		return 1;
+	}
+	return lost > 0 ? 3 : 0;
+}
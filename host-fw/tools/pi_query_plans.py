@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""
+pi_query_plans.py
+
+Checks that the Pi's hot database queries use their indexes.
+
+Each hot function in base-rpi-fw/database.py is run against a throwaway
+database holding active and soft-deleted rows. Every statement it sends to
+SQLite is captured (expanded, with its parameters) and put through EXPLAIN
+QUERY PLAN. A function fails if any of its statements scans gps_points
+without an index, or if its plan does not use the index it is meant to.
+
+The maintained active count (point_stats), R*Tree and grid counts are also
+compared with COUNT(*) after the writes.
+
+Usage: pi_query_plans.py [--rpi-dir base-rpi-fw] [--rows N] [-v]
+Exits 1 if any check fails.
+"""
+
+import argparse
+import inspect
+import os
+import re
+import shutil
+import sys
+import tempfile
+
+# function → (args, text its plan must contain)
+EXPECT = [
+    ("get_all_points",        (),          "INDEX gps_points_active"),
+    ("get_latest_points",     (50,),       "INDEX gps_points_active"),
+    ("get_point_count",       (),          "point_stats"),
+    ("get_changes_since",     (1990,),     "INDEX gps_points_change"),
+    ("get_changed_positions", (1990, 100), "INDEX gps_points_change"),
+    ("get_points_page",       (1000, 200, "-time"),
+                                           "INDEX gps_points_utc"),
+    ("get_points_page",       (0, 200, "time", "2026-01-01", "2026-01-01"),
+                                           "INDEX gps_points_utc"),
+    ("get_points_page",       (500, 200, "-id"),
+                                           "INDEX gps_points_active"),
+    ("get_points_in_bbox",    (-82.351, 29.6402, -82.349, 29.6405),
+                                           "gps_points_rtree VIRTUAL TABLE INDEX"),
+    ("get_grid_in_bbox",      (-82.36, 29.63, -82.34, 29.65, 16),
+                                           "point_grid USING PRIMARY KEY"),
+    ("get_grid_in_bbox",      (-82.36, 29.63, -82.34, 29.65, 16, "2026-01-01"),
+                                           "gps_points_rtree VIRTUAL TABLE INDEX"),
+    ("iter_points",           (),          "INDEX gps_points_utc"),
+    ("iter_points",           ("2026-01-01", "2026-01-01"),
+                                           "INDEX gps_points_utc"),
+    ("iter_points",           (None, None, (-82.351, 29.64, -82.349, 29.65)),
+                                           "INDEX gps_points_utc"),
+    ("iter_points",           (None, None, None, [5, 6, 7]),
+                                           "INTEGER PRIMARY KEY"),
+    ("get_deleted_points",    (),          "INDEX gps_points_deleted"),
+    ("get_oldest_deleted_ms", (),          "INDEX gps_points_deleted"),
+    ("purge_deleted_batch",   (2 ** 62, 50),
+                                           "INDEX gps_points_deleted"),
+    ("soft_delete_points",    ([3, 4],),   "INTEGER PRIMARY KEY"),
+    ("restore_points",        ([3],),      "INTEGER PRIMARY KEY"),
+    ("soft_delete_matching",  (None, (20, 40)),
+                                           "INTEGER PRIMARY KEY"),
+    ("soft_delete_matching",  (None, None, "2026-01-01", "2026-01-01"),
+                                           "INDEX gps_points_utc"),
+    ("soft_delete_matching",  (None, None, None, None, (-82.351, 29.6402, -82.349, 29.6405)),
+                                           "gps_points_rtree VIRTUAL TABLE INDEX"),
+    ("restore_matching",      (None, (20, 40)),
+                                           "INTEGER PRIMARY KEY"),
+]
+
+FULL_SCAN = re.compile(r"\bSCAN gps_points\b(?! USING)")
+
+
+def record(i):
+    return {
+        "utc_date": "010126",
+        "utc_time": "%06d.00" % i,
+        "latitude": 29.64 + i * 1e-6,
+        "longitude": -82.35,
+        "fix_quality": 1,
+        "num_satellites": 9,
+        "hdop": 0.9,
+        "altitude": 30.0,
+        "geoid_height": -20.0,
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--rpi-dir", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "..", "base-rpi-fw"))
+    ap.add_argument("--rows", type=int, default=2000)
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+
+    work = tempfile.mkdtemp(prefix="pi_query_plans_")
+    os.environ["HUB_DB_PATH"] = os.path.join(work, "watermelon_hub.db")
+    sys.path.insert(0, os.path.abspath(args.rpi_dir))
+
+    import database
+
+    captured = []
+    open_connection = database._open_connection
+
+    def traced_connection():
+        conn = open_connection()
+        conn.set_trace_callback(captured.append)
+        return conn
+
+    database._open_connection = traced_connection
+
+    database.init_db()
+    database.insert_points_batch([record(i) for i in range(args.rows)])
+    database.soft_delete_points(list(range(1, args.rows + 1, 10)))
+
+    plan_conn = open_connection()
+    # Batch deletes join a temp table of ids made on the writer connection
+    plan_conn.execute("CREATE TEMP TABLE point_selection (id INTEGER PRIMARY KEY)")
+    failed = 0
+
+    for name, call_args, expect in EXPECT:
+        del captured[:]
+        result = getattr(database, name)(*call_args)
+        if inspect.isgenerator(result):
+            for _ in result:                    # streams run as they are read
+                pass
+
+        plans = []
+        for sql in dict.fromkeys(captured):     # triggers repeat the statement
+            if not re.search(r"gps_points|point_stats|point_grid", sql):
+                continue
+            if not re.match(r"\s*(SELECT|UPDATE|DELETE)\b", sql, re.I):
+                continue
+            rows = plan_conn.execute("EXPLAIN QUERY PLAN " + sql).fetchall()
+            plans.append((sql, [r[3] for r in rows]))
+
+        lines = [line for _, plan in plans for line in plan]
+        problems = []
+        if not plans:
+            problems.append("no query captured")
+        if not any(expect in line for line in lines):
+            problems.append("plan does not use %s" % expect)
+        problems += ["full scan: %s" % line for line in lines if FULL_SCAN.search(line)]
+
+        print("%-4s %s" % ("FAIL" if problems else "ok", name))
+        for p in problems:
+            print("       %s" % p)
+        if problems or args.verbose:
+            for sql, plan in plans:
+                print("       %s" % " ".join(sql.split())[:100])
+                for line in plan:
+                    print("         %s" % line)
+        failed += bool(problems)
+
+    active = plan_conn.execute(
+        "SELECT COUNT(*) FROM gps_points WHERE deleted_at IS NULL").fetchone()[0]
+    counted = database.get_point_count()
+    ok = active == counted
+    print("%-4s point_stats.active_count (%d) == COUNT(*) (%d)"
+          % ("ok" if ok else "FAIL", counted, active))
+    failed += not ok
+
+    for what, sql in (("gps_points_rtree rows",
+                       "SELECT COUNT(*) FROM gps_points_rtree"),
+                      ("point_grid SUM(n)",
+                       "SELECT SUM(n) FROM point_grid")):
+        n = plan_conn.execute(sql).fetchone()[0]
+        print("%-4s %s (%d) == COUNT(*) (%d)"
+              % ("ok" if n == active else "FAIL", what, n, active))
+        failed += n != active
+
+    plan_conn.close()
+    shutil.rmtree(work, ignore_errors=True)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
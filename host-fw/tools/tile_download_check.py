@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""
+tile_download_check.py
+
+Runs base-rpi-fw/download_tiles.py against a local mock tile server and
+checks its concurrency limit, rate limit, retries and resume.
+
+The mock server answers /{z}/{x}/{y}.png with a small PNG-signed body that
+encodes z/x/y. It adds --latency-ms to each request and answers the first
+request for every 7th tile with 503 (to exercise the retry). It records the
+highest number of requests it had open at once and each request's arrival
+time.
+
+    1. a first run is SIGKILLed after --kill-after tiles were served
+    2. a second run resumes from the .part file and finishes
+    3. a third run finds everything present and requests nothing
+
+Checks: every tile is in the output with the right bytes and the .part file
+is gone, the second run re-requests no more than one commit's worth of
+tiles the first run already fetched, the third run makes no request, no more
+than --workers requests were open at once, and the request rate stayed
+within --rate.
+
+Usage: tile_download_check.py [--rpi-dir base-rpi-fw] [--workers 4]
+                              [--rate 400] [--kill-after 300]
+Exits 1 if any check fails.
+"""
+
+import argparse
+import http.server
+import os
+import re
+import shutil
+import signal
+import sqlite3
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+# The UF campus box; 686 tiles at zooms 15-18
+BBOX = "29.6350,-82.3700,29.6550,-82.3350"
+MIN_ZOOM = 15
+
+
+def tile_body(z, x, y):
+    return b"\x89PNG\r\n\x1a\n" + ("%d/%d/%d" % (z, x, y)).encode() * 20
+
+
+class MockTiles:
+    def __init__(self, latency_s):
+        self.latency_s = latency_s
+        self.lock = threading.Lock()
+        self.served = []            # (z, x, y) of every 200 answer
+        self.arrivals = []
+        self.open = 0
+        self.max_open = 0
+        self.failed_once = set()
+        self.on_served = None
+
+    def handle(self, path):
+        m = re.match(r"^/(\d+)/(\d+)/(\d+)\.png$", path)
+        if not m:
+            return 404, b""
+        z, x, y = (int(v) for v in m.groups())
+        with self.lock:
+            self.arrivals.append(time.monotonic())
+            self.open += 1
+            self.max_open = max(self.max_open, self.open)
+        try:
+            time.sleep(self.latency_s)
+            with self.lock:
+                if (x + y) % 7 == 0 and (z, x, y) not in self.failed_once:
+                    self.failed_once.add((z, x, y))
+                    return 503, b""
+                self.served.append((z, x, y))
+                n = len(self.served)
+            if self.on_served:
+                self.on_served(n)
+            return 200, tile_body(z, x, y)
+        finally:
+            with self.lock:
+                self.open -= 1
+
+
+def serve(mock):
+    class Handler(http.server.BaseHTTPRequestHandler):
+        def do_GET(self):
+            code, body = mock.handle(self.path)
+            self.send_response(code)
+            self.send_header("Content-Type", "image/png")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            try:
+                self.wfile.write(body)
+            except ConnectionError:
+                pass    # the downloader was killed mid-request
+
+        def log_message(self, *args):
+            pass
+
+    server = http.server.ThreadingHTTPServer(("127.0.0.1", 0), Handler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    return server
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--rpi-dir", default=os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "..", "..", "base-rpi-fw"))
+    ap.add_argument("--workers", type=int, default=4)
+    ap.add_argument("--rate", type=float, default=400.0)
+    ap.add_argument("--latency-ms", type=float, default=10.0)
+    ap.add_argument("--max-zoom", type=int, default=18)
+    ap.add_argument("--kill-after", type=int, default=300)
+    args = ap.parse_args()
+
+    script = os.path.join(os.path.abspath(args.rpi_dir), "download_tiles.py")
+    sys.path.insert(0, os.path.abspath(args.rpi_dir))
+    import download_tiles
+
+    work = tempfile.mkdtemp(prefix="tile_download_check_")
+    output = os.path.join(work, "field.mbtiles")
+    mock = MockTiles(args.latency_ms / 1000.0)
+    server = serve(mock)
+    url = "http://127.0.0.1:%d/{z}/{x}/{y}.png" % server.server_address[1]
+
+    cmd = [sys.executable, script, "--bbox", BBOX, "--min-zoom", str(MIN_ZOOM),
+           "--max-zoom", str(args.max_zoom), "--output", output, "--url", url,
+           "--workers", str(args.workers), "--rate", str(args.rate)]
+
+    bbox = dict(zip(("min_lat", "min_lon", "max_lat", "max_lon"),
+                    (float(v) for v in BBOX.split(","))))
+    expected = set()
+    for z in range(MIN_ZOOM, args.max_zoom + 1):
+        x_min, x_max, y_min, y_max = download_tiles.tile_range(bbox, z)
+        expected |= {(z, x, y) for x in range(x_min, x_max + 1)
+                     for y in range(y_min, y_max + 1)}
+
+    def run(kill_after=None):
+        start = len(mock.served)
+        proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL)
+        if kill_after is not None:
+            def on_served(n):
+                if n - start >= kill_after:
+                    mock.on_served = None
+                    proc.send_signal(signal.SIGKILL)
+            mock.on_served = on_served
+        t0 = time.monotonic()
+        code = proc.wait()
+        mock.on_served = None
+        return code, mock.served[start:], t0
+
+    failed = 0
+
+    def check(ok, what):
+        nonlocal failed
+        print("%-4s %s" % ("ok" if ok else "FAIL", what))
+        failed += not ok
+
+    print("%d tiles, zooms %d-%d, %d workers, %.0f req/s limit"
+          % (len(expected), MIN_ZOOM, args.max_zoom, args.workers, args.rate))
+
+    code1, first, _ = run(kill_after=args.kill_after)
+    check(code1 != 0 and os.path.exists(output + ".part"),
+          "run 1 killed after %d tiles, .part kept" % len(first))
+
+    code2, second, t0 = run()
+    again = set(first) & set(second)
+    check(code2 == 0, "run 2 finished (%d tiles)" % len(second))
+    check(len(again) <= download_tiles.COMMIT_EVERY + args.workers * 4,
+          "run 2 re-fetched %d tile(s) from run 1 (uncommitted at the kill)"
+          % len(again))
+
+    arrivals = [t for t in mock.arrivals if t >= t0]
+    if len(arrivals) > 1:
+        rate = (len(arrivals) - 1) / (arrivals[-1] - arrivals[0])
+        check(rate <= args.rate * 1.05,
+              "run 2 request rate %.0f/s within %.0f/s" % (rate, args.rate))
+    check(mock.max_open <= args.workers,
+          "at most %d request(s) open at once (limit %d)"
+          % (mock.max_open, args.workers))
+
+    code3, third, _ = run()
+    check(code3 == 0 and not third, "run 3 requested %d tile(s)" % len(third))
+
+    conn = sqlite3.connect(output)
+    rows = conn.execute(
+        "SELECT zoom_level, tile_column, tile_row, tile_data FROM tiles").fetchall()
+    conn.close()
+    got = {(z, x, (1 << z) - 1 - row): bytes(data) for z, x, row, data in rows}
+    check(set(got) == expected
+          and all(got[t] == tile_body(*t) for t in expected),
+          "output holds all %d tiles with the right bytes" % len(expected))
+    check(not os.path.exists(output + ".part"), ".part file renamed away")
+
+    server.shutdown()
+    shutil.rmtree(work, ignore_errors=True)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
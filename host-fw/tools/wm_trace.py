@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+"""
+wm_trace.py
+
+Turns hot-path trace dumps (components/trace/include/trace.h) into Chrome
+trace JSON, which chrome://tracing and ui.perfetto.dev both open.
+
+Inputs may be:
+    - console captures holding "WMTRACE <hex>" lines, each dump ending with
+      "WMTRACE END" (idf.py monitor logs from the base or the shears)
+    - raw dumps as written by wm_sim --trace=FILE
+
+Every dump becomes one process (shears / base / host). Within it, each core
+gets one track per lane, where a lane groups the trace points one task
+hits, so begin/end pairs always nest. Timestamps start at the earliest event in the dump; the 32-bit cycle
+counter is unwrapped in ring order, so gaps longer than one wrap (~17 s at
+240 MHz) fold.
+
+Usage: wm_trace.py [--mhz=N] INPUT... > trace.json
+"""
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+MAGIC = b"WMTR"
+VERSION = 1
+HEADER = struct.Struct("<4sBBBBI")
+CORE = struct.Struct("<BBHI")
+EVENT = struct.Struct("<IHH")
+
+SOURCES = {0: "host", 1: "shears", 2: "base"}
+
+# trace_id_t — append only, never renumber (must match trace.h)
+NAMES = {
+    1: "cut_press",
+    2: "gga_captured",
+    3: "save",
+    4: "storage_append",
+    5: "fopen",
+    6: "fprintf",
+    7: "fclose",
+    8: "segment_announce",
+    9: "chunk_notify",
+    32: "data_notify_rx",
+    33: "chunk_fwrite",
+    34: "uart_segment",
+}
+
+# Task that records each id; spans of one lane never interleave.
+LANES = {
+    1: "gps / save", 2: "gps / save", 3: "gps / save", 4: "gps / save",
+    5: "gps / save", 6: "gps / save", 7: "gps / save", 8: "gps / save",
+    9: "ble tx",
+    32: "ble rx", 33: "ble rx",
+    34: "uart",
+}
+LANE_ORDER = ["gps / save", "ble tx", "ble rx", "uart", "other"]
+
+PHASES = {0: "i", 1: "B", 2: "E"}
+
+_LINE = re.compile(r"WMTRACE (END|[0-9a-fA-F]+)\s*$")
+
+
+class TraceError(Exception):
+    """Raised when a dump is malformed."""
+
+
+def dumps_from_log(text):
+    """Yield the byte string of every WMTRACE dump in a console capture."""
+    buf = bytearray()
+    for line in text.splitlines():
+        m = _LINE.search(line)
+        if not m:
+            continue
+        if m.group(1) == "END":
+            yield bytes(buf)
+            buf = bytearray()
+        else:
+            buf.extend(bytes.fromhex(m.group(1)))
+    if buf:
+        yield bytes(buf)    # capture cut off before END
+
+
+def dumps_from_file(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data.startswith(MAGIC):
+        # Raw dumps may be concatenated.
+        while data:
+            if not data.startswith(MAGIC):
+                raise TraceError("%s: trailing bytes after the last dump" % path)
+            size = dump_size(data)
+            yield data[:size]
+            data = data[size:]
+    else:
+        yield from dumps_from_log(data.decode("utf-8", errors="replace"))
+
+
+def dump_size(data):
+    """Length of the dump at the start of data."""
+    try:
+        _, _, _, cores, _, _ = HEADER.unpack_from(data, 0)
+        pos = HEADER.size
+        for _ in range(cores):
+            _, _, n, _ = CORE.unpack_from(data, pos)
+            pos += CORE.size + n * EVENT.size
+    except struct.error:
+        raise TraceError("dump truncated")
+    return pos
+
+
+def parse(dump):
+    """Return (source, mhz, {core: [(cycles, id, phase, arg), ...]}, overwritten)."""
+    if len(dump) < HEADER.size or not dump.startswith(MAGIC):
+        raise TraceError("missing WMTR header")
+    _, ver, source, cores, _, mhz = HEADER.unpack_from(dump, 0)
+    if ver != VERSION:
+        raise TraceError("unsupported dump version %d" % ver)
+
+    pos = HEADER.size
+    rings = {}
+    overwritten = 0
+    for _ in range(cores):
+        if pos + CORE.size > len(dump):
+            raise TraceError("dump truncated")
+        core, _, n, lost = CORE.unpack_from(dump, pos)
+        pos += CORE.size
+        if pos + n * EVENT.size > len(dump):
+            raise TraceError("dump truncated")
+        events = []
+        for _ in range(n):
+            cycles, word, arg = EVENT.unpack_from(dump, pos)
+            pos += EVENT.size
+            events.append((cycles, word & 0x3FFF, word >> 14, arg))
+        rings[core] = events
+        overwritten += lost
+    return source, mhz, rings, overwritten
+
+
+def unwrap(events, mhz):
+    """Absolute cycle counts for one ring, in ring order."""
+    # A slot claimed just before an ISR can carry a slightly later stamp
+    # than the ISR's own event; treat short backward steps as that.
+    slack = mhz * 1000
+    out = []
+    t = None
+    prev = None
+    for cycles, *rest in events:
+        if t is None:
+            t = cycles
+        else:
+            delta = (cycles - prev) & 0xFFFFFFFF
+            if delta > 0xFFFFFFFF - slack:
+                delta -= 1 << 32
+            t += delta
+        prev = cycles
+        out.append((t, *rest))
+    return out
+
+
+def to_chrome(dumps, mhz_override=None):
+    trace = []
+    named = set()
+    for pid, dump in enumerate(dumps, start=1):
+        source, mhz, rings, overwritten = parse(dump)
+        mhz = mhz_override or mhz or 240
+
+        name = SOURCES.get(source, "source_%d" % source)
+        trace.append({"ph": "M", "pid": pid, "name": "process_name",
+                      "args": {"name": "%s (dump %d)" % (name, pid)}})
+        if overwritten:
+            print("%s dump %d: %d older events overwritten" % (name, pid, overwritten),
+                  file=sys.stderr)
+
+        timed = {core: unwrap(events, mhz) for core, events in rings.items() if events}
+        if not timed:
+            continue
+        origin = min(events[0][0] for events in timed.values())
+
+        for core, events in sorted(timed.items()):
+            for t, eid, phase, arg in events:
+                lane = LANES.get(eid, "other")
+                tid = core * len(LANE_ORDER) + LANE_ORDER.index(lane)
+                if (pid, tid) not in named:
+                    named.add((pid, tid))
+                    trace.append({"ph": "M", "pid": pid, "tid": tid, "name": "thread_name",
+                                  "args": {"name": "core %d: %s" % (core, lane)}})
+                ev = {
+                    "name": NAMES.get(eid, "id_%d" % eid),
+                    "ph": PHASES.get(phase, "i"),
+                    "ts": (t - origin) / mhz,
+                    "pid": pid,
+                    "tid": tid,
+                    "args": {"arg": arg},
+                }
+                if ev["ph"] == "i":
+                    ev["s"] = "t"
+                trace.append(ev)
+
+    return {"traceEvents": trace, "displayTimeUnit": "ns"}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[1])
+    ap.add_argument("inputs", nargs="+")
+    ap.add_argument("--mhz", type=int, help="CPU clock if it differs from the dump header")
+    args = ap.parse_args()
+
+    try:
+        dumps = [d for path in args.inputs for d in dumps_from_file(path) if d]
+        if not dumps:
+            sys.exit("no trace dumps found (is CONFIG_WM_TRACE enabled?)")
+        json.dump(to_chrome(dumps, args.mhz), sys.stdout)
+    except TraceError as e:
+        sys.exit("bad dump: %s" % e)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
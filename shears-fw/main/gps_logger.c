@@ -7,7 +7,19 @@
  *   - configure UART2 for 115200 baud NMEA input
  *   - keep the most recent full NMEA sentence in latestNmea[]
  *   - accept save requests from a GPIO button or gpsLoggerRequestSave()
- *   - on save, append one $GNGGA row to gps_points.csv
+ *   - on save, append one $GNGGA row to the head log segment and tell the
+ *     transfer server, which seals and announces it once it is worth sending
+ *   - post beeps / LED changes to shears_feedback without waiting on them
+ *   - track save latency (trigger -> row on flash) and log the worst case;
+ *     cut-to-fix and save times also go to the metrics registry, and the
+ *     path is marked with trace points (trace.h) in debug builds
+ *   - park the GNSS receiver in backup while SAFE and wake it on prime
+ *     (shears_gnssPower); NMEA is only parsed while it is awake
+ *
+ * Both tasks block until there is work: uartReadTask on the UART driver's
+ * event queue, saveTask on its task notification bits (set from the button
+ * ISRs, the reader task and the clear-hold timer). Nothing polls, so the
+ * chip can light-sleep between events.
  *
  * Note:
  *   - SPIFFS is mounted elsewhere (app_main). This module only uses the filesystem.
@@ -15,10 +27,15 @@
 
 #include "gps_logger.h"
 #include "shears_piezo.h"
+#include "shears_feedback.h"
+#include "shears_power.h"
+#include "shears_gnssPower.h"
 #include "shears_primeSwitch.h"
 #include "shears_gpsButtons.h"
 #include "shears_gpsStorage.h"
 #include "log_transfer_server.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <stdint.h>
 #include <string.h>
@@ -30,41 +47,49 @@
 
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
 
-#include "log_paths.h"
-
 #define GPS_UART_NUM   UART_NUM_2
 #define GPS_UART_RX    GPIO_NUM_16
 #define GPS_UART_TX    GPIO_NUM_17
 #define GPS_BUF_SIZE   512
-
-#define LED_STATUS_PIN      GPIO_NUM_32
+#define GPS_UART_QUEUE_LEN  10
 
 #define CLEAR_HOLD_US         5000000
 #define TRIGGER_DEBOUNCE_US   400000
-#define LED_BLINK_ON_MS       200
-#define LED_BLINK_OFF_MS      200
+#define CLEAR_TONE_MS         2000
+
+/* saveTask notification bits */
+#define SAVE_EVT_SAVE         (1u << 0)   /* GGA captured or gpsLoggerRequestSave() */
+#define SAVE_EVT_PRIME        (1u << 1)   /* prime switch changed */
+#define SAVE_EVT_GPS_BUTTON   (1u << 2)   /* GPS button pressed or released */
+#define SAVE_EVT_CLEAR_HOLD   (1u << 3)   /* GPS button held for CLEAR_HOLD_US */
 
 static const char *TAG = "gps_logger";
 
+static TaskHandle_t saveTaskHandle = NULL;
+static QueueHandle_t gpsUartQueue = NULL;
+static esp_timer_handle_t clearHoldTimer = NULL;
+
 static char latestNmea[GPS_BUF_SIZE];
 static char latestDate[8] = {0};
 
 static volatile bool nmeaValid = false;
 static volatile bool saveRequestedFlag = false;
 
-static volatile bool clearRequestedFlag = false;
 static int64_t buttonPressTimeUs = 0;
 
-static volatile bool clearBeepRequested = false;
-static volatile int cutBeepCount = 0;
-
 static volatile bool gpsButtonHeld = false;
-static volatile bool clearTriggered = false;
 
 static volatile bool captureNextGGA = false;
 static volatile int64_t lastTriggerPressUs = 0;
+static volatile int64_t primeEdgeUs = 0;
+
+/* Save latency instrumentation (all times from esp_timer_get_time()). */
+static volatile int64_t ggaCapturedUs = 0;
+static int64_t maxSaveUs = 0;       /* GGA captured -> row stored */
+static int64_t maxTriggerUs = 0;    /* trigger press -> row stored */
 
 static void uartReadTask(void *arg);
 static void saveTask(void *arg);
@@ -76,13 +101,42 @@ static void onPrimeLevel(int level);
 static void onGpsButtonLevel(int level);
 static void onCutPress(gpio_num_t pin);
 
+static void IRAM_ATTR notifySaveTaskFromIsr(uint32_t bits)
+{
+	if (!saveTaskHandle) {
+		return;
+	}
+
+	BaseType_t hpTaskWoken = pdFALSE;
+	xTaskNotifyFromISR(saveTaskHandle, bits, eSetBits, &hpTaskWoken);
+	if (hpTaskWoken) {
+		portYIELD_FROM_ISR();
+	}
+}
+
+static void notifySaveTask(uint32_t bits)
+{
+	if (saveTaskHandle) {
+		xTaskNotify(saveTaskHandle, bits, eSetBits);
+	}
+}
+
+static void clearHoldTimerCb(void *arg)
+{
+	(void)arg;
+	notifySaveTask(SAVE_EVT_CLEAR_HOLD);
+}
+
 static void IRAM_ATTR onPrimeLevel(int level)
 {
 	shearsPrimeSwitchUpdateFromLevel(level);
+	primeEdgeUs = esp_timer_get_time();
 
 	if (shearsPrimeSwitchConsumeUnprimedEdge()) {
 		captureNextGGA = false;
 	}
+
+	notifySaveTaskFromIsr(SAVE_EVT_PRIME);
 }
 
 static bool IRAM_ATTR registerTriggerPress(void)
@@ -101,7 +155,7 @@ static void IRAM_ATTR onGpsButtonLevel(int level)
 	if (level == 0) {
 		buttonPressTimeUs = esp_timer_get_time();
 		gpsButtonHeld = true;
-		clearTriggered = false;
+		notifySaveTaskFromIsr(SAVE_EVT_GPS_BUTTON);
 		return;
 	}
 
@@ -109,7 +163,7 @@ static void IRAM_ATTR onGpsButtonLevel(int level)
 	int64_t timeDiff = nowTime - buttonPressTimeUs;
 
 	gpsButtonHeld = false;
-	clearTriggered = false;
+	notifySaveTaskFromIsr(SAVE_EVT_GPS_BUTTON);
 
 	if (timeDiff < CLEAR_HOLD_US) {
 		if (shearsPrimeSwitchIsPrimed() && !captureNextGGA) {
@@ -124,6 +178,7 @@ static void IRAM_ATTR onGpsButtonLevel(int level)
 static void IRAM_ATTR onCutPress(gpio_num_t pin)
 {
 	(void)pin;
+	TRACE_INSTANT(TRACE_ID_CUT_PRESS, pin);
 
 	if (shearsPrimeSwitchIsPrimed() && !captureNextGGA) {
 		if (registerTriggerPress()) {
@@ -145,117 +200,188 @@ static const char *nmeaField(const char *sentence, int fieldNum)
     return p;
 }
 
-static void uartReadTask(void *arg)
+static void handleNmeaBytes(const uint8_t *data, int len)
 {
-	(void)arg;
-
-	uint8_t data[GPS_BUF_SIZE];
 	static char nmea_buf[GPS_BUF_SIZE];
-	size_t nmea_len = 0;
+	static size_t nmea_len = 0;
 
-	while (1) {
-		int len = uart_read_bytes(GPS_UART_NUM,
-		                          data,
-		                          GPS_BUF_SIZE - 1,
-		                          pdMS_TO_TICKS(100));
+	/* Drop anything left over from before the receiver went to backup. */
+	if (!shearsGnssPowerIsActive()) {
+		nmea_len = 0;
+		return;
+	}
 
-		if (len > 0) {
-			for (int i = 0; i < len; i++) {
-				char c = (char)data[i];
+	for (int i = 0; i < len; i++) {
+		char c = (char)data[i];
+
+		if (nmea_len < GPS_BUF_SIZE - 1) {
+			nmea_buf[nmea_len++] = c;
+		}
 
-				if (nmea_len < GPS_BUF_SIZE - 1) {
-					nmea_buf[nmea_len++] = c;
+		if (c == '\n') {
+			nmea_buf[nmea_len] = '\0';
+
+			/* Always grab date from RMC when available */
+			if (strncmp(nmea_buf, "$GNRMC,", 7) == 0) {
+				const char *dateField = nmeaField(nmea_buf, 9);
+				if (dateField && dateField[0] != ',' && dateField[0] != '*') {
+					strncpy(latestDate, dateField, 6);
+						latestDate[6] = '\0';
 				}
+			}
 
-				if (c == '\n') {
-					nmea_buf[nmea_len] = '\0';
+			/* Fix quality drives the time-to-fix metrics */
+			if (strncmp(nmea_buf, "$GNGGA,", 7) == 0) {
+				const char *qualityField = nmeaField(nmea_buf, 6);
+				if (qualityField && *qualityField >= '0' && *qualityField <= '9') {
+					shearsGnssPowerOnGga(*qualityField - '0');
+				}
+			}
 
-					/* Always grab date from RMC when available */
-					if (strncmp(nmea_buf, "$GNRMC,", 7) == 0) {
-						const char *dateField = nmeaField(nmea_buf, 9);
-						if (dateField && dateField[0] != ',' && dateField[0] != '*') {
-							strncpy(latestDate, dateField, 6);
-								latestDate[6] = '\0';
-						}
-					}
+			/* Capture GGA sentence when requested */
+			if (captureNextGGA && strncmp(nmea_buf, "$GNGGA,", 7) == 0) {
+				strncpy(latestNmea, nmea_buf, GPS_BUF_SIZE);
+				nmeaValid = true;
+
+				TRACE_INSTANT(TRACE_ID_GGA_CAPTURED, 0);
+				ggaCapturedUs = esp_timer_get_time();
+				metrics_observe_us(METRIC_HIST_CUT_TO_FIX, ggaCapturedUs - lastTriggerPressUs);
+				captureNextGGA = false;
+				saveRequestedFlag = true;
+				notifySaveTask(SAVE_EVT_SAVE);
+			}
 
-					/* Capture GGA sentence when requested */
-					if (captureNextGGA && strncmp(nmea_buf, "$GNGGA,", 7) == 0) {
-						strncpy(latestNmea, nmea_buf, GPS_BUF_SIZE);
-						nmeaValid = true;
+			nmea_len = 0;
+		}
+	}
+}
 
-						captureNextGGA = false;
-						saveRequestedFlag = true;
-					}
+static void uartReadTask(void *arg)
+{
+	(void)arg;
+
+	uint8_t data[GPS_BUF_SIZE];
+
+	while (1) {
+		uart_event_t event;
+		if (xQueueReceive(gpsUartQueue, &event, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
 
-					nmea_len = 0;
+		shearsPowerCountWakeup(SHEARS_WAKE_GPS_UART);
+
+		switch (event.type) {
+		case UART_DATA: {
+			size_t pending = event.size;
+			while (pending > 0) {
+				size_t want = (pending < sizeof(data)) ? pending : sizeof(data);
+				int len = uart_read_bytes(GPS_UART_NUM, data, want, 0);
+				if (len <= 0) {
+					break;
 				}
+				handleNmeaBytes(data, len);
+				pending -= (size_t)len;
 			}
+			break;
 		}
 
-		vTaskDelay(pdMS_TO_TICKS(10));
+		case UART_FIFO_OVF:
+		case UART_BUFFER_FULL:
+			ESP_LOGW(TAG, "GPS UART overflow; flushing");
+			uart_flush_input(GPS_UART_NUM);
+			xQueueReset(gpsUartQueue);
+			break;
+
+		default:
+			break;
+		}
 	}
 }
 
-static void requestCutFeedback(void)
+static void IRAM_ATTR requestCutFeedback(void)
 {
-	cutBeepCount++;
+	shearsFeedbackBeepsFromIsr(1);
+}
+
+static void recordSaveLatency(void)
+{
+	int64_t nowUs = esp_timer_get_time();
+	int64_t saveUs = nowUs - ggaCapturedUs;
+	int64_t triggerUs = nowUs - lastTriggerPressUs;
+
+	if (saveUs > maxSaveUs) {
+		maxSaveUs = saveUs;
+	}
+	if (triggerUs > maxTriggerUs) {
+		maxTriggerUs = triggerUs;
+	}
+
+	ESP_LOGI(TAG, "Save latency: %lld ms from fix (max %lld), %lld ms from trigger (max %lld)",
+	         (long long)(saveUs / 1000), (long long)(maxSaveUs / 1000),
+	         (long long)(triggerUs / 1000), (long long)(maxTriggerUs / 1000));
+
+	metrics_observe_us(METRIC_HIST_SAVE, saveUs);
+
+	shearsGnssPowerRecordCut(lastTriggerPressUs, nowUs);
 }
 
 static void saveTask(void *arg)
 {
 	(void)arg;
 
-	while (1) {
-		static int64_t lastBlinkUs = 0;
-		static bool ledOn = true;
+	bool ledPrimed = false;
+
+	/* Apply the startup prime state before waiting for the first event. */
+	uint32_t events = SAVE_EVT_PRIME;
 
+	while (1) {
 		bool primed = shearsPrimeSwitchIsPrimed();
 
-		if (gpsButtonHeld && !primed && !clearTriggered) {
-			int64_t nowUs = esp_timer_get_time();
-			if ((nowUs - buttonPressTimeUs) >= CLEAR_HOLD_US) {
-				clearTriggered = true;
-				clearRequestedFlag = true;
-				clearBeepRequested = true;
+		if (events & SAVE_EVT_GPS_BUTTON) {
+			/* (Re)start the hold timer on press, cancel it on release. */
+			esp_timer_stop(clearHoldTimer);
+			if (gpsButtonHeld) {
+				esp_timer_start_once(clearHoldTimer, CLEAR_HOLD_US);
 			}
 		}
 
-		if (clearRequestedFlag) {
-			clearRequestedFlag = false;
-
-			shearsGpsStorageClearCsv(GPS_LOG_FILE_PATH);
+		if ((events & SAVE_EVT_CLEAR_HOLD) && gpsButtonHeld && !primed) {
+			shearsGpsStorageClearAll();
 
 			memset(latestNmea, 0, sizeof(latestNmea));
 			nmeaValid = false;
 
-			if (clearBeepRequested) {
-				clearBeepRequested = false;
-				shearsPiezoToneMs(2000);
-			}
-		} else if (saveRequestedFlag) {
+			shearsFeedbackTone(CLEAR_TONE_MS);
+		} else if ((events & SAVE_EVT_SAVE) && saveRequestedFlag) {
 			saveRequestedFlag = false;
 
 			if (nmeaValid) {
 				bool saveOk;
+				char segPath[40];
 
+				TRACE_BEGIN(TRACE_ID_SAVE, 0);
 				ESP_LOGI(TAG, "Save requested; latest NMEA: %s", latestNmea);
 
-				saveOk = shearsGpsStorageAppendGngga(GPS_LOG_FILE_PATH, latestNmea, latestDate);
+				/* Remember where the row lands; the append may seal that segment. */
+				shearsGpsStorageGetHeadPath(segPath, sizeof(segPath));
+				saveOk = shearsGpsStorageAppendCut(latestNmea, latestDate);
 
 				if (!saveOk) {
 					ESP_LOGW(TAG, "GPS save failed; playing no-signal feedback");
-					shearsPiezoBeepPattern(4);
+					metrics_inc(METRIC_SAVES_FAILED);
+					shearsFeedbackBeeps(4);
 				} else {
-					shearsGpsStoragePrintNewest(GPS_LOG_FILE_PATH, 5);
-
-					if (log_transfer_server_isConnected() &&
-					    !log_transfer_server_isTransferActive()) {
-						if (!log_transfer_server_startTransfer("gps_points.csv")) {
-							ESP_LOGW(TAG, "Failed to start log transfer after save");
-						}
-					}
+					metrics_inc(METRIC_CUTS_SAVED);
+					recordSaveLatency();
+
+					shearsGpsStoragePrintNewest(segPath, 5);
+
+					/* Let the base pull the cut once its segment is sealed. */
+					TRACE_BEGIN(TRACE_ID_SEGMENT_ANNOUNCE, 0);
+					log_transfer_server_announceSegments();
+					TRACE_END(TRACE_ID_SEGMENT_ANNOUNCE, 0);
 				}
+				TRACE_END(TRACE_ID_SAVE, saveOk);
 
 				nmeaValid = false;
 				memset(latestNmea, 0, sizeof(latestNmea));
@@ -264,39 +390,32 @@ static void saveTask(void *arg)
 			}
 		}
 
-		if (shearsPrimeSwitchConsumePrimedEdge()) {
-			shearsPiezoBeepPattern(3);
-		}
+		if (events & SAVE_EVT_PRIME) {
+			if (shearsPrimeSwitchConsumePrimedEdge()) {
+				shearsFeedbackBeeps(3);
+			}
 
-		if (cutBeepCount > 0) {
-			int count = cutBeepCount;
-			cutBeepCount = 0;
-			shearsPiezoBeepPattern(count);
-		}
+			if (primed != ledPrimed) {
+				ledPrimed = primed;
+				shearsFeedbackSetStatusBlink(primed);
 
-		if (!primed) {
-			if (!ledOn) {
-				ledOn = true;
-				gpio_set_level(LED_STATUS_PIN, 1);
-			}
-		} else {
-			int64_t nowUs = esp_timer_get_time();
-			int64_t intervalUs = (ledOn ? LED_BLINK_ON_MS : LED_BLINK_OFF_MS) * 1000;
-			if ((nowUs - lastBlinkUs) >= intervalUs) {
-				ledOn = !ledOn;
-				gpio_set_level(LED_STATUS_PIN, ledOn ? 1 : 0);
-				lastBlinkUs = nowUs;
+				/* NMEA bytes are lost across light sleep; stay awake while a cut can happen. */
+				shearsPowerSetAwake(SHEARS_AWAKE_PRIMED, primed);
+
+				/* Receiver follows the switch: hot start on prime, backup when SAFE. */
+				shearsGnssPowerSetPrimed(primed, primeEdgeUs);
 			}
 		}
 
-		vTaskDelay(pdMS_TO_TICKS(10));
+		xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+		shearsPowerCountWakeup(SHEARS_WAKE_SAVE_TASK);
 	}
 }
 
 void gpsLoggerInit(void)
 {
-	/* SPIFFS is mounted outside this module. Just ensure our file exists. */
-	shearsGpsStorageEnsureCsvExists(GPS_LOG_FILE_PATH);
+	/* SPIFFS is mounted outside this module. Just locate the head segment. */
+	shearsGpsStorageSegmentsInit();
 
 	uart_config_t uart_config = {
 		.baud_rate = 115200,
@@ -312,10 +431,21 @@ void gpsLoggerInit(void)
 	             GPS_UART_RX,
 	             UART_PIN_NO_CHANGE,
 	             UART_PIN_NO_CHANGE);
-	uart_driver_install(GPS_UART_NUM, GPS_BUF_SIZE * 2, 0, 0, NULL, 0);
+	uart_driver_install(GPS_UART_NUM, GPS_BUF_SIZE * 2, 0,
+	                    GPS_UART_QUEUE_LEN, &gpsUartQueue, 0);
 
 	ESP_LOGI(TAG, "UART2 configured for GPS at 115200 baud");
 
+	const esp_timer_create_args_t clearHoldArgs = {
+		.callback = clearHoldTimerCb,
+		.name     = "gps_clear_hold"
+	};
+	esp_timer_create(&clearHoldArgs, &clearHoldTimer);
+
+	/* Feedback first: the button ISRs post cut beeps to it. */
+	shearsPiezoInit();
+	shearsFeedbackInit();
+
 	shearsPrimeSwitchInit(gpio_get_level(SHEARS_PRIME_BUTTON_PIN));
 
 	shearsGpsButtonsCallbacks_t callbacks = {
@@ -325,32 +455,24 @@ void gpsLoggerInit(void)
 	};
 	shearsGpsButtonsInit(&callbacks);
 
-	gpio_config_t out_conf = {
-		.pin_bit_mask = (1ULL << LED_STATUS_PIN),
-		.mode         = GPIO_MODE_OUTPUT,
-		.pull_up_en   = 0,
-		.pull_down_en = 0,
-		.intr_type    = GPIO_INTR_DISABLE
-	};
-	gpio_config(&out_conf);
-	gpio_set_level(LED_STATUS_PIN, 1);
-
-	shearsPiezoInit();
-
 	bool primed = shearsPrimeSwitchIsPrimed();
 
+	primeEdgeUs = esp_timer_get_time();
+	shearsGnssPowerInit(GPS_UART_NUM, primed);
+
 	ESP_LOGI(TAG, "Input interrupts configured on GPS=%d PRIME=%d CUT2=%d CUT3=%d",
 	         SHEARS_GPS_BUTTON_PIN, SHEARS_PRIME_BUTTON_PIN, SHEARS_CUT2_BUTTON_PIN, SHEARS_CUT3_BUTTON_PIN);
 	ESP_LOGI(TAG, "Prime switch startup state: %s", primed ? "PRIMED" : "SAFE");
 
+	xTaskCreate(saveTask, "gps_save_task", 4096, NULL, 5, &saveTaskHandle);
 	xTaskCreate(uartReadTask, "gps_uart_read", 4096, NULL, 5, NULL);
-	xTaskCreate(saveTask, "gps_save_task", 4096, NULL, 5, NULL);
 }
 
 void gpsLoggerRequestSave(void)
 {
 	if (nmeaValid) {
 		saveRequestedFlag = true;
+		notifySaveTask(SAVE_EVT_SAVE);
 	} else {
 		ESP_LOGW(TAG, "Save requested but no valid NMEA data available");
 	}
@@ -358,5 +480,8 @@ void gpsLoggerRequestSave(void)
 
 void gpsLoggerPrintCsv(void)
 {
-	shearsGpsStoragePrintNewest(GPS_LOG_FILE_PATH, 5);
+	char headPath[40];
+
+	shearsGpsStorageGetHeadPath(headPath, sizeof(headPath));
+	shearsGpsStoragePrintNewest(headPath, 5);
 }
@@ -4,7 +4,7 @@
  * GPS logging interface for the shears firmware.
  *
  * This module reads NMEA sentences from UART2 and appends $GPGGA fixes to
- * /spiffs/gps_points.csv. Save requests can come from a GPIO button interrupt
+ * the head log segment (/spiffs/gps_NNNNNN.csv). Save requests can come from a GPIO button interrupt
  * or from gpsLoggerRequestSave().
  */
 
@@ -22,7 +22,7 @@ void gpsLoggerInit(void);
 /* Triggers a save using the same internal path as the button press. */
 void gpsLoggerRequestSave(void);
 
-/* Prints /spiffs/gps_points.csv to the log (debug helper). */
+/* Prints the newest rows of the head segment to the log (debug helper). */
 void gpsLoggerPrintCsv(void);
 
 #ifdef __cplusplus
@@ -3,12 +3,22 @@
  *
  * Shears-side GATT server for BLE log transfer.
  *
- * Exposes a custom service that allows the base to request a file by name
- * and receive it as indexed chunks:
- *   - control characteristic: START_TRANSFER / ABORT writes, STATUS_* notifies
+ * Exposes a custom service that allows the base to list sealed log segments,
+ * request one by name and receive it as indexed chunks:
+ *   - control characteristic: START_TRANSFER / ABORT / LIST_SEGMENTS /
+ *     ACK_SEGMENT / TRACE_DUMP writes, STATUS_*, SEGMENT_LIST and TRACE
+ *     notifies
  *   - data characteristic: file chunk notifications with a chunk index
+ *   - diagnostics characteristic: read-only metrics snapshot (metrics.h)
  *
  * File data is read from SPIFFS and streamed out from a background task.
+ * Only sealed segments can be transferred; a segment is deleted once the
+ * base acknowledges it, while new cuts keep going to the head segment.
+ * When the base asks for LOG_XFER_ENC_DELTA_LZ, the file is first encoded
+ * into a sibling "<name>.wz" file and that file is streamed instead, unless
+ * it came out no smaller than the original. START_TRANSFER only queues the
+ * request; the task opens (and encodes) the file and sends STATUS_OK, so the
+ * NimBLE host task is never held up by file I/O.
  */
 
 #include <stdio.h>
@@ -16,15 +26,22 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "host/ble_hs.h"
 #include "host/ble_att.h"
 
 #include "log_transfer_server.h"
 #include "log_transfer_protocol.h"
+#include "log_codec.h"
+#include "log_paths.h"
+#include "log_segments.h"
 #include "shears_gpsStorage.h"
+#include "metrics.h"
+#include "trace.h"
 
 static const char *TAG = "log_xfer_srv";
 
@@ -32,12 +49,26 @@ static const char *TAG = "log_xfer_srv";
 #define LOG_SVC_UUID       0xFFF0
 #define LOG_CTRL_CHR_UUID  0xFFF1
 #define LOG_DATA_CHR_UUID  0xFFF2
+#define LOG_DIAG_CHR_UUID  0xFFF3
 
 #define LOG_TRANSFER_INVALID_CONN_HANDLE BLE_HS_CONN_HANDLE_NONE
 
+/* Suffix of the temporary file holding an encoded copy of the log. */
+#define LOG_ENCODED_SUFFIX ".wz"
+
+/*
+ * A head segment below GPS_LOG_SEGMENT_SEAL_BYTES is sealed after this long
+ * without a cut; the segment list is then repeated at this period until
+ * every sealed segment has been acknowledged.
+ */
+#define SEAL_IDLE_US (10 * 1000 * 1000)
+
 typedef struct {
 	bool		active;
+	bool		pending;	/* START queued, task has not opened it yet */
+	bool		abort_pending;	/* ABORT arrived while pending */
 	char		filename[64];
+	char		send_path[68];
 	FILE		*fp;
 	uint32_t	file_size;
 	uint32_t	bytes_sent;
@@ -46,12 +77,29 @@ typedef struct {
 	uint16_t	conn_handle;
 	uint16_t	ctrl_val_handle;
 	uint16_t	data_val_handle;
+	uint8_t		encoding;
+	uint8_t		preferred_encoding;
 } log_transfer_t;
 
 static log_transfer_t g_log_xfer;
 
+/* A START_TRANSFER handed from the GATT callback to the transfer task. */
+typedef struct {
+	uint16_t	conn_handle;
+	uint8_t		encoding;
+} start_request_t;
+
+static QueueHandle_t g_start_queue;
+
+/* Set by CTRL_CMD_TRACE_DUMP; the transfer task sends the dump when idle. */
+static volatile bool g_trace_dump_requested = false;
+
+/* Seals a partly filled head once cuts pause; see log_transfer_server_announceSegments(). */
+static esp_timer_handle_t g_seal_idle_timer;
+
 static uint16_t g_ctrl_char_handle = 0;
 static uint16_t g_data_char_handle = 0;
+static uint16_t g_diag_char_handle = 0;
 
 static int	log_ctrl_access_cb(uint16_t conn_handle,
 				   uint16_t attr_handle,
@@ -61,12 +109,21 @@ static int	log_data_access_cb(uint16_t conn_handle,
 				   uint16_t attr_handle,
 				   struct ble_gatt_access_ctxt *ctxt,
 				   void *arg);
+static int	log_diag_access_cb(uint16_t conn_handle,
+				   uint16_t attr_handle,
+				   struct ble_gatt_access_ctxt *ctxt,
+				   void *arg);
 static void	log_transfer_task(void *arg);
-static bool	start_transfer_internal(uint16_t conn_handle,
-					const uint8_t *filename_buf,
-					uint16_t filename_len);
+static bool	post_start_request(uint16_t conn_handle,
+				   const uint8_t *filename_buf,
+				   uint16_t filename_len,
+				   uint8_t encoding);
+static void	start_transfer_internal(const start_request_t *req);
+static void	remove_encoded_copy(void);
 static void	handle_abort_transfer(void);
 static void	send_status(ctrl_status_code_t status, uint32_t file_size);
+static void	send_segment_list(uint32_t after_seq);
+static void	handle_segment_ack(uint32_t seq);
 
 /* --- GATT service definition --------------------------------------------- */
 
@@ -87,6 +144,12 @@ static struct ble_gatt_svc_def log_svc_def[] = {
 				.flags	   = BLE_GATT_CHR_F_NOTIFY,
 				.val_handle = &g_data_char_handle,
 			},
+			{
+				.uuid	   = BLE_UUID16_DECLARE(LOG_DIAG_CHR_UUID),
+				.access_cb  = log_diag_access_cb,
+				.flags	   = BLE_GATT_CHR_F_READ,
+				.val_handle = &g_diag_char_handle,
+			},
 			{ 0 }
 		},
 	},
@@ -104,7 +167,7 @@ static void send_status(ctrl_status_code_t status, uint32_t file_size)
 		 g_log_xfer.ctrl_val_handle ? g_log_xfer.ctrl_val_handle
 					    : g_ctrl_char_handle);
 
-	uint8_t payload[1 + 1 + 4];
+	uint8_t payload[1 + 1 + 4 + 1];
 	uint16_t len = 0;
 
 	payload[len++] = CTRL_EVT_STATUS;
@@ -113,6 +176,7 @@ static void send_status(ctrl_status_code_t status, uint32_t file_size)
 	if (status == STATUS_OK) {
 		memcpy(&payload[len], &file_size, sizeof(file_size));
 		len += sizeof(file_size);
+		payload[len++] = g_log_xfer.encoding;
 	}
 
 	if (g_log_xfer.ctrl_val_handle == 0) {
@@ -132,6 +196,7 @@ static void send_status(ctrl_status_code_t status, uint32_t file_size)
 	struct os_mbuf *om = ble_hs_mbuf_from_flat(payload, len);
 	if (!om) {
 		ESP_LOGW(TAG, "send_status: allocation failed");
+		metrics_inc(METRIC_BLE_NOTIFY_ERRORS);
 		return;
 	}
 
@@ -140,51 +205,215 @@ static void send_status(ctrl_status_code_t status, uint32_t file_size)
 					 om);
 	if (rc != 0) {
 		ESP_LOGW(TAG, "STATUS notify failed rc=%d", rc);
+		metrics_inc(METRIC_BLE_NOTIFY_ERRORS);
 	}
 }
 
-/* --- Transfer helpers ----------------------------------------------------- */
+/* --- Segment listing ------------------------------------------------------ */
 
-static bool start_transfer_internal(uint16_t conn_handle,
-				    const uint8_t *filename_buf,
-				    uint16_t filename_len)
+static void send_segment_list(uint32_t after_seq)
 {
-	g_log_xfer.conn_handle = conn_handle;
+	if (!log_transfer_server_isConnected()) {
+		return;
+	}
 
-	/*
-	 * ATT MTU includes the ATT header.
-	 * Reserve 2 bytes in the payload for the chunk index.
-	 */
-	uint16_t mtu = ble_att_mtu(conn_handle);
+	if (g_log_xfer.ctrl_val_handle == 0) {
+		g_log_xfer.ctrl_val_handle = g_ctrl_char_handle;
+	}
+
+	/* Fit the whole event into one notification at the current MTU. */
+	uint16_t mtu = ble_att_mtu(g_log_xfer.conn_handle);
 	uint16_t maxNotif = (mtu > 3) ? (mtu - 3) : 0;
-	uint16_t maxPayload = (maxNotif > 2) ? (maxNotif - 2) : 0;
+	int maxEntries = (maxNotif > LOG_XFER_SEGMENT_LIST_HDR) ?
+			 (maxNotif - LOG_XFER_SEGMENT_LIST_HDR) / 4 : 0;
 
-	if (maxPayload == 0) {
-		send_status(STATUS_ERR_FS, 0);
-		if (g_log_xfer.fp) {
-			fclose(g_log_xfer.fp);
-			g_log_xfer.fp = NULL;
-		}
-		return false;
+	if (maxEntries > LOG_XFER_SEGMENT_LIST_MAX) {
+		maxEntries = LOG_XFER_SEGMENT_LIST_MAX;
+	}
+	if (maxEntries == 0) {
+		ESP_LOGW(TAG, "send_segment_list: MTU %u too small", mtu);
+		return;
 	}
 
-	if (maxPayload > 160) {
-		maxPayload = 160;
+	uint32_t seqs[LOG_XFER_SEGMENT_LIST_MAX];
+	bool more = false;
+	int count = shearsGpsStorageListSealed(after_seq, seqs, maxEntries, &more);
+
+	uint8_t payload[LOG_XFER_SEGMENT_LIST_HDR + 4 * LOG_XFER_SEGMENT_LIST_MAX];
+	uint16_t len = 0;
+	uint32_t epoch = shearsGpsStorageEpoch();
+
+	payload[len++] = CTRL_EVT_SEGMENT_LIST;
+	payload[len++] = (uint8_t)count;
+	payload[len++] = more ? 1 : 0;
+	memcpy(&payload[len], &epoch, sizeof(epoch));
+	len += sizeof(epoch);
+
+	for (int i = 0; i < count; i++) {
+		memcpy(&payload[len], &seqs[i], sizeof(seqs[i]));
+		len += sizeof(seqs[i]);
 	}
 
-	g_log_xfer.chunk_size = maxPayload;
+	ESP_LOGI(TAG, "SEGMENT_LIST after=%u: count=%d more=%d first=%u",
+		 after_seq, count, more, count > 0 ? seqs[0] : 0);
 
-	ESP_LOGI(TAG, "Using chunk_size=%u (mtu=%u, maxNotif=%u)",
-		 g_log_xfer.chunk_size, mtu, maxNotif);
+	struct os_mbuf *om = ble_hs_mbuf_from_flat(payload, len);
+	if (!om) {
+		ESP_LOGW(TAG, "send_segment_list: allocation failed");
+		metrics_inc(METRIC_BLE_NOTIFY_ERRORS);
+		return;
+	}
+
+	int rc = ble_gatts_notify_custom(g_log_xfer.conn_handle,
+					 g_log_xfer.ctrl_val_handle,
+					 om);
+	if (rc != 0) {
+		ESP_LOGW(TAG, "SEGMENT_LIST notify failed rc=%d", rc);
+		metrics_inc(METRIC_BLE_NOTIFY_ERRORS);
+	}
+}
+
+/* --- Trace dump ---------------------------------------------------------- */
+
+typedef struct {
+	uint8_t  buf[1 + 160];
+	uint16_t fill;
+	uint16_t cap;
+} trace_notify_t;
+
+static void trace_notify_flush(trace_notify_t *t)
+{
+	t->buf[0] = CTRL_EVT_TRACE;
+
+	struct os_mbuf *om = ble_hs_mbuf_from_flat(t->buf, 1 + t->fill);
+	int rc = om ? ble_gatts_notify_custom(g_log_xfer.conn_handle,
+					      g_log_xfer.ctrl_val_handle,
+					      om)
+		    : BLE_HS_ENOMEM;
+	if (rc != 0) {
+		ESP_LOGW(TAG, "TRACE notify failed rc=%d", rc);
+		metrics_inc(METRIC_BLE_NOTIFY_ERRORS);
+	}
+
+	t->fill = 0;
+	vTaskDelay(pdMS_TO_TICKS(10));
+}
+
+static void trace_notify_sink(const uint8_t *data, size_t len, void *ctx)
+{
+	trace_notify_t *t = (trace_notify_t *)ctx;
+
+	while (len > 0) {
+		size_t n = t->cap - t->fill;
+		if (n > len) {
+			n = len;
+		}
+		memcpy(&t->buf[1 + t->fill], data, n);
+		t->fill += n;
+		data += n;
+		len -= n;
+
+		if (t->fill == t->cap) {
+			trace_notify_flush(t);
+		}
+	}
+}
+
+/* Streams the trace rings as CTRL_EVT_TRACE notifications. */
+static void send_trace_dump(void)
+{
+	if (!log_transfer_server_isConnected()) {
+		return;
+	}
 
 	if (g_log_xfer.ctrl_val_handle == 0) {
 		g_log_xfer.ctrl_val_handle = g_ctrl_char_handle;
 	}
-	if (g_log_xfer.data_val_handle == 0) {
-		g_log_xfer.data_val_handle = g_data_char_handle;
+
+	uint16_t mtu = ble_att_mtu(g_log_xfer.conn_handle);
+	uint16_t maxNotif = (mtu > 3) ? (mtu - 3) : 0;
+
+	trace_notify_t t = { .fill = 0 };
+	t.cap = (maxNotif > 1) ? (maxNotif - 1) : 0;
+	if (t.cap > sizeof(t.buf) - 1) {
+		t.cap = sizeof(t.buf) - 1;
+	}
+	if (t.cap == 0) {
+		return;
+	}
+
+	size_t total = trace_serialize(TRACE_SOURCE_SHEARS, trace_notify_sink, &t);
+	if (t.fill > 0) {
+		trace_notify_flush(&t);
+	}
+	trace_notify_flush(&t);    /* Empty event: end of dump */
+
+	ESP_LOGI(TAG, "Trace dump sent (%u bytes)", (unsigned)total);
+}
+
+/* --- Transfer helpers ----------------------------------------------------- */
+
+static void remove_encoded_copy(void)
+{
+	if (g_log_xfer.encoding != LOG_XFER_ENC_RAW && g_log_xfer.send_path[0] != '\0') {
+		remove(g_log_xfer.send_path);
+	}
+}
+
+/*
+ * Encodes g_log_xfer.filename into "<filename>.wz" and points
+ * g_log_xfer.send_path at it. Falls back to a raw transfer of the file
+ * itself if encoding fails or does not make it smaller (a segment of a
+ * few rows is mostly header and literals).
+ */
+static void prepare_encoded_copy(void)
+{
+	char encPath[sizeof(g_log_xfer.send_path)];
+
+	int n = snprintf(encPath, sizeof(encPath), "%s" LOG_ENCODED_SUFFIX,
+			 g_log_xfer.filename);
+	if (n <= 0 || n >= (int)sizeof(encPath)) {
+		g_log_xfer.encoding = LOG_XFER_ENC_RAW;
+		return;
 	}
 
-	if (g_log_xfer.active) {
+	log_codec_stats_t stats;
+	int64_t startUs = esp_timer_get_time();
+
+	if (!log_codec_compress_file(g_log_xfer.filename, encPath, &stats)) {
+		ESP_LOGW(TAG, "Encoding '%s' failed; sending raw", g_log_xfer.filename);
+		remove(encPath);
+		g_log_xfer.encoding = LOG_XFER_ENC_RAW;
+		return;
+	}
+
+	if (stats.encodedBytes >= stats.rawBytes) {
+		ESP_LOGI(TAG, "Encoding saves nothing (%u -> %u bytes); sending raw",
+			 stats.rawBytes, stats.encodedBytes);
+		remove(encPath);
+		g_log_xfer.encoding = LOG_XFER_ENC_RAW;
+		return;
+	}
+
+	strcpy(g_log_xfer.send_path, encPath);
+
+	ESP_LOGI(TAG, "Encoded %u -> %u bytes (delta=%u) in %lld ms",
+		 stats.rawBytes, stats.encodedBytes, stats.deltaBytes,
+		 (long long)((esp_timer_get_time() - startUs) / 1000));
+}
+
+/*
+ * Runs in the GATT callback: checks the request and hands it to the
+ * transfer task. g_log_xfer.filename is only touched while idle.
+ */
+static bool post_start_request(uint16_t conn_handle,
+			       const uint8_t *filename_buf,
+			       uint16_t filename_len,
+			       uint8_t encoding)
+{
+	g_log_xfer.conn_handle = conn_handle;
+
+	if (g_log_xfer.active || g_log_xfer.pending) {
 		send_status(STATUS_ERR_BUSY, 0);
 		return false;
 	}
@@ -207,46 +436,136 @@ static bool start_transfer_internal(uint16_t conn_handle,
 		return false;
 	}
 
-	ESP_LOGI(TAG, "Start transfer for file '%s'", g_log_xfer.filename);
+	const start_request_t req = {
+		.conn_handle = conn_handle,
+		.encoding    = encoding,
+	};
+
+	g_log_xfer.pending = true;
+	g_log_xfer.abort_pending = false;
+	if (xQueueSend(g_start_queue, &req, 0) != pdTRUE) {
+		g_log_xfer.pending = false;
+		send_status(STATUS_ERR_BUSY, 0);
+		return false;
+	}
+
+	return true;
+}
+
+/* Runs in the transfer task for a request from post_start_request(). */
+static void start_transfer_internal(const start_request_t *req)
+{
+	uint16_t conn_handle = req->conn_handle;
+
+	/*
+	 * ATT MTU includes the ATT header.
+	 * Reserve 2 bytes in the payload for the chunk index.
+	 */
+	uint16_t mtu = ble_att_mtu(conn_handle);
+	uint16_t maxNotif = (mtu > 3) ? (mtu - 3) : 0;
+	uint16_t maxPayload = (maxNotif > 2) ? (maxNotif - 2) : 0;
+
+	if (maxPayload == 0) {
+		send_status(STATUS_ERR_FS, 0);
+		return;
+	}
+
+	if (maxPayload > 160) {
+		maxPayload = 160;
+	}
+
+	g_log_xfer.chunk_size = maxPayload;
+
+	ESP_LOGI(TAG, "Using chunk_size=%u (mtu=%u, maxNotif=%u)",
+		 g_log_xfer.chunk_size, mtu, maxNotif);
+
+	if (g_log_xfer.ctrl_val_handle == 0) {
+		g_log_xfer.ctrl_val_handle = g_ctrl_char_handle;
+	}
+	if (g_log_xfer.data_val_handle == 0) {
+		g_log_xfer.data_val_handle = g_data_char_handle;
+	}
+
+	ESP_LOGI(TAG, "Start transfer for file '%s' (encoding=%u)",
+		 g_log_xfer.filename, req->encoding);
+
+	/* The head segment is still being appended; only sealed ones are served. */
+	if (!shearsGpsStorageIsSealed(g_log_xfer.filename)) {
+		ESP_LOGW(TAG, "'%s' is not a sealed segment", g_log_xfer.filename);
+		send_status(STATUS_ERR_NO_FILE, 0);
+		return;
+	}
 
 	FILE *fp = fopen(g_log_xfer.filename, "rb");
 	if (!fp) {
 		ESP_LOGW(TAG, "File not found");
 		send_status(STATUS_ERR_NO_FILE, 0);
-		return false;
+		return;
+	}
+
+	g_log_xfer.encoding = (req->encoding == LOG_XFER_ENC_DELTA_LZ) ? LOG_XFER_ENC_DELTA_LZ
+								       : LOG_XFER_ENC_RAW;
+	strcpy(g_log_xfer.send_path, g_log_xfer.filename);
+
+	if (g_log_xfer.encoding != LOG_XFER_ENC_RAW) {
+		fclose(fp);
+		prepare_encoded_copy();
+
+		fp = fopen(g_log_xfer.send_path, "rb");
+		if (!fp) {
+			remove_encoded_copy();
+			send_status(STATUS_ERR_FS, 0);
+			return;
+		}
 	}
 
 	if (fseek(fp, 0, SEEK_END) != 0) {
 		fclose(fp);
+		remove_encoded_copy();
 		send_status(STATUS_ERR_FS, 0);
-		return false;
+		return;
 	}
 
 	long size = ftell(fp);
 	if (size < 0) {
 		fclose(fp);
+		remove_encoded_copy();
 		send_status(STATUS_ERR_FS, 0);
-		return false;
+		return;
 	}
 
 	if (fseek(fp, 0, SEEK_SET) != 0) {
 		fclose(fp);
+		remove_encoded_copy();
 		send_status(STATUS_ERR_FS, 0);
-		return false;
+		return;
+	}
+
+	/* The base gave up while the file was being encoded. */
+	if (g_log_xfer.abort_pending) {
+		fclose(fp);
+		remove_encoded_copy();
+		send_status(STATUS_TRANSFER_ABORTED, 0);
+		return;
 	}
 
-	g_log_xfer.active	 = true;
 	g_log_xfer.fp		 = fp;
 	g_log_xfer.file_size	 = (uint32_t)size;
 	g_log_xfer.bytes_sent	 = 0;
 	g_log_xfer.chunk_index	 = 0;
+	g_log_xfer.active	 = true;
 
 	send_status(STATUS_OK, g_log_xfer.file_size);
-	return true;
 }
 
 static void handle_abort_transfer(void)
 {
+	if (g_log_xfer.pending) {
+		/* The transfer task answers once it has dropped the request. */
+		g_log_xfer.abort_pending = true;
+		return;
+	}
+
 	if (!g_log_xfer.active) {
 		return;
 	}
@@ -256,10 +575,31 @@ static void handle_abort_transfer(void)
 		g_log_xfer.fp = NULL;
 	}
 
+	remove_encoded_copy();
+
 	g_log_xfer.active = false;
 	send_status(STATUS_TRANSFER_ABORTED, g_log_xfer.file_size);
 }
 
+/* The base has stored segment seq; it is safe to drop it here. */
+static void handle_segment_ack(uint32_t seq)
+{
+	char path[sizeof(g_log_xfer.filename)];
+	if (!log_segment_format_path(path, sizeof(path), seq)) {
+		return;
+	}
+
+	if ((g_log_xfer.active || g_log_xfer.pending) &&
+	    strcmp(path, g_log_xfer.filename) == 0) {
+		ESP_LOGW(TAG, "ACK for '%s' while it is being sent; ignored", path);
+		return;
+	}
+
+	if (!shearsGpsStorageDeleteSegment(path)) {
+		ESP_LOGW(TAG, "Failed to delete acknowledged segment '%s'", path);
+	}
+}
+
 /* --- Public API ----------------------------------------------------------- */
 
 void log_transfer_server_setConnection(uint16_t conn_handle)
@@ -270,6 +610,7 @@ void log_transfer_server_setConnection(uint16_t conn_handle)
 void log_transfer_server_clearConnection(void)
 {
 	g_log_xfer.conn_handle = LOG_TRANSFER_INVALID_CONN_HANDLE;
+	g_log_xfer.preferred_encoding = LOG_XFER_ENC_RAW;
 }
 
 bool log_transfer_server_isConnected(void)
@@ -279,7 +620,7 @@ bool log_transfer_server_isConnected(void)
 
 bool log_transfer_server_isTransferActive(void)
 {
-	return g_log_xfer.active;
+	return g_log_xfer.active || g_log_xfer.pending;
 }
 
 bool log_transfer_server_startTransfer(const char *filename)
@@ -299,9 +640,10 @@ bool log_transfer_server_startTransfer(const char *filename)
 		return false;
 	}
 
-	return start_transfer_internal(g_log_xfer.conn_handle,
-				       (const uint8_t *)filename,
-				       (uint16_t)strlen(filename));
+	return post_start_request(g_log_xfer.conn_handle,
+				  (const uint8_t *)filename,
+				  (uint16_t)strlen(filename),
+				  g_log_xfer.preferred_encoding);
 }
 
 void log_transfer_server_abortTransfer(void)
@@ -309,6 +651,49 @@ void log_transfer_server_abortTransfer(void)
 	handle_abort_transfer();
 }
 
+static void seal_and_announce(void)
+{
+	if (log_transfer_server_isConnected() && shearsGpsStorageSealHead()) {
+		send_segment_list(0);
+	}
+}
+
+static void seal_idle_timer_cb(void *arg)
+{
+	(void)arg;
+
+	if (!log_transfer_server_isConnected()) {
+		return;
+	}
+
+	shearsGpsStorageSealHead();
+
+	/* The list is a notify and may be lost; repeat it until the base has ACKed everything. */
+	uint32_t seq;
+	bool more;
+	if (shearsGpsStorageListSealed(0, &seq, 1, &more) > 0) {
+		send_segment_list(0);
+		esp_timer_start_once(g_seal_idle_timer, SEAL_IDLE_US);
+	}
+}
+
+void log_transfer_server_announceSegments(void)
+{
+	if (!log_transfer_server_isConnected()) {
+		return;
+	}
+
+	/*
+	 * Sealing every cut would leave one row per segment, which the codec
+	 * cannot compress. A row-sized head waits for more cuts instead.
+	 */
+	esp_timer_stop(g_seal_idle_timer);
+	if (shearsGpsStorageHeadBytes() >= GPS_LOG_SEGMENT_SEAL_BYTES) {
+		seal_and_announce();
+	}
+	esp_timer_start_once(g_seal_idle_timer, SEAL_IDLE_US);
+}
+
 /* --- GATT callbacks ------------------------------------------------------- */
 
 static int log_ctrl_access_cb(uint16_t conn_handle,
@@ -337,14 +722,55 @@ static int log_ctrl_access_cb(uint16_t conn_handle,
 	uint8_t opcode = buf[0];
 
 	switch ((ctrl_opcode_t)opcode) {
-	case CTRL_CMD_START_TRANSFER:
-		(void)start_transfer_internal(conn_handle, &buf[1], len - 1);
+	case CTRL_CMD_START_TRANSFER: {
+		/* [1..N] filename, NUL, optional encoding byte. */
+		uint16_t nameLen = 0;
+		while (1 + nameLen < len && buf[1 + nameLen] != '\0') {
+			nameLen++;
+		}
+
+		uint8_t encoding = LOG_XFER_ENC_RAW;
+		if (1 + nameLen + 1 < len) {
+			encoding = buf[1 + nameLen + 1];
+		}
+		g_log_xfer.preferred_encoding = encoding;
+
+		(void)post_start_request(conn_handle, &buf[1], nameLen, encoding);
 		break;
+	}
 
 	case CTRL_CMD_ABORT:
 		handle_abort_transfer();
 		break;
 
+	case CTRL_CMD_LIST_SEGMENTS: {
+		uint32_t afterSeq = 0;
+		if (len >= 1 + sizeof(afterSeq)) {
+			memcpy(&afterSeq, &buf[1], sizeof(afterSeq));
+		}
+
+		g_log_xfer.conn_handle = conn_handle;
+		shearsGpsStorageSealHead();
+		send_segment_list(afterSeq);
+		break;
+	}
+
+	case CTRL_CMD_ACK_SEGMENT: {
+		uint32_t seq = 0;
+		if (len < 1 + sizeof(seq)) {
+			break;
+		}
+
+		memcpy(&seq, &buf[1], sizeof(seq));
+		handle_segment_ack(seq);
+		break;
+	}
+
+	case CTRL_CMD_TRACE_DUMP:
+		g_log_xfer.conn_handle = conn_handle;
+		g_trace_dump_requested = true;
+		break;
+
 	default:
 		ESP_LOGW(TAG, "Unknown CTRL opcode 0x%02X", opcode);
 		break;
@@ -366,6 +792,33 @@ static int log_data_access_cb(uint16_t conn_handle,
 	return 0;
 }
 
+static int log_diag_access_cb(uint16_t conn_handle,
+			      uint16_t attr_handle,
+			      struct ble_gatt_access_ctxt *ctxt,
+			      void *arg)
+{
+	(void)conn_handle;
+	(void)attr_handle;
+	(void)arg;
+
+	if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+		return BLE_ATT_ERR_UNLIKELY;
+	}
+
+	/* Rebuilt on every read; NimBLE slices it for read-long offsets. */
+	uint8_t buf[METRICS_SNAPSHOT_MAX];
+	size_t len = metrics_snapshot(METRICS_SOURCE_SHEARS, buf, sizeof(buf));
+	if (len == 0) {
+		return BLE_ATT_ERR_UNLIKELY;
+	}
+
+	if (os_mbuf_append(ctxt->om, buf, len) != 0) {
+		return BLE_ATT_ERR_INSUFFICIENT_RES;
+	}
+
+	return 0;
+}
+
 /* --- Transfer task -------------------------------------------------------- */
 
 static void log_transfer_task(void *arg)
@@ -373,6 +826,7 @@ static void log_transfer_task(void *arg)
 	(void)arg;
 
 	uint8_t buf[2 + 160];
+	start_request_t req;
 
 	while (1) {
 		if (g_log_xfer.active && g_log_xfer.fp) {
@@ -380,29 +834,18 @@ static void log_transfer_task(void *arg)
 					 g_log_xfer.chunk_size,
 					 g_log_xfer.fp);
 
-			ESP_LOGI(TAG, "read: chunk=%u n=%u sent=%u/%u (chunk_size=%u)",
+			ESP_LOGD(TAG, "read: chunk=%u n=%u sent=%u/%u (chunk_size=%u)",
 				 g_log_xfer.chunk_index,
 				 (unsigned)n,
 				 g_log_xfer.bytes_sent,
 				 g_log_xfer.file_size,
 				 g_log_xfer.chunk_size);
 
-			if (n > 0) {
-				ESP_LOGI(TAG, "head: %02X %02X %02X %02X  %02X %02X %02X %02X",
-					 buf[2],
-					 (n > 1) ? buf[3] : 0,
-					 (n > 2) ? buf[4] : 0,
-					 (n > 3) ? buf[5] : 0,
-					 (n > 4) ? buf[6] : 0,
-					 (n > 5) ? buf[7] : 0,
-					 (n > 6) ? buf[8] : 0,
-					 (n > 7) ? buf[9] : 0);
-			}
-
 			if (n > 0 && g_log_xfer.data_val_handle != 0 && log_transfer_server_isConnected()) {
 				uint16_t idx = g_log_xfer.chunk_index;
 				memcpy(&buf[0], &idx, sizeof(idx));
 
+				TRACE_BEGIN(TRACE_ID_CHUNK_NOTIFY, idx);
 				struct os_mbuf *om =
 					ble_hs_mbuf_from_flat(buf, 2 + n);
 				if (om) {
@@ -411,16 +854,21 @@ static void log_transfer_task(void *arg)
 						g_log_xfer.data_val_handle,
 						om);
 
-					ESP_LOGI(TAG, "notify: chunk=%u rc=%d bytes=%u",
+					ESP_LOGD(TAG, "notify: chunk=%u rc=%d bytes=%u",
 						 g_log_xfer.chunk_index, rc, (unsigned)n);
 
 					if (rc != 0) {
 						ESP_LOGW(TAG, "DATA notify failed rc=%d", rc);
+						metrics_inc(METRIC_BLE_CHUNKS_FAILED);
+					} else {
+						metrics_inc(METRIC_BLE_CHUNKS_SENT);
 					}
 				} else {
 					ESP_LOGW(TAG, "notify: mbuf alloc failed (chunk=%u bytes=%u)",
 						 g_log_xfer.chunk_index, (unsigned)n);
+					metrics_inc(METRIC_BLE_CHUNKS_FAILED);
 				}
+				TRACE_END(TRACE_ID_CHUNK_NOTIFY, idx);
 
 				g_log_xfer.bytes_sent += n;
 				g_log_xfer.chunk_index++;
@@ -441,19 +889,17 @@ static void log_transfer_task(void *arg)
 				send_status(STATUS_TRANSFER_DONE,
 					    g_log_xfer.file_size);
 
-				ESP_LOGI(TAG, "Clearing transferred log file '%s'",
-					 g_log_xfer.filename);
-
-				if (shearsGpsStorageClearCsv(g_log_xfer.filename)) {
-					ESP_LOGI(TAG, "Cleared transferred log file");
-				} else {
-					ESP_LOGW(TAG, "Failed to clear transferred log file");
-				}
+				/* The segment itself waits for the base's ACK_SEGMENT. */
+				remove_encoded_copy();
 			}
 
 			vTaskDelay(pdMS_TO_TICKS(10));
-		} else {
-			vTaskDelay(pdMS_TO_TICKS(50));
+		} else if (g_trace_dump_requested) {
+			g_trace_dump_requested = false;
+			send_trace_dump();
+		} else if (xQueueReceive(g_start_queue, &req, pdMS_TO_TICKS(50)) == pdTRUE) {
+			start_transfer_internal(&req);
+			g_log_xfer.pending = false;
 		}
 	}
 }
@@ -479,6 +925,14 @@ void log_transfer_server_init(void)
 
 	ESP_LOGI(TAG, "Log transfer service registered");
 
+	const esp_timer_create_args_t sealIdleArgs = {
+		.callback = seal_idle_timer_cb,
+		.name     = "seal_idle"
+	};
+	esp_timer_create(&sealIdleArgs, &g_seal_idle_timer);
+
+	g_start_queue = xQueueCreate(1, sizeof(start_request_t));
+
 	xTaskCreate(log_transfer_task,
 		    "log_xfer_task",
 		    4096,
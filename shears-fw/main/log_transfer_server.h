@@ -28,15 +28,26 @@ void log_transfer_server_clearConnection(void);
 /* Returns true when a BLE connection is available for transfer. */
 bool log_transfer_server_isConnected(void);
 
-/* Returns true while a file transfer is in progress. */
+/* Returns true while a file transfer is queued or in progress. */
 bool log_transfer_server_isTransferActive(void);
 
-/* Starts a transfer for the given filename basename. */
+/*
+ * Queues a transfer for the given filename basename. The transfer task
+ * opens the file and reports STATUS_OK or an error over CTRL.
+ */
 bool log_transfer_server_startTransfer(const char *filename);
 
 /* Aborts the active transfer, if one is running. */
 void log_transfer_server_abortTransfer(void);
 
+/*
+ * Call after each saved cut. Once the head segment reaches
+ * GPS_LOG_SEGMENT_SEAL_BYTES, or no cut follows for a few seconds, it is
+ * sealed and an unsolicited SEGMENT_LIST lets the base fetch it. The list
+ * is repeated while segments await ACK_SEGMENT. No-op while disconnected.
+ */
+void log_transfer_server_announceSegments(void);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
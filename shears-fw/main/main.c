@@ -4,6 +4,7 @@
  * Top-level entry point for the shears firmware.
  *
  * Startup sequence:
+ *   - configure power management (automatic light sleep when idle)
  *   - initialize the status LED subsystem
  *   - start the GPS logger (SPIFFS, UART, button ISR, background tasks)
  *   - start BLE in peripheral mode and advertise as "WM-SHEARS"
@@ -12,6 +13,7 @@
  * runs inside module-specific FreeRTOS tasks.
  */
 
+#include "shears_power.h"
 #include "shears_led.h"
 #include "shears_ble.h"
 #include "shears_spiffs.h"
@@ -36,6 +38,9 @@ static void bleConnChanged(bool connected)
 
 void app_main(void)
 {
+	/* Light sleep between events; modules hold awake reasons as needed. */
+	shearsPowerInit();
+
 	/* Initialize status LED and indicate idle/advertising state. */
 	shearsLedInit();
 	shearsLedSetBlinking(true);
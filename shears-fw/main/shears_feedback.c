@@ -0,0 +1,248 @@
+/*
+ * shears_feedback.c
+ *
+ * Feedback engine: a queue of piezo patterns played by a dedicated task,
+ * with every on/off edge driven by a one-shot esp_timer instead of
+ * vTaskDelay(). The status LED blink runs on its own periodic esp_timer.
+ *
+ * Flow for one pattern:
+ *   - feedbackTask takes a command from the queue and turns the tone on
+ *   - stepTimerCb toggles the tone for each remaining edge and re-arms
+ *   - after the trailing gap the callback notifies feedbackTask, which
+ *     moves on to the next command
+ */
+
+#include "shears_feedback.h"
+#include "shears_piezo.h"
+#include "shears_power.h"
+
+#include "driver/gpio.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#define LED_STATUS_PIN        GPIO_NUM_32
+
+#define BEEP_ON_MS            80
+#define BEEP_OFF_MS           80
+#define LED_BLINK_ON_MS       200
+#define LED_BLINK_OFF_MS      200
+
+#define FEEDBACK_QUEUE_LEN    8
+
+static const char *TAG = "feedback";
+
+typedef enum {
+	FEEDBACK_CMD_BEEPS,
+	FEEDBACK_CMD_TONE
+} feedbackCmdType_t;
+
+typedef struct {
+	feedbackCmdType_t type;
+	uint32_t value;   /* beep count or tone duration (ms) */
+} feedbackCmd_t;
+
+static QueueHandle_t feedbackQueue = NULL;
+static TaskHandle_t feedbackTaskHandle = NULL;
+
+static esp_timer_handle_t stepTimer = NULL;
+static esp_timer_handle_t blinkTimer = NULL;
+
+/* Pattern state, owned by stepTimerCb while a pattern plays. */
+static bool toneOn = false;
+static uint32_t edgesLeft = 0;
+static uint32_t onMs = 0;
+static uint32_t offMs = 0;
+static volatile bool playing = false;
+
+static bool ledOn = true;
+static volatile bool ledBlinking = false;
+
+/* --- Pattern playback ----------------------------------------------------- */
+
+static void stepTimerCb(void *arg)
+{
+	(void)arg;
+
+	shearsPowerCountWakeup(SHEARS_WAKE_TIMER);
+
+	if (edgesLeft == 0) {
+		/* Trailing gap finished; hand control back to the task. */
+		playing = false;
+		shearsPowerSetAwake(SHEARS_AWAKE_FEEDBACK, false);
+		xTaskNotifyGive(feedbackTaskHandle);
+		return;
+	}
+
+	toneOn = !toneOn;
+	shearsPiezoSet(toneOn);
+	edgesLeft--;
+
+	esp_timer_start_once(stepTimer, (uint64_t)(toneOn ? onMs : offMs) * 1000);
+}
+
+static void startPattern(const feedbackCmd_t *cmd)
+{
+	if (cmd->type == FEEDBACK_CMD_TONE) {
+		onMs = cmd->value;
+		offMs = BEEP_OFF_MS;
+		edgesLeft = 1;
+	} else {
+		onMs = BEEP_ON_MS;
+		offMs = BEEP_OFF_MS;
+		edgesLeft = cmd->value * 2 - 1;
+	}
+
+	/* LEDC stops in light sleep, so stay awake while the tone plays. */
+	shearsPowerSetAwake(SHEARS_AWAKE_FEEDBACK, true);
+
+	playing = true;
+	toneOn = true;
+	shearsPiezoSet(true);
+
+	esp_timer_start_once(stepTimer, (uint64_t)onMs * 1000);
+}
+
+static void feedbackTask(void *arg)
+{
+	(void)arg;
+
+	while (1) {
+		feedbackCmd_t cmd;
+		if (xQueueReceive(feedbackQueue, &cmd, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		if (cmd.value == 0) {
+			continue;
+		}
+
+		startPattern(&cmd);
+
+		/* Sleep until stepTimerCb reports the pattern (and its gap) is done. */
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+	}
+}
+
+/* --- Status LED ----------------------------------------------------------- */
+
+static void blinkTimerCb(void *arg)
+{
+	(void)arg;
+
+	shearsPowerCountWakeup(SHEARS_WAKE_TIMER);
+
+	/* A mode change can race this callback; solid mode wins and stops here. */
+	if (!ledBlinking) {
+		ledOn = true;
+		gpio_set_level(LED_STATUS_PIN, 1);
+		return;
+	}
+
+	ledOn = !ledOn;
+	gpio_set_level(LED_STATUS_PIN, ledOn ? 1 : 0);
+
+	esp_timer_start_once(blinkTimer,
+	                     (uint64_t)(ledOn ? LED_BLINK_ON_MS : LED_BLINK_OFF_MS) * 1000);
+}
+
+/* --- Public API ----------------------------------------------------------- */
+
+void shearsFeedbackInit(void)
+{
+	gpio_config_t outConf = {
+		.pin_bit_mask = (1ULL << LED_STATUS_PIN),
+		.mode         = GPIO_MODE_OUTPUT,
+		.pull_up_en   = 0,
+		.pull_down_en = 0,
+		.intr_type    = GPIO_INTR_DISABLE
+	};
+	gpio_config(&outConf);
+	gpio_set_level(LED_STATUS_PIN, 1);
+
+	const esp_timer_create_args_t stepArgs = {
+		.callback = stepTimerCb,
+		.name     = "fb_step"
+	};
+	esp_timer_create(&stepArgs, &stepTimer);
+
+	const esp_timer_create_args_t blinkArgs = {
+		.callback = blinkTimerCb,
+		.name     = "fb_blink"
+	};
+	esp_timer_create(&blinkArgs, &blinkTimer);
+
+	feedbackQueue = xQueueCreate(FEEDBACK_QUEUE_LEN, sizeof(feedbackCmd_t));
+
+	xTaskCreate(feedbackTask, "feedback", 2048, NULL, 4, &feedbackTaskHandle);
+
+	ESP_LOGI(TAG, "Feedback engine ready");
+}
+
+static bool post(feedbackCmdType_t type, uint32_t value)
+{
+	if (!feedbackQueue) {
+		return false;
+	}
+
+	feedbackCmd_t cmd = { .type = type, .value = value };
+	if (xQueueSend(feedbackQueue, &cmd, 0) != pdTRUE) {
+		ESP_LOGW(TAG, "Feedback queue full; dropping pattern");
+		return false;
+	}
+	return true;
+}
+
+bool shearsFeedbackBeeps(int count)
+{
+	return (count > 0) && post(FEEDBACK_CMD_BEEPS, (uint32_t)count);
+}
+
+bool IRAM_ATTR shearsFeedbackBeepsFromIsr(int count)
+{
+	if (!feedbackQueue || count <= 0) {
+		return false;
+	}
+
+	BaseType_t hpTaskWoken = pdFALSE;
+	feedbackCmd_t cmd = { .type = FEEDBACK_CMD_BEEPS, .value = (uint32_t)count };
+	BaseType_t ok = xQueueSendFromISR(feedbackQueue, &cmd, &hpTaskWoken);
+
+	if (hpTaskWoken) {
+		portYIELD_FROM_ISR();
+	}
+	return ok == pdTRUE;
+}
+
+bool shearsFeedbackTone(uint32_t durationMs)
+{
+	return post(FEEDBACK_CMD_TONE, durationMs);
+}
+
+void shearsFeedbackSetStatusBlink(bool blinking)
+{
+	if (blinking == ledBlinking) {
+		return;
+	}
+
+	ledBlinking = blinking;
+	esp_timer_stop(blinkTimer);
+
+	/* Both modes start from LED on; blinking toggles it from there. */
+	ledOn = true;
+	gpio_set_level(LED_STATUS_PIN, 1);
+
+	if (blinking) {
+		esp_timer_start_once(blinkTimer, (uint64_t)LED_BLINK_ON_MS * 1000);
+	}
+}
+
+bool shearsFeedbackIsBusy(void)
+{
+	return playing || (feedbackQueue && uxQueueMessagesWaiting(feedbackQueue) > 0);
+}
@@ -0,0 +1,42 @@
+/*
+ * shears_feedback.h
+ *
+ * Non-blocking user feedback for the shears (piezo patterns + status LED).
+ *
+ * Callers post a pattern and return immediately. A dedicated task takes
+ * patterns from a queue one at a time and plays them with an esp_timer, so
+ * no caller ever waits on a beep or tone.
+ *
+ * Call shearsFeedbackInit() once (after shearsPiezoInit()).
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Starts the feedback task and configures the status LED. */
+void shearsFeedbackInit(void);
+
+/* Queues N short beeps. Returns false if the queue is full (pattern dropped). */
+bool shearsFeedbackBeeps(int count);
+
+/* Same as shearsFeedbackBeeps(), callable from an ISR. */
+bool shearsFeedbackBeepsFromIsr(int count);
+
+/* Queues a steady tone of durationMs. Returns false if the queue is full. */
+bool shearsFeedbackTone(uint32_t durationMs);
+
+/* Status LED: blinking (primed) or solid on (safe). Takes effect immediately. */
+void shearsFeedbackSetStatusBlink(bool blinking);
+
+/* True while a pattern is playing or waiting in the queue. */
+bool shearsFeedbackIsBusy(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,323 @@
+/*
+ * shears_gnssPower.c
+ *
+ * GNSS backup/wake control and time-to-fix / cut latency metrics.
+ *
+ * Backup uses UBX-RXM-PMREQ (class 0x02, id 0x41, 16-byte version) with an
+ * indefinite duration and UART RX as the wakeup source. Any falling edge
+ * on the receiver's RX line wakes it, so a few 0xFF bytes are enough; it
+ * then restarts from battery-backed RAM with ephemeris and last position
+ * intact. Without V_BCKP that degrades to a cold start, which shows up
+ * directly in the time-to-fix numbers logged here.
+ */
+
+#include "shears_gnssPower.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+
+#define UBX_SYNC1               0xB5
+#define UBX_SYNC2               0x62
+#define UBX_CLASS_RXM           0x02
+#define UBX_ID_RXM_PMREQ        0x41
+
+#define PMREQ_FLAG_BACKUP       0x00000002u
+#define PMREQ_FLAG_FORCE        0x00000004u
+#define PMREQ_WAKE_UARTRX       0x00000008u
+
+/* GGA fix quality values of interest. */
+#define GGA_FIX_NONE            0
+#define GGA_FIX_RTK_FIXED       4
+
+#define WAKE_PULSE_BYTES        8
+
+static const char *TAG = "gnss_power";
+
+static uart_port_t gnssPort = UART_NUM_MAX;
+static volatile bool gnssActive = true;
+
+static portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED;
+
+/* Current primed session (times relative to the prime edge). */
+static int64_t sessionEdgeUs = 0;
+static int64_t sessionFixUs = -1;
+static int64_t sessionRtkUs = -1;
+static bool sessionFirstCutDone = false;
+
+/* Accumulated duty cycle. */
+static int64_t stateSinceUs = 0;
+static int64_t backupTotalUs = 0;
+static int64_t activeTotalUs = 0;
+
+/* Time-to-fix statistics over all wakes. */
+static uint32_t wakeCount = 0;
+static uint32_t fixCount = 0;
+static int64_t fixSumUs = 0;
+static int64_t fixMaxUs = 0;
+static uint32_t rtkCount = 0;
+static int64_t rtkSumUs = 0;
+static int64_t rtkMaxUs = 0;
+
+/* Cut latency (trigger -> row stored) for cuts made while primed. */
+static uint32_t cutCount = 0;
+static int64_t cutSumUs = 0;
+static int64_t cutMaxUs = 0;
+static uint32_t firstCutCount = 0;
+static int64_t firstCutSumUs = 0;
+static int64_t firstCutMaxUs = 0;
+static int64_t firstCutSincePrimeMaxUs = 0;
+
+/* --- UBX ------------------------------------------------------------------ */
+
+static void ubxSend(uint8_t cls, uint8_t id, const uint8_t *payload, uint16_t len)
+{
+	uint8_t head[6] = { UBX_SYNC1, UBX_SYNC2, cls, id,
+	                    (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+	uint8_t ckA = 0;
+	uint8_t ckB = 0;
+
+	/* 8-bit Fletcher over class, id, length and payload. */
+	for (int i = 2; i < 6; i++) {
+		ckA += head[i];
+		ckB += ckA;
+	}
+	for (uint16_t i = 0; i < len; i++) {
+		ckA += payload[i];
+		ckB += ckA;
+	}
+
+	uint8_t tail[2] = { ckA, ckB };
+
+	uart_write_bytes(gnssPort, head, sizeof(head));
+	if (len > 0) {
+		uart_write_bytes(gnssPort, payload, len);
+	}
+	uart_write_bytes(gnssPort, tail, sizeof(tail));
+}
+
+static void putU32Le(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t)(v);
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static void enterBackup(void)
+{
+	uint8_t payload[16];
+
+	memset(payload, 0, sizeof(payload));
+	/* payload[0] version 0, [1..3] reserved, [4..7] duration 0 = until woken */
+	putU32Le(&payload[8], PMREQ_FLAG_BACKUP | PMREQ_FLAG_FORCE);
+	putU32Le(&payload[12], PMREQ_WAKE_UARTRX);
+
+	/* Stop receiving first: whatever the receiver still sends is not needed. */
+	uart_disable_rx_intr(gnssPort);
+
+	ubxSend(UBX_CLASS_RXM, UBX_ID_RXM_PMREQ, payload, sizeof(payload));
+	uart_wait_tx_done(gnssPort, pdMS_TO_TICKS(100));
+
+	uart_flush_input(gnssPort);
+}
+
+static void wakeReceiver(void)
+{
+	uint8_t pulse[WAKE_PULSE_BYTES];
+
+	/* Each 0xFF is a start bit: a falling edge on the receiver's RX pin. */
+	memset(pulse, 0xFF, sizeof(pulse));
+	uart_write_bytes(gnssPort, pulse, sizeof(pulse));
+	uart_wait_tx_done(gnssPort, pdMS_TO_TICKS(100));
+
+	uart_flush_input(gnssPort);
+	uart_enable_rx_intr(gnssPort);
+}
+
+/* --- Accounting ----------------------------------------------------------- */
+
+static void accountState(int64_t nowUs)
+{
+	int64_t spent = nowUs - stateSinceUs;
+
+	if (gnssActive) {
+		activeTotalUs += spent;
+	} else {
+		backupTotalUs += spent;
+	}
+	stateSinceUs = nowUs;
+}
+
+/* long long, not int64_t, so "%lld" is right on every libc. */
+static long long avgMs(int64_t sumUs, uint32_t count)
+{
+	return count ? (long long)((sumUs / count) / 1000) : 0;
+}
+
+/* --- Public API ----------------------------------------------------------- */
+
+void shearsGnssPowerInit(uart_port_t port, bool primed)
+{
+	gnssPort = port;
+	gnssActive = true;
+	stateSinceUs = esp_timer_get_time();
+
+	if (!primed) {
+		enterBackup();
+		gnssActive = false;
+		ESP_LOGI(TAG, "Receiver in backup until primed");
+	} else {
+		/* Booting primed: treat boot as the prime edge. */
+		sessionEdgeUs = stateSinceUs;
+		sessionFixUs = -1;
+		sessionRtkUs = -1;
+		sessionFirstCutDone = false;
+	}
+}
+
+void shearsGnssPowerSetPrimed(bool primed, int64_t edgeUs)
+{
+	if (primed == gnssActive) {
+		return;
+	}
+
+	int64_t nowUs = esp_timer_get_time();
+
+	if (primed) {
+		wakeReceiver();
+
+		portENTER_CRITICAL(&statsMux);
+		accountState(nowUs);
+		gnssActive = true;
+		sessionEdgeUs = edgeUs;
+		sessionFixUs = -1;
+		sessionRtkUs = -1;
+		sessionFirstCutDone = false;
+		wakeCount++;
+		portEXIT_CRITICAL(&statsMux);
+
+		ESP_LOGI(TAG, "Receiver woken (%lld ms after prime edge)",
+		         (long long)((nowUs - edgeUs) / 1000));
+	} else {
+		portENTER_CRITICAL(&statsMux);
+		accountState(nowUs);
+		gnssActive = false;
+		portEXIT_CRITICAL(&statsMux);
+
+		enterBackup();
+		shearsGnssPowerLogStats();
+	}
+}
+
+bool shearsGnssPowerIsActive(void)
+{
+	return gnssActive;
+}
+
+void shearsGnssPowerOnGga(int fixQuality)
+{
+	if (!gnssActive || fixQuality <= GGA_FIX_NONE) {
+		return;
+	}
+
+	int64_t nowUs = esp_timer_get_time();
+	bool newFix = false;
+	bool newRtk = false;
+
+	portENTER_CRITICAL(&statsMux);
+	int64_t sinceEdge = nowUs - sessionEdgeUs;
+
+	if (sessionFixUs < 0) {
+		sessionFixUs = sinceEdge;
+		fixCount++;
+		fixSumUs += sinceEdge;
+		if (sinceEdge > fixMaxUs) {
+			fixMaxUs = sinceEdge;
+		}
+		newFix = true;
+	}
+	if (fixQuality == GGA_FIX_RTK_FIXED && sessionRtkUs < 0) {
+		sessionRtkUs = sinceEdge;
+		rtkCount++;
+		rtkSumUs += sinceEdge;
+		if (sinceEdge > rtkMaxUs) {
+			rtkMaxUs = sinceEdge;
+		}
+		newRtk = true;
+	}
+	portEXIT_CRITICAL(&statsMux);
+
+	if (newFix) {
+		ESP_LOGI(TAG, "First fix (quality %d) %lld ms after prime", fixQuality,
+		         (long long)(sinceEdge / 1000));
+	}
+	if (newRtk) {
+		ESP_LOGI(TAG, "RTK fixed %lld ms after prime", (long long)(sinceEdge / 1000));
+	}
+}
+
+void shearsGnssPowerRecordCut(int64_t triggerUs, int64_t storedUs)
+{
+	int64_t latencyUs = storedUs - triggerUs;
+	bool first;
+
+	portENTER_CRITICAL(&statsMux);
+	first = !sessionFirstCutDone;
+	sessionFirstCutDone = true;
+
+	cutCount++;
+	cutSumUs += latencyUs;
+	if (latencyUs > cutMaxUs) {
+		cutMaxUs = latencyUs;
+	}
+
+	int64_t sincePrimeUs = triggerUs - sessionEdgeUs;
+	if (first) {
+		firstCutCount++;
+		firstCutSumUs += latencyUs;
+		if (latencyUs > firstCutMaxUs) {
+			firstCutMaxUs = latencyUs;
+		}
+		if (sincePrimeUs > firstCutSincePrimeMaxUs) {
+			firstCutSincePrimeMaxUs = sincePrimeUs;
+		}
+	}
+	portEXIT_CRITICAL(&statsMux);
+
+	if (first) {
+		ESP_LOGI(TAG, "First cut after prime: %lld ms trigger->stored, trigger %lld ms after prime",
+		         (long long)(latencyUs / 1000), (long long)(sincePrimeUs / 1000));
+	}
+}
+
+void shearsGnssPowerLogStats(void)
+{
+	int64_t nowUs = esp_timer_get_time();
+
+	portENTER_CRITICAL(&statsMux);
+	accountState(nowUs);
+	int64_t backupUs = backupTotalUs;
+	int64_t activeUs = activeTotalUs;
+	portEXIT_CRITICAL(&statsMux);
+
+	float backupH = (float)backupUs / 3.6e9f;
+	float savedMah = backupH * (SHEARS_GNSS_ACTIVE_MA - SHEARS_GNSS_BACKUP_MA);
+	int64_t totalUs = backupUs + activeUs;
+	int dutyPct = totalUs ? (int)((activeUs * 100) / totalUs) : 100;
+
+	ESP_LOGI(TAG, "Duty: active %lld s, backup %lld s (%d%% on), ~%.1f mAh saved",
+	         (long long)(activeUs / 1000000), (long long)(backupUs / 1000000),
+	         dutyPct, savedMah);
+	ESP_LOGI(TAG, "Wakes %lu: first fix avg %lld / max %lld ms (%lu), RTK avg %lld / max %lld ms (%lu)",
+	         (unsigned long)wakeCount,
+	         avgMs(fixSumUs, fixCount), (long long)(fixMaxUs / 1000), (unsigned long)fixCount,
+	         avgMs(rtkSumUs, rtkCount), (long long)(rtkMaxUs / 1000), (unsigned long)rtkCount);
+	ESP_LOGI(TAG, "Cut latency: avg %lld / max %lld ms (%lu); first after prime avg %lld / max %lld ms, up to %lld ms after prime",
+	         avgMs(cutSumUs, cutCount), (long long)(cutMaxUs / 1000), (unsigned long)cutCount,
+	         avgMs(firstCutSumUs, firstCutCount), (long long)(firstCutMaxUs / 1000),
+	         (long long)(firstCutSincePrimeMaxUs / 1000));
+}
@@ -0,0 +1,58 @@
+/*
+ * shears_gnssPower.h
+ *
+ * Duty-cycles the ZED-F9P with the prime switch.
+ *
+ * While SAFE the receiver is parked in backup mode with UBX-RXM-PMREQ and
+ * the UART RX interrupt is disabled, so no NMEA is received or parsed.
+ * On the SAFE->PRIMED edge the receiver is woken by UART activity and
+ * resumes from battery-backed RAM (hot start, needs V_BCKP powered).
+ *
+ * The module also owns the metrics for that trade-off:
+ *   - time from prime edge to first fix and to RTK fixed
+ *   - time spent in backup vs. active and the estimated charge saved
+ *   - cut latency (trigger -> row stored) for cuts made after priming,
+ *     with the first cut of each primed session tracked separately
+ *
+ * All calls except shearsGnssPowerOnGga() come from gps_logger's save task.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/uart.h"
+
+/* Datasheet figures used to estimate savings (ZED-F9P, 3.3 V). */
+#define SHEARS_GNSS_ACTIVE_MA    68.0f    /* continuous tracking */
+#define SHEARS_GNSS_BACKUP_MA    0.045f   /* V_BCKP only */
+
+/* Takes the (already installed) GNSS UART and applies the initial state. */
+void shearsGnssPowerInit(uart_port_t port, bool primed);
+
+/*
+ * Applies a prime switch change. edgeUs is the esp_timer time captured in
+ * the prime ISR; metrics are measured from it.
+ */
+void shearsGnssPowerSetPrimed(bool primed, int64_t edgeUs);
+
+/* True while the receiver is awake and NMEA should be parsed. */
+bool shearsGnssPowerIsActive(void);
+
+/* Feeds the fix quality (GGA field 6) of every parsed GGA sentence. */
+void shearsGnssPowerOnGga(int fixQuality);
+
+/* Records one stored cut: trigger press time and time the row was stored. */
+void shearsGnssPowerRecordCut(int64_t triggerUs, int64_t storedUs);
+
+/* Logs the accumulated duty-cycle and latency metrics. */
+void shearsGnssPowerLogStats(void);
+
+#ifdef __cplusplus
+}
+#endif
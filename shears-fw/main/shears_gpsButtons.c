@@ -5,13 +5,29 @@
 #include "esp_attr.h"
 #include "esp_err.h"
 
+#include "shears_power.h"
+
 static shearsGpsButtonsCallbacks_t gCallbacks;
 
+/*
+ * Edge interrupts cannot wake the ESP32 from light sleep, so every pin uses
+ * a level interrupt armed for the level it does not have now. Flipping it
+ * on each interrupt gives the any-edge behaviour the callbacks expect, and
+ * gpio_wakeup_enable() makes the same level a wakeup source.
+ */
+static void armForChange(gpio_num_t pin, int level)
+{
+	gpio_wakeup_enable(pin, level ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+}
+
 static void IRAM_ATTR buttonsIsrHandler(void *arg)
 {
 	gpio_num_t pin = (gpio_num_t)(intptr_t)arg;
 	int level = gpio_get_level(pin);
 
+	armForChange(pin, level);
+	shearsPowerCountWakeup(SHEARS_WAKE_GPIO);
+
 	if (pin == SHEARS_PRIME_BUTTON_PIN) {
 		if (gCallbacks.onPrimeLevel) {
 			gCallbacks.onPrimeLevel(level);
@@ -64,4 +80,10 @@ void shearsGpsButtonsInit(const shearsGpsButtonsCallbacks_t *callbacks)
 	gpio_isr_handler_add(SHEARS_PRIME_BUTTON_PIN, buttonsIsrHandler, (void *)(intptr_t)SHEARS_PRIME_BUTTON_PIN);
 	gpio_isr_handler_add(SHEARS_CUT2_BUTTON_PIN, buttonsIsrHandler, (void *)(intptr_t)SHEARS_CUT2_BUTTON_PIN);
 	gpio_isr_handler_add(SHEARS_CUT3_BUTTON_PIN, buttonsIsrHandler, (void *)(intptr_t)SHEARS_CUT3_BUTTON_PIN);
+
+	/* Switch from the any-edge interrupt above to the wakeup-capable levels. */
+	armForChange(SHEARS_GPS_BUTTON_PIN, gpio_get_level(SHEARS_GPS_BUTTON_PIN));
+	armForChange(SHEARS_PRIME_BUTTON_PIN, gpio_get_level(SHEARS_PRIME_BUTTON_PIN));
+	armForChange(SHEARS_CUT2_BUTTON_PIN, gpio_get_level(SHEARS_CUT2_BUTTON_PIN));
+	armForChange(SHEARS_CUT3_BUTTON_PIN, gpio_get_level(SHEARS_CUT3_BUTTON_PIN));
 }
\ No newline at end of file
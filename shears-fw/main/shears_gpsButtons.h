@@ -26,7 +26,8 @@ typedef struct {
 
 /*
  * Configures GPIO inputs + interrupts and installs the ISR handlers.
- * Call once at startup.
+ * Every pin is also a light-sleep wakeup source (level based; see
+ * shearsPowerInit() for the global GPIO wakeup enable). Call once at startup.
  *
  * Callbacks run inside the GPIO ISR (keep them short / ISR-safe).
  */
@@ -3,18 +3,38 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "esp_log.h"
+#include "esp_random.h"
+
+#include "log_paths.h"
+#include "log_segments.h"
+#include "trace.h"
 
 #define GPS_BUF_SIZE 512
 
+#define SEGMENT_PATH_MAX 40
+#define CLEAR_BATCH      16
+
 static const char* TAG = "gps_storage";
 
+static const char csvHeader[] =
+	"utc_date, utc_time,latitude,longitude,fix_quality,"
+	"num_satellites,hdop,altitude,geoid_height\n";
+
+/* Head segment state; guarded by segMutex once shearsGpsStorageSegmentsInit() ran. */
+static SemaphoreHandle_t segMutex = NULL;
+static uint32_t headSeq = 0;
+static char headPath[SEGMENT_PATH_MAX];
+static uint32_t storageEpoch = 0;
+
 static void writeCsvHeader(FILE* f)
 {
-	fprintf(f,
-	        "utc_date, utc_time,latitude,longitude,fix_quality,"
-	        "num_satellites,hdop,altitude,geoid_height\n");
+	fputs(csvHeader, f);
 }
 
 static double nmeaToDecimal(const char* nmeaVal, char hemisphere)
@@ -40,10 +60,9 @@ static void formatUtcTime(const char* nmeaUtc, char* out, size_t outLen)
 
 	char hh[3] = { nmeaUtc[0], nmeaUtc[1], '\0' };
 	char mm[3] = { nmeaUtc[2], nmeaUtc[3], '\0' };
-	char ss[16];
 
-	snprintf(ss, sizeof(ss), "%s", nmeaUtc + 4);
-	snprintf(out, outLen, "%s:%s:%s", hh, mm, ss);
+	/* NMEA seconds are "ss.ss"; the precision bounds the result to 16 bytes. */
+	snprintf(out, outLen, "%s:%s:%.9s", hh, mm, nmeaUtc + 4);
 }
 
 bool shearsGpsStorageEnsureCsvExists(const char* csvPath)
@@ -115,7 +134,9 @@ bool shearsGpsStorageAppendGngga(const char* csvPath, const char* nmea, const ch
 	double alt = atof(tokens[9]);
 	double geoid = atof(tokens[11]);
 
+	TRACE_BEGIN(TRACE_ID_STORAGE_FOPEN, 0);
 	FILE* f = fopen(csvPath, "a");
+	TRACE_END(TRACE_ID_STORAGE_FOPEN, 0);
 	if (!f) {
 		ESP_LOGE(TAG, "Append open failed: %s", csvPath);
 		return false;
@@ -129,9 +150,14 @@ bool shearsGpsStorageAppendGngga(const char* csvPath, const char* nmea, const ch
 				utcDate[0], utcDate[1]);
 	}
 
-	fprintf(f, "%s,%s,%.7f,%.7f,%d,%d,%.1f,%.3f,%.3f\n",
-	        dateFMT, utcTime, lat, lon, fix, sats, hdop, alt, geoid);
+	TRACE_BEGIN(TRACE_ID_STORAGE_WRITE, 0);
+	int rowLen = fprintf(f, "%s,%s,%.7f,%.7f,%d,%d,%.1f,%.3f,%.3f\n",
+	                     dateFMT, utcTime, lat, lon, fix, sats, hdop, alt, geoid);
+	TRACE_END(TRACE_ID_STORAGE_WRITE, rowLen);
+
+	TRACE_BEGIN(TRACE_ID_STORAGE_FCLOSE, 0);
 	fclose(f);
+	TRACE_END(TRACE_ID_STORAGE_FCLOSE, 0);
 
 	ESP_LOGI(TAG, "Saved: date=%s time=%s lat=%.7f lon=%.7f", dateFMT, utcTime, lat, lon);
 	return true;
@@ -174,8 +200,7 @@ void shearsGpsStoragePrintNewest(const char* csvPath, int maxLines)
 	while (fgets(buffer, sizeof(buffer), f)) {
 		int idx = dataLinesSeen % maxLines;
 
-		strncpy(lines[idx], buffer, LINE_BUF - 1);
-		lines[idx][LINE_BUF - 1] = '\0';
+		memcpy(lines[idx], buffer, LINE_BUF);
 
 		lineNums[idx] = dataLinesSeen + 1;
 		dataLinesSeen++;
@@ -246,4 +271,310 @@ void shearsGpsStoragePrintNewest(const char* csvPath, int maxLines)
 
 	free(lines);
 	free(lineNums);
-}
\ No newline at end of file
+}
+
+/* --- Segmented log -------------------------------------------------------- */
+
+static long fileSize(const char* path)
+{
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		return -1;
+	}
+	return (long)st.st_size;
+}
+
+static bool hasRows(const char* path)
+{
+	return fileSize(path) > (long)(sizeof(csvHeader) - 1);
+}
+
+static bool setHeadLocked(uint32_t seq)
+{
+	char path[SEGMENT_PATH_MAX];
+	if (!log_segment_format_path(path, sizeof(path), seq)) {
+		return false;
+	}
+
+	if (!shearsGpsStorageEnsureCsvExists(path)) {
+		return false;
+	}
+
+	strcpy(headPath, path);
+	headSeq = seq;
+	return true;
+}
+
+static bool sealHeadLocked(void)
+{
+	if (!hasRows(headPath)) {
+		return false;
+	}
+
+	uint32_t sealed = headSeq;
+	long sealedBytes = fileSize(headPath);
+
+	if (!setHeadLocked(headSeq + 1)) {
+		ESP_LOGE(TAG, "Could not open next head segment after %06lu", (unsigned long)sealed);
+		return false;
+	}
+
+	ESP_LOGI(TAG, "Sealed segment %06lu (%ld bytes)", (unsigned long)sealed, sealedBytes);
+	return true;
+}
+
+/*
+ * Without an epoch file the filesystem is new (or was erased), so segment
+ * numbers are about to start over; a fresh random epoch keeps the Pi from
+ * taking them for segments it already has.
+ */
+static bool loadEpoch(void)
+{
+	if (log_epoch_load(&storageEpoch) && storageEpoch != 0) {
+		return true;
+	}
+
+	do {
+		storageEpoch = esp_random();
+	} while (storageEpoch == 0);
+
+	if (!log_epoch_store(storageEpoch)) {
+		ESP_LOGE(TAG, "Could not write %s", GPS_LOG_EPOCH_PATH);
+		return false;
+	}
+
+	ESP_LOGW(TAG, "New storage epoch %08lx", (unsigned long)storageEpoch);
+	return true;
+}
+
+static bool isSealedPath(const char* path)
+{
+	const char* base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+
+	uint32_t seq;
+	return log_segment_parse_name(base, &seq) && seq < headSeq;
+}
+
+bool shearsGpsStorageSegmentsInit(void)
+{
+	if (!segMutex) {
+		segMutex = xSemaphoreCreateMutex();
+		if (!segMutex) {
+			ESP_LOGE(TAG, "Segment mutex alloc failed");
+			return false;
+		}
+	}
+
+	if (!loadEpoch()) {
+		return false;
+	}
+
+	uint32_t newest = 0;
+	int found = log_segment_list(0, NULL, 0, &newest);
+	if (found < 0) {
+		ESP_LOGE(TAG, "Could not scan %s", GPS_LOG_DIR);
+		return false;
+	}
+
+	uint32_t seq = newest ? newest : 1;
+
+	/* Rows left in the pre-segmentation log become the next sealed segment. */
+	if (hasRows(GPS_LOG_FILE_PATH)) {
+		char legacyPath[SEGMENT_PATH_MAX];
+		seq = newest + 1;
+
+		if (log_segment_format_path(legacyPath, sizeof(legacyPath), seq) &&
+		    rename(GPS_LOG_FILE_PATH, legacyPath) == 0) {
+			ESP_LOGW(TAG, "Migrated %s into %s", GPS_LOG_FILE_PATH, legacyPath);
+			seq++;
+		} else {
+			ESP_LOGE(TAG, "Could not migrate %s", GPS_LOG_FILE_PATH);
+		}
+	} else {
+		remove(GPS_LOG_FILE_PATH);
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+	bool ok = setHeadLocked(seq);
+	xSemaphoreGive(segMutex);
+
+	ESP_LOGI(TAG, "Head segment %s (%d segment(s) on flash, epoch %08lx)",
+		 headPath, found, (unsigned long)storageEpoch);
+	return ok;
+}
+
+uint32_t shearsGpsStorageEpoch(void)
+{
+	return storageEpoch;
+}
+
+bool shearsGpsStorageAppendCut(const char* nmea, const char* utcDate)
+{
+	if (!segMutex) {
+		return false;
+	}
+
+	TRACE_BEGIN(TRACE_ID_STORAGE_APPEND, 0);
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+
+	bool ok = shearsGpsStorageAppendGngga(headPath, nmea, utcDate);
+	if (ok && fileSize(headPath) >= GPS_LOG_SEGMENT_MAX_BYTES) {
+		sealHeadLocked();
+	}
+
+	xSemaphoreGive(segMutex);
+	TRACE_END(TRACE_ID_STORAGE_APPEND, ok);
+	return ok;
+}
+
+bool shearsGpsStorageSealHead(void)
+{
+	if (!segMutex) {
+		return false;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+	bool sealed = sealHeadLocked();
+	xSemaphoreGive(segMutex);
+
+	return sealed;
+}
+
+long shearsGpsStorageHeadBytes(void)
+{
+	if (!segMutex) {
+		return 0;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+	long bytes = fileSize(headPath);
+	xSemaphoreGive(segMutex);
+
+	return bytes;
+}
+
+int shearsGpsStorageListSealed(uint32_t afterSeq, uint32_t* seqs, int maxSeqs, bool* more)
+{
+	if (more) {
+		*more = false;
+	}
+
+	if (!segMutex || !seqs || maxSeqs <= 0) {
+		return 0;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+
+	int total = log_segment_list(afterSeq, seqs, maxSeqs, NULL);
+	int sealedTotal = total - ((headSeq > afterSeq) ? 1 : 0);
+
+	xSemaphoreGive(segMutex);
+
+	if (sealedTotal <= 0) {
+		return 0;
+	}
+
+	/* The head has the highest sequence, so it can only be the last entry. */
+	int stored = (total < maxSeqs) ? total : maxSeqs;
+	if (stored > sealedTotal) {
+		stored = sealedTotal;
+	}
+
+	if (more) {
+		*more = sealedTotal > stored;
+	}
+	return stored;
+}
+
+bool shearsGpsStorageIsSealed(const char* path)
+{
+	if (!segMutex || !path) {
+		return false;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+	bool sealed = isSealedPath(path);
+	xSemaphoreGive(segMutex);
+
+	return sealed;
+}
+
+bool shearsGpsStorageDeleteSegment(const char* path)
+{
+	if (!segMutex || !path) {
+		return false;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+
+	bool ok = false;
+	if (!isSealedPath(path)) {
+		ESP_LOGW(TAG, "Refusing to delete %s (not a sealed segment)", path);
+	} else if (remove(path) != 0) {
+		ESP_LOGE(TAG, "Could not delete %s", path);
+	} else {
+		ESP_LOGI(TAG, "Deleted segment %s", path);
+		ok = true;
+	}
+
+	xSemaphoreGive(segMutex);
+	return ok;
+}
+
+bool shearsGpsStorageClearAll(void)
+{
+	if (!segMutex) {
+		return false;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+
+	uint32_t seqs[CLEAR_BATCH];
+	int deleted = 0;
+
+	while (1) {
+		int total = log_segment_list(0, seqs, CLEAR_BATCH, NULL);
+		int stored = (total < CLEAR_BATCH) ? total : CLEAR_BATCH;
+		int removedNow = 0;
+
+		for (int i = 0; i < stored; i++) {
+			char path[SEGMENT_PATH_MAX];
+			if (seqs[i] >= headSeq ||
+			    !log_segment_format_path(path, sizeof(path), seqs[i])) {
+				continue;
+			}
+			if (remove(path) == 0) {
+				removedNow++;
+			}
+		}
+
+		deleted += removedNow;
+		if (removedNow == 0) {
+			break;
+		}
+	}
+
+	bool ok = shearsGpsStorageClearCsv(headPath);
+
+	xSemaphoreGive(segMutex);
+
+	ESP_LOGW(TAG, "Cleared %d sealed segment(s) and the head", deleted);
+	return ok;
+}
+
+void shearsGpsStorageGetHeadPath(char* out, size_t outLen)
+{
+	if (!out || outLen == 0) {
+		return;
+	}
+
+	if (!segMutex) {
+		out[0] = '\0';
+		return;
+	}
+
+	xSemaphoreTake(segMutex, portMAX_DELAY);
+	snprintf(out, outLen, "%s", headPath);
+	xSemaphoreGive(segMutex);
+}
@@ -5,6 +5,8 @@ extern "C" {
 #endif
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 bool shearsGpsStorageEnsureCsvExists(const char* csvPath);
 
@@ -14,6 +16,44 @@ bool shearsGpsStorageAppendGngga(const char* csvPath, const char* nmea, const ch
 
 void shearsGpsStoragePrintNewest(const char* csvPath, int maxLines);
 
+/* --- Segmented log (see log_segments.h) --- */
+
+/*
+ * Finds the head segment, migrating the legacy single-file log if present,
+ * and loads the storage epoch (starting a new one on a fresh filesystem).
+ */
+bool shearsGpsStorageSegmentsInit(void);
+
+/* Storage epoch the segment numbers belong to (GPS_LOG_EPOCH_PATH). */
+uint32_t shearsGpsStorageEpoch(void);
+
+/* Appends one cut to the head segment, sealing it once it is full. */
+bool shearsGpsStorageAppendCut(const char* nmea, const char* utcDate);
+
+/* Seals the head if it holds any rows. Returns true if a segment was sealed. */
+bool shearsGpsStorageSealHead(void);
+
+/* Size of the head segment in bytes, header included. */
+long shearsGpsStorageHeadBytes(void);
+
+/*
+ * Lists sealed segments newer than afterSeq, oldest first.
+ * Returns how many were stored in seqs; *more is set when others remain.
+ */
+int shearsGpsStorageListSealed(uint32_t afterSeq, uint32_t* seqs, int maxSeqs, bool* more);
+
+/* True if path names a sealed (no longer appended) segment. */
+bool shearsGpsStorageIsSealed(const char* path);
+
+/* Deletes a sealed segment. The head is never deleted. */
+bool shearsGpsStorageDeleteSegment(const char* path);
+
+/* Deletes every sealed segment and empties the head. */
+bool shearsGpsStorageClearAll(void);
+
+/* Copies the head segment path (for debug printing). */
+void shearsGpsStorageGetHeadPath(char* out, size_t outLen);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -7,49 +7,44 @@
  *   - blink while advertising / waiting for a BLE connection
  *   - solid ON while connected to the base
  *
- * Blinking is implemented in a dedicated FreeRTOS task so LED timing
- * never blocks BLE or sensor-related work.
+ * Blinking is driven by a one-shot esp_timer that re-arms itself, so the
+ * LED costs one wakeup per edge while blinking and none while solid.
  */
 
 #include "shears_led.h"
 
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "esp_timer.h"
 #include "driver/gpio.h"
 
-/* Handle for the LED task (kept for possible future control). */
-static TaskHandle_t ledTaskHandle = NULL;
+#include "shears_power.h"
+
+#define LED_BLINK_HALF_PERIOD_US  100000
+
+/* Timer that toggles the LED while blinking. */
+static esp_timer_handle_t blinkTimer = NULL;
 
 /* When true, the LED blinks. When false, the LED remains in a solid state. */
 static volatile bool ledBlinking = false;
 
-/* --- LED task ------------------------------------------------------------- */
+static bool ledOn = false;
+
+/* --- Blink timer ---------------------------------------------------------- */
 
-static void ledTask(void *arg)
+static void blinkTimerCb(void *arg)
 {
 	(void)arg;
 
-	while (1) {
-		if (ledBlinking) {
-			/* LED ON */
-			gpio_set_level(SHEARS_STATUS_LED_GPIO, 1);
-			vTaskDelay(pdMS_TO_TICKS(100));
-
-			/* Re-check before turning OFF so a recent state change
-			 * (e.g. connection established) is not overridden.
-			 */
-			if (!ledBlinking) {
-				continue;
-			}
-
-			/* LED OFF */
-			gpio_set_level(SHEARS_STATUS_LED_GPIO, 0);
-			vTaskDelay(pdMS_TO_TICKS(100));
-		} else {
-			/* Idle briefly and poll the blink flag again. */
-			vTaskDelay(pdMS_TO_TICKS(50));
-		}
+	shearsPowerCountWakeup(SHEARS_WAKE_TIMER);
+
+	/* A solid state set after this callback was queued wins. */
+	if (!ledBlinking) {
+		return;
 	}
+
+	ledOn = !ledOn;
+	gpio_set_level(SHEARS_STATUS_LED_GPIO, ledOn ? 1 : 0);
+
+	esp_timer_start_once(blinkTimer, LED_BLINK_HALF_PERIOD_US);
 }
 
 /* --- Public API ----------------------------------------------------------- */
@@ -69,30 +64,39 @@ void shearsLedInit(void)
 	/* Default to LED OFF at startup. */
 	gpio_set_level(SHEARS_STATUS_LED_GPIO, 0);
 
-	/* Start the background LED task. */
-	xTaskCreate(ledTask,
-	            "shears_led",
-	            2048,
-	            NULL,
-	            5,
-	            &ledTaskHandle);
+	const esp_timer_create_args_t blinkArgs = {
+		.callback = blinkTimerCb,
+		.name     = "shears_led"
+	};
+	esp_timer_create(&blinkArgs, &blinkTimer);
 }
 
 void shearsLedSetBlinking(bool enable)
 {
+	if (enable == ledBlinking) {
+		return;
+	}
+
 	ledBlinking = enable;
 
 	/* Solid ON/OFF state is controlled explicitly by the caller. */
+	if (enable) {
+		ledOn = true;
+		gpio_set_level(SHEARS_STATUS_LED_GPIO, 1);
+		esp_timer_start_once(blinkTimer, LED_BLINK_HALF_PERIOD_US);
+	} else {
+		esp_timer_stop(blinkTimer);
+	}
 }
 
 void shearsLedSetSolidOn(void)
 {
-	ledBlinking = false;
+	shearsLedSetBlinking(false);
 	gpio_set_level(SHEARS_STATUS_LED_GPIO, 1);
 }
 
 void shearsLedSetOff(void)
 {
-	ledBlinking = false;
+	shearsLedSetBlinking(false);
 	gpio_set_level(SHEARS_STATUS_LED_GPIO, 0);
 }
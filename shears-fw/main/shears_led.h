@@ -4,8 +4,7 @@
  * Status LED interface for the shears node.
  *
  * Provides GPIO configuration and a small control API for driving the
- * shears status LED. Blink timing is handled internally by a background
- * FreeRTOS task.
+ * shears status LED. Blink timing is handled internally by an esp_timer.
  */
 
 #pragma once
@@ -18,7 +17,7 @@
 
 /* --- Public API ----------------------------------------------------------- */
 
-/* Initializes the status LED and starts the background blink task. */
+/* Initializes the status LED and creates the blink timer. */
 void shearsLedInit(void);
 
 /* Enables or disables blinking mode. */
@@ -2,21 +2,19 @@
  * shears_piezo.c
  *
  * Piezo buzzer driver (LEDC) for the shears firmware.
+ *
+ * Only switches the tone on and off; beep patterns are timed by
+ * shears_feedback.c.
  */
 
 #include "shears_piezo.h"
 
 #include "driver/ledc.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
 #include "driver/gpio.h"
 
 #define PIEZO_PIN_A       GPIO_NUM_21
 #define PIEZO_PIN_B       GPIO_NUM_5
 
-#define BEEP_ON_MS        80
-#define BEEP_OFF_MS       80
-
 #define PIEZO_LEDC_TIMER      LEDC_TIMER_0
 #define PIEZO_LEDC_CHANNEL_A  LEDC_CHANNEL_0
 #define PIEZO_LEDC_CHANNEL_B  LEDC_CHANNEL_1
@@ -72,20 +70,3 @@ void shearsPiezoSet(bool enable)
 	              enable ? PIEZO_LEDC_DUTY : 0);
 	ledc_update_duty(PIEZO_LEDC_MODE, PIEZO_LEDC_CHANNEL_B);
 }
-
-void shearsPiezoBeepPattern(int count)
-{
-	for (int i = 0; i < count; i++) {
-		shearsPiezoSet(true);
-		vTaskDelay(pdMS_TO_TICKS(BEEP_ON_MS));
-		shearsPiezoSet(false);
-		vTaskDelay(pdMS_TO_TICKS(BEEP_OFF_MS));
-	}
-}
-
-void shearsPiezoToneMs(uint32_t durationMs)
-{
-	shearsPiezoSet(true);
-	vTaskDelay(pdMS_TO_TICKS(durationMs));
-	shearsPiezoSet(false);
-}
\ No newline at end of file
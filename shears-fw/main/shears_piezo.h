@@ -5,7 +5,8 @@
  *
  * Notes:
  * - Call shearsPiezoInit() once at startup before using anything else.
- * - These helpers use vTaskDelay(), so beep/tone calls block the caller task.
+ * - Patterns (beeps, long tones) are played without blocking by
+ *   shears_feedback.h; this driver only switches the tone.
  */
 
 #pragma once
@@ -20,15 +21,9 @@ extern "C" {
 /* Sets up LEDC + both piezo pins. Call once during init. */
 void shearsPiezoInit(void);
 
-/* Turns the tone on/off. Useful if you want manual control instead of patterns. */
+/* Turns the tone on/off. Safe to call from task or esp_timer context. */
 void shearsPiezoSet(bool enable);
 
-/* Plays N short beeps (count = 1,2,3...). Blocks while it plays. */
-void shearsPiezoBeepPattern(int count);
-
-/* Plays a steady tone for durationMs milliseconds. Blocks while it plays. */
-void shearsPiezoToneMs(uint32_t durationMs);
-
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
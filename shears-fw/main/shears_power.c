@@ -0,0 +1,162 @@
+/*
+ * shears_power.c
+ *
+ * Automatic light sleep for the shears and a periodic wakeup report.
+ *
+ * All awake reasons share one ESP_PM_NO_LIGHT_SLEEP lock; it is acquired
+ * when the first reason is set and released when the last one clears.
+ * Without CONFIG_PM_ENABLE the module only keeps the wakeup counters.
+ *
+ * Light sleep wakes on the GPIO levels armed by shears_gpsButtons (prime
+ * switch, GPS save/clear button, cut buttons) and on timers. The GNSS UART
+ * is not a wakeup source: NMEA only flows while primed, and priming holds
+ * SHEARS_AWAKE_PRIMED, so the chip never sleeps while it would arrive.
+ */
+
+#include "shears_power.h"
+
+#include <stdio.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#endif
+
+#define POWER_REPORT_PERIOD_US  (30 * 1000000LL)
+
+static const char *TAG = "shears_power";
+
+static const char *wakeSourceNames[SHEARS_WAKE_COUNT] = {
+	"save", "gps_uart", "timer", "gpio"
+};
+
+static uint32_t wakeCounts[SHEARS_WAKE_COUNT];
+static uint32_t awakeMask = 0;
+static portMUX_TYPE awakeMux = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t reportTimer = NULL;
+static int64_t lastReportUs = 0;
+
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t noSleepLock = NULL;
+#endif
+
+/* --- Wakeup report -------------------------------------------------------- */
+
+static void reportTimerCb(void *arg)
+{
+	(void)arg;
+
+	int64_t nowUs = esp_timer_get_time();
+	float seconds = (float)(nowUs - lastReportUs) / 1000000.0f;
+	lastReportUs = nowUs;
+
+	char perSource[SHEARS_WAKE_COUNT * 20];
+	int used = 0;
+	uint32_t total = 0;
+	for (int i = 0; i < SHEARS_WAKE_COUNT; i++) {
+		uint32_t count = __atomic_exchange_n(&wakeCounts[i], 0, __ATOMIC_RELAXED);
+		total += count;
+		if (used < (int)sizeof(perSource)) {
+			used += snprintf(perSource + used, sizeof(perSource) - used, "%s%s=%.2f",
+			                 i ? " " : "", wakeSourceNames[i], count / seconds);
+		}
+	}
+
+	ESP_LOGI(TAG, "Wakeups/s: %.2f (%s) awake=0x%02x",
+	         total / seconds, perSource, (unsigned)awakeMask);
+
+#if CONFIG_PM_PROFILING
+	/* Time spent per power mode since boot; light sleep share drives idle current. */
+	esp_pm_dump_locks(stdout);
+#endif
+}
+
+/* --- Public API ----------------------------------------------------------- */
+
+void shearsPowerInit(void)
+{
+#if CONFIG_PM_ENABLE
+	/* Without this, light sleep would sleep through a prime or button press. */
+	esp_err_t err = esp_sleep_enable_gpio_wakeup();
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "GPIO wakeup enable failed (%s)", esp_err_to_name(err));
+	}
+
+	esp_pm_config_t pmConfig = {
+		.max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+		.min_freq_mhz       = 40,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+		.light_sleep_enable = true
+#else
+		.light_sleep_enable = false
+#endif
+	};
+
+	err = esp_pm_configure(&pmConfig);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "esp_pm_configure failed (%s)", esp_err_to_name(err));
+	}
+
+	err = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "shears_awake", &noSleepLock);
+	if (err != ESP_OK) {
+		ESP_LOGE(TAG, "PM lock create failed (%s)", esp_err_to_name(err));
+	}
+
+	ESP_LOGI(TAG, "Power management on: %d-%d MHz, light sleep %s",
+	         pmConfig.min_freq_mhz, pmConfig.max_freq_mhz,
+	         pmConfig.light_sleep_enable ? "enabled" : "disabled");
+#if CONFIG_BTDM_CTRL_LPCLK_SEL_MAIN_XTAL
+	/* The controller then holds its "btLS" lock: no light sleep while BLE is up. */
+	ESP_LOGW(TAG, "BT sleep clock is the main crystal; light sleep only while BLE is off");
+#endif
+#else
+	ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off; running without light sleep");
+#endif
+
+	const esp_timer_create_args_t reportArgs = {
+		.callback = reportTimerCb,
+		.name     = "power_report"
+	};
+	esp_timer_create(&reportArgs, &reportTimer);
+
+	lastReportUs = esp_timer_get_time();
+	esp_timer_start_periodic(reportTimer, POWER_REPORT_PERIOD_US);
+}
+
+void shearsPowerSetAwake(shearsAwakeReason_t reason, bool awake)
+{
+	/* The lock calls stay inside the critical section so transitions cannot interleave. */
+	portENTER_CRITICAL_SAFE(&awakeMux);
+
+	uint32_t before = awakeMask;
+	awakeMask = awake ? (awakeMask | reason) : (awakeMask & ~(uint32_t)reason);
+
+#if CONFIG_PM_ENABLE
+	if (noSleepLock) {
+		if (before == 0 && awakeMask != 0) {
+			esp_pm_lock_acquire(noSleepLock);
+		} else if (before != 0 && awakeMask == 0) {
+			esp_pm_lock_release(noSleepLock);
+		}
+	}
+#else
+	(void)before;
+#endif
+
+	portEXIT_CRITICAL_SAFE(&awakeMux);
+}
+
+void IRAM_ATTR shearsPowerCountWakeup(shearsWakeSource_t source)
+{
+	if ((unsigned)source < SHEARS_WAKE_COUNT) {
+		__atomic_fetch_add(&wakeCounts[source], 1, __ATOMIC_RELAXED);
+	}
+}
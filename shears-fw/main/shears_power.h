@@ -0,0 +1,54 @@
+/*
+ * shears_power.h
+ *
+ * Power management for the shears firmware.
+ *
+ * With CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE (see
+ * sdkconfig.defaults) the chip drops into automatic light sleep whenever
+ * every task is blocked. Modules that need the chip awake (UART reception
+ * of NMEA while primed, LEDC tones) hold an awake reason while they need it.
+ *
+ * Event handlers call shearsPowerCountWakeup() so the periodic report can
+ * show how often the firmware actually wakes up.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Reasons for keeping light sleep off (bit mask, combined internally). */
+typedef enum {
+	SHEARS_AWAKE_PRIMED   = 1u << 0,   /* GNSS NMEA must be received intact */
+	SHEARS_AWAKE_FEEDBACK = 1u << 1    /* LEDC tone is playing */
+} shearsAwakeReason_t;
+
+/* Wakeup sources counted for the report. */
+typedef enum {
+	SHEARS_WAKE_SAVE_TASK = 0,
+	SHEARS_WAKE_GPS_UART,
+	SHEARS_WAKE_TIMER,
+	SHEARS_WAKE_GPIO,           /* Prime switch, GPS button or cut buttons */
+	SHEARS_WAKE_COUNT
+} shearsWakeSource_t;
+
+/*
+ * Configures DFS + automatic light sleep and starts the wakeup report.
+ * GPIO wakeup is enabled before light sleep; the pins themselves are armed
+ * by shearsGpsButtonsInit().
+ */
+void shearsPowerInit(void);
+
+/* Adds or removes one reason to stay out of light sleep. */
+void shearsPowerSetAwake(shearsAwakeReason_t reason, bool awake);
+
+/* Counts one wakeup from the given source. Safe from ISR and timer context. */
+void shearsPowerCountWakeup(shearsWakeSource_t source);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,13 +4,26 @@
 #include "esp_spiffs.h"
 #include "esp_err.h"
 
+#include "metrics.h"
+
 static const char* TAG = "shears_spiffs";
+static const char* PARTITION_LABEL = "storage";
+
+/* Snapshot sampler: usage is read from SPIFFS only when someone asks. */
+static void sampleUsage(void)
+{
+	size_t total = 0, used = 0;
+	if (esp_spiffs_info(PARTITION_LABEL, &total, &used) == ESP_OK) {
+		metrics_set(METRIC_SPIFFS_USED_BYTES, (uint32_t)used);
+		metrics_set(METRIC_SPIFFS_TOTAL_BYTES, (uint32_t)total);
+	}
+}
 
 bool shearsSpiffsInit(void)
 {
 	esp_vfs_spiffs_conf_t conf = {
 		.base_path = "/spiffs",
-		.partition_label = "storage",
+		.partition_label = PARTITION_LABEL,
 		.max_files = 5,
 		.format_if_mount_failed = true
 	};
@@ -35,5 +48,6 @@ bool shearsSpiffsInit(void)
 		ESP_LOGW(TAG, "Info failed (%s)", esp_err_to_name(ret));
 	}
 
+	metrics_set_sampler(sampleUsage);
 	return true;
 }
\ No newline at end of file